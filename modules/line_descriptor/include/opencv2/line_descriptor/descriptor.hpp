@@ -581,6 +581,8 @@ class CV_EXPORTS BinaryDescriptor : public Algorithm
 
     cv::Mat dirImg_;  //store the direction image
 
+    EdgeChains edges_;  //edge chains of the last image, kept to reuse their memory on the next one
+
     double logNT_;
 
     cv::Mat_<float> ATA;   //the previous matrix of A^T * A;
@@ -821,6 +823,13 @@ unsigned char binaryConversion( float* f1, float* f2 );
 /* compute LBD descriptors using EDLine extractor */
 int computeLBD( ScaleLines &keyLines, bool useDetectionData = false );
 
+/* compute LBD descriptors of the lines in range */
+void computeLBDLines( ScaleLines &keyLines, bool useDetectionData, const Range& range ) const;
+
+/* parallel line extraction over octaves and LBD computation over lines */
+class EDLineInvoker;
+class ComputeLBDInvoker;
+
 /* gathers lines in groups using EDLine extractor.
  Each group contains the same line, detected in different octaves */
 int OctaveKeyLines( cv::Mat& image, ScaleLines &keyLines );
@@ -1066,33 +1075,6 @@ BinaryDescriptorMatcher();
 }
 
 private:
-class BucketGroup
-{
-
-public:
-/** constructor */
-BucketGroup();
-
-/** destructor */
-~BucketGroup();
-
-/** insert data into the bucket */
-void insert( int subindex, UINT32 data );
-
-/** perform a query to the bucket */
-UINT32* query( int subindex, int *size );
-
-/** utility functions */
-void insert_value( std::vector<uint32_t>& vec, int index, UINT32 data );
-void push_value( std::vector<uint32_t>& vec, UINT32 Data );
-
-/** data fields */
-UINT32 empty;
-std::vector<uint32_t> group;
-
-
-};
-
 class SparseHashtable
 {
 
@@ -1101,8 +1083,11 @@ private:
 /** Maximum bits per key before folding the table */
 static const int MAX_B;
 
-/** Bins (each bin is an Array object for duplicates of the same key) */
-BucketGroup *table;
+/** Start of every bin in data: bin i holds data[offsets[i]] ... data[offsets[i + 1] - 1] */
+std::vector<UINT32> offsets;
+
+/** Contents of all the bins (indices of the codes), stored contiguously in bin order */
+std::vector<UINT32> data;
 
 public:
 
@@ -1115,11 +1100,11 @@ SparseHashtable();
 /** initializer */
 int init( int _b );
 
-/** insert data */
-void insert( UINT64 index, UINT32 data );
+/** fill the table with the indices of n keys (read every keyStep elements), replacing its content */
+void build( const UINT64* keys, int keyStep, UINT32 n );
 
 /** query data */
-UINT32* query( UINT64 index, int* size );
+const UINT32* query( UINT64 index, int* size ) const;
 
 /** Bits per index */
 int b;
@@ -1223,18 +1208,12 @@ UINT64 N;
 /** Table of original full-length codes */
 cv::Mat codes;
 
-/** Counter for eliminating duplicate results (it is not thread safe) */
-bitarray *counter;
-
 /** Array of m hashtables */
 SparseHashtable *H;
 
 /** Volume of a b-bit Hamming ball with radius s (for s = 0 to d) */
 UINT32 *xornum;
 
-/** Used within generation of binary codes at a certain Hamming distance */
-int power[100];
-
 /** constructor */
 Mihasher();
 
@@ -1250,15 +1229,20 @@ void setK( int K );
 /** populate tables */
 void populate( cv::Mat & codes, UINT32 N, int dim1codes );
 
-/** execute a batch query */
+/** execute a batch query, the queries are processed in parallel */
 void batchquery( UINT32 * results, UINT32 *numres/*, qstat *stats*/, const cv::Mat & q, UINT32 numq, int dim1queries );
 
 private:
 
-/** execute a single query */
-void query( UINT32 * results, UINT32* numres/*, qstat *stats*/, UINT8 *q, UINT64 * chunks, UINT32 * res );
+class BatchQueryInvoker;
+
+/** execute a single query, counter (for eliminating duplicate results), chunks and res are the caller's workspace */
+void query( UINT32 * results, UINT32* numres/*, qstat *stats*/, const UINT8 *q, UINT64 * chunks, UINT32 * res, bitarray& counter ) const;
 };
 
+/** return the index of the train descriptors, it is rebuilt only when they differ from the previous call */
+Mihasher* getTrainIndex( const Mat& trainDescriptors ) const;
+
 /** retrieve Hamming distances */
 void checkKDistances( UINT32 * numres, int k, std::vector<int>& k_distances, int row, int string_length ) const;
 
@@ -1280,6 +1264,12 @@ int numImages;
 /** number of descriptors in dataset */
 int descrInDS;
 
+/** index of the train descriptors of the last match call with a pair of images */
+mutable Ptr<Mihasher> trainIndex;
+
+/** guards trainIndex, which is shared by the const match calls */
+mutable Mutex trainIndexMutex;
+
 };
 
 /* --------------------------------------------------------------------------------------------
@@ -683,6 +683,29 @@ void BinaryDescriptor::computeImpl( const Mat& imageSrc, std::vector<KeyLine>& k
 
 }
 
+/* extraction of lines from every octave image, octaves are processed concurrently */
+class BinaryDescriptor::EDLineInvoker : public ParallelLoopBody
+{
+ public:
+  EDLineInvoker( std::vector<Ptr<EDLineDetector> >& _edLineVec, std::vector<cv::Mat>& _blurs, std::vector<int>& _results ) :
+      edLineVec( _edLineVec ), blurs( _blurs ), results( _results )
+  {
+  }
+
+  void operator()( const Range& range ) const
+  {
+    for ( int octaveCount = range.start; octaveCount < range.end; octaveCount++ )
+      results[octaveCount] = edLineVec[octaveCount]->EDline( blurs[octaveCount] );
+  }
+
+ private:
+  std::vector<Ptr<EDLineDetector> >& edLineVec;
+  std::vector<cv::Mat>& blurs;
+  std::vector<int>& results;
+
+  EDLineInvoker& operator=( const EDLineInvoker& );
+};
+
 int BinaryDescriptor::OctaveKeyLines( cv::Mat& image, ScaleLines &keyLines )
 {
 
@@ -694,28 +717,20 @@ int BinaryDescriptor::OctaveKeyLines( cv::Mat& image, ScaleLines &keyLines )
   float curSigma2 = 1.0;  //[sqrt(2)]^0=1;
   double factor = sqrt( 2 );  //the down sample factor between connective two octave images
 
-  /* loop over number of octaves */
+  /* matrices storing results from blurring processes */
+  std::vector<cv::Mat> blurs( params.numOfOctave_ );
+
+  /* loop over number of octaves: every octave image is obtained from the previous one */
   for ( int octaveCount = 0; octaveCount < params.numOfOctave_; octaveCount++ )
   {
-    /* matrix storing results from blurring processes */
-    cv::Mat blur;
-
     /* apply Gaussian blur */
     float increaseSigma = sqrt( curSigma2 - preSigma2 );
-    cv::GaussianBlur( image, blur, cv::Size( params.ksize_, params.ksize_ ), increaseSigma );
-    images_sizes[octaveCount] = blur.size();
-
-    /* for current octave, extract lines */
-    if( ( edLineVec_[octaveCount]->EDline( blur ) ) != 1 )
-    {
-      return -1;
-    }
-
-    /* update number of total extracted lines */
-    numOfFinalLine += edLineVec_[octaveCount]->lines_.numOfLines;
+    cv::GaussianBlur( image, blurs[octaveCount], cv::Size( params.ksize_, params.ksize_ ), increaseSigma );
+    images_sizes[octaveCount] = blurs[octaveCount].size();
 
     /* resize image for next level of pyramid */
-    cv::resize( blur, image, cv::Size(), ( 1.f / factor ), ( 1.f / factor ) );
+    if( octaveCount + 1 < params.numOfOctave_ )
+      cv::resize( blurs[octaveCount], image, cv::Size(), ( 1.f / factor ), ( 1.f / factor ) );
 
     /* update sigma values */
     preSigma2 = curSigma2;
@@ -723,6 +738,21 @@ int BinaryDescriptor::OctaveKeyLines( cv::Mat& image, ScaleLines &keyLines )
 
   } /* end of loop over number of octaves */
 
+  /* extract lines from all octaves, every octave has its own EDLineDetector */
+  std::vector<int> results( params.numOfOctave_ );
+  parallel_for_( Range( 0, params.numOfOctave_ ), EDLineInvoker( edLineVec_, blurs, results ) );
+
+  for ( int octaveCount = 0; octaveCount < params.numOfOctave_; octaveCount++ )
+  {
+    if( results[octaveCount] != 1 )
+    {
+      return -1;
+    }
+
+    /* update number of total extracted lines */
+    numOfFinalLine += edLineVec_[octaveCount]->lines_.numOfLines;
+  }
+
   /* prepare a vector to store octave information associated to extracted lines */
   std::vector < OctaveLine > octaveLines( numOfFinalLine );
 
@@ -1020,12 +1050,41 @@ int BinaryDescriptor::OctaveKeyLines( cv::Mat& image, ScaleLines &keyLines )
   return 1;
 }
 
+/* computation of LBD descriptors, lines are processed in parallel */
+class BinaryDescriptor::ComputeLBDInvoker : public ParallelLoopBody
+{
+ public:
+  ComputeLBDInvoker( const BinaryDescriptor& _bd, ScaleLines& _keyLines, bool _useDetectionData ) :
+      bd( _bd ), keyLines( _keyLines ), useDetectionData( _useDetectionData )
+  {
+  }
+
+  void operator()( const Range& range ) const
+  {
+    bd.computeLBDLines( keyLines, useDetectionData, range );
+  }
+
+ private:
+  const BinaryDescriptor& bd;
+  ScaleLines& keyLines;
+  bool useDetectionData;
+
+  ComputeLBDInvoker& operator=( const ComputeLBDInvoker& );
+};
+
 int BinaryDescriptor::computeLBD( ScaleLines &keyLines, bool useDetectionData )
+{
+  /* the descriptors of different lines are independent */
+  parallel_for_( Range( 0, (int) keyLines.size() ), ComputeLBDInvoker( *this, keyLines, useDetectionData ) );
+
+  return 1;
+}
+
+void BinaryDescriptor::computeLBDLines( ScaleLines &keyLines, bool useDetectionData, const Range& range ) const
 {
   //the default length of the band is the line length.
-  short numOfFinalLine = (short) keyLines.size();
-  float *dL = new float[2];  //line direction cos(dir), sin(dir)
-  float *dO = new float[2];  //the clockwise orthogonal vector of line direction.
+  float dL[2];  //line direction cos(dir), sin(dir)
+  float dO[2];  //the clockwise orthogonal vector of line direction.
   short heightOfLSP = (short) ( params.widthOfBand_ * NUM_OF_BANDS );  //the height of line support region;
   short descriptor_size = NUM_OF_BANDS * 8;  //each band, we compute the m( pgdL, ngdL,  pgdO, ngdO) and std( pgdL, ngdL,  pgdO, ngdO);
   float pgdLRowSum;  //the summation of {g_dL |g_dL>0 } for each row of the region;
@@ -1037,14 +1096,14 @@ int BinaryDescriptor::computeLBD( ScaleLines &keyLines, bool useDetectionData )
   float pgdO2RowSum;  //the summation of {g_dO^2 |g_dO>0 } for each row of the region;
   float ngdO2RowSum;  //the summation of {g_dO^2 |g_dO<0 } for each row of the region;
 
-  float *pgdLBandSum = new float[NUM_OF_BANDS];  //the summation of {g_dL |g_dL>0 } for each band of the region;
-  float *ngdLBandSum = new float[NUM_OF_BANDS];  //the summation of {g_dL |g_dL<0 } for each band of the region;
-  float *pgdL2BandSum = new float[NUM_OF_BANDS];  //the summation of {g_dL^2 |g_dL>0 } for each band of the region;
-  float *ngdL2BandSum = new float[NUM_OF_BANDS];  //the summation of {g_dL^2 |g_dL<0 } for each band of the region;
-  float *pgdOBandSum = new float[NUM_OF_BANDS];  //the summation of {g_dO |g_dO>0 } for each band of the region;
-  float *ngdOBandSum = new float[NUM_OF_BANDS];  //the summation of {g_dO |g_dO<0 } for each band of the region;
-  float *pgdO2BandSum = new float[NUM_OF_BANDS];  //the summation of {g_dO^2 |g_dO>0 } for each band of the region;
-  float *ngdO2BandSum = new float[NUM_OF_BANDS];  //the summation of {g_dO^2 |g_dO<0 } for each band of the region;
+  float pgdLBandSum[NUM_OF_BANDS];  //the summation of {g_dL |g_dL>0 } for each band of the region;
+  float ngdLBandSum[NUM_OF_BANDS];  //the summation of {g_dL |g_dL<0 } for each band of the region;
+  float pgdL2BandSum[NUM_OF_BANDS];  //the summation of {g_dL^2 |g_dL>0 } for each band of the region;
+  float ngdL2BandSum[NUM_OF_BANDS];  //the summation of {g_dL^2 |g_dL<0 } for each band of the region;
+  float pgdOBandSum[NUM_OF_BANDS];  //the summation of {g_dO |g_dO>0 } for each band of the region;
+  float ngdOBandSum[NUM_OF_BANDS];  //the summation of {g_dO |g_dO<0 } for each band of the region;
+  float pgdO2BandSum[NUM_OF_BANDS];  //the summation of {g_dO^2 |g_dO>0 } for each band of the region;
+  float ngdO2BandSum[NUM_OF_BANDS];  //the summation of {g_dO^2 |g_dO<0 } for each band of the region;
 
   short numOfBitsBand = NUM_OF_BANDS * sizeof(float);
   short lengthOfLSP;  //the length of line support region, varies with lines
@@ -1059,14 +1118,14 @@ int BinaryDescriptor::computeLBD( ScaleLines &keyLines, bool useDetectionData )
   float gDL;  //store the gradient projection of pixels in support region along dL vector
   float gDO;  //store the gradient projection of pixels in support region along dO vector
   short imageWidth, imageHeight, realWidth;
-  short *pdxImg, *pdyImg;
+  const short *pdxImg, *pdyImg;
   float *desVec;
 
   short sameLineSize;
   short octaveCount;
   OctaveSingleLine *pSingleLine;
   /* loop over list of LineVec */
-  for ( short lineIDInScaleVec = 0; lineIDInScaleVec < numOfFinalLine; lineIDInScaleVec++ )
+  for ( short lineIDInScaleVec = (short) range.start; lineIDInScaleVec < range.end; lineIDInScaleVec++ )
   {
     sameLineSize = (short) ( keyLines[lineIDInScaleVec].size() );
     /* loop over current LineVec's lines */
@@ -1339,33 +1398,8 @@ int BinaryDescriptor::computeLBD( ScaleLines &keyLines, bool useDetectionData )
     }/* end for(short lineIDInSameLine = 0; lineIDInSameLine<sameLineSize;
      lineIDInSameLine++) */
 
-    cv::Mat appoggio = cv::Mat( 1, 32, CV_32FC1 );
-    float* pointerToRow = appoggio.ptr<float>( 0 );
-    for ( int g = 0; g < 32; g++ )
-    {
-      /* get LBD data */
-      float* des_Vec = keyLines[lineIDInScaleVec][0].descriptor.data();
-      *pointerToRow = des_Vec[g];
-      pointerToRow++;
-
-    }
-
   }/* end for(short lineIDInScaleVec = 0;
    lineIDInScaleVec<numOfFinalLine; lineIDInScaleVec++) */
-
-  delete[] dL;
-  delete[] dO;
-  delete[] pgdLBandSum;
-  delete[] ngdLBandSum;
-  delete[] pgdL2BandSum;
-  delete[] ngdL2BandSum;
-  delete[] pgdOBandSum;
-  delete[] ngdOBandSum;
-  delete[] pgdO2BandSum;
-  delete[] ngdO2BandSum;
-
-  return 1;
-
 }
 
 BinaryDescriptor::EDLineDetector::EDLineDetector()
@@ -2239,8 +2273,8 @@ int BinaryDescriptor::EDLineDetector::EdgeDrawing( cv::Mat &image, EdgeChains &e
 int BinaryDescriptor::EDLineDetector::EDline( cv::Mat &image, LineChains &lines )
 {
 
-  //first, call EdgeDrawing function to extract edges
-  EdgeChains edges;
+  //first, call EdgeDrawing function to extract edges, the chains reuse the memory of the previous image
+  EdgeChains& edges = edges_;
   if( ( EdgeDrawing( image, edges ) ) != 1 )
   {
     std::cout << "Line Detection not finished" << std::endl;
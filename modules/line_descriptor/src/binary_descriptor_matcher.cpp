@@ -42,8 +42,6 @@
 #include "precomp.hpp"
 
 #define MAX_B 37
-double ARRAY_RESIZE_FACTOR = 1.1;    // minimum is 1.0
-double ARRAY_RESIZE_ADD_FACTOR = 4;  // minimum is 1
 
 //using namespace cv;
 namespace cv
@@ -101,6 +99,29 @@ void BinaryDescriptorMatcher::clear()
   nextAddedIndex = 0;
   numImages = 0;
   descrInDS = 0;
+
+  AutoLock lock( trainIndexMutex );
+  trainIndex.release();
+}
+
+/* return the index of train descriptors, rebuilding it only when they differ
+ from the ones indexed by the previous call */
+BinaryDescriptorMatcher::Mihasher* BinaryDescriptorMatcher::getTrainIndex( const Mat& trainDescriptors ) const
+{
+  bool sameCodes = !trainIndex.empty() && trainIndex->codes.size() == trainDescriptors.size()
+      && trainIndex->codes.type() == trainDescriptors.type();
+  size_t rowSize = trainDescriptors.cols * trainDescriptors.elemSize();
+  for ( int i = 0; sameCodes && i < trainDescriptors.rows; i++ )
+    sameCodes = memcmp( trainIndex->codes.ptr( i ), trainDescriptors.ptr( i ), rowSize ) == 0;
+
+  if( !sameCodes )
+  {
+    trainIndex = makePtr<Mihasher>( 256, 32 );
+    Mat copy = trainDescriptors.clone();
+    trainIndex->populate( copy, copy.rows, copy.cols );
+  }
+
+  return trainIndex.get();
 }
 
 /* retrieve Hamming distances */
@@ -211,12 +232,9 @@ void BinaryDescriptorMatcher::match( const Mat& queryDescriptors, const Mat& tra
     return;
   }
 
-  /* create a new mihasher object */
-  Mihasher *mh = new Mihasher( 256, 32 );
-
-  /* populate mihasher */
-  cv::Mat copy = trainDescriptors.clone();
-  mh->populate( copy, copy.rows, copy.cols );
+  /* get the index of train descriptors, it is reused if they did not change since the previous call */
+  AutoLock lock( trainIndexMutex );
+  Mihasher *mh = getTrainIndex( trainDescriptors );
   mh->setK( 1 );
 
   /* prepare structures for query */
@@ -247,7 +265,6 @@ void BinaryDescriptorMatcher::match( const Mat& queryDescriptors, const Mat& tra
   }
 
   /* delete data */
-  delete mh;
   delete[] results;
   delete[] numres;
 
@@ -273,12 +290,9 @@ void BinaryDescriptorMatcher::knnMatch( const Mat& queryDescriptors, const Mat&
     return;
   }
 
-  /* create a new mihasher object */
-  Mihasher *mh = new Mihasher( 256, 32 );
-
-  /* populate mihasher */
-  cv::Mat copy = trainDescriptors.clone();
-  mh->populate( copy, copy.rows, copy.cols );
+  /* get the index of train descriptors, it is reused if they did not change since the previous call */
+  AutoLock lock( trainIndexMutex );
+  Mihasher *mh = getTrainIndex( trainDescriptors );
 
   /* set K */
   mh->setK( k );
@@ -329,7 +343,6 @@ void BinaryDescriptorMatcher::knnMatch( const Mat& queryDescriptors, const Mat&
   }
 
   /* delete data */
-  delete mh;
   delete[] results;
   delete[] numres;
 }
@@ -444,13 +457,9 @@ void BinaryDescriptorMatcher::radiusMatch( const Mat& queryDescriptors, const Ma
     return;
   }
 
-  /* create a new Mihasher */
-  Mihasher* mh = new Mihasher( 256, 32 );
-
-  /* populate Mihasher */
-  //Mat copy = queryDescriptors.clone();
-  Mat copy = trainDescriptors.clone();
-  mh->populate( copy, copy.rows, copy.cols );
+  /* get the index of train descriptors, it is reused if they did not change since the previous call */
+  AutoLock lock( trainIndexMutex );
+  Mihasher *mh = getTrainIndex( trainDescriptors );
 
   /* set K */
   mh->setK( trainDescriptors.rows );
@@ -498,7 +507,6 @@ void BinaryDescriptorMatcher::radiusMatch( const Mat& queryDescriptors, const Ma
   }
 
   /* delete data */
-  delete mh;
   delete[] results;
   delete[] numres;
 }
@@ -592,47 +600,49 @@ void BinaryDescriptorMatcher::radiusMatch( const Mat& queryDescriptors, std::vec
 
 }
 
-/* execute a batch query */
-void BinaryDescriptorMatcher::Mihasher::batchquery( UINT32 * results, UINT32 *numres, const cv::Mat & queries, UINT32 numq, int dim1queries )
+/* parallel execution of a batch query, every stripe has its own workspace */
+class BinaryDescriptorMatcher::Mihasher::BatchQueryInvoker : public ParallelLoopBody
 {
-  /* create and initialize a bitarray */
-  counter = new bitarray;
-  counter->init( N );
-
-  UINT32 *res = new UINT32[K * ( D + 1 )];
-  UINT64 *chunks = new UINT64[m];
-  UINT32 * presults = results;
-  UINT32 *pnumres = numres;
-
-  /* make a copy of input queries */
-  cv::Mat queries_clone = queries.clone();
-
-  /* set a pointer to first query (row) */
-  UINT8 *pq = queries_clone.ptr();
-
-  /* loop over number of descriptors */
-  for ( size_t i = 0; i < numq; i++ )
+ public:
+  BatchQueryInvoker( const Mihasher& _mh, UINT32 * _results, UINT32 * _numres, const cv::Mat & _queries ) :
+      mh( _mh ), results( _results ), numres( _numres ), queries( _queries )
   {
-    /* for every descriptor, query database */
-    query( presults, pnumres, pq, chunks, res );
+  }
 
-    /* move pointer to write next K indeces */
-    presults += K;
-    pnumres += B + 1;
+  void operator()( const Range& range ) const
+  {
+    /* bitarray for eliminating duplicate results */
+    bitarray counter;
+    counter.init( mh.N );
 
-    /* move forward pointer to current row in descriptors matrix */
-    pq += dim1queries;
+    AutoBuffer<UINT32> res( (size_t) mh.K * ( mh.D + 1 ) );
+    AutoBuffer<UINT64> chunks( mh.m );
 
+    for ( int i = range.start; i < range.end; i++ )
+      mh.query( results + (size_t) i * mh.K, numres + (size_t) i * ( mh.B + 1 ), queries.ptr( i ), chunks, res, counter );
   }
 
-  delete[] res;
-  delete[] chunks;
+ private:
+  const Mihasher& mh;
+  UINT32 * results;
+  UINT32 * numres;
+  const cv::Mat & queries;
 
-  delete counter;
+  BatchQueryInvoker& operator=( const BatchQueryInvoker& );
+};
+
+/* execute a batch query */
+void BinaryDescriptorMatcher::Mihasher::batchquery( UINT32 * results, UINT32 *numres, const cv::Mat & queries, UINT32 numq, int dim1queries )
+{
+  CV_Assert( (int) numq <= queries.rows && dim1queries == queries.cols );
+
+  /* queries are independent, process them in stripes of a few dozens */
+  parallel_for_( Range( 0, (int) numq ), BatchQueryInvoker( *this, results, numres, queries ), numq / 32.0 );
 }
 
 /* execute a single query */
-void BinaryDescriptorMatcher::Mihasher::query( UINT32* results, UINT32* numres, UINT8 * Query, UINT64 *chunks, UINT32 *res )
+void BinaryDescriptorMatcher::Mihasher::query( UINT32* results, UINT32* numres, const UINT8 * Query, UINT64 *chunks, UINT32 *res,
+                                               bitarray& counter ) const
 {
   /* if K == 0 that means we want everything to be processed.
    So maxres = N in that case. Otherwise K limits the results processed */
@@ -649,12 +659,15 @@ void BinaryDescriptorMatcher::Mihasher::query( UINT32* results, UINT32* numres,
   UINT32 nl = 0;
 
   UINT32 nd = 0;
-  UINT32 *arr;
+  const UINT32 *arr;
   int size = 0;
   UINT32 index;
   int hammd;
 
-  counter->erase();
+  /* used within generation of binary codes at a certain Hamming distance */
+  int power[100];
+
+  counter.erase();
   memset( numres, 0, ( B + 1 ) * sizeof ( *numres ) );
 
   split( chunks, Query, m, mplus, b );
@@ -712,9 +725,9 @@ void BinaryDescriptorMatcher::Mihasher::query( UINT32* results, UINT32* numres,
             for ( int c = 0; c < size; c++ )
             {
               index = arr[c];
-              if( !counter->get( index ) )
+              if( !counter.get( index ) )
               { /* if it is not a duplicate */
-                counter->set( index );
+                counter.set( index );
                 hammd = cv::line_descriptor::match( codes.ptr() + (UINT64) index * ( B_over_8 ), Query, B_over_8 );
 
                 nc++;
@@ -801,27 +814,20 @@ void BinaryDescriptorMatcher::Mihasher::populate( cv::Mat & _codes, UINT32 N_val
 {
   N = N_val;
   codes = _codes;
-  UINT64 * chunks = new UINT64[m];
 
+  /* split all the codes first, then fill every table in one pass */
+  std::vector<UINT64> chunks( (size_t) N * m );
   UINT8 * pcodes = codes.ptr();
   for ( UINT64 i = 0; i < N; i++, pcodes += dim1codes )
-  {
-    split( chunks, pcodes, m, mplus, b );
+    split( &chunks[(size_t) i * m], pcodes, m, mplus, b );
 
-    for ( int k = 0; k < m; k++ )
-      H[k].insert( chunks[k], (UINT32) i );
-
-    if( i % (int) ceil( N / 1000.0 ) == 0 )
-      fflush (stdout);
-  }
-
-  delete[] chunks;
+  for ( int k = 0; k < m; k++ )
+    H[k].build( N > 0 ? &chunks[k] : NULL, m, (UINT32) N );
 }
 
 /* constructor */
 BinaryDescriptorMatcher::SparseHashtable::SparseHashtable()
 {
-  table = NULL;
   size = 0;
   b = 0;
 }
@@ -834,8 +840,7 @@ int BinaryDescriptorMatcher::SparseHashtable::init( int _b )
   if( b < 5 || b > MAX_B || b > (int) ( sizeof(UINT64) * 8 ) )
     return 1;
 
-  size = UINT64_1 << ( b - 5 );  // size = 2 ^ b
-  table = (BucketGroup*) calloc( (size_t)size, sizeof(BucketGroup) );
+  size = UINT64_1 << b;  // size = 2 ^ b
 
   return 0;
 
@@ -844,128 +849,36 @@ int BinaryDescriptorMatcher::SparseHashtable::init( int _b )
 /* destructor */
 BinaryDescriptorMatcher::SparseHashtable::~SparseHashtable()
 {
-  free (table);
 }
 
-/* insert data */
-void BinaryDescriptorMatcher::SparseHashtable::insert( UINT64 index, UINT32 data )
+/* fill the bins with a counting sort of the keys: the bins are stored
+ one after another and each one lists its indices in increasing order */
+void BinaryDescriptorMatcher::SparseHashtable::build( const UINT64* keys, int keyStep, UINT32 n )
 {
-  table[index >> 5].insert( (int) ( index % 32 ), data );
+  offsets.assign( (size_t) size + 1, 0 );
+  for ( UINT32 i = 0; i < n; i++ )
+    offsets[(size_t) keys[(size_t) i * keyStep] + 1]++;
+  for ( UINT64 j = 0; j < size; j++ )
+    offsets[(size_t) j + 1] += offsets[(size_t) j];
+
+  std::vector<UINT32> pos( offsets.begin(), offsets.end() - 1 );
+  data.resize( n );
+  for ( UINT32 i = 0; i < n; i++ )
+    data[pos[(size_t) keys[(size_t) i * keyStep]]++] = i;
 }
 
 /* query data */
-UINT32* BinaryDescriptorMatcher::SparseHashtable::query( UINT64 index, int *Size )
-{
-  return table[index >> 5].query( (int) ( index % 32 ), Size );
-}
-
-/* constructor */
-BinaryDescriptorMatcher::BucketGroup::BucketGroup()
-{
-  empty = 0;
-  group = std::vector < uint32_t > ( 2, 0 );
-}
-
-/* destructor */
-BinaryDescriptorMatcher::BucketGroup::~BucketGroup()
-{
-}
-
-void BinaryDescriptorMatcher::BucketGroup::insert_value( std::vector<uint32_t>& vec, int index, UINT32 data )
+const UINT32* BinaryDescriptorMatcher::SparseHashtable::query( UINT64 index, int *Size ) const
 {
-  if( vec.size() > 1 )
+  if( offsets.empty() )
   {
-    if( vec[0] == vec[1] )
-    {
-      vec[1] = (UINT32) ceil( vec[0] * 1.1 );
-      for ( int i = 0; i < (int) ( 2 + vec[1] - vec.size() ); i++ )
-        vec.push_back( 0 );
-
-    }
-
-    vec.insert( vec.begin() + 2 + index, data );
-    vec[2 + index] = data;
-    vec[0]++;
-  }
-
-  else
-  {
-    vec = std::vector < uint32_t > ( 3, 0 );
-    vec[0] = 1;
-    vec[1] = 1;
-    vec[2] = data;
-  }
-}
-
-void BinaryDescriptorMatcher::BucketGroup::push_value( std::vector<uint32_t>& vec, UINT32 Data )
-{
-  if( vec.size() > 0 )
-  {
-    if( vec[0] == vec[1] )
-    {
-      vec[1] = (UINT32) std::max( ceil( vec[1] * ARRAY_RESIZE_FACTOR ), vec[1] + ARRAY_RESIZE_ADD_FACTOR );
-      for ( int i = 0; i < (int) ( 2 + vec[1] - vec.size() ); i++ )
-        vec.push_back( 0 );
-    }
-
-    vec[2 + vec[0]] = Data;
-    vec[0]++;
-
-  }
-
-  else
-  {
-    vec = std::vector < uint32_t > ( 2 + (uint32_t) ARRAY_RESIZE_ADD_FACTOR, 0 );
-    vec[0] = 1;
-    vec[1] = 1;
-    vec[2] = Data;
-  }
-}
-
-/* insert data into the bucket */
-void BinaryDescriptorMatcher::BucketGroup::insert( int subindex, UINT32 data )
-{
-  if( group.size() == 0 )
-  {
-    push_value( group, 0 );
-  }
-
-  UINT32 lowerbits = ( (UINT32) 1 << subindex ) - 1;
-  int end = popcnt( empty & lowerbits );
-
-  if( ! ( empty & ( (UINT32) 1 << subindex ) ) )
-  {
-    insert_value( group, end, group[end + 2] );
-    empty |= (UINT32) 1 << subindex;
-  }
-
-  int totones = popcnt( empty );
-  insert_value( group, totones + 1 + group[2 + end + 1], data );
-
-  for ( int i = end + 1; i < totones + 1; i++ )
-    group[2 + i]++;
-}
-
-/* perform a query to the bucket */
-UINT32* BinaryDescriptorMatcher::BucketGroup::query( int subindex, int *size )
-{
-  if( empty & ( (UINT32) 1 << subindex ) )
-  {
-    UINT32 lowerbits = ( (UINT32) 1 << subindex ) - 1;
-    int end = popcnt( empty & lowerbits );
-    int totones = popcnt( empty );
-
-    *size = group[2 + end + 1] - group[2 + end];
-    return & ( * ( group.begin() + 2 + totones + 1 + (int) group[2 + end] ) );
-  }
-
-  else
-  {
-    *size = 0;
+    *Size = 0;
     return NULL;
   }
+
+  *Size = (int) ( offsets[(size_t) index + 1] - offsets[(size_t) index] );
+  return *Size > 0 ? &data[offsets[(size_t) index]] : NULL;
 }
 
 }
 }
-
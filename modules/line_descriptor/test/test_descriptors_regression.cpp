@@ -372,3 +372,48 @@ TEST( BinaryDescriptor_Descriptors, regression )
   CV_BD_DescriptorsTest<Hamming> test( std::string( "lbd_descriptors_cameraman" ), 1 );
   test.safe_run();
 }
+
+TEST( BinaryDescriptor_Descriptors, parallel_consistency )
+{
+  std::string imgFilename = std::string( cvtest::TS::ptr()->get_data_path() ) + LINE_DESCRIPTOR_DIR + "/" + IMAGE_FILENAME;
+  Mat img = imread( imgFilename, IMREAD_GRAYSCALE );
+  ASSERT_FALSE( img.empty() );
+
+  int threads = getNumThreads();
+
+  /* several octaves, so that the lines of the pyramid levels are detected in parallel */
+  BinaryDescriptor::Params params;
+  params.numOfOctave_ = 3;
+  Ptr<BinaryDescriptor> bd = BinaryDescriptor::createBinaryDescriptor( params );
+
+  /* single threaded reference */
+  setNumThreads( 1 );
+  std::vector<KeyLine> keylinesRef;
+  Mat descriptorsRef;
+  bd->detect( img, keylinesRef );
+  bd->compute( img, keylinesRef, descriptorsRef );
+  setNumThreads( threads );
+
+  bool upperOctaves = false;
+  for ( size_t i = 0; i < keylinesRef.size(); i++ )
+    upperOctaves = upperOctaves || keylinesRef[i].octave > 0;
+  ASSERT_TRUE( upperOctaves );
+
+  /* octaves and lines processed in parallel, the buffers of the previous image are reused */
+  for ( int iter = 0; iter < 2; iter++ )
+  {
+    std::vector<KeyLine> keylines;
+    Mat descriptors;
+    bd->detect( img, keylines );
+    bd->compute( img, keylines, descriptors );
+
+    ASSERT_EQ( keylinesRef.size(), keylines.size() );
+    for ( size_t i = 0; i < keylines.size(); i++ )
+    {
+      EXPECT_EQ( keylinesRef[i].octave, keylines[i].octave );
+      EXPECT_EQ( keylinesRef[i].startPointX, keylines[i].startPointX );
+      EXPECT_EQ( keylinesRef[i].endPointY, keylines[i].endPointY );
+    }
+    EXPECT_EQ( 0, cvtest::norm( descriptorsRef, descriptors, NORM_INF ) );
+  }
+}
@@ -577,3 +577,50 @@ TEST( BinaryDescriptor_Matcher, regression)
   CV_BinaryDescriptorMatcherTest test( 0.01f );
   test.safe_run();
 }
+
+TEST( BinaryDescriptor_Matcher, train_index_reuse )
+{
+  RNG rng( 0 );
+  Mat query( 100, 32, CV_8UC1 ), train( 400, 32, CV_8UC1 );
+  rng.fill( query, RNG::UNIFORM, Scalar( 0 ), Scalar( 256 ) );
+  rng.fill( train, RNG::UNIFORM, Scalar( 0 ), Scalar( 256 ) );
+
+  Ptr<BinaryDescriptorMatcher> cached = BinaryDescriptorMatcher::createBinaryDescriptorMatcher();
+  std::vector<DMatch> matches, matchesFresh;
+  BinaryDescriptorMatcher::createBinaryDescriptorMatcher()->match( query, train, matchesFresh );
+
+  /* the index built for train by the first call is reused by the second one */
+  for ( int iter = 0; iter < 2; iter++ )
+  {
+    matches.clear();
+    cached->match( query, train, matches );
+    ASSERT_EQ( matchesFresh.size(), matches.size() );
+    for ( size_t i = 0; i < matches.size(); i++ )
+    {
+      EXPECT_EQ( matchesFresh[i].trainIdx, matches[i].trainIdx );
+      EXPECT_EQ( matchesFresh[i].distance, matches[i].distance );
+    }
+  }
+
+  /* modifying the train descriptors in place must rebuild the index */
+  query.row( 0 ).copyTo( train.row( 123 ) );
+  matches.clear();
+  cached->match( query, train, matches );
+  ASSERT_EQ( query.rows, (int) matches.size() );
+  EXPECT_EQ( 123, matches[0].trainIdx );
+  EXPECT_EQ( 0.f, matches[0].distance );
+
+  std::vector<std::vector<DMatch> > knnCached, knnFresh;
+  cached->knnMatch( query, train, knnCached, 3 );
+  BinaryDescriptorMatcher::createBinaryDescriptorMatcher()->knnMatch( query, train, knnFresh, 3 );
+  ASSERT_EQ( knnFresh.size(), knnCached.size() );
+  for ( size_t i = 0; i < knnFresh.size(); i++ )
+  {
+    ASSERT_EQ( knnFresh[i].size(), knnCached[i].size() );
+    for ( size_t k = 0; k < knnFresh[i].size(); k++ )
+    {
+      EXPECT_EQ( knnFresh[i][k].trainIdx, knnCached[i][k].trainIdx );
+      EXPECT_EQ( knnFresh[i][k].distance, knnCached[i][k].distance );
+    }
+  }
+}
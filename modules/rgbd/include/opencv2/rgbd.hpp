@@ -483,6 +483,14 @@ namespace rgbd
     void
     releasePyramids();
 
+    /** Replace the frame data by a new one (e.g. the next frame of a sequence). The pyramids are released
+     * but their memory is kept in pyramidBuffers, so the cache of the new frame is prepared without
+     * reallocations when the resolution doesn't change. Only the buffers which are not referenced
+     * anywhere else are kept.
+     */
+    void
+    setFrame(const Mat& image, const Mat& depth, const Mat& mask=Mat(), const Mat& normals=Mat(), int ID=-1);
+
     std::vector<Mat> pyramidImage;
     std::vector<Mat> pyramidDepth;
     std::vector<Mat> pyramidMask;
@@ -495,6 +503,9 @@ namespace rgbd
 
     std::vector<Mat> pyramidNormals;
     std::vector<Mat> pyramidNormalsMask;
+
+    /** Memory of the released pyramids, reused by the next cache preparation */
+    std::vector<Mat> pyramidBuffers;
   };
 
   /** Base class for computation of odometry.
@@ -568,6 +579,25 @@ namespace rgbd
     bool
     compute(Ptr<OdometryFrame>& srcFrame, Ptr<OdometryFrame>& dstFrame, Mat& Rt, const Mat& initRt = Mat()) const;
 
+    /** Method to compute the transformation between the consecutive frames of a sequence.
+     * The cache of the destination frame of the previous call becomes the cache of the source frame, and
+     * the memory of the previous source frame is reused for the new destination frame (see OdometryFrame::setFrame).
+     * Pyramid levels which are already in a cache are not computed again, except the masks and normals of the
+     * previous destination frame when the odometry uses normals, which are rebuilt (in the same memory) as for a
+     * source frame so that the result equals compute().
+     * @param prevFrame Previous frame of the sequence, it is set to the destination frame of the previous call.
+     * @param frame Destination frame of the previous call, it is set to the new frame.
+     * @param image Image data of the new frame (CV_8UC1)
+     * @param depth Depth data of the new frame (CV_32FC1, in meters)
+     * @param mask Mask that sets which pixels have to be used from the new frame (CV_8UC1)
+     * @param Rt Resulting transformation from the previous frame to the new one (see compute).
+     * For the first frame of the sequence (when frame has no data) Rt is the identity and false is returned.
+     * @param initRt Initial transformation from the previous frame to the new one (optional)
+     */
+    bool
+    computeNext(Ptr<OdometryFrame>& prevFrame, Ptr<OdometryFrame>& frame,
+                const Mat& image, const Mat& depth, const Mat& mask, Mat& Rt, const Mat& initRt = Mat()) const;
+
     /** Prepare a cache for the frame. The function checks the precomputed/passed data (throws the error if this data
      * does not satisfy) and computes all remaining cache data needed for the frame. Returned size is a resolution
      * of the prepared frame.
@@ -401,7 +401,7 @@ public:
 
   int numTemplates() const;
   int numTemplates(const String& class_id) const;
-  int numClasses() const { return static_cast<int>(class_templates.size()); }
+  int numClasses() const;
 
   std::vector<String> classIds() const;
 
@@ -415,6 +415,31 @@ public:
                    const String& format = "templates_%s.yml.gz");
   void writeClasses(const String& format = "templates_%s.yml.gz") const;
 
+  /**
+   * \brief Write all the classes into a single packed binary file.
+   *
+   * The features of the templates of a class are stored as one contiguous array, and an
+   * index at the end of the file locates every class, so they can be read individually.
+   */
+  void writeClassesBinary(const String& filename) const;
+
+  /**
+   * \brief Add the classes of a file written by writeClassesBinary().
+   *
+   * \param filename Binary template file.
+   * \param lazy     If true, only the index of the file is read here and the templates of
+   *                 a class are loaded the first time they are needed, e.g. when match()
+   *                 searches for the class. Otherwise all the templates are loaded at once.
+   *
+   * The const methods (match(), getTemplates(), numTemplates(), numClasses(), classIds()) may
+   * be called concurrently, they serialize the lazy loading and their accesses to the templates.
+   * Methods adding or reading classes must not run concurrently with any other call.
+   *
+   * The values are stored in the byte order of the host which wrote the file, a file written
+   * on a host with the other byte order is rejected.
+   */
+  void readClassesBinary(const String& filename, bool lazy = true);
+
 protected:
   std::vector< Ptr<Modality> > modalities;
   int pyramid_levels;
@@ -422,7 +447,27 @@ protected:
 
   typedef std::vector<Template> TemplatePyramid;
   typedef std::map<String, std::vector<TemplatePyramid> > TemplatesMap;
-  TemplatesMap class_templates;
+  // Mutable as the classes of a binary template file are loaded on first use
+  mutable TemplatesMap class_templates;
+
+  /// Location of a class in a binary template file, not loaded yet
+  struct BinaryClass
+  {
+    String filename;
+    int num_templates;
+    int64 offset;
+    int64 size;
+  };
+  mutable std::map<String, BinaryClass> pending_classes;
+
+  // Guards the loading of the pending classes, the const accessors of the templates take it
+  // too as a load modifies the template maps
+  Ptr<Mutex> templates_mutex;
+
+  /**
+   * \brief Load the pending classes among class_ids, or all of them if class_ids is empty.
+   */
+  void loadPendingClasses(const std::vector<String>& class_ids) const;
 
   typedef std::vector<Mat> LinearMemories;
   // Indexed as [pyramid level][modality][quantized label]
@@ -42,6 +42,10 @@
 
 #include "precomp.hpp"
 
+#ifndef _WIN32
+#include <sys/types.h> // off_t
+#endif
+
 namespace cv
 {
 namespace linemod
@@ -1041,6 +1045,9 @@ static void computeResponseMaps(const Mat& src, std::vector<Mat>& response_maps)
 
 #if CV_SSSE3
   volatile bool haveSSSE3 = checkHardwareSupport(CV_CPU_SSSE3);
+#if CV_AVX2
+  volatile bool haveAVX2 = checkHardwareSupport(CV_CPU_AVX2);
+#endif
   if (haveSSSE3)
   {
     const __m128i* lut = reinterpret_cast<const __m128i*>(SIMILARITY_LUT);
@@ -1049,9 +1056,25 @@ static void computeResponseMaps(const Mat& src, std::vector<Mat>& response_maps)
       __m128i* map_data = response_maps[ori].ptr<__m128i>();
       __m128i* lsb4_data = lsb4.ptr<__m128i>();
       __m128i* msb4_data = msb4.ptr<__m128i>();
+      int i = 0;
+
+#if CV_AVX2
+      if (haveAVX2)
+      {
+        // VPSHUFB looks up each 128-bit lane separately, so both lanes get a copy of the LUT
+        __m256i lut_low = _mm256_inserti128_si256(_mm256_castsi128_si256(lut[2*ori + 0]), lut[2*ori + 0], 1);
+        __m256i lut_hi = _mm256_inserti128_si256(_mm256_castsi128_si256(lut[2*ori + 1]), lut[2*ori + 1], 1);
+        for ( ; i < (src.rows * src.cols) / 16 - 1; i += 2)
+        {
+          __m256i res1 = _mm256_shuffle_epi8(lut_low, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(lsb4_data + i)));
+          __m256i res2 = _mm256_shuffle_epi8(lut_hi, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(msb4_data + i)));
+          _mm256_storeu_si256(reinterpret_cast<__m256i*>(map_data + i), _mm256_max_epu8(res1, res2));
+        }
+      }
+#endif
 
       // Precompute the 2D response map S_i (section 2.4)
-      for (int i = 0; i < (src.rows * src.cols) / 16; ++i)
+      for ( ; i < (src.rows * src.cols) / 16; ++i)
       {
         // Using SSE shuffle for table lookup on 4 orientations at a time
         // The most/least significant 4 bits are used as the LUT index
@@ -1193,7 +1216,9 @@ static void similarity(const std::vector<Mat>& linear_memories, const Template&
 
   /// @todo In old code, dst is buffer of size m_U. Could make it something like
   /// (span_x)x(span_y) instead?
-  dst = Mat::zeros(H, W, CV_8U);
+  // Reuse the memory of dst, it is the same size for all the templates matched at a level
+  dst.create(H, W, CV_8U);
+  dst = Scalar::all(0);
   uchar* dst_ptr = dst.ptr<uchar>();
 
 #if CV_SSE2
@@ -1201,6 +1226,9 @@ static void similarity(const std::vector<Mat>& linear_memories, const Template&
 #if CV_SSE3
   volatile bool haveSSE3 = checkHardwareSupport(CV_CPU_SSE3);
 #endif
+#endif
+#if CV_AVX2
+  volatile bool haveAVX2 = checkHardwareSupport(CV_CPU_AVX2);
 #endif
 
   // Compute the similarity measure for this template by accumulating the contribution of
@@ -1218,6 +1246,18 @@ static void similarity(const std::vector<Mat>& linear_memories, const Template&
 
     // Now we do an aligned/unaligned add of dst_ptr and lm_ptr with template_positions elements
     int j = 0;
+#if CV_AVX2
+    // Process responses 32 at a time, the remaining ones are left to the SSE loops
+    if (haveAVX2)
+    {
+      for ( ; j < template_positions - 31; j += 32)
+      {
+        __m256i responses = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(lm_ptr + j));
+        __m256i* dst_ptr_avx = reinterpret_cast<__m256i*>(dst_ptr + j);
+        _mm256_storeu_si256(dst_ptr_avx, _mm256_add_epi8(_mm256_loadu_si256(dst_ptr_avx), responses));
+      }
+    }
+#endif
     // Process responses 16 at a time if vectorization possible
 #if CV_SSE2
 #if CV_SSE3
@@ -1268,7 +1308,8 @@ static void similarityLocal(const std::vector<Mat>& linear_memories, const Templ
 
   // Compute the similarity map in a 16x16 patch around center
   int W = size.width / T;
-  dst = Mat::zeros(16, 16, CV_8U);
+  dst.create(16, 16, CV_8U);
+  dst = Scalar::all(0);
 
   // Offset each feature point by the requested center. Further adjust to (-8,-8) from the
   // center to get the top-left corner of the 16x16 patch.
@@ -1283,6 +1324,9 @@ static void similarityLocal(const std::vector<Mat>& linear_memories, const Templ
 #endif
   __m128i* dst_ptr_sse = dst.ptr<__m128i>();
 #endif
+#if CV_AVX2
+  volatile bool haveAVX2 = checkHardwareSupport(CV_CPU_AVX2);
+#endif
 
   for (int i = 0; i < (int)templ.features.size(); ++i)
   {
@@ -1296,6 +1340,22 @@ static void similarityLocal(const std::vector<Mat>& linear_memories, const Templ
     const uchar* lm_ptr = accessLinearMemory(linear_memories, f, T, W);
 
     // Process whole row at a time if vectorization possible
+#if CV_AVX2
+    if (haveAVX2)
+    {
+      // The 16-byte rows of dst are contiguous, add two of them at once
+      __m256i* dst_ptr_avx = dst.ptr<__m256i>();
+      for (int row = 0; row < 8; ++row)
+      {
+        __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lm_ptr));
+        __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lm_ptr + W));
+        __m256i responses = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+        _mm256_storeu_si256(dst_ptr_avx + row, _mm256_add_epi8(_mm256_loadu_si256(dst_ptr_avx + row), responses));
+        lm_ptr += 2 * W; // Step to next pair of rows
+      }
+    }
+    else
+#endif
 #if CV_SSE2
 #if CV_SSE3
     if (haveSSE3)
@@ -1337,16 +1397,45 @@ static void similarityLocal(const std::vector<Mat>& linear_memories, const Templ
 
 static void addUnaligned8u16u(const uchar * src1, const uchar * src2, ushort * res, int length)
 {
-  const uchar * end = src1 + length;
+  int i = 0;
 
-  while (src1 != end)
+#if CV_AVX2
+  volatile bool haveAVX2 = checkHardwareSupport(CV_CPU_AVX2);
+  if (haveAVX2)
   {
-    *res = *src1 + *src2;
+    // Widen 16 responses of each source to 16 bits and add them
+    for ( ; i < length - 15; i += 16)
+    {
+      __m256i a = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src1 + i)));
+      __m256i b = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src2 + i)));
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(res + i), _mm256_add_epi16(a, b));
+    }
+  }
+#endif
+
+  for ( ; i < length; ++i)
+    res[i] = static_cast<ushort>(src1[i] + src2[i]);
+}
+
+static void addUnaligned16u8u(const uchar * src, ushort * res, int length)
+{
+  int i = 0;
 
-    ++src1;
-    ++src2;
-    ++res;
+#if CV_AVX2
+  volatile bool haveAVX2 = checkHardwareSupport(CV_CPU_AVX2);
+  if (haveAVX2)
+  {
+    for ( ; i < length - 15; i += 16)
+    {
+      __m256i a = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)));
+      __m256i* res_ptr = reinterpret_cast<__m256i*>(res + i);
+      _mm256_storeu_si256(res_ptr, _mm256_add_epi16(_mm256_loadu_si256(res_ptr), a));
+    }
   }
+#endif
+
+  for ( ; i < length; ++i)
+    res[i] = static_cast<ushort>(res[i] + src[i]);
 }
 
 /**
@@ -1367,9 +1456,8 @@ static void addSimilarities(const std::vector<Mat>& similarities, Mat& dst)
     dst.create(similarities[0].size(), CV_16U);
     addUnaligned8u16u(similarities[0].ptr(), similarities[1].ptr(), dst.ptr<ushort>(), static_cast<int>(dst.total()));
 
-    /// @todo Optimize 16u + 8u -> 16u when more than 2 modalities
     for (size_t i = 2; i < similarities.size(); ++i)
-      add(dst, similarities[i], dst, noArray(), CV_16U);
+      addUnaligned16u8u(similarities[i].ptr(), dst.ptr<ushort>(), static_cast<int>(dst.total()));
   }
 }
 
@@ -1378,6 +1466,7 @@ static void addSimilarities(const std::vector<Mat>& similarities, Mat& dst)
 \****************************************************************************************/
 
 Detector::Detector()
+  : templates_mutex(makePtr<Mutex>())
 {
 }
 
@@ -1385,10 +1474,305 @@ Detector::Detector(const std::vector< Ptr<Modality> >& _modalities,
                    const std::vector<int>& T_pyramid)
   : modalities(_modalities),
     pyramid_levels(static_cast<int>(T_pyramid.size())),
-    T_at_level(T_pyramid)
+    T_at_level(T_pyramid),
+    templates_mutex(makePtr<Mutex>())
 {
 }
 
+// Used to filter out weak matches
+struct MatchPredicate
+{
+  MatchPredicate(float _threshold) : threshold(_threshold) {}
+  bool operator() (const Match& m) { return m.similarity < threshold; }
+  float threshold;
+};
+
+/**
+ * \brief Score buffers of the template matching, reused across the templates matched by one thread.
+ */
+struct MatchBuffers
+{
+  std::vector<Mat> similarities;
+  Mat total_similarity;
+  std::vector<Mat> similarities2;
+  Mat total_similarity2;
+};
+
+/**
+ * \brief Match a single template pyramid against the linear memories of the input image.
+ *
+ * \param[in]  detector    Detector owning the template.
+ * \param[in]  lm_pyramid  Linear memories, pyramid level -> modality -> label.
+ * \param[in]  sizes       Size of the input image at each pyramid level.
+ * \param      threshold   Similarity threshold, a percentage between 0 and 100.
+ * \param[in]  class_id    Class of the template.
+ * \param      template_id Index of the template within its class.
+ * \param[in]  tp          Template pyramid, modality templates of each level in order.
+ * \param      buffers     Score buffers of the calling thread.
+ * \param[out] candidates  Matches of the template.
+ */
+static void matchTemplate(const Detector& detector,
+                          const std::vector< std::vector< std::vector<Mat> > >& lm_pyramid,
+                          const std::vector<Size>& sizes, float threshold,
+                          const String& class_id, int template_id,
+                          const std::vector<Template>& tp,
+                          MatchBuffers& buffers, std::vector<Match>& candidates)
+{
+  int num_modalities = static_cast<int>(detector.getModalities().size());
+  int pyramid_levels = detector.pyramidLevels();
+
+  // First match over the whole image at the lowest pyramid level
+  /// @todo Factor this out into separate function
+  const std::vector< std::vector<Mat> >& lowest_lm = lm_pyramid.back();
+
+  // Compute similarity maps for each modality at lowest pyramid level
+  std::vector<Mat>& similarities = buffers.similarities;
+  similarities.resize(num_modalities);
+  int lowest_start = static_cast<int>(tp.size()) - num_modalities;
+  int lowest_T = detector.getT(pyramid_levels - 1);
+  int num_features = 0;
+  for (int i = 0; i < num_modalities; ++i)
+  {
+    const Template& templ = tp[lowest_start + i];
+    num_features += static_cast<int>(templ.features.size());
+    similarity(lowest_lm[i], templ, similarities[i], sizes.back(), lowest_T);
+  }
+
+  // Combine into overall similarity
+  /// @todo Support weighting the modalities
+  Mat& total_similarity = buffers.total_similarity;
+  addSimilarities(similarities, total_similarity);
+
+  // Convert user-friendly percentage to raw similarity threshold. The percentage
+  // threshold scales from half the max response (what you would expect from applying
+  // the template to a completely random image) to the max response.
+  // NOTE: This assumes max per-feature response is 4, so we scale between [2*nf, 4*nf].
+  int raw_threshold = static_cast<int>(2*num_features + (threshold / 100.f) * (2*num_features) + 0.5f);
+
+  // Find initial matches
+  candidates.clear();
+  for (int r = 0; r < total_similarity.rows; ++r)
+  {
+    ushort* row = total_similarity.ptr<ushort>(r);
+    for (int c = 0; c < total_similarity.cols; ++c)
+    {
+      int raw_score = row[c];
+      if (raw_score > raw_threshold)
+      {
+        int offset = lowest_T / 2 + (lowest_T % 2 - 1);
+        int x = c * lowest_T + offset;
+        int y = r * lowest_T + offset;
+        float score =(raw_score * 100.f) / (4 * num_features) + 0.5f;
+        candidates.push_back(Match(x, y, score, class_id, template_id));
+      }
+    }
+  }
+
+  // Locally refine each match by marching up the pyramid
+  for (int l = pyramid_levels - 2; l >= 0; --l)
+  {
+    const std::vector< std::vector<Mat> >& lms = lm_pyramid[l];
+    int T = detector.getT(l);
+    int start = l * num_modalities;
+    Size size = sizes[l];
+    int border = 8 * T;
+    int offset = T / 2 + (T % 2 - 1);
+    int max_x = size.width - tp[start].width - border;
+    int max_y = size.height - tp[start].height - border;
+
+    std::vector<Mat>& similarities2 = buffers.similarities2;
+    similarities2.resize(num_modalities);
+    Mat& total_similarity2 = buffers.total_similarity2;
+    for (int m = 0; m < (int)candidates.size(); ++m)
+    {
+      Match& match2 = candidates[m];
+      int x = match2.x * 2 + 1; /// @todo Support other pyramid distance
+      int y = match2.y * 2 + 1;
+
+      // Require 8 (reduced) row/cols to the up/left
+      x = std::max(x, border);
+      y = std::max(y, border);
+
+      // Require 8 (reduced) row/cols to the down/left, plus the template size
+      x = std::min(x, max_x);
+      y = std::min(y, max_y);
+
+      // Compute local similarity maps for each modality
+      int numFeatures = 0;
+      for (int i = 0; i < num_modalities; ++i)
+      {
+        const Template& templ = tp[start + i];
+        numFeatures += static_cast<int>(templ.features.size());
+        similarityLocal(lms[i], templ, similarities2[i], size, T, Point(x, y));
+      }
+      addSimilarities(similarities2, total_similarity2);
+
+      // Find best local adjustment
+      int best_score = 0;
+      int best_r = -1, best_c = -1;
+      for (int r = 0; r < total_similarity2.rows; ++r)
+      {
+        ushort* row = total_similarity2.ptr<ushort>(r);
+        for (int c = 0; c < total_similarity2.cols; ++c)
+        {
+          int score = row[c];
+          if (score > best_score)
+          {
+            best_score = score;
+            best_r = r;
+            best_c = c;
+          }
+        }
+      }
+      // Update current match
+      match2.x = (x / T - 8 + best_c) * T + offset;
+      match2.y = (y / T - 8 + best_r) * T + offset;
+      match2.similarity = (best_score * 100.f) / (4 * numFeatures);
+    }
+
+    // Filter out any matches that drop below the similarity threshold
+    std::vector<Match>::iterator new_end = std::remove_if(candidates.begin(), candidates.end(),
+                                                          MatchPredicate(threshold));
+    candidates.erase(new_end, candidates.end());
+  }
+}
+
+/**
+ * \brief A template to match: its class and its position among the templates of the class.
+ */
+struct TemplateTask
+{
+  TemplateTask(const String* _class_id, const std::vector<Template>* _tp, int _template_id)
+    : class_id(_class_id), tp(_tp), template_id(_template_id) {}
+
+  const String* class_id;
+  const std::vector<Template>* tp;
+  int template_id;
+};
+
+/**
+ * \brief Match templates in parallel. Every stripe has its own score buffers and the
+ * matches of each template are kept apart, so the result does not depend on the threads.
+ */
+class MatchTemplatesInvoker : public ParallelLoopBody
+{
+public:
+  MatchTemplatesInvoker(const Detector& _detector,
+                        const std::vector< std::vector< std::vector<Mat> > >& _lm_pyramid,
+                        const std::vector<Size>& _sizes, float _threshold,
+                        const std::vector<TemplateTask>& _tasks,
+                        std::vector< std::vector<Match> >& _matches)
+    : detector(_detector), lm_pyramid(_lm_pyramid), sizes(_sizes), threshold(_threshold),
+      tasks(_tasks), matches(_matches)
+  {
+  }
+
+  virtual void operator()(const Range& range) const
+  {
+    MatchBuffers buffers;
+    for (int i = range.start; i < range.end; ++i)
+    {
+      const TemplateTask& task = tasks[i];
+      matchTemplate(detector, lm_pyramid, sizes, threshold, *task.class_id, task.template_id,
+                    *task.tp, buffers, matches[i]);
+    }
+  }
+
+private:
+  const Detector& detector;
+  const std::vector< std::vector< std::vector<Mat> > >& lm_pyramid;
+  const std::vector<Size>& sizes;
+  float threshold;
+  const std::vector<TemplateTask>& tasks;
+  std::vector< std::vector<Match> >& matches;
+
+  MatchTemplatesInvoker& operator=(const MatchTemplatesInvoker&);
+};
+
+static void matchTemplates(const Detector& detector,
+                           const std::vector< std::vector< std::vector<Mat> > >& lm_pyramid,
+                           const std::vector<Size>& sizes, float threshold,
+                           const std::vector<TemplateTask>& tasks, std::vector<Match>& matches)
+{
+  int num_tasks = static_cast<int>(tasks.size());
+  if (num_tasks == 0)
+    return;
+
+  // Stripes of a few templates amortize the score buffers, but there is at least one per thread
+  std::vector< std::vector<Match> > template_matches(num_tasks);
+  double nstripes = std::max(num_tasks / 16., static_cast<double>(std::min(num_tasks, getNumThreads())));
+  parallel_for_(Range(0, num_tasks),
+                MatchTemplatesInvoker(detector, lm_pyramid, sizes, threshold, tasks, template_matches),
+                nstripes);
+
+  // Gather the matches in the order of the templates
+  for (int i = 0; i < num_tasks; ++i)
+    matches.insert(matches.end(), template_matches[i].begin(), template_matches[i].end());
+}
+
+/**
+ * \brief Quantize, spread and compute the response maps of the modalities of one pyramid level
+ * concurrently.
+ */
+class ResponseMapsInvoker : public ParallelLoopBody
+{
+public:
+  ResponseMapsInvoker(const std::vector< Ptr<QuantizedPyramid> >& _quantizers, bool _pyr_down, int _T,
+                      std::vector<Mat>& _quantized, std::vector< std::vector<Mat> >& _response_maps)
+    : quantizers(_quantizers), pyr_down(_pyr_down), T(_T), quantized(_quantized),
+      response_maps(_response_maps)
+  {
+  }
+
+  virtual void operator()(const Range& range) const
+  {
+    Mat spread_quantized;
+    for (int i = range.start; i < range.end; ++i)
+    {
+      if (pyr_down)
+        quantizers[i]->pyrDown();
+      quantizers[i]->quantize(quantized[i]);
+      spread(quantized[i], spread_quantized, T);
+      computeResponseMaps(spread_quantized, response_maps[i]);
+    }
+  }
+
+private:
+  const std::vector< Ptr<QuantizedPyramid> >& quantizers;
+  bool pyr_down;
+  int T;
+  std::vector<Mat>& quantized;
+  std::vector< std::vector<Mat> >& response_maps;
+
+  ResponseMapsInvoker& operator=(const ResponseMapsInvoker&);
+};
+
+/**
+ * \brief Linearize the 8 response maps of every modality concurrently.
+ */
+class LinearizeInvoker : public ParallelLoopBody
+{
+public:
+  LinearizeInvoker(const std::vector< std::vector<Mat> >& _response_maps, int _T,
+                   std::vector< std::vector<Mat> >& _memories)
+    : response_maps(_response_maps), T(_T), memories(_memories)
+  {
+  }
+
+  virtual void operator()(const Range& range) const
+  {
+    for (int k = range.start; k < range.end; ++k)
+      linearize(response_maps[k / 8][k % 8], memories[k / 8][k % 8], T);
+  }
+
+private:
+  const std::vector< std::vector<Mat> >& response_maps;
+  int T;
+  std::vector< std::vector<Mat> >& memories;
+
+  LinearizeInvoker& operator=(const LinearizeInvoker&);
+};
+
 void Detector::match(const std::vector<Mat>& sources, float threshold, std::vector<Match>& matches,
                      const std::vector<String>& class_ids, OutputArrayOfArrays quantized_images,
                      const std::vector<Mat>& masks) const
@@ -1415,54 +1799,60 @@ void Detector::match(const std::vector<Mat>& sources, float threshold, std::vect
                                  std::vector<LinearMemories>(modalities.size(), LinearMemories(8)));
 
   // For each pyramid level, precompute linear memories for each modality
+  int num_modalities = static_cast<int>(quantizers.size());
   std::vector<Size> sizes;
+  std::vector<Mat> quantized(num_modalities);
+  std::vector< std::vector<Mat> > response_maps(num_modalities);
   for (int l = 0; l < pyramid_levels; ++l)
   {
     int T = T_at_level[l];
     std::vector<LinearMemories>& lm_level = lm_pyramid[l];
 
-    if (l > 0)
-    {
-      for (int i = 0; i < (int)quantizers.size(); ++i)
-        quantizers[i]->pyrDown();
-    }
+    // The modalities are independent, build their response maps and linear memories concurrently
+    parallel_for_(Range(0, num_modalities), ResponseMapsInvoker(quantizers, l > 0, T, quantized, response_maps));
+    parallel_for_(Range(0, num_modalities * 8), LinearizeInvoker(response_maps, T, lm_level));
 
-    Mat quantized, spread_quantized;
-    std::vector<Mat> response_maps;
-    for (int i = 0; i < (int)quantizers.size(); ++i)
+    if (quantized_images.needed()) //use copyTo here to side step reference semantics.
     {
-      quantizers[i]->quantize(quantized);
-      spread(quantized, spread_quantized, T);
-      computeResponseMaps(spread_quantized, response_maps);
-
-      LinearMemories& memories = lm_level[i];
-      for (int j = 0; j < 8; ++j)
-        linearize(response_maps[j], memories[j], T);
-
-      if (quantized_images.needed()) //use copyTo here to side step reference semantics.
-        quantized.copyTo(quantized_images.getMatRef(static_cast<int>(l*quantizers.size() + i)));
+      for (int i = 0; i < num_modalities; ++i)
+        quantized[i].copyTo(quantized_images.getMatRef(l * num_modalities + i));
     }
 
-    sizes.push_back(quantized.size());
+    sizes.push_back(quantized.back().size());
   }
 
-  if (class_ids.empty())
-  {
-    // Match all templates
-    TemplatesMap::const_iterator it = class_templates.begin(), itend = class_templates.end();
-    for ( ; it != itend; ++it)
-      matchClass(lm_pyramid, sizes, threshold, matches, it->first, it->second);
-  }
-  else
+  // Gather the templates of the requested classes, all of them are matched in one parallel loop
+  std::vector<TemplateTask> tasks;
   {
-    // Match only templates for the requested class IDs
-    for (int i = 0; i < (int)class_ids.size(); ++i)
+    // Classes pending in a binary template file are loaded first, the lock keeps class_templates
+    // from being modified by a concurrent load while the templates are gathered
+    AutoLock lock(*templates_mutex);
+    loadPendingClasses(class_ids);
+
+    if (class_ids.empty())
     {
-      TemplatesMap::const_iterator it = class_templates.find(class_ids[i]);
-      if (it != class_templates.end())
-        matchClass(lm_pyramid, sizes, threshold, matches, it->first, it->second);
+      // Match all templates
+      TemplatesMap::const_iterator it = class_templates.begin(), itend = class_templates.end();
+      for ( ; it != itend; ++it)
+      {
+        for (size_t template_id = 0; template_id < it->second.size(); ++template_id)
+          tasks.push_back(TemplateTask(&it->first, &it->second[template_id], static_cast<int>(template_id)));
+      }
+    }
+    else
+    {
+      // Match only templates for the requested class IDs
+      for (int i = 0; i < (int)class_ids.size(); ++i)
+      {
+        TemplatesMap::const_iterator it = class_templates.find(class_ids[i]);
+        if (it == class_templates.end())
+          continue;
+        for (size_t template_id = 0; template_id < it->second.size(); ++template_id)
+          tasks.push_back(TemplateTask(&it->first, &it->second[template_id], static_cast<int>(template_id)));
+      }
     }
   }
+  matchTemplates(*this, lm_pyramid, sizes, threshold, tasks, matches);
 
   // Sort matches by similarity, and prune any duplicates introduced by pyramid refinement
   std::sort(matches.begin(), matches.end());
@@ -1470,146 +1860,25 @@ void Detector::match(const std::vector<Mat>& sources, float threshold, std::vect
   matches.erase(new_end, matches.end());
 }
 
-// Used to filter out weak matches
-struct MatchPredicate
-{
-  MatchPredicate(float _threshold) : threshold(_threshold) {}
-  bool operator() (const Match& m) { return m.similarity < threshold; }
-  float threshold;
-};
-
 void Detector::matchClass(const LinearMemoryPyramid& lm_pyramid,
                           const std::vector<Size>& sizes,
                           float threshold, std::vector<Match>& matches,
                           const String& class_id,
                           const std::vector<TemplatePyramid>& template_pyramids) const
 {
-  // For each template...
+  std::vector<TemplateTask> tasks;
+  tasks.reserve(template_pyramids.size());
   for (size_t template_id = 0; template_id < template_pyramids.size(); ++template_id)
-  {
-    const TemplatePyramid& tp = template_pyramids[template_id];
-
-    // First match over the whole image at the lowest pyramid level
-    /// @todo Factor this out into separate function
-    const std::vector<LinearMemories>& lowest_lm = lm_pyramid.back();
-
-    // Compute similarity maps for each modality at lowest pyramid level
-    std::vector<Mat> similarities(modalities.size());
-    int lowest_start = static_cast<int>(tp.size() - modalities.size());
-    int lowest_T = T_at_level.back();
-    int num_features = 0;
-    for (int i = 0; i < (int)modalities.size(); ++i)
-    {
-      const Template& templ = tp[lowest_start + i];
-      num_features += static_cast<int>(templ.features.size());
-      similarity(lowest_lm[i], templ, similarities[i], sizes.back(), lowest_T);
-    }
-
-    // Combine into overall similarity
-    /// @todo Support weighting the modalities
-    Mat total_similarity;
-    addSimilarities(similarities, total_similarity);
-
-    // Convert user-friendly percentage to raw similarity threshold. The percentage
-    // threshold scales from half the max response (what you would expect from applying
-    // the template to a completely random image) to the max response.
-    // NOTE: This assumes max per-feature response is 4, so we scale between [2*nf, 4*nf].
-    int raw_threshold = static_cast<int>(2*num_features + (threshold / 100.f) * (2*num_features) + 0.5f);
-
-    // Find initial matches
-    std::vector<Match> candidates;
-    for (int r = 0; r < total_similarity.rows; ++r)
-    {
-      ushort* row = total_similarity.ptr<ushort>(r);
-      for (int c = 0; c < total_similarity.cols; ++c)
-      {
-        int raw_score = row[c];
-        if (raw_score > raw_threshold)
-        {
-          int offset = lowest_T / 2 + (lowest_T % 2 - 1);
-          int x = c * lowest_T + offset;
-          int y = r * lowest_T + offset;
-          float score =(raw_score * 100.f) / (4 * num_features) + 0.5f;
-          candidates.push_back(Match(x, y, score, class_id, static_cast<int>(template_id)));
-        }
-      }
-    }
-
-    // Locally refine each match by marching up the pyramid
-    for (int l = pyramid_levels - 2; l >= 0; --l)
-    {
-      const std::vector<LinearMemories>& lms = lm_pyramid[l];
-      int T = T_at_level[l];
-      int start = static_cast<int>(l * modalities.size());
-      Size size = sizes[l];
-      int border = 8 * T;
-      int offset = T / 2 + (T % 2 - 1);
-      int max_x = size.width - tp[start].width - border;
-      int max_y = size.height - tp[start].height - border;
-
-      std::vector<Mat> similarities2(modalities.size());
-      Mat total_similarity2;
-      for (int m = 0; m < (int)candidates.size(); ++m)
-      {
-        Match& match2 = candidates[m];
-        int x = match2.x * 2 + 1; /// @todo Support other pyramid distance
-        int y = match2.y * 2 + 1;
+    tasks.push_back(TemplateTask(&class_id, &template_pyramids[template_id], static_cast<int>(template_id)));
 
-        // Require 8 (reduced) row/cols to the up/left
-        x = std::max(x, border);
-        y = std::max(y, border);
-
-        // Require 8 (reduced) row/cols to the down/left, plus the template size
-        x = std::min(x, max_x);
-        y = std::min(y, max_y);
-
-        // Compute local similarity maps for each modality
-        int numFeatures = 0;
-        for (int i = 0; i < (int)modalities.size(); ++i)
-        {
-          const Template& templ = tp[start + i];
-          numFeatures += static_cast<int>(templ.features.size());
-          similarityLocal(lms[i], templ, similarities2[i], size, T, Point(x, y));
-        }
-        addSimilarities(similarities2, total_similarity2);
-
-        // Find best local adjustment
-        int best_score = 0;
-        int best_r = -1, best_c = -1;
-        for (int r = 0; r < total_similarity2.rows; ++r)
-        {
-          ushort* row = total_similarity2.ptr<ushort>(r);
-          for (int c = 0; c < total_similarity2.cols; ++c)
-          {
-            int score = row[c];
-            if (score > best_score)
-            {
-              best_score = score;
-              best_r = r;
-              best_c = c;
-            }
-          }
-        }
-        // Update current match
-        match2.x = (x / T - 8 + best_c) * T + offset;
-        match2.y = (y / T - 8 + best_r) * T + offset;
-        match2.similarity = (best_score * 100.f) / (4 * numFeatures);
-      }
-
-      // Filter out any matches that drop below the similarity threshold
-      std::vector<Match>::iterator new_end = std::remove_if(candidates.begin(), candidates.end(),
-                                                            MatchPredicate(threshold));
-      candidates.erase(new_end, candidates.end());
-    }
-
-    matches.insert(matches.end(), candidates.begin(), candidates.end());
-  }
+  matchTemplates(*this, lm_pyramid, sizes, threshold, tasks, matches);
 }
 
 int Detector::addTemplate(const std::vector<Mat>& sources, const String& class_id,
                           const Mat& object_mask, Rect* bounding_box)
 {
   int num_modalities = static_cast<int>(modalities.size());
+  loadPendingClasses(std::vector<String>(1, class_id));
   std::vector<TemplatePyramid>& template_pyramids = class_templates[class_id];
   int template_id = static_cast<int>(template_pyramids.size());
 
@@ -1644,6 +1913,7 @@ int Detector::addTemplate(const std::vector<Mat>& sources, const String& class_i
 
 int Detector::addSyntheticTemplate(const std::vector<Template>& templates, const String& class_id)
 {
+  loadPendingClasses(std::vector<String>(1, class_id));
   std::vector<TemplatePyramid>& template_pyramids = class_templates[class_id];
   int template_id = static_cast<int>(template_pyramids.size());
   template_pyramids.push_back(templates);
@@ -1652,6 +1922,8 @@ int Detector::addSyntheticTemplate(const std::vector<Template>& templates, const
 
 const std::vector<Template>& Detector::getTemplates(const String& class_id, int template_id) const
 {
+  AutoLock lock(*templates_mutex);
+  loadPendingClasses(std::vector<String>(1, class_id));
   TemplatesMap::const_iterator i = class_templates.find(class_id);
   CV_Assert(i != class_templates.end());
   CV_Assert(i->second.size() > size_t(template_id));
@@ -1660,29 +1932,48 @@ const std::vector<Template>& Detector::getTemplates(const String& class_id, int
 
 int Detector::numTemplates() const
 {
+  AutoLock lock(*templates_mutex);
   int ret = 0;
   TemplatesMap::const_iterator i = class_templates.begin(), iend = class_templates.end();
   for ( ; i != iend; ++i)
     ret += static_cast<int>(i->second.size());
+  std::map<String, BinaryClass>::const_iterator p = pending_classes.begin(), pend = pending_classes.end();
+  for ( ; p != pend; ++p)
+    ret += p->second.num_templates;
   return ret;
 }
 
 int Detector::numTemplates(const String& class_id) const
 {
+  AutoLock lock(*templates_mutex);
+  std::map<String, BinaryClass>::const_iterator p = pending_classes.find(class_id);
+  if (p != pending_classes.end())
+    return p->second.num_templates;
   TemplatesMap::const_iterator i = class_templates.find(class_id);
   if (i == class_templates.end())
     return 0;
   return static_cast<int>(i->second.size());
 }
 
+int Detector::numClasses() const
+{
+  AutoLock lock(*templates_mutex);
+  return static_cast<int>(class_templates.size() + pending_classes.size());
+}
+
 std::vector<String> Detector::classIds() const
 {
+  AutoLock lock(*templates_mutex);
   std::vector<String> ids;
   TemplatesMap::const_iterator i = class_templates.begin(), iend = class_templates.end();
   for ( ; i != iend; ++i)
   {
     ids.push_back(i->first);
   }
+  std::map<String, BinaryClass>::const_iterator p = pending_classes.begin(), pend = pending_classes.end();
+  for ( ; p != pend; ++p)
+    ids.push_back(p->first);
+  std::sort(ids.begin(), ids.end());
 
   return ids;
 }
@@ -1690,6 +1981,7 @@ std::vector<String> Detector::classIds() const
 void Detector::read(const FileNode& fn)
 {
   class_templates.clear();
+  pending_classes.clear();
   pyramid_levels = fn["pyramid_levels"];
   fn["T"] >> T_at_level;
 
@@ -1734,6 +2026,7 @@ void Detector::write(FileStorage& fs) const
     {
       String class_id_tmp = fn["class_id"];
       CV_Assert(class_templates.find(class_id_tmp) == class_templates.end());
+      CV_Assert(pending_classes.find(class_id_tmp) == pending_classes.end());
       class_id = class_id_tmp;
     }
     else
@@ -1769,6 +2062,7 @@ void Detector::write(FileStorage& fs) const
 
 void Detector::writeClass(const String& class_id, FileStorage& fs) const
 {
+  loadPendingClasses(std::vector<String>(1, class_id));
   TemplatesMap::const_iterator it = class_templates.find(class_id);
   CV_Assert(it != class_templates.end());
   const std::vector<TemplatePyramid>& tps = it->second;
@@ -1812,6 +2106,7 @@ void Detector::readClasses(const std::vector<String>& class_ids,
 
 void Detector::writeClasses(const String& format) const
 {
+  loadPendingClasses(std::vector<String>());
   TemplatesMap::const_iterator it = class_templates.begin(), it_end = class_templates.end();
   for ( ; it != it_end; ++it)
   {
@@ -1822,6 +2117,405 @@ void Detector::writeClasses(const String& format) const
   }
 }
 
+/****************************************************************************************\
+*                                Binary template files                                   *
+\****************************************************************************************/
+
+// A binary template file starts with a fixed header: magic, version, offset and size of the
+// index. The index, at the end of the file, lists the modalities, the number of pyramid levels
+// and for every class its id, number of template pyramids, offset and size of its block.
+// A class block holds the number of templates of every pyramid, then width, height, pyramid
+// level and number of features of every template, then all the features as (x, y, label)
+// triples of 16-bit integers. All the values are stored in the byte order of the writing host,
+// the magic read back byte-swapped identifies a file from a host with the other byte order.
+static const unsigned int BINARY_TEMPLATES_MAGIC = 0x444f4d4c; // "LMOD"
+static const unsigned int BINARY_TEMPLATES_MAGIC_SWAPPED = 0x4c4d4f44;
+static const int BINARY_TEMPLATES_VERSION = 1;
+static const size_t BINARY_TEMPLATES_HEADER_SIZE = 2 * sizeof(int) + 2 * sizeof(int64);
+
+static void writeBinary(std::vector<uchar>& buf, const void* data, size_t size)
+{
+  const uchar* bytes = static_cast<const uchar*>(data);
+  buf.insert(buf.end(), bytes, bytes + size);
+}
+
+template <typename T>
+static void writeBinaryValue(std::vector<uchar>& buf, T value)
+{
+  writeBinary(buf, &value, sizeof(value));
+}
+
+static void writeBinaryString(std::vector<uchar>& buf, const String& str)
+{
+  writeBinaryValue(buf, static_cast<int>(str.size()));
+  writeBinary(buf, str.c_str(), str.size());
+}
+
+/**
+ * \brief Sequential reader of a block of a binary template file.
+ */
+class BinaryReader
+{
+public:
+  BinaryReader(const std::vector<uchar>& data)
+    : ptr(data.empty() ? NULL : &data[0]), end(ptr + data.size()) {}
+
+  void read(void* dst, size_t size)
+  {
+    if (size > static_cast<size_t>(end - ptr))
+      CV_Error(Error::StsParseError, "Truncated LINEMOD binary template file");
+    memcpy(dst, ptr, size);
+    ptr += size;
+  }
+
+  template <typename T>
+  T readValue()
+  {
+    T value;
+    read(&value, sizeof(value));
+    return value;
+  }
+
+  /// Number of bytes left in the block
+  size_t remaining() const { return static_cast<size_t>(end - ptr); }
+
+  String readString()
+  {
+    int length = readValue<int>();
+    if (length < 0 || length > end - ptr)
+      CV_Error(Error::StsParseError, "Truncated LINEMOD binary template file");
+    String str(reinterpret_cast<const char*>(ptr), static_cast<size_t>(length));
+    ptr += length;
+    return str;
+  }
+
+private:
+  const uchar* ptr;
+  const uchar* end;
+};
+
+// 64-bit file positioning, long is 32-bit on LLP64 platforms
+static bool seekFile(FILE* f, int64 offset, int origin)
+{
+#if defined _WIN32
+  return _fseeki64(f, offset, origin) == 0;
+#else
+  off_t pos = static_cast<off_t>(offset);
+  return pos == offset && fseeko(f, pos, origin) == 0;
+#endif
+}
+
+static int64 tellFile(FILE* f)
+{
+#if defined _WIN32
+  return _ftelli64(f);
+#else
+  return static_cast<int64>(ftello(f));
+#endif
+}
+
+/**
+ * \brief Binary template file opened once to read several of its blocks.
+ */
+class BinaryFileReader
+{
+public:
+  explicit BinaryFileReader(const String& _filename)
+    : filename(_filename)
+  {
+    f = fopen(filename.c_str(), "rb");
+    if (!f)
+      CV_Error(Error::StsError, "Can't open LINEMOD binary template file " + filename);
+    file_size = seekFile(f, 0, SEEK_END) ? tellFile(f) : -1;
+  }
+
+  ~BinaryFileReader()
+  {
+    fclose(f);
+  }
+
+  /**
+   * \brief Read size bytes at offset of the file, the block has to lie within the file.
+   */
+  void readBlock(int64 offset, int64 size, std::vector<uchar>& buf)
+  {
+    if (file_size < 0 || offset < 0 || size < 0 || offset > file_size - size)
+      CV_Error(Error::StsParseError, "Truncated LINEMOD binary template file " + filename);
+
+    buf.resize(static_cast<size_t>(size));
+    bool ok = seekFile(f, offset, SEEK_SET) &&
+              (buf.empty() || fread(&buf[0], 1, buf.size(), f) == buf.size());
+    if (!ok)
+      CV_Error(Error::StsParseError, "Truncated LINEMOD binary template file " + filename);
+  }
+
+private:
+  BinaryFileReader(const BinaryFileReader&);
+  BinaryFileReader& operator=(const BinaryFileReader&);
+
+  String filename;
+  FILE* f;
+  int64 file_size;
+};
+
+/**
+ * \brief Parse the block of a class.
+ *
+ * \param[in]  block         Block of the class in a binary template file.
+ * \param      num_templates Expected number of template pyramids.
+ * \param[out] tps           Template pyramids of the class.
+ */
+static void readBinaryClass(const std::vector<uchar>& block, int num_templates,
+                            std::vector< std::vector<Template> >& tps)
+{
+  BinaryReader reader(block);
+  if (num_templates < 0 || reader.readValue<int>() != num_templates ||
+      static_cast<size_t>(num_templates) > reader.remaining() / sizeof(int))
+    CV_Error(Error::StsParseError, "Corrupted LINEMOD binary template file");
+
+  std::vector<int> counts(num_templates);
+  if (num_templates > 0)
+    reader.read(&counts[0], counts.size() * sizeof(int));
+
+  // The counts are checked against the bytes left before anything is allocated
+  const size_t template_header_size = 4 * sizeof(int);
+  const size_t feature_size = 3 * sizeof(short);
+  int64 total_templates = 0;
+  for (int i = 0; i < num_templates; ++i)
+  {
+    if (counts[i] < 0)
+      CV_Error(Error::StsParseError, "Corrupted LINEMOD binary template file");
+    total_templates += counts[i];
+  }
+  if (total_templates > static_cast<int64>(reader.remaining() / template_header_size))
+    CV_Error(Error::StsParseError, "Truncated LINEMOD binary template file");
+
+  std::vector<int> headers(static_cast<size_t>(total_templates) * 4);
+  if (!headers.empty())
+    reader.read(&headers[0], headers.size() * sizeof(int));
+
+  int64 total_features = 0;
+  for (size_t k = 0; k < headers.size(); k += 4)
+  {
+    if (headers[k + 3] < 0)
+      CV_Error(Error::StsParseError, "Corrupted LINEMOD binary template file");
+    total_features += headers[k + 3];
+  }
+  if (total_features > static_cast<int64>(reader.remaining() / feature_size))
+    CV_Error(Error::StsParseError, "Truncated LINEMOD binary template file");
+
+  tps.resize(num_templates);
+  const int* header = headers.empty() ? NULL : &headers[0];
+  for (int i = 0; i < num_templates; ++i)
+  {
+    tps[i].resize(counts[i]);
+    for (int j = 0; j < counts[i]; ++j, header += 4)
+    {
+      Template& templ = tps[i][j];
+      templ.width = header[0];
+      templ.height = header[1];
+      templ.pyramid_level = header[2];
+      templ.features.resize(header[3]);
+    }
+  }
+
+  // The features of all the templates follow each other
+  std::vector<short> packed;
+  for (int i = 0; i < num_templates; ++i)
+  {
+    for (int j = 0; j < counts[i]; ++j)
+    {
+      std::vector<Feature>& features = tps[i][j].features;
+      if (features.empty())
+        continue;
+      packed.resize(features.size() * 3);
+      reader.read(&packed[0], packed.size() * sizeof(short));
+      for (size_t k = 0; k < features.size(); ++k)
+        features[k] = Feature(packed[3*k], packed[3*k + 1], packed[3*k + 2]);
+    }
+  }
+}
+
+void Detector::loadPendingClasses(const std::vector<String>& class_ids) const
+{
+  AutoLock lock(*templates_mutex);
+  if (pending_classes.empty())
+    return;
+
+  std::vector<String> ids = class_ids;
+  if (ids.empty())
+  {
+    std::map<String, BinaryClass>::const_iterator it = pending_classes.begin(), it_end = pending_classes.end();
+    for ( ; it != it_end; ++it)
+      ids.push_back(it->first);
+  }
+
+  // Each file is opened once for all its classes
+  std::map<String, Ptr<BinaryFileReader> > files;
+  std::vector<uchar> block;
+  for (size_t i = 0; i < ids.size(); ++i)
+  {
+    std::map<String, BinaryClass>::iterator it = pending_classes.find(ids[i]);
+    if (it == pending_classes.end())
+      continue;
+
+    const BinaryClass& bc = it->second;
+    Ptr<BinaryFileReader>& file = files[bc.filename];
+    if (file.empty())
+      file = makePtr<BinaryFileReader>(bc.filename);
+    std::vector<TemplatePyramid> tps;
+    file->readBlock(bc.offset, bc.size, block);
+    readBinaryClass(block, bc.num_templates, tps);
+
+    class_templates[it->first].swap(tps);
+    pending_classes.erase(it);
+  }
+}
+
+void Detector::writeClassesBinary(const String& filename) const
+{
+  loadPendingClasses(std::vector<String>());
+
+  std::vector<uchar> buf(BINARY_TEMPLATES_HEADER_SIZE);
+  std::vector<int64> offsets, sizes;
+
+  // Class blocks
+  TemplatesMap::const_iterator it = class_templates.begin(), it_end = class_templates.end();
+  for ( ; it != it_end; ++it)
+  {
+    const std::vector<TemplatePyramid>& tps = it->second;
+    offsets.push_back(static_cast<int64>(buf.size()));
+
+    writeBinaryValue(buf, static_cast<int>(tps.size()));
+    for (size_t i = 0; i < tps.size(); ++i)
+      writeBinaryValue(buf, static_cast<int>(tps[i].size()));
+    for (size_t i = 0; i < tps.size(); ++i)
+    {
+      for (size_t j = 0; j < tps[i].size(); ++j)
+      {
+        const Template& templ = tps[i][j];
+        int header[4] = { templ.width, templ.height, templ.pyramid_level,
+                          static_cast<int>(templ.features.size()) };
+        writeBinary(buf, header, sizeof(header));
+      }
+    }
+    for (size_t i = 0; i < tps.size(); ++i)
+    {
+      for (size_t j = 0; j < tps[i].size(); ++j)
+      {
+        const std::vector<Feature>& features = tps[i][j].features;
+        for (size_t k = 0; k < features.size(); ++k)
+        {
+          const Feature& f = features[k];
+          CV_Assert(f.x == (short)f.x && f.y == (short)f.y && f.label == (short)f.label);
+          short packed[3] = { (short)f.x, (short)f.y, (short)f.label };
+          writeBinary(buf, packed, sizeof(packed));
+        }
+      }
+    }
+
+    sizes.push_back(static_cast<int64>(buf.size()) - offsets.back());
+  }
+
+  // Index
+  int64 index_offset = static_cast<int64>(buf.size());
+  writeBinaryValue(buf, static_cast<int>(modalities.size()));
+  for (size_t i = 0; i < modalities.size(); ++i)
+    writeBinaryString(buf, modalities[i]->name());
+  writeBinaryValue(buf, pyramid_levels);
+  writeBinaryValue(buf, static_cast<int>(class_templates.size()));
+  int idx = 0;
+  for (it = class_templates.begin(); it != it_end; ++it, ++idx)
+  {
+    writeBinaryString(buf, it->first);
+    writeBinaryValue(buf, static_cast<int>(it->second.size()));
+    writeBinaryValue(buf, offsets[idx]);
+    writeBinaryValue(buf, sizes[idx]);
+  }
+  int64 index_size = static_cast<int64>(buf.size()) - index_offset;
+
+  // Header
+  std::vector<uchar> header;
+  writeBinaryValue(header, BINARY_TEMPLATES_MAGIC);
+  writeBinaryValue(header, BINARY_TEMPLATES_VERSION);
+  writeBinaryValue(header, index_offset);
+  writeBinaryValue(header, index_size);
+  std::copy(header.begin(), header.end(), buf.begin());
+
+  FILE* f = fopen(filename.c_str(), "wb");
+  if (!f)
+    CV_Error(Error::StsError, "Can't create LINEMOD binary template file " + filename);
+  bool ok = fwrite(&buf[0], 1, buf.size(), f) == buf.size();
+  ok = fclose(f) == 0 && ok;
+  if (!ok)
+    CV_Error(Error::StsError, "Can't write LINEMOD binary template file " + filename);
+}
+
+void Detector::readClassesBinary(const String& filename, bool lazy)
+{
+  BinaryFileReader file(filename);
+  std::vector<uchar> block;
+  file.readBlock(0, BINARY_TEMPLATES_HEADER_SIZE, block);
+  BinaryReader header(block);
+  unsigned int magic = header.readValue<unsigned int>();
+  if (magic == BINARY_TEMPLATES_MAGIC_SWAPPED)
+    CV_Error(Error::StsParseError, "LINEMOD binary template file written with another byte order: " + filename);
+  if (magic != BINARY_TEMPLATES_MAGIC)
+    CV_Error(Error::StsParseError, "Not a LINEMOD binary template file: " + filename);
+  if (header.readValue<int>() != BINARY_TEMPLATES_VERSION)
+    CV_Error(Error::StsParseError, "Unsupported LINEMOD binary template file version: " + filename);
+  int64 index_offset = header.readValue<int64>();
+  int64 index_size = header.readValue<int64>();
+  if (index_offset < static_cast<int64>(BINARY_TEMPLATES_HEADER_SIZE))
+    CV_Error(Error::StsParseError, "Corrupted LINEMOD binary template file " + filename);
+
+  file.readBlock(index_offset, index_size, block);
+  BinaryReader index(block);
+
+  // Verify compatible with Detector settings
+  CV_Assert(index.readValue<int>() == (int)modalities.size());
+  for (size_t i = 0; i < modalities.size(); ++i)
+    CV_Assert(modalities[i]->name() == index.readString());
+  CV_Assert(index.readValue<int>() == pyramid_levels);
+
+  int num_classes = index.readValue<int>();
+  if (num_classes < 0)
+    CV_Error(Error::StsParseError, "Corrupted LINEMOD binary template file " + filename);
+  if (static_cast<size_t>(num_classes) > index.remaining() / (2 * sizeof(int) + 2 * sizeof(int64)))
+    CV_Error(Error::StsParseError, "Truncated LINEMOD binary template file " + filename);
+
+  // The whole index is checked before the detector is modified
+  std::vector<String> class_ids(num_classes);
+  std::vector<BinaryClass> classes(num_classes);
+  for (int i = 0; i < num_classes; ++i)
+  {
+    BinaryClass& bc = classes[i];
+    class_ids[i] = index.readString();
+    bc.filename = filename;
+    bc.num_templates = index.readValue<int>();
+    bc.offset = index.readValue<int64>();
+    bc.size = index.readValue<int64>();
+
+    // The class blocks lie between the header and the index
+    if (bc.num_templates < 0 || bc.offset < static_cast<int64>(BINARY_TEMPLATES_HEADER_SIZE) ||
+        bc.size < static_cast<int64>(sizeof(int)) || bc.offset > index_offset - bc.size)
+      CV_Error(Error::StsParseError, "Corrupted LINEMOD binary template file " + filename);
+  }
+
+  AutoLock lock(*templates_mutex);
+  // Detector should not already have these classes
+  for (int i = 0; i < num_classes; ++i)
+  {
+    CV_Assert(class_templates.find(class_ids[i]) == class_templates.end());
+    CV_Assert(pending_classes.find(class_ids[i]) == pending_classes.end());
+  }
+  for (int i = 0; i < num_classes; ++i)
+    pending_classes[class_ids[i]] = classes[i];
+
+  if (!lazy)
+    loadPendingClasses(class_ids);
+}
+
 static const int T_DEFAULTS[] = {5, 8};
 
 Ptr<Detector> getDefaultLINE()
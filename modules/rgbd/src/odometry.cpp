@@ -128,143 +128,166 @@ void checkNormals(const Mat& normals, const Size& depthSize)
         CV_Error(Error::StsBadSize, "Normals type has to be CV_32FC3.");
 }
 
+// Takes a buffer of the given size and type from the released pyramids of a frame, an empty
+// matrix is returned if there is none so the caller allocates it.
 static
-void preparePyramidImage(const Mat& image, std::vector<Mat>& pyramidImage, size_t levelCount)
+Mat takeBuffer(std::vector<Mat>& buffers, const Size& size, int type)
 {
-    if(!pyramidImage.empty())
+    for(size_t i = 0; i < buffers.size(); i++)
+    {
+        if(buffers[i].size() == size && buffers[i].type() == type)
+        {
+            Mat buffer = buffers[i];
+            buffers[i] = buffers.back();
+            buffers.pop_back();
+            return buffer;
+        }
+    }
+    return Mat();
+}
+
+// Adds the missing levels of a Gaussian pyramid (the same ones buildPyramid computes)
+static
+void buildMissingLevels(const Mat& image, std::vector<Mat>& pyramid, size_t levelCount, std::vector<Mat>& buffers)
+{
+    if(pyramid.empty())
+        pyramid.push_back(image);
+
+    for(size_t i = pyramid.size(); i < levelCount; i++)
     {
-        if(pyramidImage.size() < levelCount)
-            CV_Error(Error::StsBadSize, "Levels count of pyramidImage has to be equal or less than size of iterCounts.");
+        const Mat& prevLevel = pyramid[i-1];
+        Mat level = takeBuffer(buffers, Size((prevLevel.cols + 1) / 2, (prevLevel.rows + 1) / 2), prevLevel.type());
+        pyrDown(prevLevel, level);
+        pyramid.push_back(level);
+    }
+}
 
+static
+void preparePyramidImage(const Mat& image, std::vector<Mat>& pyramidImage, size_t levelCount, std::vector<Mat>& buffers)
+{
+    if(!pyramidImage.empty())
+    {
         CV_Assert(pyramidImage[0].size() == image.size());
         for(size_t i = 0; i < pyramidImage.size(); i++)
             CV_Assert(pyramidImage[i].type() == image.type());
     }
-    else
-        buildPyramid(image, pyramidImage, (int)levelCount - 1);
+
+    buildMissingLevels(image, pyramidImage, levelCount, buffers);
 }
 
 static
-void preparePyramidDepth(const Mat& depth, std::vector<Mat>& pyramidDepth, size_t levelCount)
+void preparePyramidDepth(const Mat& depth, std::vector<Mat>& pyramidDepth, size_t levelCount, std::vector<Mat>& buffers)
 {
     if(!pyramidDepth.empty())
     {
-        if(pyramidDepth.size() < levelCount)
-            CV_Error(Error::StsBadSize, "Levels count of pyramidDepth has to be equal or less than size of iterCounts.");
-
         CV_Assert(pyramidDepth[0].size() == depth.size());
         for(size_t i = 0; i < pyramidDepth.size(); i++)
             CV_Assert(pyramidDepth[i].type() == depth.type());
     }
-    else
-        buildPyramid(depth, pyramidDepth, (int)levelCount - 1);
+
+    buildMissingLevels(depth, pyramidDepth, levelCount, buffers);
 }
 
 static
 void preparePyramidMask(const Mat& mask, const std::vector<Mat>& pyramidDepth, float minDepth, float maxDepth,
                         const std::vector<Mat>& pyramidNormal,
-                        std::vector<Mat>& pyramidMask)
+                        std::vector<Mat>& pyramidMask, std::vector<Mat>& buffers)
 {
     minDepth = std::max(0.f, minDepth);
 
-    if(!pyramidMask.empty())
-    {
-        if(pyramidMask.size() != pyramidDepth.size())
-            CV_Error(Error::StsBadSize, "Levels count of pyramidMask has to be equal to size of pyramidDepth.");
+    if(pyramidMask.size() > pyramidDepth.size())
+        CV_Error(Error::StsBadSize, "Levels count of pyramidMask has to be equal to size of pyramidDepth.");
 
-        for(size_t i = 0; i < pyramidMask.size(); i++)
-        {
-            CV_Assert(pyramidMask[i].size() == pyramidDepth[i].size());
-            CV_Assert(pyramidMask[i].type() == CV_8UC1);
-        }
+    for(size_t i = 0; i < pyramidMask.size(); i++)
+    {
+        CV_Assert(pyramidMask[i].size() == pyramidDepth[i].size());
+        CV_Assert(pyramidMask[i].type() == CV_8UC1);
     }
+
+    if(pyramidMask.size() == pyramidDepth.size())
+        return;
+
+    Mat validMask;
+    if(mask.empty())
+        validMask = Mat(pyramidDepth[0].size(), CV_8UC1, Scalar(255));
     else
-    {
-        Mat validMask;
-        if(mask.empty())
-            validMask = Mat(pyramidDepth[0].size(), CV_8UC1, Scalar(255));
-        else
-            validMask = mask.clone();
+        validMask = mask.clone();
 
-        buildPyramid(validMask, pyramidMask, (int)pyramidDepth.size() - 1);
+    std::vector<Mat> pyramidValidMask;
+    buildPyramid(validMask, pyramidValidMask, (int)pyramidDepth.size() - 1);
 
-        for(size_t i = 0; i < pyramidMask.size(); i++)
-        {
-            Mat levelDepth = pyramidDepth[i].clone();
-            patchNaNs(levelDepth, 0);
+    for(size_t i = pyramidMask.size(); i < pyramidDepth.size(); i++)
+    {
+        Mat levelDepth = pyramidDepth[i].clone();
+        patchNaNs(levelDepth, 0);
 
-            Mat& levelMask = pyramidMask[i];
-            levelMask &= (levelDepth > minDepth) & (levelDepth < maxDepth);
+        Mat levelMask = takeBuffer(buffers, pyramidDepth[i].size(), CV_8UC1);
+        bitwise_and(pyramidValidMask[i], (levelDepth > minDepth) & (levelDepth < maxDepth), levelMask);
 
-            if(!pyramidNormal.empty())
-            {
-                CV_Assert(pyramidNormal[i].type() == CV_32FC3);
-                CV_Assert(pyramidNormal[i].size() == pyramidDepth[i].size());
-                Mat levelNormal = pyramidNormal[i].clone();
+        if(!pyramidNormal.empty())
+        {
+            CV_Assert(pyramidNormal[i].type() == CV_32FC3);
+            CV_Assert(pyramidNormal[i].size() == pyramidDepth[i].size());
+            Mat levelNormal = pyramidNormal[i].clone();
 
-                Mat validNormalMask = levelNormal == levelNormal; // otherwise it's Nan
-                CV_Assert(validNormalMask.type() == CV_8UC3);
+            Mat validNormalMask = levelNormal == levelNormal; // otherwise it's Nan
+            CV_Assert(validNormalMask.type() == CV_8UC3);
 
-                std::vector<Mat> channelMasks;
-                split(validNormalMask, channelMasks);
-                validNormalMask = channelMasks[0] & channelMasks[1] & channelMasks[2];
+            std::vector<Mat> channelMasks;
+            split(validNormalMask, channelMasks);
+            validNormalMask = channelMasks[0] & channelMasks[1] & channelMasks[2];
 
-                levelMask &= validNormalMask;
-            }
+            levelMask &= validNormalMask;
         }
+        pyramidMask.push_back(levelMask);
     }
 }
 
 static
-void preparePyramidCloud(const std::vector<Mat>& pyramidDepth, const Mat& cameraMatrix, std::vector<Mat>& pyramidCloud)
+void preparePyramidCloud(const std::vector<Mat>& pyramidDepth, const Mat& cameraMatrix, std::vector<Mat>& pyramidCloud,
+                         std::vector<Mat>& buffers)
 {
-    if(!pyramidCloud.empty())
-    {
-        if(pyramidCloud.size() != pyramidDepth.size())
-            CV_Error(Error::StsBadSize, "Incorrect size of pyramidCloud.");
+    if(pyramidCloud.size() > pyramidDepth.size())
+        CV_Error(Error::StsBadSize, "Incorrect size of pyramidCloud.");
 
-        for(size_t i = 0; i < pyramidDepth.size(); i++)
-        {
-            CV_Assert(pyramidCloud[i].size() == pyramidDepth[i].size());
-            CV_Assert(pyramidCloud[i].type() == CV_32FC3);
-        }
-    }
-    else
+    for(size_t i = 0; i < pyramidCloud.size(); i++)
     {
-        std::vector<Mat> pyramidCameraMatrix;
-        buildPyramidCameraMatrix(cameraMatrix, (int)pyramidDepth.size(), pyramidCameraMatrix);
+        CV_Assert(pyramidCloud[i].size() == pyramidDepth[i].size());
+        CV_Assert(pyramidCloud[i].type() == CV_32FC3);
+    }
 
-        pyramidCloud.resize(pyramidDepth.size());
-        for(size_t i = 0; i < pyramidDepth.size(); i++)
-        {
-            Mat cloud;
-            depthTo3d(pyramidDepth[i], pyramidCameraMatrix[i], cloud);
-            pyramidCloud[i] = cloud;
-        }
+    if(pyramidCloud.size() == pyramidDepth.size())
+        return;
+
+    std::vector<Mat> pyramidCameraMatrix;
+    buildPyramidCameraMatrix(cameraMatrix, (int)pyramidDepth.size(), pyramidCameraMatrix);
+
+    for(size_t i = pyramidCloud.size(); i < pyramidDepth.size(); i++)
+    {
+        Mat cloud = takeBuffer(buffers, pyramidDepth[i].size(), CV_MAKETYPE(pyramidDepth[i].depth(), 3));
+        depthTo3d(pyramidDepth[i], pyramidCameraMatrix[i], cloud);
+        pyramidCloud.push_back(cloud);
     }
 }
 
 static
-void preparePyramidSobel(const std::vector<Mat>& pyramidImage, int dx, int dy, std::vector<Mat>& pyramidSobel)
+void preparePyramidSobel(const std::vector<Mat>& pyramidImage, int dx, int dy, std::vector<Mat>& pyramidSobel,
+                         std::vector<Mat>& buffers)
 {
-    if(!pyramidSobel.empty())
-    {
-        if(pyramidSobel.size() != pyramidImage.size())
-            CV_Error(Error::StsBadSize, "Incorrect size of pyramidSobel.");
+    if(pyramidSobel.size() > pyramidImage.size())
+        CV_Error(Error::StsBadSize, "Incorrect size of pyramidSobel.");
 
-        for(size_t i = 0; i < pyramidSobel.size(); i++)
-        {
-            CV_Assert(pyramidSobel[i].size() == pyramidImage[i].size());
-            CV_Assert(pyramidSobel[i].type() == CV_16SC1);
-        }
+    for(size_t i = 0; i < pyramidSobel.size(); i++)
+    {
+        CV_Assert(pyramidSobel[i].size() == pyramidImage[i].size());
+        CV_Assert(pyramidSobel[i].type() == CV_16SC1);
     }
-    else
+
+    for(size_t i = pyramidSobel.size(); i < pyramidImage.size(); i++)
     {
-        pyramidSobel.resize(pyramidImage.size());
-        for(size_t i = 0; i < pyramidImage.size(); i++)
-        {
-            Sobel(pyramidImage[i], pyramidSobel[i], CV_16S, dx, dy, sobelSize);
-        }
+        Mat sobel = takeBuffer(buffers, pyramidImage[i].size(), CV_16SC1);
+        Sobel(pyramidImage[i], sobel, CV_16S, dx, dy, sobelSize);
+        pyramidSobel.push_back(sobel);
     }
 }
 
@@ -298,79 +321,74 @@ void randomSubsetOfMask(Mat& mask, float part)
 static
 void preparePyramidTexturedMask(const std::vector<Mat>& pyramid_dI_dx, const std::vector<Mat>& pyramid_dI_dy,
                                 const std::vector<float>& minGradMagnitudes, const std::vector<Mat>& pyramidMask, double maxPointsPart,
-                                std::vector<Mat>& pyramidTexturedMask)
+                                std::vector<Mat>& pyramidTexturedMask, std::vector<Mat>& buffers)
 {
-    if(!pyramidTexturedMask.empty())
-    {
-        if(pyramidTexturedMask.size() != pyramid_dI_dx.size())
-            CV_Error(Error::StsBadSize, "Incorrect size of pyramidTexturedMask.");
+    if(pyramidTexturedMask.size() > pyramid_dI_dx.size())
+        CV_Error(Error::StsBadSize, "Incorrect size of pyramidTexturedMask.");
 
-        for(size_t i = 0; i < pyramidTexturedMask.size(); i++)
-        {
-            CV_Assert(pyramidTexturedMask[i].size() == pyramid_dI_dx[i].size());
-            CV_Assert(pyramidTexturedMask[i].type() == CV_8UC1);
-        }
+    for(size_t i = 0; i < pyramidTexturedMask.size(); i++)
+    {
+        CV_Assert(pyramidTexturedMask[i].size() == pyramid_dI_dx[i].size());
+        CV_Assert(pyramidTexturedMask[i].type() == CV_8UC1);
     }
-    else
+
+    const float sobelScale2_inv = 1.f / (float)(sobelScale * sobelScale);
+    for(size_t i = pyramidTexturedMask.size(); i < pyramid_dI_dx.size(); i++)
     {
-        const float sobelScale2_inv = 1.f / (float)(sobelScale * sobelScale);
-        pyramidTexturedMask.resize(pyramid_dI_dx.size());
-        for(size_t i = 0; i < pyramidTexturedMask.size(); i++)
-        {
-            const float minScaledGradMagnitude2 = minGradMagnitudes[i] * minGradMagnitudes[i] * sobelScale2_inv;
-            const Mat& dIdx = pyramid_dI_dx[i];
-            const Mat& dIdy = pyramid_dI_dy[i];
+        const float minScaledGradMagnitude2 = minGradMagnitudes[i] * minGradMagnitudes[i] * sobelScale2_inv;
+        const Mat& dIdx = pyramid_dI_dx[i];
+        const Mat& dIdy = pyramid_dI_dy[i];
 
-            Mat texturedMask(dIdx.size(), CV_8UC1, Scalar(0));
+        Mat texturedMask = takeBuffer(buffers, dIdx.size(), CV_8UC1);
+        texturedMask.create(dIdx.size(), CV_8UC1);
+        texturedMask.setTo(Scalar(0));
 
-            for(int y = 0; y < dIdx.rows; y++)
+        for(int y = 0; y < dIdx.rows; y++)
+        {
+            const short *dIdx_row = dIdx.ptr<short>(y);
+            const short *dIdy_row = dIdy.ptr<short>(y);
+            uchar *texturedMask_row = texturedMask.ptr<uchar>(y);
+            for(int x = 0; x < dIdx.cols; x++)
             {
-                const short *dIdx_row = dIdx.ptr<short>(y);
-                const short *dIdy_row = dIdy.ptr<short>(y);
-                uchar *texturedMask_row = texturedMask.ptr<uchar>(y);
-                for(int x = 0; x < dIdx.cols; x++)
-                {
-                    float magnitude2 = static_cast<float>(dIdx_row[x] * dIdx_row[x] + dIdy_row[x] * dIdy_row[x]);
-                    if(magnitude2 >= minScaledGradMagnitude2)
-                        texturedMask_row[x] = 255;
-                }
+                float magnitude2 = static_cast<float>(dIdx_row[x] * dIdx_row[x] + dIdy_row[x] * dIdy_row[x]);
+                if(magnitude2 >= minScaledGradMagnitude2)
+                    texturedMask_row[x] = 255;
             }
-            pyramidTexturedMask[i] = texturedMask & pyramidMask[i];
-
-            randomSubsetOfMask(pyramidTexturedMask[i], (float)maxPointsPart);
         }
+        texturedMask &= pyramidMask[i];
+
+        randomSubsetOfMask(texturedMask, (float)maxPointsPart);
+        pyramidTexturedMask.push_back(texturedMask);
     }
 }
 
 static
-void preparePyramidNormals(const Mat& normals, const std::vector<Mat>& pyramidDepth, std::vector<Mat>& pyramidNormals)
+void preparePyramidNormals(const Mat& normals, const std::vector<Mat>& pyramidDepth, std::vector<Mat>& pyramidNormals,
+                           std::vector<Mat>& buffers)
 {
-    if(!pyramidNormals.empty())
-    {
-        if(pyramidNormals.size() != pyramidDepth.size())
-            CV_Error(Error::StsBadSize, "Incorrect size of pyramidNormals.");
+    if(pyramidNormals.size() > pyramidDepth.size())
+        CV_Error(Error::StsBadSize, "Incorrect size of pyramidNormals.");
 
-        for(size_t i = 0; i < pyramidNormals.size(); i++)
-        {
-            CV_Assert(pyramidNormals[i].size() == pyramidDepth[i].size());
-            CV_Assert(pyramidNormals[i].type() == CV_32FC3);
-        }
+    for(size_t i = 0; i < pyramidNormals.size(); i++)
+    {
+        CV_Assert(pyramidNormals[i].size() == pyramidDepth[i].size());
+        CV_Assert(pyramidNormals[i].type() == CV_32FC3);
     }
-    else
+
+    size_t firstMissingLevel = std::max(pyramidNormals.size(), (size_t)1);
+    buildMissingLevels(normals, pyramidNormals, pyramidDepth.size(), buffers);
+
+    // renormalize normals
+    for(size_t i = firstMissingLevel; i < pyramidNormals.size(); i++)
     {
-        buildPyramid(normals, pyramidNormals, (int)pyramidDepth.size() - 1);
-        // renormalize normals
-        for(size_t i = 1; i < pyramidNormals.size(); i++)
+        Mat& currNormals = pyramidNormals[i];
+        for(int y = 0; y < currNormals.rows; y++)
         {
-            Mat& currNormals = pyramidNormals[i];
-            for(int y = 0; y < currNormals.rows; y++)
+            Point3f* normals_row = currNormals.ptr<Point3f>(y);
+            for(int x = 0; x < currNormals.cols; x++)
             {
-                Point3f* normals_row = currNormals.ptr<Point3f>(y);
-                for(int x = 0; x < currNormals.cols; x++)
-                {
-                    double nrm = norm(normals_row[x]);
-                    normals_row[x] *= 1./nrm;
-                }
+                double nrm = norm(normals_row[x]);
+                normals_row[x] *= 1./nrm;
             }
         }
     }
@@ -378,43 +396,37 @@ void preparePyramidNormals(const Mat& normals, const std::vector<Mat>& pyramidDe
 
 static
 void preparePyramidNormalsMask(const std::vector<Mat>& pyramidNormals, const std::vector<Mat>& pyramidMask, double maxPointsPart,
-                               std::vector<Mat>& pyramidNormalsMask)
+                               std::vector<Mat>& pyramidNormalsMask, std::vector<Mat>& buffers)
 {
-    if(!pyramidNormalsMask.empty())
-    {
-        if(pyramidNormalsMask.size() != pyramidMask.size())
-            CV_Error(Error::StsBadSize, "Incorrect size of pyramidNormalsMask.");
+    if(pyramidNormalsMask.size() > pyramidMask.size())
+        CV_Error(Error::StsBadSize, "Incorrect size of pyramidNormalsMask.");
 
-        for(size_t i = 0; i < pyramidNormalsMask.size(); i++)
-        {
-            CV_Assert(pyramidNormalsMask[i].size() == pyramidMask[i].size());
-            CV_Assert(pyramidNormalsMask[i].type() == pyramidMask[i].type());
-        }
-    }
-    else
+    for(size_t i = 0; i < pyramidNormalsMask.size(); i++)
     {
-        pyramidNormalsMask.resize(pyramidMask.size());
+        CV_Assert(pyramidNormalsMask[i].size() == pyramidMask[i].size());
+        CV_Assert(pyramidNormalsMask[i].type() == pyramidMask[i].type());
+    }
 
-        for(size_t i = 0; i < pyramidNormalsMask.size(); i++)
+    for(size_t i = pyramidNormalsMask.size(); i < pyramidMask.size(); i++)
+    {
+        Mat normalsMask = takeBuffer(buffers, pyramidMask[i].size(), pyramidMask[i].type());
+        pyramidMask[i].copyTo(normalsMask);
+        for(int y = 0; y < normalsMask.rows; y++)
         {
-            pyramidNormalsMask[i] = pyramidMask[i].clone();
-            Mat& normalsMask = pyramidNormalsMask[i];
-            for(int y = 0; y < normalsMask.rows; y++)
+            const Vec3f *normals_row = pyramidNormals[i].ptr<Vec3f>(y);
+            uchar *normalsMask_row = normalsMask.ptr<uchar>(y);
+            for(int x = 0; x < normalsMask.cols; x++)
             {
-                const Vec3f *normals_row = pyramidNormals[i].ptr<Vec3f>(y);
-                uchar *normalsMask_row = pyramidNormalsMask[i].ptr<uchar>(y);
-                for(int x = 0; x < normalsMask.cols; x++)
+                Vec3f n = normals_row[x];
+                if(cvIsNaN(n[0]))
                 {
-                    Vec3f n = normals_row[x];
-                    if(cvIsNaN(n[0]))
-                    {
-                        CV_DbgAssert(cvIsNaN(n[1]) && cvIsNaN(n[2]));
-                        normalsMask_row[x] = 0;
-                    }
+                    CV_DbgAssert(cvIsNaN(n[1]) && cvIsNaN(n[2]));
+                    normalsMask_row[x] = 0;
                 }
             }
-            randomSubsetOfMask(normalsMask, (float)maxPointsPart);
         }
+        randomSubsetOfMask(normalsMask, (float)maxPointsPart);
+        pyramidNormalsMask.push_back(normalsMask);
     }
 }
 
@@ -451,30 +463,130 @@ void computeProjectiveMatrix(const Mat& ksi, Mat& Rt)
 #endif
 }
 
+// Memory reused by all the iterations and pyramid levels of an odometry computation,
+// every buffer grows to the largest size asked for and the smaller ones take a part of it.
+struct OdometryBuffers
+{
+    Mat projections;
+    Mat projectedDepth;
+    Mat correspsMap;
+    Mat correspsRgbd;
+    Mat correspsIcp;
+    Mat diffs;
+    Mat transformedPoints;
+    Mat sums;
+};
+
+// Header of the given size and type over the memory of buffer, which grows only when needed.
+static
+Mat getBufferMat(Mat& buffer, int rows, int cols, int type)
+{
+    size_t size = (size_t)rows * cols * CV_ELEM_SIZE(type);
+    if(buffer.total() < size)
+        buffer.create(1, (int)size, CV_8UC1);
+    return Mat(rows, cols, type, buffer.data);
+}
+
+// Projects the selected pixels of depth1 onto the pixels of depth0 with a compatible depth.
+// Every pixel stores the index of its projection (-1 if there is none) and its projected depth.
+class ProjectDepthInvoker : public ParallelLoopBody
+{
+public:
+    ProjectDepthInvoker(const Mat& _depth0, const Mat& _validMask0,
+                        const Mat& _depth1, const Mat& _selectMask1, float _maxDepthDiff,
+                        const float* _KRK_inv_u1, const float* _KRK_inv_v1, const double* _Kt_ptr,
+                        Mat& _projections, Mat& _projectedDepth) :
+        depth0(_depth0), validMask0(_validMask0), depth1(_depth1), selectMask1(_selectMask1),
+        maxDepthDiff(_maxDepthDiff), KRK_inv_u1(_KRK_inv_u1), KRK_inv_v1(_KRK_inv_v1), Kt_ptr(_Kt_ptr),
+        projections(_projections), projectedDepth(_projectedDepth)
+    {}
+
+    virtual void operator()(const Range& range) const
+    {
+        const float *KRK_inv0_u1 = KRK_inv_u1;
+        const float *KRK_inv3_u1 = KRK_inv0_u1 + depth1.cols;
+        const float *KRK_inv6_u1 = KRK_inv3_u1 + depth1.cols;
+        const float *KRK_inv1_v1_plus_KRK_inv2 = KRK_inv_v1;
+        const float *KRK_inv4_v1_plus_KRK_inv5 = KRK_inv1_v1_plus_KRK_inv2 + depth1.rows;
+        const float *KRK_inv7_v1_plus_KRK_inv8 = KRK_inv4_v1_plus_KRK_inv5 + depth1.rows;
+
+        Rect r(0, 0, depth1.cols, depth1.rows);
+        for(int v1 = range.start; v1 < range.end; v1++)
+        {
+            const float *depth1_row = depth1.ptr<float>(v1);
+            const uchar *mask1_row = selectMask1.ptr<uchar>(v1);
+            int *projections_row = projections.ptr<int>(v1);
+            float *projectedDepth_row = projectedDepth.ptr<float>(v1);
+            for(int u1 = 0; u1 < depth1.cols; u1++)
+            {
+                projections_row[u1] = -1;
+                if(!mask1_row[u1])
+                    continue;
+
+                float d1 = depth1_row[u1];
+                CV_DbgAssert(!cvIsNaN(d1));
+                float transformed_d1 = static_cast<float>(d1 * (KRK_inv6_u1[u1] + KRK_inv7_v1_plus_KRK_inv8[v1]) +
+                                                          Kt_ptr[2]);
+                if(transformed_d1 > 0)
+                {
+                    float transformed_d1_inv = 1.f / transformed_d1;
+                    int u0 = cvRound(transformed_d1_inv * (d1 * (KRK_inv0_u1[u1] + KRK_inv1_v1_plus_KRK_inv2[v1]) +
+                                                           Kt_ptr[0]));
+                    int v0 = cvRound(transformed_d1_inv * (d1 * (KRK_inv3_u1[u1] + KRK_inv4_v1_plus_KRK_inv5[v1]) +
+                                                           Kt_ptr[1]));
+
+                    if(r.contains(Point(u0,v0)))
+                    {
+                        float d0 = depth0.ptr<float>(v0)[u0];
+                        if(validMask0.ptr<uchar>(v0)[u0] && std::abs(transformed_d1 - d0) <= maxDepthDiff)
+                        {
+                            CV_DbgAssert(!cvIsNaN(d0));
+                            projections_row[u1] = v0 * depth1.cols + u0;
+                            projectedDepth_row[u1] = transformed_d1;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+private:
+    const Mat& depth0;
+    const Mat& validMask0;
+    const Mat& depth1;
+    const Mat& selectMask1;
+    float maxDepthDiff;
+    const float* KRK_inv_u1;
+    const float* KRK_inv_v1;
+    const double* Kt_ptr;
+    Mat& projections;
+    Mat& projectedDepth;
+
+    ProjectDepthInvoker& operator=(const ProjectDepthInvoker&);
+};
+
 static
 void computeCorresps(const Mat& K, const Mat& K_inv, const Mat& Rt,
                      const Mat& depth0, const Mat& validMask0,
                      const Mat& depth1, const Mat& selectMask1, float maxDepthDiff,
-                     Mat& _corresps)
+                     OdometryBuffers& buffers, Mat& correspsStorage, Mat& _corresps)
 {
     CV_Assert(K.type() == CV_64FC1);
     CV_Assert(K_inv.type() == CV_64FC1);
     CV_Assert(Rt.type() == CV_64FC1);
+    CV_Assert(depth0.size() == depth1.size());
 
-    Mat corresps(depth1.size(), CV_16SC2, Scalar::all(-1));
-    
-    Rect r(0, 0, depth1.cols, depth1.rows);
     Mat Kt = Rt(Rect(3,0,1,3)).clone();
     Kt = K * Kt;
     const double * Kt_ptr = Kt.ptr<const double>();
 
     AutoBuffer<float> buf(3 * (depth1.cols + depth1.rows));
     float *KRK_inv0_u1 = buf;
-    float *KRK_inv1_v1_plus_KRK_inv2 = KRK_inv0_u1 + depth1.cols;
-    float *KRK_inv3_u1 = KRK_inv1_v1_plus_KRK_inv2 + depth1.rows;
-    float *KRK_inv4_v1_plus_KRK_inv5 = KRK_inv3_u1 + depth1.cols;
-    float *KRK_inv6_u1 = KRK_inv4_v1_plus_KRK_inv5 + depth1.rows;
-    float *KRK_inv7_v1_plus_KRK_inv8 = KRK_inv6_u1 + depth1.cols;
+    float *KRK_inv3_u1 = KRK_inv0_u1 + depth1.cols;
+    float *KRK_inv6_u1 = KRK_inv3_u1 + depth1.cols;
+    float *KRK_inv1_v1_plus_KRK_inv2 = KRK_inv6_u1 + depth1.cols;
+    float *KRK_inv4_v1_plus_KRK_inv5 = KRK_inv1_v1_plus_KRK_inv2 + depth1.rows;
+    float *KRK_inv7_v1_plus_KRK_inv8 = KRK_inv4_v1_plus_KRK_inv5 + depth1.rows;
     {
         Mat R = Rt(Rect(0,0,3,3)).clone();
 
@@ -486,7 +598,7 @@ void computeCorresps(const Mat& K, const Mat& K_inv, const Mat& Rt,
             KRK_inv3_u1[u1] = (float)(KRK_inv_ptr[3] * u1);
             KRK_inv6_u1[u1] = (float)(KRK_inv_ptr[6] * u1);
         }
-        
+
         for(int v1 = 0; v1 < depth1.rows; v1++)
         {
             KRK_inv1_v1_plus_KRK_inv2[v1] = (float)(KRK_inv_ptr[1] * v1 + KRK_inv_ptr[2]);
@@ -495,57 +607,45 @@ void computeCorresps(const Mat& K, const Mat& K_inv, const Mat& Rt,
         }
     }
 
+    // projections of the rows are independent
+    Mat projections = getBufferMat(buffers.projections, depth1.rows, depth1.cols, CV_32SC1);
+    Mat projectedDepth = getBufferMat(buffers.projectedDepth, depth1.rows, depth1.cols, CV_32FC1);
+    parallel_for_(Range(0, depth1.rows),
+                  ProjectDepthInvoker(depth0, validMask0, depth1, selectMask1, maxDepthDiff,
+                                      KRK_inv0_u1, KRK_inv1_v1_plus_KRK_inv2, Kt_ptr,
+                                      projections, projectedDepth));
+
+    // when several pixels are projected on the same one, the closest wins (the last one on ties)
+    Mat corresps = getBufferMat(buffers.correspsMap, depth1.rows, depth1.cols, CV_16SC2);
+    corresps.setTo(Scalar::all(-1));
+    Vec2s* corresps_ptr = corresps.ptr<Vec2s>();
+
     int correspCount = 0;
     for(int v1 = 0; v1 < depth1.rows; v1++)
     {
-        const float *depth1_row = depth1.ptr<float>(v1);
-        const uchar *mask1_row = selectMask1.ptr<uchar>(v1);
+        const int *projections_row = projections.ptr<int>(v1);
+        const float *projectedDepth_row = projectedDepth.ptr<float>(v1);
         for(int u1 = 0; u1 < depth1.cols; u1++)
         {
-            float d1 = depth1_row[u1];
-            if(mask1_row[u1])
-            {
-                CV_DbgAssert(!cvIsNaN(d1));
-                float transformed_d1 = static_cast<float>(d1 * (KRK_inv6_u1[u1] + KRK_inv7_v1_plus_KRK_inv8[v1]) + 
-                                                          Kt_ptr[2]);
-                if(transformed_d1 > 0)
-                {
-                    float transformed_d1_inv = 1.f / transformed_d1;
-                    int u0 = cvRound(transformed_d1_inv * (d1 * (KRK_inv0_u1[u1] + KRK_inv1_v1_plus_KRK_inv2[v1]) + 
-                                                           Kt_ptr[0]));
-                    int v0 = cvRound(transformed_d1_inv * (d1 * (KRK_inv3_u1[u1] + KRK_inv4_v1_plus_KRK_inv5[v1]) + 
-                                                           Kt_ptr[1]));
-                    
-                    if(r.contains(Point(u0,v0)))
-                    {
-                        float d0 = depth0.at<float>(v0,u0);
-                        if(validMask0.at<uchar>(v0, u0) && std::abs(transformed_d1 - d0) <= maxDepthDiff)
-                        {
-                            CV_DbgAssert(!cvIsNaN(d0));
-                            Vec2s& c = corresps.at<Vec2s>(v0,u0);
-                            if(c[0] != -1)
-                            {
-                                int exist_u1 = c[0], exist_v1 = c[1];
-
-                                float exist_d1 = (float)(depth1.at<float>(exist_v1,exist_u1) * 
-                                    (KRK_inv6_u1[exist_u1] + KRK_inv7_v1_plus_KRK_inv8[exist_v1]) + Kt_ptr[2]);
-
-                                if(transformed_d1 > exist_d1)
-                                    continue;
-                            }
-                            else
-                                correspCount++;
+            int p = projections_row[u1];
+            if(p < 0)
+                continue;
 
-                            c = Vec2s((short)u1, (short)v1);
-                        }
-                    }
-                }
+            Vec2s& c = corresps_ptr[p];
+            if(c[0] != -1)
+            {
+                if(projectedDepth_row[u1] > projectedDepth.ptr<float>(c[1])[c[0]])
+                    continue;
             }
+            else
+                correspCount++;
+
+            c = Vec2s((short)u1, (short)v1);
         }
     }
 
-    _corresps.create(correspCount, 1, CV_32SC4);
-    Vec4i * corresps_ptr = _corresps.ptr<Vec4i>();
+    _corresps = getBufferMat(correspsStorage, correspCount, 1, CV_32SC4);
+    Vec4i * _corresps_ptr = _corresps.ptr<Vec4i>();
     for(int v0 = 0, i = 0; v0 < corresps.rows; v0++)
     {
         const Vec2s* corresps_row = corresps.ptr<Vec2s>(v0);
@@ -553,7 +653,7 @@ void computeCorresps(const Mat& K, const Mat& K_inv, const Mat& Rt,
         {
             const Vec2s& c = corresps_row[u0];
             if(c[0] != -1)
-                corresps_ptr[i++] = Vec4i(u0,v0,c[0],c[1]);
+                _corresps_ptr[i++] = Vec4i(u0,v0,c[0],c[1]);
         }
     }
 }
@@ -631,23 +731,132 @@ void calcICPEquationCoeffsTranslation(double* C, const Point3f& /*p0*/, const Ve
 typedef
 void (*CalcICPEquationCoeffsPtr)(double*, const Point3f&, const Vec3f&);
 
-static 
+// Number of correspondences accumulated by a parallel stripe, the stripes don't depend on the
+// number of threads so the normal equations are the same whatever the parallel backend.
+const int lsmStripeSize = 1024;
+
+static inline
+void accumulateLsm(const double* A_ptr, double w, double diff, int transformDim, double* AtA_ptr, double* AtB_ptr)
+{
+    for(int y = 0; y < transformDim; y++)
+    {
+        double* AtA_row = AtA_ptr + y * transformDim;
+        for(int x = y; x < transformDim; x++)
+            AtA_row[x] += A_ptr[y] * A_ptr[x];
+
+        AtB_ptr[y] += A_ptr[y] * w * diff;
+    }
+}
+
+// Sums the normal equations of all the stripes, every row of sums is AtA followed by AtB
+static
+void reduceLsmSums(const Mat& sums, int transformDim, Mat& AtA, Mat& AtB)
+{
+    AtA.create(transformDim, transformDim, CV_64FC1);
+    AtB.create(transformDim, 1, CV_64FC1);
+    AtA.setTo(Scalar(0));
+    AtB.setTo(Scalar(0));
+    double* AtA_ptr = AtA.ptr<double>();
+    double* AtB_ptr = AtB.ptr<double>();
+
+    for(int stripe = 0; stripe < sums.rows; stripe++)
+    {
+        const double* sums_ptr = sums.ptr<double>(stripe);
+        for(int y = 0; y < transformDim; y++)
+        {
+            for(int x = y; x < transformDim; x++)
+                AtA_ptr[y * transformDim + x] += sums_ptr[y * transformDim + x];
+            AtB_ptr[y] += sums_ptr[transformDim * transformDim + y];
+        }
+    }
+
+    for(int y = 0; y < transformDim; y++)
+        for(int x = y+1; x < transformDim; x++)
+            AtA_ptr[x * transformDim + y] = AtA_ptr[y * transformDim + x];
+}
+
+class RgbdLsmInvoker : public ParallelLoopBody
+{
+public:
+    RgbdLsmInvoker(const Mat& _cloud0, const double* _Rt_ptr,
+                   const Mat& _dI_dx1, const Mat& _dI_dy1,
+                   const Mat& _corresps, const float* _diffs_ptr, double _sigma,
+                   double _fx, double _fy, double _sobelScaleIn,
+                   CalcRgbdEquationCoeffsPtr _func, int _transformDim, Mat& _sums) :
+        cloud0(_cloud0), Rt_ptr(_Rt_ptr), dI_dx1(_dI_dx1), dI_dy1(_dI_dy1),
+        corresps(_corresps), diffs_ptr(_diffs_ptr), sigma(_sigma),
+        fx(_fx), fy(_fy), sobelScaleIn(_sobelScaleIn),
+        func(_func), transformDim(_transformDim), sums(_sums)
+    {}
+
+    virtual void operator()(const Range& range) const
+    {
+        const Vec4i* corresps_ptr = corresps.ptr<Vec4i>();
+        double A_ptr[6];
+
+        for(int stripe = range.start; stripe < range.end; stripe++)
+        {
+            double* AtA_ptr = sums.ptr<double>(stripe);
+            double* AtB_ptr = AtA_ptr + transformDim * transformDim;
+
+            int end = std::min(corresps.rows, (stripe + 1) * lsmStripeSize);
+            for(int correspIndex = stripe * lsmStripeSize; correspIndex < end; correspIndex++)
+            {
+                const Vec4i& c = corresps_ptr[correspIndex];
+                int u0 = c[0], v0 = c[1];
+                int u1 = c[2], v1 = c[3];
+
+                double w = sigma + std::abs(diffs_ptr[correspIndex]);
+                w = w > DBL_EPSILON ? 1./w : 1.;
+
+                double w_sobelScale = w * sobelScaleIn;
+
+                const Point3f& p0 = cloud0.ptr<Point3f>(v0)[u0];
+                Point3f tp0;
+                tp0.x = (float)(p0.x * Rt_ptr[0] + p0.y * Rt_ptr[1] + p0.z * Rt_ptr[2] + Rt_ptr[3]);
+                tp0.y = (float)(p0.x * Rt_ptr[4] + p0.y * Rt_ptr[5] + p0.z * Rt_ptr[6] + Rt_ptr[7]);
+                tp0.z = (float)(p0.x * Rt_ptr[8] + p0.y * Rt_ptr[9] + p0.z * Rt_ptr[10] + Rt_ptr[11]);
+
+                func(A_ptr,
+                     w_sobelScale * dI_dx1.ptr<short int>(v1)[u1],
+                     w_sobelScale * dI_dy1.ptr<short int>(v1)[u1],
+                     tp0, fx, fy);
+
+                accumulateLsm(A_ptr, w, diffs_ptr[correspIndex], transformDim, AtA_ptr, AtB_ptr);
+            }
+        }
+    }
+
+private:
+    const Mat& cloud0;
+    const double* Rt_ptr;
+    const Mat& dI_dx1;
+    const Mat& dI_dy1;
+    const Mat& corresps;
+    const float* diffs_ptr;
+    double sigma;
+    double fx, fy, sobelScaleIn;
+    CalcRgbdEquationCoeffsPtr func;
+    int transformDim;
+    Mat& sums;
+
+    RgbdLsmInvoker& operator=(const RgbdLsmInvoker&);
+};
+
+static
 void calcRgbdLsmMatrices(const Mat& image0, const Mat& cloud0, const Mat& Rt,
                const Mat& image1, const Mat& dI_dx1, const Mat& dI_dy1,
                const Mat& corresps, double fx, double fy, double sobelScaleIn,
-               Mat& AtA, Mat& AtB, CalcRgbdEquationCoeffsPtr func, int transformDim)
+               Mat& AtA, Mat& AtB, CalcRgbdEquationCoeffsPtr func, int transformDim,
+               OdometryBuffers& buffers)
 {
-    AtA = Mat(transformDim, transformDim, CV_64FC1, Scalar(0));
-    AtB = Mat(transformDim, 1, CV_64FC1, Scalar(0));
-    double* AtB_ptr = AtB.ptr<double>();
-
     const int correspsCount = corresps.rows;
 
     CV_Assert(Rt.type() == CV_64FC1);
     const double * Rt_ptr = Rt.ptr<const double>();
 
-    AutoBuffer<float> diffs(correspsCount);
-    float* diffs_ptr = diffs;
+    Mat diffs = getBufferMat(buffers.diffs, correspsCount, 1, CV_32FC1);
+    float* diffs_ptr = diffs.ptr<float>();
 
     const Vec4i* corresps_ptr = corresps.ptr<Vec4i>();
 
@@ -657,73 +866,90 @@ void calcRgbdLsmMatrices(const Mat& image0, const Mat& cloud0, const Mat& Rt,
          const Vec4i& c = corresps_ptr[correspIndex];
          int u0 = c[0], v0 = c[1];
          int u1 = c[2], v1 = c[3];
-              
-         diffs_ptr[correspIndex] = static_cast<float>(static_cast<int>(image0.at<uchar>(v0,u0)) - 
-                                                      static_cast<int>(image1.at<uchar>(v1,u1)));
+
+         diffs_ptr[correspIndex] = static_cast<float>(static_cast<int>(image0.ptr<uchar>(v0)[u0]) -
+                                                      static_cast<int>(image1.ptr<uchar>(v1)[u1]));
          sigma += diffs_ptr[correspIndex] * diffs_ptr[correspIndex];
     }
     sigma = std::sqrt(sigma/correspsCount);
 
-    std::vector<double> A_buf(transformDim);
-    double* A_ptr = &A_buf[0];
+    // every stripe accumulates its own normal equations
+    int stripesCount = (correspsCount + lsmStripeSize - 1) / lsmStripeSize;
+    Mat sums = getBufferMat(buffers.sums, stripesCount, transformDim * (transformDim + 1), CV_64FC1);
+    sums.setTo(Scalar(0));
+    parallel_for_(Range(0, stripesCount),
+                  RgbdLsmInvoker(cloud0, Rt_ptr, dI_dx1, dI_dy1, corresps, diffs_ptr, sigma,
+                                 fx, fy, sobelScaleIn, func, transformDim, sums));
 
-    for(int correspIndex = 0; correspIndex < corresps.rows; correspIndex++)
-    {
-         const Vec4i& c = corresps_ptr[correspIndex];
-         int u0 = c[0], v0 = c[1];
-         int u1 = c[2], v1 = c[3];
+    reduceLsmSums(sums, transformDim, AtA, AtB);
+}
 
-         double w = sigma + std::abs(diffs_ptr[correspIndex]);
-         w = w > DBL_EPSILON ? 1./w : 1.;
+class ICPLsmInvoker : public ParallelLoopBody
+{
+public:
+    ICPLsmInvoker(const Mat& _normals1, const Mat& _corresps,
+                  const Point3f* _tps0_ptr, const float* _diffs_ptr, double _sigma,
+                  CalcICPEquationCoeffsPtr _func, int _transformDim, Mat& _sums) :
+        normals1(_normals1), corresps(_corresps), tps0_ptr(_tps0_ptr), diffs_ptr(_diffs_ptr), sigma(_sigma),
+        func(_func), transformDim(_transformDim), sums(_sums)
+    {}
+
+    virtual void operator()(const Range& range) const
+    {
+        const Vec4i* corresps_ptr = corresps.ptr<Vec4i>();
+        double A_ptr[6];
 
-         double w_sobelScale = w * sobelScaleIn;
+        for(int stripe = range.start; stripe < range.end; stripe++)
+        {
+            double* AtA_ptr = sums.ptr<double>(stripe);
+            double* AtB_ptr = AtA_ptr + transformDim * transformDim;
 
-         const Point3f& p0 = cloud0.at<Point3f>(v0,u0);
-         Point3f tp0;
-         tp0.x = (float)(p0.x * Rt_ptr[0] + p0.y * Rt_ptr[1] + p0.z * Rt_ptr[2] + Rt_ptr[3]);
-         tp0.y = (float)(p0.x * Rt_ptr[4] + p0.y * Rt_ptr[5] + p0.z * Rt_ptr[6] + Rt_ptr[7]);
-         tp0.z = (float)(p0.x * Rt_ptr[8] + p0.y * Rt_ptr[9] + p0.z * Rt_ptr[10] + Rt_ptr[11]);
+            int end = std::min(corresps.rows, (stripe + 1) * lsmStripeSize);
+            for(int correspIndex = stripe * lsmStripeSize; correspIndex < end; correspIndex++)
+            {
+                const Vec4i& c = corresps_ptr[correspIndex];
+                int u1 = c[2], v1 = c[3];
 
-         func(A_ptr,
-              w_sobelScale * dI_dx1.at<short int>(v1,u1),
-              w_sobelScale * dI_dy1.at<short int>(v1,u1),
-              tp0, fx, fy);
+                double w = sigma + std::abs(diffs_ptr[correspIndex]);
+                w = w > DBL_EPSILON ? 1./w : 1.;
 
-        for(int y = 0; y < transformDim; y++)
-        {
-            double* AtA_ptr = AtA.ptr<double>(y);
-            for(int x = y; x < transformDim; x++)
-                AtA_ptr[x] += A_ptr[y] * A_ptr[x];
+                func(A_ptr, tps0_ptr[correspIndex], normals1.ptr<Vec3f>(v1)[u1] * w);
 
-            AtB_ptr[y] += A_ptr[y] * w * diffs_ptr[correspIndex];
+                accumulateLsm(A_ptr, w, diffs_ptr[correspIndex], transformDim, AtA_ptr, AtB_ptr);
+            }
         }
-    }		
-    
-    for(int y = 0; y < transformDim; y++)
-        for(int x = y+1; x < transformDim; x++)
-            AtA.at<double>(x,y) = AtA.at<double>(y,x);
-}
+    }
+
+private:
+    const Mat& normals1;
+    const Mat& corresps;
+    const Point3f* tps0_ptr;
+    const float* diffs_ptr;
+    double sigma;
+    CalcICPEquationCoeffsPtr func;
+    int transformDim;
+    Mat& sums;
+
+    ICPLsmInvoker& operator=(const ICPLsmInvoker&);
+};
 
 static
 void calcICPLsmMatrices(const Mat& cloud0, const Mat& Rt,
                         const Mat& cloud1, const Mat& normals1,
                         const Mat& corresps,
-                        Mat& AtA, Mat& AtB, CalcICPEquationCoeffsPtr func, int transformDim)
+                        Mat& AtA, Mat& AtB, CalcICPEquationCoeffsPtr func, int transformDim,
+                        OdometryBuffers& buffers)
 {
-    AtA = Mat(transformDim, transformDim, CV_64FC1, Scalar(0));
-    AtB = Mat(transformDim, 1, CV_64FC1, Scalar(0));
-    double* AtB_ptr = AtB.ptr<double>();
-
     const int correspsCount = corresps.rows;
 
     CV_Assert(Rt.type() == CV_64FC1);
     const double * Rt_ptr = Rt.ptr<const double>();
 
-    AutoBuffer<float> diffs(correspsCount);
-    float * diffs_ptr = diffs;
+    Mat diffs = getBufferMat(buffers.diffs, correspsCount, 1, CV_32FC1);
+    float * diffs_ptr = diffs.ptr<float>();
 
-    AutoBuffer<Point3f> transformedPoints0(correspsCount);
-    Point3f * tps0_ptr = transformedPoints0;
+    Mat transformedPoints0 = getBufferMat(buffers.transformedPoints, correspsCount, 1, CV_32FC3);
+    Point3f * tps0_ptr = transformedPoints0.ptr<Point3f>();
 
     const Vec4i* corresps_ptr = corresps.ptr<Vec4i>();
 
@@ -734,14 +960,14 @@ void calcICPLsmMatrices(const Mat& cloud0, const Mat& Rt,
         int u0 = c[0], v0 = c[1];
         int u1 = c[2], v1 = c[3];
 
-        const Point3f& p0 = cloud0.at<Point3f>(v0,u0);
+        const Point3f& p0 = cloud0.ptr<Point3f>(v0)[u0];
         Point3f tp0;
         tp0.x = (float)(p0.x * Rt_ptr[0] + p0.y * Rt_ptr[1] + p0.z * Rt_ptr[2] + Rt_ptr[3]);
         tp0.y = (float)(p0.x * Rt_ptr[4] + p0.y * Rt_ptr[5] + p0.z * Rt_ptr[6] + Rt_ptr[7]);
         tp0.z = (float)(p0.x * Rt_ptr[8] + p0.y * Rt_ptr[9] + p0.z * Rt_ptr[10] + Rt_ptr[11]);
 
-        Vec3f n1 = normals1.at<Vec3f>(v1, u1);
-        Point3f v = cloud1.at<Point3f>(v1,u1) - tp0;
+        Vec3f n1 = normals1.ptr<Vec3f>(v1)[u1];
+        Point3f v = cloud1.ptr<Point3f>(v1)[u1] - tp0;
 
         tps0_ptr[correspIndex] = tp0;
         diffs_ptr[correspIndex] = n1[0] * v.x + n1[1] * v.y + n1[2] * v.z;
@@ -750,31 +976,14 @@ void calcICPLsmMatrices(const Mat& cloud0, const Mat& Rt,
 
     sigma = std::sqrt(sigma/correspsCount);
 
-    std::vector<double> A_buf(transformDim);
-    double* A_ptr = &A_buf[0];
-    for(int correspIndex = 0; correspIndex < corresps.rows; correspIndex++)
-    {
-        const Vec4i& c = corresps_ptr[correspIndex];
-        int u1 = c[2], v1 = c[3];
+    // every stripe accumulates its own normal equations
+    int stripesCount = (correspsCount + lsmStripeSize - 1) / lsmStripeSize;
+    Mat sums = getBufferMat(buffers.sums, stripesCount, transformDim * (transformDim + 1), CV_64FC1);
+    sums.setTo(Scalar(0));
+    parallel_for_(Range(0, stripesCount),
+                  ICPLsmInvoker(normals1, corresps, tps0_ptr, diffs_ptr, sigma, func, transformDim, sums));
 
-        double w = sigma + std::abs(diffs_ptr[correspIndex]);
-        w = w > DBL_EPSILON ? 1./w : 1.;
-
-        func(A_ptr, tps0_ptr[correspIndex], normals1.at<Vec3f>(v1, u1) * w);
-
-        for(int y = 0; y < transformDim; y++)
-        {
-            double* AtA_ptr = AtA.ptr<double>(y);
-            for(int x = y; x < transformDim; x++)
-                AtA_ptr[x] += A_ptr[y] * A_ptr[x];
-
-            AtB_ptr[y] += A_ptr[y] * w * diffs_ptr[correspIndex];
-        }
-    }
-
-    for(int y = 0; y < transformDim; y++)
-        for(int x = y+1; x < transformDim; x++)
-            AtA.at<double>(x,y) = AtA.at<double>(y,x);
+    reduceLsmSums(sums, transformDim, AtA, AtB);
 }
 
 static
@@ -844,6 +1053,8 @@ bool RGBDICPOdometryImpl(Mat& Rt, const Mat& initRt,
 
     Mat resultRt = initRt.empty() ? Mat::eye(4,4,CV_64FC1) : initRt.clone();
     Mat currRt, ksi;
+    Mat AtA_rgbd, AtB_rgbd, AtA_icp, AtB_icp;
+    OdometryBuffers buffers;
 
     bool isOk = false;
     for(int level = (int)iterCounts.size() - 1; level >= 0; level--)
@@ -857,7 +1068,6 @@ bool RGBDICPOdometryImpl(Mat& Rt, const Mat& initRt,
         const double fy = levelCameraMatrix.at<double>(1,1);
         const double determinantThreshold = 1e-6;
 
-        Mat AtA_rgbd, AtB_rgbd, AtA_icp, AtB_icp;
         Mat corresps_rgbd, corresps_icp;
 
         // Run transformation search on current level iteratively.
@@ -868,12 +1078,12 @@ bool RGBDICPOdometryImpl(Mat& Rt, const Mat& initRt,
             if(method & RGBD_ODOMETRY)
                 computeCorresps(levelCameraMatrix, levelCameraMatrix_inv, resultRt_inv,
                                 srcLevelDepth, srcFrame->pyramidMask[level], dstLevelDepth, dstFrame->pyramidTexturedMask[level],
-                                maxDepthDiff, corresps_rgbd);
+                                maxDepthDiff, buffers, buffers.correspsRgbd, corresps_rgbd);
 
             if(method & ICP_ODOMETRY)
                 computeCorresps(levelCameraMatrix, levelCameraMatrix_inv, resultRt_inv,
                                 srcLevelDepth, srcFrame->pyramidMask[level], dstLevelDepth, dstFrame->pyramidNormalsMask[level],
-                                maxDepthDiff, corresps_icp);
+                                maxDepthDiff, buffers, buffers.correspsIcp, corresps_icp);
 
             if(corresps_rgbd.rows < minCorrespsCount && corresps_icp.rows < minCorrespsCount)
                 break;
@@ -884,7 +1094,7 @@ bool RGBDICPOdometryImpl(Mat& Rt, const Mat& initRt,
                 calcRgbdLsmMatrices(srcFrame->pyramidImage[level], srcFrame->pyramidCloud[level], resultRt,
                                     dstFrame->pyramidImage[level], dstFrame->pyramid_dI_dx[level], dstFrame->pyramid_dI_dy[level],
                                     corresps_rgbd, fx, fy, sobelScale,
-                                    AtA_rgbd, AtB_rgbd, rgbdEquationFuncPtr, transformDim);
+                                    AtA_rgbd, AtB_rgbd, rgbdEquationFuncPtr, transformDim, buffers);
 
                 AtA += AtA_rgbd;
                 AtB += AtB_rgbd;
@@ -893,7 +1103,7 @@ bool RGBDICPOdometryImpl(Mat& Rt, const Mat& initRt,
             {
                 calcICPLsmMatrices(srcFrame->pyramidCloud[level], resultRt,
                                    dstFrame->pyramidCloud[level], dstFrame->pyramidNormals[level],
-                                   corresps_icp, AtA_icp, AtB_icp, icpEquationFuncPtr, transformDim);
+                                   corresps_icp, AtA_icp, AtB_icp, icpEquationFuncPtr, transformDim, buffers);
                 AtA += AtA_icp;
                 AtB += AtB_icp;
             }
@@ -1022,6 +1232,39 @@ void OdometryFrame::release()
     releasePyramids();
 }
 
+// Moves the levels of a pyramid which are not shared with the user to the buffers of the frame
+static
+void recyclePyramid(std::vector<Mat>& pyramid, std::vector<Mat>& buffers)
+{
+    for(size_t level = 0; level < pyramid.size(); level++)
+    {
+        const Mat& buffer = pyramid[level];
+        if(buffer.u && buffer.u->refcount == 1 && buffer.isContinuous())
+            buffers.push_back(buffer);
+    }
+    pyramid.clear();
+}
+
+void OdometryFrame::setFrame(const Mat& image_in, const Mat& depth_in, const Mat& mask_in, const Mat& normals_in, int ID_in)
+{
+    RgbdFrame::release();
+
+    std::vector<Mat>* pyramids[] = { &pyramidImage, &pyramidDepth, &pyramidMask, &pyramidCloud,
+                                     &pyramid_dI_dx, &pyramid_dI_dy, &pyramidTexturedMask,
+                                     &pyramidNormals, &pyramidNormalsMask };
+
+    // the buffers which were not reused by the current frame are dropped
+    pyramidBuffers.clear();
+    for(size_t i = 0; i < sizeof(pyramids) / sizeof(pyramids[0]); i++)
+        recyclePyramid(*pyramids[i], pyramidBuffers);
+
+    ID = ID_in;
+    image = image_in;
+    depth = depth_in;
+    mask = mask_in;
+    normals = normals_in;
+}
+
 void OdometryFrame::releasePyramids()
 {
     pyramidImage.clear();
@@ -1036,6 +1279,8 @@ void OdometryFrame::releasePyramids()
 
     pyramidNormals.clear();
     pyramidNormalsMask.clear();
+
+    pyramidBuffers.clear();
 }
 
 bool Odometry::compute(const Mat& srcImage, const Mat& srcDepth, const Mat& srcMask,
@@ -1061,6 +1306,38 @@ bool Odometry::compute(Ptr<OdometryFrame>& srcFrame, Ptr<OdometryFrame>& dstFram
     return computeImpl(srcFrame, dstFrame, Rt, initRt);
 }
 
+bool Odometry::computeNext(Ptr<OdometryFrame>& prevFrame, Ptr<OdometryFrame>& frame,
+                           const Mat& image, const Mat& depth, const Mat& mask, Mat& Rt, const Mat& initRt) const
+{
+    if(prevFrame.empty())
+        prevFrame = makePtr<OdometryFrame>();
+    if(frame.empty())
+        frame = makePtr<OdometryFrame>();
+
+    // the last frame becomes the source one and the memory of the old source is reused for the new frame
+    std::swap(prevFrame, frame);
+    frame->setFrame(image, depth, mask);
+
+    // the masks of a destination frame are built with its normals (when the odometry uses them),
+    // which a source frame doesn't use, so they are rebuilt the way compute() builds them for a new
+    // source frame, their memory being reused for that
+    if(!prevFrame->pyramidNormals.empty())
+    {
+        prevFrame->normals.release();
+        recyclePyramid(prevFrame->pyramidNormals, prevFrame->pyramidBuffers);
+        recyclePyramid(prevFrame->pyramidMask, prevFrame->pyramidBuffers);
+        recyclePyramid(prevFrame->pyramidNormalsMask, prevFrame->pyramidBuffers);
+    }
+
+    if(prevFrame->depth.empty() && prevFrame->pyramidDepth.empty() && prevFrame->pyramidCloud.empty())
+    {
+        Rt = Mat::eye(4, 4, CV_64FC1);
+        return false;
+    }
+
+    return compute(prevFrame, frame, Rt, initRt);
+}
+
 Size Odometry::prepareFrameCache(Ptr<OdometryFrame> &frame, int /*cacheType*/) const
 {
     if(frame == 0)
@@ -1148,22 +1425,22 @@ Size RgbdOdometry::prepareFrameCache(Ptr<OdometryFrame>& frame, int cacheType) c
         frame->mask = frame->pyramidMask[0];
     checkMask(frame->mask, frame->image.size());
 
-    preparePyramidImage(frame->image, frame->pyramidImage, iterCounts.total());
+    preparePyramidImage(frame->image, frame->pyramidImage, iterCounts.total(), frame->pyramidBuffers);
 
-    preparePyramidDepth(frame->depth, frame->pyramidDepth, iterCounts.total());
+    preparePyramidDepth(frame->depth, frame->pyramidDepth, iterCounts.total(), frame->pyramidBuffers);
 
     preparePyramidMask(frame->mask, frame->pyramidDepth, (float)minDepth, (float)maxDepth,
-                       frame->pyramidNormals, frame->pyramidMask);
+                       frame->pyramidNormals, frame->pyramidMask, frame->pyramidBuffers);
 
     if(cacheType & OdometryFrame::CACHE_SRC)
-        preparePyramidCloud(frame->pyramidDepth, cameraMatrix, frame->pyramidCloud);
+        preparePyramidCloud(frame->pyramidDepth, cameraMatrix, frame->pyramidCloud, frame->pyramidBuffers);
 
     if(cacheType & OdometryFrame::CACHE_DST)
     {
-        preparePyramidSobel(frame->pyramidImage, 1, 0, frame->pyramid_dI_dx);
-        preparePyramidSobel(frame->pyramidImage, 0, 1, frame->pyramid_dI_dy);
+        preparePyramidSobel(frame->pyramidImage, 1, 0, frame->pyramid_dI_dx, frame->pyramidBuffers);
+        preparePyramidSobel(frame->pyramidImage, 0, 1, frame->pyramid_dI_dy, frame->pyramidBuffers);
         preparePyramidTexturedMask(frame->pyramid_dI_dx, frame->pyramid_dI_dy, minGradientMagnitudes,
-                                   frame->pyramidMask, maxPointsPart, frame->pyramidTexturedMask);
+                                   frame->pyramidMask, maxPointsPart, frame->pyramidTexturedMask, frame->pyramidBuffers);
     }
 
     return frame->image.size();
@@ -1227,9 +1504,9 @@ Size ICPOdometry::prepareFrameCache(Ptr<OdometryFrame>& frame, int cacheType) co
         frame->mask = frame->pyramidMask[0];
     checkMask(frame->mask, frame->depth.size());
 
-    preparePyramidDepth(frame->depth, frame->pyramidDepth, iterCounts.total());
+    preparePyramidDepth(frame->depth, frame->pyramidDepth, iterCounts.total(), frame->pyramidBuffers);
 
-    preparePyramidCloud(frame->pyramidDepth, cameraMatrix, frame->pyramidCloud);
+    preparePyramidCloud(frame->pyramidDepth, cameraMatrix, frame->pyramidCloud, frame->pyramidBuffers);
 
     if(cacheType & OdometryFrame::CACHE_DST)
     {
@@ -1255,16 +1532,17 @@ Size ICPOdometry::prepareFrameCache(Ptr<OdometryFrame>& frame, int cacheType) co
         }
         checkNormals(frame->normals, frame->depth.size());
 
-        preparePyramidNormals(frame->normals, frame->pyramidDepth, frame->pyramidNormals);
+        preparePyramidNormals(frame->normals, frame->pyramidDepth, frame->pyramidNormals, frame->pyramidBuffers);
 
         preparePyramidMask(frame->mask, frame->pyramidDepth, (float)minDepth, (float)maxDepth,
-                           frame->pyramidNormals, frame->pyramidMask);
+                           frame->pyramidNormals, frame->pyramidMask, frame->pyramidBuffers);
 
-        preparePyramidNormalsMask(frame->pyramidNormals, frame->pyramidMask, maxPointsPart, frame->pyramidNormalsMask);
+        preparePyramidNormalsMask(frame->pyramidNormals, frame->pyramidMask, maxPointsPart, frame->pyramidNormalsMask,
+                                  frame->pyramidBuffers);
     }
     else
         preparePyramidMask(frame->mask, frame->pyramidDepth, (float)minDepth, (float)maxDepth,
-                           frame->pyramidNormals, frame->pyramidMask);
+                           frame->pyramidNormals, frame->pyramidMask, frame->pyramidBuffers);
 
     return frame->depth.size();
 }
@@ -1339,11 +1617,11 @@ Size RgbdICPOdometry::prepareFrameCache(Ptr<OdometryFrame>& frame, int cacheType
         frame->mask = frame->pyramidMask[0];
     checkMask(frame->mask, frame->image.size());
 
-    preparePyramidImage(frame->image, frame->pyramidImage, iterCounts.total());
+    preparePyramidImage(frame->image, frame->pyramidImage, iterCounts.total(), frame->pyramidBuffers);
 
-    preparePyramidDepth(frame->depth, frame->pyramidDepth, iterCounts.total());
+    preparePyramidDepth(frame->depth, frame->pyramidDepth, iterCounts.total(), frame->pyramidBuffers);
 
-    preparePyramidCloud(frame->pyramidDepth, cameraMatrix, frame->pyramidCloud);
+    preparePyramidCloud(frame->pyramidDepth, cameraMatrix, frame->pyramidCloud, frame->pyramidBuffers);
 
     if(cacheType & OdometryFrame::CACHE_DST)
     {
@@ -1369,22 +1647,23 @@ Size RgbdICPOdometry::prepareFrameCache(Ptr<OdometryFrame>& frame, int cacheType
         }
         checkNormals(frame->normals, frame->depth.size());
 
-        preparePyramidNormals(frame->normals, frame->pyramidDepth, frame->pyramidNormals);
+        preparePyramidNormals(frame->normals, frame->pyramidDepth, frame->pyramidNormals, frame->pyramidBuffers);
 
         preparePyramidMask(frame->mask, frame->pyramidDepth, (float)minDepth, (float)maxDepth,
-                           frame->pyramidNormals, frame->pyramidMask);
+                           frame->pyramidNormals, frame->pyramidMask, frame->pyramidBuffers);
 
-        preparePyramidSobel(frame->pyramidImage, 1, 0, frame->pyramid_dI_dx);
-        preparePyramidSobel(frame->pyramidImage, 0, 1, frame->pyramid_dI_dy);
+        preparePyramidSobel(frame->pyramidImage, 1, 0, frame->pyramid_dI_dx, frame->pyramidBuffers);
+        preparePyramidSobel(frame->pyramidImage, 0, 1, frame->pyramid_dI_dy, frame->pyramidBuffers);
         preparePyramidTexturedMask(frame->pyramid_dI_dx, frame->pyramid_dI_dy,
                                    minGradientMagnitudes, frame->pyramidMask,
-                                   maxPointsPart, frame->pyramidTexturedMask);
+                                   maxPointsPart, frame->pyramidTexturedMask, frame->pyramidBuffers);
 
-        preparePyramidNormalsMask(frame->pyramidNormals, frame->pyramidMask, maxPointsPart, frame->pyramidNormalsMask);
+        preparePyramidNormalsMask(frame->pyramidNormals, frame->pyramidMask, maxPointsPart, frame->pyramidNormalsMask,
+                                  frame->pyramidBuffers);
     }
     else
         preparePyramidMask(frame->mask, frame->pyramidDepth, (float)minDepth, (float)maxDepth,
-                           frame->pyramidNormals, frame->pyramidMask);
+                           frame->pyramidNormals, frame->pyramidMask, frame->pyramidBuffers);
 
     return frame->image.size();
 }
@@ -0,0 +1,290 @@
+/*
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2012, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage, Inc. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "test_precomp.hpp"
+
+#include <opencv2/imgproc.hpp>
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+
+namespace cv
+{
+namespace linemod
+{
+
+// A textured background plane with two hemispheres in front of it, painted with a disc and a ring
+static
+void makeScene(Mat& color, Mat& depth, std::vector<Mat>& objectMasks)
+{
+  RNG rng(12345);
+  color.create(240, 320, CV_8UC3);
+  rng.fill(color, RNG::UNIFORM, 0, 256);
+  GaussianBlur(color, color, Size(7, 7), 2.);
+  depth = Mat(color.size(), CV_16UC1, Scalar(1000));
+
+  const Point centers[] = { Point(90, 120), Point(220, 110) };
+  const int radii[] = { 40, 32 };
+  objectMasks.clear();
+  for (int i = 0; i < 2; ++i)
+  {
+    int r = radii[i];
+    for (int y = -r; y <= r; ++y)
+    {
+      for (int x = -r; x <= r; ++x)
+      {
+        int d2 = x * x + y * y;
+        if (d2 <= r * r)
+          depth.at<ushort>(centers[i].y + y, centers[i].x + x) = saturate_cast<ushort>(900. - 3. * std::sqrt(double(r * r - d2)));
+      }
+    }
+    circle(color, centers[i], r, Scalar(40, 200, 90 + 100 * i), i == 0 ? -1 : 10);
+
+    Mat mask = Mat::zeros(color.size(), CV_8UC1);
+    circle(mask, centers[i], r + 4, Scalar(255), -1);
+    objectMasks.push_back(mask);
+  }
+}
+
+// Color gradients and depth normals, a third modality adds coarser color gradients
+static
+Ptr<Detector> makeDetector(int num_modalities)
+{
+  std::vector< Ptr<Modality> > modalities;
+  modalities.push_back(makePtr<ColorGradient>());
+  modalities.push_back(makePtr<DepthNormal>());
+  if (num_modalities > 2)
+    modalities.push_back(makePtr<ColorGradient>(20.0f, 31, 60.0f));
+
+  std::vector<int> T_pyramid;
+  T_pyramid.push_back(5);
+  T_pyramid.push_back(8);
+  return makePtr<Detector>(modalities, T_pyramid);
+}
+
+static
+std::vector<Mat> makeSources(const Detector& detector, const Mat& color, const Mat& depth)
+{
+  std::vector<Mat> sources;
+  for (size_t i = 0; i < detector.getModalities().size(); ++i)
+    sources.push_back(detector.getModalities()[i]->name() == "DepthNormal" ? depth : color);
+  return sources;
+}
+
+// One class per object and a third one with both of them
+static
+void addSceneTemplates(Detector& detector, const std::vector<Mat>& sources, const std::vector<Mat>& objectMasks)
+{
+  ASSERT_GE(detector.addTemplate(sources, "disc", objectMasks[0]), 0);
+  ASSERT_GE(detector.addTemplate(sources, "ring", objectMasks[1]), 0);
+  ASSERT_GE(detector.addTemplate(sources, "pair", objectMasks[0] | objectMasks[1]), 0);
+}
+
+static
+void expectSameMatches(const std::vector<Match>& expected, const std::vector<Match>& actual)
+{
+  ASSERT_EQ(expected.size(), actual.size());
+  for (size_t i = 0; i < expected.size(); ++i)
+  {
+    EXPECT_EQ(expected[i].x, actual[i].x) << "match " << i;
+    EXPECT_EQ(expected[i].y, actual[i].y) << "match " << i;
+    EXPECT_EQ(expected[i].similarity, actual[i].similarity) << "match " << i;
+    EXPECT_EQ(expected[i].class_id, actual[i].class_id) << "match " << i;
+    EXPECT_EQ(expected[i].template_id, actual[i].template_id) << "match " << i;
+  }
+}
+
+// The templates are matched in parallel and the results gathered in template order, so the
+// matches don't depend on the threads
+static
+void checkThreadsIndependence(int num_modalities)
+{
+  Mat color, depth;
+  std::vector<Mat> objectMasks;
+  makeScene(color, depth, objectMasks);
+
+  Ptr<Detector> detector = makeDetector(num_modalities);
+  std::vector<Mat> sources = makeSources(*detector, color, depth);
+  addSceneTemplates(*detector, sources, objectMasks);
+  ASSERT_EQ(3, detector->numTemplates());
+
+  int threads = getNumThreads();
+  setNumThreads(1);
+  std::vector<Match> serialMatches;
+  detector->match(sources, 80.f, serialMatches);
+  setNumThreads(std::max(threads, 4));
+  std::vector<Match> parallelMatches;
+  detector->match(sources, 80.f, parallelMatches);
+  setNumThreads(threads);
+
+  ASSERT_FALSE(serialMatches.empty());
+  expectSameMatches(serialMatches, parallelMatches);
+}
+
+static
+void expectSameTemplates(const std::vector<Template>& expected, const std::vector<Template>& actual)
+{
+  ASSERT_EQ(expected.size(), actual.size());
+  for (size_t i = 0; i < expected.size(); ++i)
+  {
+    EXPECT_EQ(expected[i].width, actual[i].width);
+    EXPECT_EQ(expected[i].height, actual[i].height);
+    EXPECT_EQ(expected[i].pyramid_level, actual[i].pyramid_level);
+    ASSERT_EQ(expected[i].features.size(), actual[i].features.size());
+    for (size_t j = 0; j < expected[i].features.size(); ++j)
+    {
+      EXPECT_EQ(expected[i].features[j].x, actual[i].features[j].x);
+      EXPECT_EQ(expected[i].features[j].y, actual[i].features[j].y);
+      EXPECT_EQ(expected[i].features[j].label, actual[i].features[j].label);
+    }
+  }
+}
+
+// The classes of a binary template file read lazily are reported before they are loaded, and
+// give the same templates and matches as the classes read from YAML files
+static
+void checkBinaryRoundTrip()
+{
+  Mat color, depth;
+  std::vector<Mat> objectMasks;
+  makeScene(color, depth, objectMasks);
+
+  Ptr<Detector> detector = makeDetector(2);
+  std::vector<Mat> sources = makeSources(*detector, color, depth);
+  addSceneTemplates(*detector, sources, objectMasks);
+  std::vector<String> classIds = detector->classIds();
+
+  String binaryFile = tempfile(".bin");
+  String yamlPrefix = tempfile();
+  String yamlFormat = yamlPrefix + "_%s.yml";
+  detector->writeClassesBinary(binaryFile);
+  detector->writeClasses(yamlFormat);
+
+  Ptr<Detector> yamlDetector = makeDetector(2);
+  yamlDetector->readClasses(classIds, yamlFormat);
+
+  Ptr<Detector> binaryDetector = makeDetector(2);
+  binaryDetector->readClassesBinary(binaryFile, true);
+
+  // Nothing is loaded yet
+  EXPECT_EQ(detector->numClasses(), binaryDetector->numClasses());
+  EXPECT_EQ(detector->numTemplates(), binaryDetector->numTemplates());
+  EXPECT_EQ(classIds, binaryDetector->classIds());
+  for (size_t i = 0; i < classIds.size(); ++i)
+    EXPECT_EQ(detector->numTemplates(classIds[i]), binaryDetector->numTemplates(classIds[i]));
+
+  // getTemplates loads its class only
+  expectSameTemplates(detector->getTemplates("disc", 0), binaryDetector->getTemplates("disc", 0));
+  EXPECT_EQ(detector->numTemplates(), binaryDetector->numTemplates());
+  EXPECT_EQ(classIds, binaryDetector->classIds());
+
+  // match loads the other classes
+  std::vector<Match> yamlMatches, binaryMatches;
+  yamlDetector->match(sources, 80.f, yamlMatches);
+  binaryDetector->match(sources, 80.f, binaryMatches);
+  ASSERT_FALSE(yamlMatches.empty());
+  expectSameMatches(yamlMatches, binaryMatches);
+
+  EXPECT_EQ(detector->numClasses(), binaryDetector->numClasses());
+  EXPECT_EQ(detector->numTemplates(), binaryDetector->numTemplates());
+  EXPECT_EQ(classIds, binaryDetector->classIds());
+  for (size_t i = 0; i < classIds.size(); ++i)
+  {
+    for (int j = 0; j < detector->numTemplates(classIds[i]); ++j)
+      expectSameTemplates(detector->getTemplates(classIds[i], j), binaryDetector->getTemplates(classIds[i], j));
+  }
+
+  std::remove(binaryFile.c_str());
+  std::remove(yamlPrefix.c_str());
+  for (size_t i = 0; i < classIds.size(); ++i)
+    std::remove(format(yamlFormat.c_str(), classIds[i].c_str()).c_str());
+}
+
+// A truncated file is rejected before any of its classes is added
+static
+void checkTruncatedBinaryFile()
+{
+  Mat color, depth;
+  std::vector<Mat> objectMasks;
+  makeScene(color, depth, objectMasks);
+
+  Ptr<Detector> detector = makeDetector(2);
+  std::vector<Mat> sources = makeSources(*detector, color, depth);
+  addSceneTemplates(*detector, sources, objectMasks);
+
+  String binaryFile = tempfile(".bin");
+  detector->writeClassesBinary(binaryFile);
+
+  std::vector<char> data;
+  {
+    std::ifstream in(binaryFile.c_str(), std::ios::binary);
+    data.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+  }
+  ASSERT_GT(data.size(), 32u);
+  {
+    std::ofstream out(binaryFile.c_str(), std::ios::binary | std::ios::trunc);
+    out.write(&data[0], data.size() - 16);
+  }
+
+  Ptr<Detector> binaryDetector = makeDetector(2);
+  EXPECT_ANY_THROW(binaryDetector->readClassesBinary(binaryFile, true));
+  EXPECT_EQ(0, binaryDetector->numClasses());
+
+  std::remove(binaryFile.c_str());
+}
+
+}
+}
+
+TEST(RGBD_Linemod, threads_independence_2_modalities)
+{
+  cv::linemod::checkThreadsIndependence(2);
+}
+
+TEST(RGBD_Linemod, threads_independence_3_modalities)
+{
+  cv::linemod::checkThreadsIndependence(3);
+}
+
+TEST(RGBD_Linemod, binary_templates_round_trip)
+{
+  cv::linemod::checkBinaryRoundTrip();
+}
+
+TEST(RGBD_Linemod, binary_templates_truncated)
+{
+  cv::linemod::checkTruncatedBinaryFile();
+}
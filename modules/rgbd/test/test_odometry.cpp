@@ -353,3 +353,80 @@ TEST(DISABLED_RGBD_Odometry_RgbdICP, algorithmic)
     cv::rgbd::CV_OdometryTest test(cv::rgbd::Odometry::create("RgbdICPOdometry"), 0.99, 0.99);
     test.safe_run();
 }
+
+TEST(RGBD_Odometry_RgbdICP, threads_independence)
+{
+    std::string dataPath = cvtest::TS::ptr()->get_data_path();
+    cv::Mat image = cv::imread(dataPath + "rgbd/rgb.png", 0);
+    cv::Mat depth = cv::imread(dataPath + "rgbd/depth.png", -1);
+    ASSERT_FALSE(image.empty() || depth.empty());
+    depth.convertTo(depth, CV_32FC1, 1.f/5000.f);
+    depth.setTo(std::numeric_limits<float>::quiet_NaN(), depth < FLT_EPSILON);
+
+    cv::Mat K = (cv::Mat_<float>(3,3) << 525.f, 0.f, 319.5f, 0.f, 525.f, 239.5f, 0.f, 0.f, 1.f);
+    cv::Mat rvec = (cv::Mat_<double>(3,1) << 0.01, -0.02, 0.015), tvec = (cv::Mat_<double>(3,1) << 0.01, 0.005, -0.01);
+    cv::Mat warpedImage, warpedDepth;
+    cv::rgbd::warpFrame(image, depth, rvec, tvec, K, warpedImage, warpedDepth);
+    cv::rgbd::dilateFrame(warpedImage, warpedDepth);
+
+    cv::Ptr<cv::rgbd::Odometry> odometry = cv::rgbd::Odometry::create("RgbdICPOdometry");
+    odometry->setCameraMatrix(K);
+
+    // the normal equations are reduced in a fixed order, so the result doesn't depend on the threads
+    int threads = cv::getNumThreads();
+    cv::setNumThreads(1);
+    cv::Mat serialRt;
+    bool serialOk = odometry->compute(image, depth, cv::Mat(), warpedImage, warpedDepth, cv::Mat(), serialRt);
+    cv::setNumThreads(threads);
+    cv::Mat parallelRt;
+    bool parallelOk = odometry->compute(image, depth, cv::Mat(), warpedImage, warpedDepth, cv::Mat(), parallelRt);
+
+    ASSERT_EQ(serialOk, parallelOk);
+    EXPECT_EQ(0., cv::norm(serialRt, parallelRt, cv::NORM_INF));
+}
+
+TEST(RGBD_Odometry_Rgbd, sequence_cache_reuse)
+{
+    std::string dataPath = cvtest::TS::ptr()->get_data_path();
+    cv::Mat image = cv::imread(dataPath + "rgbd/rgb.png", 0);
+    cv::Mat depth = cv::imread(dataPath + "rgbd/depth.png", -1);
+    ASSERT_FALSE(image.empty() || depth.empty());
+    depth.convertTo(depth, CV_32FC1, 1.f/5000.f);
+    depth.setTo(std::numeric_limits<float>::quiet_NaN(), depth < FLT_EPSILON);
+
+    cv::Mat K = (cv::Mat_<float>(3,3) << 525.f, 0.f, 319.5f, 0.f, 525.f, 239.5f, 0.f, 0.f, 1.f);
+    std::vector<cv::Mat> images(1, image), depths(1, depth);
+    for(int i = 1; i < 4; i++)
+    {
+        cv::Mat rvec = (cv::Mat_<double>(3,1) << 0.005 * i, -0.01, 0.002), tvec = (cv::Mat_<double>(3,1) << 0.005, 0.002 * i, -0.005);
+        cv::Mat warpedImage, warpedDepth;
+        cv::rgbd::warpFrame(image, depth, rvec, tvec, K, warpedImage, warpedDepth);
+        cv::rgbd::dilateFrame(warpedImage, warpedDepth);
+        images.push_back(warpedImage);
+        depths.push_back(warpedDepth);
+    }
+
+    // the caches rotated between the frames give the same poses as the caches built from scratch,
+    // the ICP variants also check that the masks built with the normals of a destination frame
+    // are not reused once it becomes the source one
+    const char* odometryTypes[] = { "RgbdOdometry", "ICPOdometry", "RgbdICPOdometry" };
+    for(size_t t = 0; t < sizeof(odometryTypes) / sizeof(odometryTypes[0]); t++)
+    {
+        SCOPED_TRACE(odometryTypes[t]);
+        cv::Ptr<cv::rgbd::Odometry> odometry = cv::rgbd::Odometry::create(odometryTypes[t]);
+        odometry->setCameraMatrix(K);
+
+        cv::Ptr<cv::rgbd::OdometryFrame> prevFrame, frame;
+        cv::Mat Rt;
+        EXPECT_FALSE(odometry->computeNext(prevFrame, frame, images[0], depths[0], cv::Mat(), Rt));
+        for(size_t i = 1; i < images.size(); i++)
+        {
+            cv::Mat expectedRt;
+            bool expectedOk = odometry->compute(images[i-1], depths[i-1], cv::Mat(), images[i], depths[i], cv::Mat(), expectedRt);
+            bool isOk = odometry->computeNext(prevFrame, frame, images[i], depths[i], cv::Mat(), Rt);
+
+            ASSERT_EQ(expectedOk, isOk);
+            EXPECT_EQ(0., cv::norm(expectedRt, Rt, cv::NORM_INF));
+        }
+    }
+}
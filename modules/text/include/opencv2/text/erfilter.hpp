@@ -266,6 +266,27 @@ magnitude (Grad).
  */
 CV_EXPORTS void computeNMChannels(InputArray _src, OutputArrayOfArrays _channels, int _mode = ERFILTER_NM_RGBLGrad);
 
+/** @brief Extract the Extremal Regions of every channel with the 1st and 2nd stage filters of the N&M
+algorithm [Neumann12].
+
+@param channels Vector of single channel images CV_8UC1, e.g. computed with computeNMChannels.
+
+@param er_filter1 ERFilter for the 1st stage (e.g. created with createERFilterNM1).
+
+@param er_filter2 ERFilter for the 2nd stage (e.g. created with createERFilterNM2).
+
+@param regions Output vector with the ERStat regions of every channel, ready to be passed to
+erGrouping.
+
+The channels are processed in parallel, each one by its own copy of the filters. The copies are kept
+by the filters, so the memory used for the component tree extraction is reused by subsequent calls
+(e.g. for every frame of a video). The classifier callbacks are shared by the copies and must be
+thread safe, as the default ones are. Filters that were not created by createERFilterNM1 or
+createERFilterNM2 are run on the channels in sequence.
+ */
+CV_EXPORTS void detectRegions(InputArrayOfArrays channels, const Ptr<ERFilter>& er_filter1,
+                              const Ptr<ERFilter>& er_filter2, std::vector<std::vector<ERStat> >& regions);
+
 
 
 //! text::erGrouping operation modes
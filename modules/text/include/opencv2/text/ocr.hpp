@@ -172,6 +172,18 @@ public:
         corresponding to each classes in out_class.
          */
         virtual void eval( InputArray image, std::vector<int>& out_class, std::vector<double>& out_confidence);
+
+        /** @brief Classify a list of images with a single letter each, e.g. all the characters of a word.
+
+        @param images Input images CV_8UC1 or CV_8UC3 with a single letter.
+        @param out_class The ranked list of classes of every image, as returned by eval().
+        @param out_confidence The probabilities of the classes of every image in out_class.
+
+        The default implementation calls eval() for every image, classifiers that can share work
+        among the images (e.g. a single nearest neighbours query) override it.
+         */
+        virtual void evalBatch( const std::vector<Mat>& images, std::vector< std::vector<int> >& out_class,
+                                std::vector< std::vector<double> >& out_confidence);
     };
 
 public:
@@ -390,6 +402,9 @@ public:
     (<http://en.wikipedia.org/wiki/Viterbi_algorithm>).
 
     @param beam_size Size of the beam in Beam Search algorithm.
+
+    @param lexicon Optional list of words. When given, only hypotheses that are prefixes of its words
+    are kept in the beam, and the output is always one of them (empty if none fits the image).
      */
     static Ptr<OCRBeamSearchDecoder> create(const Ptr<OCRBeamSearchDecoder::ClassifierCallback> classifier,// The character classifier with built in feature extractor
                                      const std::string& vocabulary,                    // The language vocabulary (chars when ascii english text)
@@ -399,7 +414,8 @@ public:
                                      InputArray emission_probabilities_table,          // Table with observation emission probabilities
                                                                                        //     cols == rows == vocabulari.size()
                                      decoder_mode mode = OCR_DECODER_VITERBI,          // HMM Decoding algorithm (only Viterbi for the moment)
-                                     int beam_size = 500);                              // Size of the beam in Beam Search algorithm
+                                     int beam_size = 500,                               // Size of the beam in Beam Search algorithm
+                                     const std::vector<std::string>& lexicon = std::vector<std::string>()); // Optional list of valid words
 
 protected:
 
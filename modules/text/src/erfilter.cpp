@@ -43,9 +43,9 @@
 #include "precomp.hpp"
 #include "opencv2/imgproc.hpp"
 #include "opencv2/ml.hpp"
+#include "opencv2/core/utility.hpp"
 #include <limits>
 #include <fstream>
-#include <queue>
 
 #if defined _MSC_VER && _MSC_VER == 1500
     typedef int int_fast32_t;
@@ -65,27 +65,6 @@ using namespace cv::ml;
 using namespace std;
 using namespace cv::ml;
 
-// Deletes a tree of ERStat regions starting at root. Used only
-// internally to this implementation.
-static void deleteERStatTree(ERStat* root) {
-    queue<ERStat*> to_delete;
-    to_delete.push(root);
-    while (!to_delete.empty()) {
-        ERStat* n = to_delete.front();
-        to_delete.pop();
-        ERStat* c = n->child;
-        if (c != NULL) {
-            to_delete.push(c);
-            ERStat* sibling = c->next;
-            while (sibling != NULL) {
-                to_delete.push(sibling);
-                sibling = sibling->next;
-            }
-        }
-        delete n;
-    }
-}
-
 ERStat::ERStat(int init_level, int init_pixel, int init_x, int init_y) : pixel(init_pixel),
                level(init_level), area(0), perimeter(0), euler(0), probability(1.0),
                parent(0), child(0), next(0), prev(0), local_maxima(0),
@@ -102,6 +81,165 @@ ERStat::ERStat(int init_level, int init_pixel, int init_x, int init_y) : pixel(i
 }
 
 
+// Pool of ERStat nodes and crossings used while extracting the component tree. The nodes
+// rejected during the extraction are recycled right away, and all of them are made available
+// again (without releasing their memory) when the next image is processed.
+class ERStatPool
+{
+public:
+    ERStatPool() : used_nodes(0), used_crossings(0)
+    {
+        empty_node.crossings->clear();
+        delete empty_node.crossings;
+        empty_node.crossings = NULL;
+    }
+
+    // get a node initialized as ERStat(level, pixel, x, y) would do
+    ERStat* get(int level = 256, int pixel = 0, int x = 0, int y = 0)
+    {
+        ERStat *stat;
+        if (!free_nodes.empty())
+        {
+            stat = free_nodes.back();
+            free_nodes.pop_back();
+        }
+        else
+        {
+            if (used_nodes == nodes.size())
+                nodes.push_back(empty_node);
+            stat = &nodes[used_nodes++];
+        }
+
+        *stat = empty_node;
+        stat->level = level;
+        stat->pixel = pixel;
+        stat->rect = Rect(x,y,1,1);
+
+        deque<int> *crossings;
+        if (!free_crossings.empty())
+        {
+            crossings = free_crossings.back();
+            free_crossings.pop_back();
+        }
+        else
+        {
+            if (used_crossings == crossings_storage.size())
+                crossings_storage.push_back(deque<int>());
+            crossings = &crossings_storage[used_crossings++];
+        }
+        crossings->clear();
+        crossings->push_back(0);
+        stat->crossings = crossings;
+
+        return stat;
+    }
+
+    // give back the crossings of a node, they are not needed once the node is complete
+    void releaseCrossings(ERStat *stat)
+    {
+        if (stat->crossings)
+        {
+            free_crossings.push_back(stat->crossings);
+            stat->crossings = NULL;
+        }
+    }
+
+    // give back a node that was rejected
+    void release(ERStat *stat)
+    {
+        releaseCrossings(stat);
+        free_nodes.push_back(stat);
+    }
+
+    // make all the nodes available again
+    void reset()
+    {
+        used_nodes = 0;
+        used_crossings = 0;
+        free_nodes.clear();
+        free_crossings.clear();
+    }
+
+private:
+    // deques do not move their elements when they grow
+    deque<ERStat> nodes;
+    deque< deque<int> > crossings_storage;
+    size_t used_nodes;
+    size_t used_crossings;
+    vector<ERStat*> free_nodes;
+    vector< deque<int>* > free_crossings;
+    ERStat empty_node;
+
+    ERStatPool(const ERStatPool&);
+    ERStatPool& operator=(const ERStatPool&);
+};
+
+// Iterative depth first walk of an ERStat tree, used to rebuild the tree into the output
+// vector. Every region is visited together with its context: the region it must be linked to
+// in the output tree and the last child already linked to it. Children of a region are visited
+// before its next sibling, in the same order as the recursion did.
+class ERTreeWalk
+{
+public:
+    ERTreeWalk(ERStat *root)
+    {
+        contexts.push_back(make_pair((ERStat*)NULL, (ERStat*)NULL));
+        to_visit.push_back(make_pair(root, 0));
+    }
+
+    bool next(ERStat *&stat, int &context)
+    {
+        if (to_visit.empty())
+            return false;
+        stat = to_visit.back().first;
+        context = to_visit.back().second;
+        to_visit.pop_back();
+        return true;
+    }
+
+    // add a copy of stat to the output vector, linked in the given context
+    ERStat* save(vector<ERStat> &regions, ERStat *stat, int context)
+    {
+        ERStat *parent = contexts[context].first;
+        ERStat *prev = contexts[context].second;
+
+        regions.push_back(*stat);
+        ERStat *this_er = &regions.back();
+        this_er->parent = parent;
+        this_er->next   = NULL;
+        this_er->child  = NULL;
+
+        if (prev != NULL)
+            prev->next = this_er;
+        else if (parent != NULL)
+            parent->child = this_er;
+
+        contexts[context].second = this_er;
+        return this_er;
+    }
+
+    // start a new context for the children of a saved region
+    int newContext(ERStat *parent)
+    {
+        contexts.push_back(make_pair(parent, (ERStat*)NULL));
+        return (int)contexts.size() - 1;
+    }
+
+    // visit the children of stat in the given context
+    void visitChildren(ERStat *stat, int context)
+    {
+        size_t first = to_visit.size();
+        for (ERStat * child = stat->child; child; child = child->next)
+            to_visit.push_back(make_pair(child, context));
+        reverse(to_visit.begin() + first, to_visit.end());
+    }
+
+private:
+    vector< pair<ERStat*, int> > to_visit;
+    vector< pair<ERStat*, ERStat*> > contexts;
+};
+
+
 // derivative classes
 
 
@@ -145,12 +283,27 @@ public:
     void setNonMaxSuppression(bool nonMaxSuppression);
     int  getNumRejected();
 
+    // copy of this filter used to process the given channel, kept between calls
+    ERFilterNM* getChannelFilter(int channel);
+    // add the region counts of the channel filters
+    void accumulateChannelCounts();
+
 private:
     // pointer to the input/output regions vector
     vector<ERStat> *regions;
     // image mask used for feature calculations
     Mat region_mask;
 
+    // memory reused by the component tree extraction of consecutive images
+    ERStatPool pool;
+    vector<bool> accessible_pixel_mask;
+    vector<bool> accumulated_pixel_mask;
+    vector<int> boundary_pixes[256];
+    vector<int> boundary_edges[256];
+
+    // filters processing the channels in parallel
+    vector< Ptr<ERFilterNM> > channel_filters;
+
     // extract the component tree and store all the ER regions
     void er_tree_extract( InputArray image );
     // accumulate a pixel into an ER
@@ -160,11 +313,11 @@ private:
     // merge an ER with its nested parent
     void er_merge( ERStat *parent, ERStat *child );
     // copy extracted regions into the output vector
-    ERStat* er_save( ERStat *er, ERStat *parent, ERStat *prev );
-    // recursively walk the tree and filter (remove) regions using the callback classifier
-    ERStat* er_tree_filter( InputArray image, ERStat *stat, ERStat *parent, ERStat *prev );
-    // recursively walk the tree selecting only regions with local maxima probability
-    ERStat* er_tree_nonmax_suppression( ERStat *er, ERStat *parent, ERStat *prev );
+    void er_save( ERStat *root );
+    // walk the tree and filter (remove) regions using the callback classifier
+    void er_tree_filter( InputArray image, ERStat *root );
+    // walk the tree selecting only regions with local maxima probability
+    void er_tree_nonmax_suppression( ERStat *root );
 };
 
 
@@ -237,7 +390,7 @@ void ERFilterNM::run( InputArray image, vector<ERStat>& _regions )
             vector<ERStat> aux_regions;
             regions->swap(aux_regions);
             regions->reserve(aux_regions.size());
-            er_tree_nonmax_suppression( &aux_regions.front(), NULL, NULL );
+            er_tree_nonmax_suppression( &aux_regions.front() );
             aux_regions.clear();
         }
     }
@@ -249,7 +402,7 @@ void ERFilterNM::run( InputArray image, vector<ERStat>& _regions )
         vector<ERStat> aux_regions;
         regions->swap(aux_regions);
         regions->reserve(aux_regions.size());
-        er_tree_filter( image, &aux_regions.front(), NULL, NULL );
+        er_tree_filter( image, &aux_regions.front() );
         aux_regions.clear();
     }
 }
@@ -272,6 +425,9 @@ void ERFilterNM::er_tree_extract( InputArray image )
     const unsigned char * image_data = src.data;
     int width = src.cols, height = src.rows;
 
+    // the nodes of the previous image are not referenced anymore
+    pool.reset();
+
     // the component stack
     vector<ERStat*> er_stack;
 
@@ -293,17 +449,28 @@ void ERFilterNM::er_tree_extract( InputArray image )
     // (see in page 4 at the end of first column). 
     // Q_1 and Q_2 have four patterns, while Q_3 has only two.
 
+    // the patterns are all different, so the class Q_p of every 4 bits pattern can be tabulated
+    int quad_class[16];
+    for (int q=0; q<16; q++)
+        quad_class[q] = -1;
+    for (int p=0; p<3; p++)
+        for (int q=0; q<((p<2)?4:2); q++)
+            quad_class[quads[p][q]] = p;
+
 
     // masks to know if a pixel is accessible and if it has been already added to some region
-    vector<bool> accessible_pixel_mask(width * height);
-    vector<bool> accumulated_pixel_mask(width * height);
+    accessible_pixel_mask.assign(width * height, false);
+    accumulated_pixel_mask.assign(width * height, false);
 
     // heap of boundary pixels
-    vector<int> boundary_pixes[256];
-    vector<int> boundary_edges[256];
+    for (int l=0; l<256; l++)
+    {
+        boundary_pixes[l].clear();
+        boundary_edges[l].clear();
+    }
 
     // add a dummy-component before start
-    er_stack.push_back(new ERStat);
+    er_stack.push_back(pool.get());
 
     // we'll look initially for all pixels with grey-level lower than a grey-level higher than any allowed in the image
     int threshold_level = (255/thresholdDelta)+1;
@@ -323,7 +490,7 @@ void ERFilterNM::er_tree_extract( InputArray image )
 
         // push a component with current level in the component stack
         if (push_new_component)
-            er_stack.push_back(new ERStat(current_level, current_pixel, x, y));
+            er_stack.push_back(pool.get(current_level, current_pixel, x, y));
         push_new_component = false;
 
         // explore the (remaining) edges to the neighbors to the current pixel
@@ -478,31 +645,14 @@ void ERFilterNM::er_tree_extract( InputArray image )
 
         }
 
-        int C_before[3] = {0, 0, 0};
-        int C_after[3] = {0, 0, 0};
+        // the last slot counts the patterns not belonging to any class
+        int C_before[4] = {0, 0, 0, 0};
+        int C_after[4] = {0, 0, 0, 0};
 
-        for (int p=0; p<3; p++)
+        for (int q=0; q<4; q++)
         {
-            for (int q=0; q<4; q++)
-            {
-                if ( (quad_before[0] == quads[p][q]) && ((p<2)||(q<2)) )
-                    C_before[p]++;
-                if ( (quad_before[1] == quads[p][q]) && ((p<2)||(q<2)) )
-                    C_before[p]++;
-                if ( (quad_before[2] == quads[p][q]) && ((p<2)||(q<2)) )
-                    C_before[p]++;
-                if ( (quad_before[3] == quads[p][q]) && ((p<2)||(q<2)) )
-                    C_before[p]++;
-
-                if ( (quad_after[0] == quads[p][q]) && ((p<2)||(q<2)) )
-                    C_after[p]++;
-                if ( (quad_after[1] == quads[p][q]) && ((p<2)||(q<2)) )
-                    C_after[p]++;
-                if ( (quad_after[2] == quads[p][q]) && ((p<2)||(q<2)) )
-                    C_after[p]++;
-                if ( (quad_after[3] == quads[p][q]) && ((p<2)||(q<2)) )
-                    C_after[p]++;
-            }
+            C_before[(quad_class[quad_before[q]]+4)%4]++;
+            C_after[(quad_class[quad_after[q]]+4)%4]++;
         }
 
         int d_C1 = C_after[0]-C_before[0];
@@ -518,20 +668,9 @@ void ERFilterNM::er_tree_extract( InputArray image )
 
             // save the extracted regions into the output vector
             regions->reserve(num_accepted_regions+1);
-            er_save(er_stack.back(), NULL, NULL);
+            er_save(er_stack.back());
 
-            // clean memory
-            for (size_t r=0; r<er_stack.size(); r++)
-            {
-                ERStat *stat = er_stack.at(r);
-                if (stat->crossings)
-                {
-                    stat->crossings->clear();
-                    delete(stat->crossings);
-                    stat->crossings = NULL;
-                }
-                deleteERStatTree(stat);
-            }
+            // the nodes stay in the pool until the next image
             er_stack.clear();
 
             return;
@@ -563,7 +702,7 @@ void ERFilterNM::er_tree_extract( InputArray image )
 
                 if (new_level < er_stack.back()->level)
                 {
-                    er_stack.push_back(new ERStat(new_level, current_pixel, current_pixel%width, current_pixel/width));
+                    er_stack.push_back(pool.get(new_level, current_pixel, current_pixel%width, current_pixel/width));
                     er_merge(er_stack.back(), er);
                     break;
                 }
@@ -665,9 +804,7 @@ void ERFilterNM::er_merge(ERStat *parent, ERStat *child)
     child->med_crossings = (float)m_crossings.at(1);
 
     // free unnecessary mem
-    child->crossings->clear();
-    delete(child->crossings);
-    child->crossings = NULL;
+    pool.releaseCrossings(child);
 
     // recover the original grey-level
     child->level = child->level*thresholdDelta;
@@ -712,253 +849,204 @@ void ERFilterNM::er_merge(ERStat *parent, ERStat *child)
         }
 
         // free mem
-        if(child->crossings)
-        {
-            child->crossings->clear();
-            delete(child->crossings);
-            child->crossings = NULL;
-        }
-        delete(child);
+        pool.release(child);
     }
 
 }
 
 // copy extracted regions into the output vector
-ERStat* ERFilterNM::er_save( ERStat *er, ERStat *parent, ERStat *prev )
+void ERFilterNM::er_save( ERStat *root )
 {
+    ERTreeWalk walk(root);
+    ERStat *er;
+    int context;
 
-    regions->push_back(*er);
-
-    regions->back().parent = parent;
-    if (prev != NULL)
+    while (walk.next(er, context))
     {
-      prev->next = &(regions->back());
-    }
-    else if (parent != NULL)
-      parent->child = &(regions->back());
-
-    ERStat *old_prev = NULL;
-    ERStat *this_er  = &regions->back();
+        ERStat *this_er = walk.save(*regions, er, context);
+        ERStat *parent  = this_er->parent;
 
-    if (this_er->parent == NULL)
-    {
-       this_er->probability = 0;
-    }
+        // the crossings of the root stay in the pool
+        this_er->crossings = NULL;
 
-    if (nonMaxSuppression)
-    {
         if (this_er->parent == NULL)
         {
-            this_er->max_probability_ancestor = this_er;
-            this_er->min_probability_ancestor = this_er;
+           this_er->probability = 0;
         }
-        else
-        {
-            this_er->max_probability_ancestor = (this_er->probability > parent->max_probability_ancestor->probability)? this_er :  parent->max_probability_ancestor;
 
-            this_er->min_probability_ancestor = (this_er->probability < parent->min_probability_ancestor->probability)? this_er :  parent->min_probability_ancestor;
-
-            if ( (this_er->max_probability_ancestor->probability > minProbability) && (this_er->max_probability_ancestor->probability - this_er->min_probability_ancestor->probability > minProbabilityDiff))
-            {
-              this_er->max_probability_ancestor->local_maxima = true;
-              if ((this_er->max_probability_ancestor == this_er) && (this_er->parent->local_maxima))
-              {
-                this_er->parent->local_maxima = false;
-              }
-            }
-            else if (this_er->probability < this_er->parent->probability)
+        if (nonMaxSuppression)
+        {
+            if (this_er->parent == NULL)
             {
-              this_er->min_probability_ancestor = this_er;
+                this_er->max_probability_ancestor = this_er;
+                this_er->min_probability_ancestor = this_er;
             }
-            else if (this_er->probability > this_er->parent->probability)
+            else
             {
-              this_er->max_probability_ancestor = this_er;
-            }
+                this_er->max_probability_ancestor = (this_er->probability > parent->max_probability_ancestor->probability)? this_er :  parent->max_probability_ancestor;
+
+                this_er->min_probability_ancestor = (this_er->probability < parent->min_probability_ancestor->probability)? this_er :  parent->min_probability_ancestor;
+
+                if ( (this_er->max_probability_ancestor->probability > minProbability) && (this_er->max_probability_ancestor->probability - this_er->min_probability_ancestor->probability > minProbabilityDiff))
+                {
+                  this_er->max_probability_ancestor->local_maxima = true;
+                  if ((this_er->max_probability_ancestor == this_er) && (this_er->parent->local_maxima))
+                  {
+                    this_er->parent->local_maxima = false;
+                  }
+                }
+                else if (this_er->probability < this_er->parent->probability)
+                {
+                  this_er->min_probability_ancestor = this_er;
+                }
+                else if (this_er->probability > this_er->parent->probability)
+                {
+                  this_er->max_probability_ancestor = this_er;
+                }
 
 
+            }
         }
-    }
 
-    for (ERStat * child = er->child; child; child = child->next)
-    {
-        old_prev = er_save(child, this_er, old_prev);
+        walk.visitChildren(er, walk.newContext(this_er));
     }
-
-    return this_er;
 }
 
-// recursively walk the tree and filter (remove) regions using the callback classifier
-ERStat* ERFilterNM::er_tree_filter ( InputArray image, ERStat * stat, ERStat *parent, ERStat *prev )
+// walk the tree and filter (remove) regions using the callback classifier
+void ERFilterNM::er_tree_filter ( InputArray image, ERStat *root )
 {
     Mat src = image.getMat();
     // assert correct image type
     CV_Assert( src.type() == CV_8UC1 );
 
-    //Fill the region and calculate 2nd stage features
-    Mat region = region_mask(Rect(Point(stat->rect.x,stat->rect.y),Point(stat->rect.br().x+2,stat->rect.br().y+2)));
-    region = Scalar(0);
-    int newMaskVal = 255;
-    int flags = 4 + (newMaskVal << 8) + FLOODFILL_FIXED_RANGE + FLOODFILL_MASK_ONLY;
-    Rect rect;
-
-    floodFill( src(Rect(Point(stat->rect.x,stat->rect.y),Point(stat->rect.br().x,stat->rect.br().y))),
-               region, Point(stat->pixel%src.cols - stat->rect.x, stat->pixel/src.cols - stat->rect.y),
-               Scalar(255), &rect, Scalar(stat->level), Scalar(0), flags );
-    rect.width += 2;
-    rect.height += 2;
-    region = region(rect);
-
-    vector<vector<Point> > contours;
-    vector<Point> contour_poly;
-    vector<Vec4i> hierarchy;
-    findContours( region, contours, hierarchy, RETR_TREE, CHAIN_APPROX_NONE, Point(0, 0) );
-    //TODO check epsilon parameter of approxPolyDP (set empirically) : we want more precission
-    //     if the region is very small because otherwise we'll loose all the convexities
-    approxPolyDP( Mat(contours[0]), contour_poly, (float)min(rect.width,rect.height)/17, true );
-
-    bool was_convex = false;
-    int  num_inflexion_points = 0;
+    ERTreeWalk walk(root);
+    ERStat *stat;
+    int context;
 
-    for (int p = 0 ; p<(int)contour_poly.size(); p++)
+    while (walk.next(stat, context))
     {
-        int p_prev = p-1;
-        int p_next = p+1;
-        if (p_prev == -1)
-            p_prev = (int)contour_poly.size()-1;
-        if (p_next == (int)contour_poly.size())
-            p_next = 0;
-
-        double angle_next = atan2((double)(contour_poly[p_next].y-contour_poly[p].y),
-                                  (double)(contour_poly[p_next].x-contour_poly[p].x));
-        double angle_prev = atan2((double)(contour_poly[p_prev].y-contour_poly[p].y),
-                                  (double)(contour_poly[p_prev].x-contour_poly[p].x));
-        if ( angle_next < 0 )
-            angle_next = 2.*CV_PI + angle_next;
-
-        double angle = (angle_next - angle_prev);
-        if (angle > 2.*CV_PI)
-            angle = angle - 2.*CV_PI;
-        else if (angle < 0)
-            angle = 2.*CV_PI + abs(angle);
-
-        if (p>0)
+        //Fill the region and calculate 2nd stage features
+        Mat region = region_mask(Rect(Point(stat->rect.x,stat->rect.y),Point(stat->rect.br().x+2,stat->rect.br().y+2)));
+        region = Scalar(0);
+        int newMaskVal = 255;
+        int flags = 4 + (newMaskVal << 8) + FLOODFILL_FIXED_RANGE + FLOODFILL_MASK_ONLY;
+        Rect rect;
+
+        floodFill( src(Rect(Point(stat->rect.x,stat->rect.y),Point(stat->rect.br().x,stat->rect.br().y))),
+                   region, Point(stat->pixel%src.cols - stat->rect.x, stat->pixel/src.cols - stat->rect.y),
+                   Scalar(255), &rect, Scalar(stat->level), Scalar(0), flags );
+        rect.width += 2;
+        rect.height += 2;
+        region = region(rect);
+
+        vector<vector<Point> > contours;
+        vector<Point> contour_poly;
+        vector<Vec4i> hierarchy;
+        findContours( region, contours, hierarchy, RETR_TREE, CHAIN_APPROX_NONE, Point(0, 0) );
+        //TODO check epsilon parameter of approxPolyDP (set empirically) : we want more precission
+        //     if the region is very small because otherwise we'll loose all the convexities
+        approxPolyDP( Mat(contours[0]), contour_poly, (float)min(rect.width,rect.height)/17, true );
+
+        bool was_convex = false;
+        int  num_inflexion_points = 0;
+
+        for (int p = 0 ; p<(int)contour_poly.size(); p++)
         {
-            if ( ((angle > CV_PI)&&(!was_convex)) || ((angle < CV_PI)&&(was_convex)) )
-                num_inflexion_points++;
-        }
-        was_convex = (angle > CV_PI);
-
-    }
-
-    floodFill(region, Point(0,0), Scalar(255), 0);
-    int holes_area = region.cols*region.rows-countNonZero(region);
-
-    int hull_area = 0;
-
-    {
-
-        vector<Point> hull;
-        convexHull(contours[0], hull, false);
-        hull_area = (int)contourArea(hull);
-    }
-
+            int p_prev = p-1;
+            int p_next = p+1;
+            if (p_prev == -1)
+                p_prev = (int)contour_poly.size()-1;
+            if (p_next == (int)contour_poly.size())
+                p_next = 0;
+
+            double angle_next = atan2((double)(contour_poly[p_next].y-contour_poly[p].y),
+                                      (double)(contour_poly[p_next].x-contour_poly[p].x));
+            double angle_prev = atan2((double)(contour_poly[p_prev].y-contour_poly[p].y),
+                                      (double)(contour_poly[p_prev].x-contour_poly[p].x));
+            if ( angle_next < 0 )
+                angle_next = 2.*CV_PI + angle_next;
+
+            double angle = (angle_next - angle_prev);
+            if (angle > 2.*CV_PI)
+                angle = angle - 2.*CV_PI;
+            else if (angle < 0)
+                angle = 2.*CV_PI + abs(angle);
+
+            if (p>0)
+            {
+                if ( ((angle > CV_PI)&&(!was_convex)) || ((angle < CV_PI)&&(was_convex)) )
+                    num_inflexion_points++;
+            }
+            was_convex = (angle > CV_PI);
 
-    stat->hole_area_ratio = (float)holes_area / stat->area;
-    stat->convex_hull_ratio = (float)hull_area / (float)contourArea(contours[0]);
-    stat->num_inflexion_points = (float)num_inflexion_points;
+        }
 
+        floodFill(region, Point(0,0), Scalar(255), 0);
+        int holes_area = region.cols*region.rows-countNonZero(region);
 
-    // calculate P(child|character) and filter if possible
-    if ( (classifier != NULL) && (stat->parent != NULL) )
-    {
-        stat->probability = classifier->eval(*stat);
-    }
+        int hull_area = 0;
 
-    if ( ( ((classifier != NULL)?(stat->probability >= minProbability):true) &&
-          ((stat->area >= minArea*region_mask.rows*region_mask.cols) &&
-           (stat->area <= maxArea*region_mask.rows*region_mask.cols)) ) ||
-        (stat->parent == NULL) )
-    {
+        {
 
-        num_accepted_regions++;
-        regions->push_back(*stat);
+            vector<Point> hull;
+            convexHull(contours[0], hull, false);
+            hull_area = (int)contourArea(hull);
+        }
 
-        regions->back().parent = parent;
-        regions->back().next   = NULL;
-        regions->back().child  = NULL;
 
-        if (prev != NULL)
-            prev->next = &(regions->back());
-        else if (parent != NULL)
-            parent->child = &(regions->back());
+        stat->hole_area_ratio = (float)holes_area / stat->area;
+        stat->convex_hull_ratio = (float)hull_area / (float)contourArea(contours[0]);
+        stat->num_inflexion_points = (float)num_inflexion_points;
 
-        ERStat *old_prev = NULL;
-        ERStat *this_er  = &regions->back();
 
-        for (ERStat * child = stat->child; child; child = child->next)
+        // calculate P(child|character) and filter if possible
+        if ( (classifier != NULL) && (stat->parent != NULL) )
         {
-            old_prev = er_tree_filter(image, child, this_er, old_prev);
+            stat->probability = classifier->eval(*stat);
         }
 
-        return this_er;
-
-    } else {
+        if ( ( ((classifier != NULL)?(stat->probability >= minProbability):true) &&
+              ((stat->area >= minArea*region_mask.rows*region_mask.cols) &&
+               (stat->area <= maxArea*region_mask.rows*region_mask.cols)) ) ||
+            (stat->parent == NULL) )
+        {
 
-        num_rejected_regions++;
+            num_accepted_regions++;
+            ERStat *this_er = walk.save(*regions, stat, context);
+            walk.visitChildren(stat, walk.newContext(this_er));
 
-        ERStat *old_prev = prev;
+        } else {
 
-        for (ERStat * child = stat->child; child; child = child->next)
-        {
-            old_prev = er_tree_filter(image, child, parent, old_prev);
+            // the children take the place of the rejected region
+            num_rejected_regions++;
+            walk.visitChildren(stat, context);
         }
-
-        return old_prev;
     }
 
 }
 
-// recursively walk the tree selecting only regions with local maxima probability
-ERStat* ERFilterNM::er_tree_nonmax_suppression ( ERStat * stat, ERStat *parent, ERStat *prev )
+// walk the tree selecting only regions with local maxima probability
+void ERFilterNM::er_tree_nonmax_suppression ( ERStat *root )
 {
+    ERTreeWalk walk(root);
+    ERStat *stat;
+    int context;
 
-    if ( ( stat->local_maxima ) || ( stat->parent == NULL ) )
+    while (walk.next(stat, context))
     {
-
-        regions->push_back(*stat);
-
-        regions->back().parent = parent;
-        regions->back().next   = NULL;
-        regions->back().child  = NULL;
-
-        if (prev != NULL)
-            prev->next = &(regions->back());
-        else if (parent != NULL)
-            parent->child = &(regions->back());
-
-        ERStat *old_prev = NULL;
-        ERStat *this_er  = &regions->back();
-
-        for (ERStat * child = stat->child; child; child = child->next)
+        if ( ( stat->local_maxima ) || ( stat->parent == NULL ) )
         {
-            old_prev = er_tree_nonmax_suppression( child, this_er, old_prev );
-        }
-
-        return this_er;
 
-    } else {
-
-        num_rejected_regions++;
-        num_accepted_regions--;
+            ERStat *this_er = walk.save(*regions, stat, context);
+            walk.visitChildren(stat, walk.newContext(this_er));
 
-        ERStat *old_prev = prev;
+        } else {
 
-        for (ERStat * child = stat->child; child; child = child->next)
-        {
-            old_prev = er_tree_nonmax_suppression( child, parent, old_prev );
+            // the children take the place of the rejected region
+            num_rejected_regions++;
+            num_accepted_regions--;
+            walk.visitChildren(stat, context);
         }
-
-        return old_prev;
     }
 
 }
@@ -1010,6 +1098,42 @@ void ERFilterNM::setNonMaxSuppression(bool _nonMaxSuppression)
     return;
 }
 
+// copy of this filter used to process the given channel, kept between calls
+// so that its memory pools are reused
+ERFilterNM* ERFilterNM::getChannelFilter(int channel)
+{
+    if ((int)channel_filters.size() <= channel)
+        channel_filters.resize(channel+1);
+
+    Ptr<ERFilterNM>& filter = channel_filters[channel];
+    if (filter.empty())
+        filter = makePtr<ERFilterNM>();
+
+    filter->classifier = classifier;
+    filter->thresholdDelta = thresholdDelta;
+    filter->minArea = minArea;
+    filter->maxArea = maxArea;
+    filter->minProbability = minProbability;
+    filter->nonMaxSuppression = nonMaxSuppression;
+    filter->minProbabilityDiff = minProbabilityDiff;
+    filter->num_accepted_regions = 0;
+    filter->num_rejected_regions = 0;
+
+    return filter.get();
+}
+
+// add the region counts of the channel filters
+void ERFilterNM::accumulateChannelCounts()
+{
+    for (size_t c = 0; c < channel_filters.size(); c++)
+    {
+        num_accepted_regions += channel_filters[c]->num_accepted_regions;
+        num_rejected_regions += channel_filters[c]->num_rejected_regions;
+        channel_filters[c]->num_accepted_regions = 0;
+        channel_filters[c]->num_rejected_regions = 0;
+    }
+}
+
 int ERFilterNM::getNumRejected()
 {
     return num_rejected_regions;
@@ -1198,6 +1322,86 @@ Ptr<ERFilter::Callback> loadDummyClassifier()
     return makePtr<ERDummyClassifier>();
 }
 
+/* ------------------------------------------------------------------------------------*/
+/* -------------------------------- Detect Regions NM ---------------------------------*/
+/* ------------------------------------------------------------------------------------*/
+
+// the two stages of the ERFilter run on every channel, the channels are processed in parallel
+class DetectRegionsInvoker : public ParallelLoopBody
+{
+public:
+    DetectRegionsInvoker(const vector<Mat> &_channels, vector<ERFilterNM*> &_er_filter1,
+                         vector<ERFilterNM*> &_er_filter2, vector< vector<ERStat> > &_regions)
+        : channels(_channels), er_filter1(_er_filter1), er_filter2(_er_filter2), regions(_regions) {}
+
+    void operator()( const Range &range ) const
+    {
+        for (int c = range.start; c < range.end; c++)
+        {
+            er_filter1[c]->run(channels[c], regions[c]);
+            er_filter2[c]->run(channels[c], regions[c]);
+        }
+    }
+
+private:
+    const vector<Mat> &channels;
+    vector<ERFilterNM*> &er_filter1;
+    vector<ERFilterNM*> &er_filter2;
+    vector< vector<ERStat> > &regions;
+
+    DetectRegionsInvoker& operator=(const DetectRegionsInvoker&);
+};
+
+/*!
+    Extract the Extremal Regions of every channel with the 1st and 2nd stage filters of N&M algorithm
+
+    The channels are independent and are processed in parallel. Every channel is processed by its
+    own copy of the filters, these copies are kept by the filters so that the memory they use is
+    reused by subsequent calls (e.g. for every frame of a video).
+
+    \param  _channels     Single channel CV_8UC1 images, e.g. computed with computeNMChannels.
+    \param  er_filter1    Filter for the 1st stage, e.g. created with createERFilterNM1.
+    \param  er_filter2    Filter for the 2nd stage, e.g. created with createERFilterNM2.
+    \param  regions       Output vector with the regions extracted from every channel.
+*/
+void detectRegions(InputArrayOfArrays _channels, const Ptr<ERFilter>& er_filter1,
+                   const Ptr<ERFilter>& er_filter2, vector< vector<ERStat> >& regions)
+{
+    CV_Assert( !er_filter1.empty() && !er_filter2.empty() );
+
+    vector<Mat> channels;
+    _channels.getMatVector(channels);
+
+    int num_channels = (int)channels.size();
+    regions.assign(num_channels, vector<ERStat>());
+
+    ERFilterNM *nm_filter1 = dynamic_cast<ERFilterNM*>(er_filter1.get());
+    ERFilterNM *nm_filter2 = dynamic_cast<ERFilterNM*>(er_filter2.get());
+
+    // other implementations of ERFilter can't be copied, they are run in sequence
+    if ( (nm_filter1 == NULL) || (nm_filter2 == NULL) )
+    {
+        for (int c = 0; c < num_channels; c++)
+        {
+            er_filter1->run(channels[c], regions[c]);
+            er_filter2->run(channels[c], regions[c]);
+        }
+        return;
+    }
+
+    vector<ERFilterNM*> channel_filter1(num_channels), channel_filter2(num_channels);
+    for (int c = 0; c < num_channels; c++)
+    {
+        channel_filter1[c] = nm_filter1->getChannelFilter(c);
+        channel_filter2[c] = nm_filter2->getChannelFilter(c);
+    }
+
+    parallel_for_(Range(0, num_channels), DetectRegionsInvoker(channels, channel_filter1, channel_filter2, regions));
+
+    nm_filter1->accumulateChannelCounts();
+    nm_filter2->accumulateChannelCounts();
+}
+
 /* ------------------------------------------------------------------------------------*/
 /* -------------------------------- Compute Channels NM -------------------------------*/
 /* ------------------------------------------------------------------------------------*/
@@ -43,6 +43,7 @@
 #include "precomp.hpp"
 #include "opencv2/imgproc.hpp"
 #include "opencv2/ml.hpp"
+#include "ocr_cnn_features.hpp"
 
 #include <iostream>
 #include <fstream>
@@ -101,19 +102,36 @@ void OCRBeamSearchDecoder::ClassifierCallback::eval( InputArray image, vector< v
     oversegmentation.clear();
 }
 
+// A beam search hypothesis. Hypotheses are stored once and linked to the one they extend, so a
+// segmentation is the chain of seg_point values up to the first character. The last column of
+// the Viterbi table of the hypothesis is kept until it has been expanded, so the score of every
+// child is computed with a single Viterbi step.
 struct beamSearch_node {
     double score;
-    vector<int> segmentation;
+    int parent;              // hypothesis extended by this one, -1 for a first character
+    int seg_point;           // last character of the segmentation
+    int length;              // number of characters of the segmentation
     bool expanded;
-    // TODO calculating score of its childs would be much faster if we store the last column
-    //      of their "root" path.
+    bool in_beam;
+    vector<double> column;   // Viterbi probabilities of the last character
+    vector<int> states;      // lexicon trie nodes of the column (only with a lexicon)
 };
 
-bool beam_sort_function ( beamSearch_node a, beamSearch_node b );
-bool beam_sort_function ( beamSearch_node a, beamSearch_node b )
+// Bounded beam: a min-heap of hypotheses indices on their score, the worst one on top
+struct beam_heap_compare
 {
-    return (a.score > b.score);
-}
+    const vector<beamSearch_node>* nodes;
+    beam_heap_compare(const vector<beamSearch_node>* _nodes) : nodes(_nodes) {}
+    bool operator()(int a, int b) const { return (*nodes)[a].score > (*nodes)[b].score; }
+};
+
+// Node of the lexicon trie, words are paths from the root
+struct lexicon_node {
+    int character;          // vocabulary index, -1 for the root
+    int parent;
+    bool word_end;
+    vector<int> children;
+};
 
 
 class OCRBeamSearchDecoderImpl : public OCRBeamSearchDecoder
@@ -125,7 +143,8 @@ public:
                               InputArray transition_probabilities_table,
                               InputArray emission_probabilities_table,
                               decoder_mode _mode,
-                              int _beam_size)
+                              int _beam_size,
+                              const vector<string>& _lexicon)
     {
         classifier = _classifier;
         step_size = classifier->getStepSize();
@@ -134,6 +153,7 @@ public:
         vocabulary = _vocabulary;
         mode = _mode;
         beam_size = _beam_size;
+        CV_Assert( beam_size > 0 );
         transition_probabilities_table.getMat().copyTo(transition_p);
         for (int i=0; i<transition_p.rows; i++)
         {
@@ -145,6 +165,10 @@ public:
                     transition_p.at<double>(i,j) = log(transition_p.at<double>(i,j));
             }
         }
+        // the Viterbi step reads the transitions to a character contiguously
+        transition_to = transition_p.t();
+
+        build_lexicon(_lexicon);
     }
 
     ~OCRBeamSearchDecoderImpl()
@@ -253,55 +277,90 @@ public:
             }
         }
 
-        // initialize the beam with all possible character's pairs
-        int generated_chids = 0;
-        for (size_t i=0; i<recognition_probabilities.size()-1; i++)
-        {
-          for (size_t j=i+1; j<recognition_probabilities.size(); j++)
-          {
-
-            beamSearch_node node;
-            node.segmentation.push_back((int)i);
-            node.segmentation.push_back((int)j);
-            node.score = score_segmentation(node.segmentation, out_sequence);
-            vector< vector<int> > childs = generate_childs( node.segmentation );
-            node.expanded = true;
+        nodes.clear();
+        beam.clear();
 
-            beam.push_back( node );
+        // the first character of a segmentation can be any of the recognitions
+        int num_points = (int)recognition_probabilities.size();
+        for (int i=0; i<num_points; i++)
+            create_first(i);
 
-            if (!childs.empty())
-              update_beam( childs );
+        // initialize the beam with all possible character's pairs
+        for (int i=0; i<num_points-1; i++)
+          for (int j=i+1; j<num_points; j++)
+            create_child(i, j);
 
-            generated_chids += (int)childs.size();
+        // expand the hypotheses in the beam until all of them have been expanded
+        vector<int> to_expand;
+        for (;;)
+        {
+            to_expand.clear();
+            for (size_t i=0; i<beam.size(); i++)
+                if (!nodes[beam[i]].expanded)
+                    to_expand.push_back(beam[i]);
+            if (to_expand.empty())
+                break;
 
-          }
+            for (size_t i=0; i<to_expand.size(); i++)
+            {
+                int node = to_expand[i];
+                // it may have been pushed out of the beam by a sibling
+                if (!nodes[node].in_beam)
+                    continue;
+                nodes[node].expanded = true;
+                for (int seg_point=nodes[node].seg_point+1; seg_point<num_points; seg_point++)
+                    create_child(node, seg_point);
+                // the children have their own column
+                vector<double>().swap(nodes[node].column);
+                vector<int>().swap(nodes[node].states);
+            }
         }
 
-        while (generated_chids != 0)
+        // Done! Get the best prediction found into out_sequence
+        double lp = -DBL_MAX;
+        if (lexicon.empty())
         {
-            generated_chids = 0;
-
+            int best = -1;
+            for (size_t i=0; i<beam.size(); i++)
+                if ((best < 0) || (nodes[beam[i]].score > nodes[best].score))
+                    best = beam[i];
+            if (best < 0)
+                return;
+
+            vector<int> segmentation;
+            get_segmentation(best, segmentation);
+            lp = score_segmentation( segmentation, out_sequence );
+        }
+        else
+        {
+            // only complete words of the lexicon can be the output
+            int best_state = -1;
+            vector<int> segmentation;
             for (size_t i=0; i<beam.size(); i++)
             {
-                vector< vector<int> > childs;
-                if (!beam[i].expanded)
+                get_segmentation(beam[i], segmentation);
+                int state;
+                double p = score_segmentation_lexicon( segmentation, state );
+                if ((state >= 0) && ((best_state < 0) || (p > lp)))
                 {
-                  childs = generate_childs( beam[i].segmentation );
-                  beam[i].expanded = true;
+                    lp = p;
+                    best_state = state;
                 }
-                if (!childs.empty())
-                    update_beam( childs );
-                generated_chids += (int)childs.size();
             }
-        }
+            if (best_state < 0)
+                return;
 
-        // Done! Get the best prediction found into out_sequence
-        double lp = score_segmentation( beam[0].segmentation, out_sequence );
+            for (int s = best_state; lexicon[s].character >= 0; s = lexicon[s].parent)
+                out_sequence.insert(out_sequence.begin(), vocabulary[lexicon[s].character]);
+        }
 
         // fill other (dummy) output parameters
-        component_rects->push_back(Rect(0,0,src.cols,src.rows));
-        component_texts->push_back(out_sequence);
-        component_confidences->push_back((float)exp(lp));
+        if (component_rects != NULL)
+            component_rects->push_back(Rect(0,0,src.cols,src.rows));
+        if (component_texts != NULL)
+            component_texts->push_back(out_sequence);
+        if (component_confidences != NULL)
+            component_confidences->push_back((float)exp(lp));
 
         return;
     }
@@ -310,52 +369,230 @@ private:
     int win_size;
     int step_size;
 
-    vector< beamSearch_node > beam;
+    Mat transition_to;
+    vector<lexicon_node> lexicon;
+
+    vector< beamSearch_node > nodes;
+    vector< int > beam;
     vector< vector<double> > recognition_probabilities;
     vector<int> oversegmentation;
 
-    vector< vector<int> > generate_childs( vector<int> &segmentation )
+    // lexicon trie, empty when there is no lexicon
+    void build_lexicon( const vector<string>& words )
     {
+        lexicon.clear();
+        if (words.empty())
+            return;
+
+        lexicon.resize(1);
+        lexicon[0].character = -1;
+        lexicon[0].parent = -1;
+        lexicon[0].word_end = false;
 
-        vector< vector<int> > childs;
-        for (size_t i=segmentation[segmentation.size()-1]+1; i<oversegmentation.size(); i++)
+        for (size_t w=0; w<words.size(); w++)
         {
-            int seg_point = (int)i;
-            if (find(segmentation.begin(), segmentation.end(), seg_point) == segmentation.end())
+            // words with characters out of the vocabulary can't be recognized
+            bool valid = !words[w].empty();
+            for (size_t c=0; valid && c<words[w].size(); c++)
+                valid = (vocabulary.find(words[w][c]) != string::npos);
+            if (!valid)
+                continue;
+
+            int state = 0;
+            for (size_t c=0; c<words[w].size(); c++)
             {
-                vector<int> child = segmentation;
-                child.push_back(seg_point);
-                childs.push_back(child);
+                int character = (int)vocabulary.find(words[w][c]);
+                int next = -1;
+                for (size_t k=0; k<lexicon[state].children.size(); k++)
+                    if (lexicon[lexicon[state].children[k]].character == character)
+                        next = lexicon[state].children[k];
+                if (next < 0)
+                {
+                    lexicon_node node;
+                    node.character = character;
+                    node.parent = state;
+                    node.word_end = false;
+                    next = (int)lexicon.size();
+                    lexicon[state].children.push_back(next);
+                    lexicon.push_back(node);
+                }
+                state = next;
             }
+            lexicon[state].word_end = true;
         }
-        return childs;
     }
 
-    void update_beam ( vector< vector<int> > &childs )
+    // segmentation points of a hypothesis, from the first character
+    void get_segmentation( int node, vector<int>& segmentation )
     {
-        string out_sequence;
-        double min_score = -DBL_MAX; //min score value to be part of the beam
+        segmentation.resize(nodes[node].length);
+        for (int t=nodes[node].length-1; t>=0; t--, node=nodes[node].parent)
+            segmentation[t] = nodes[node].seg_point;
+    }
+
+    // hypothesis of a single character, used only as the parent of the pairs
+    void create_first( int seg_point )
+    {
+        beamSearch_node node;
+        node.score = 0;
+        node.parent = -1;
+        node.seg_point = seg_point;
+        node.length = 1;
+        node.expanded = true;
+        node.in_beam = false;
+
+        double start_p = log(1.0/vocabulary.size());
+        const vector<double>& recognition = recognition_probabilities[seg_point];
+        if (lexicon.empty())
+        {
+            node.column.resize(vocabulary.size());
+            for (int i=0; i<(int)vocabulary.size(); i++)
+                node.column[i] = start_p + recognition[i];
+        }
+        else
+        {
+            const vector<int>& first = lexicon[0].children;
+            for (size_t k=0; k<first.size(); k++)
+            {
+                double prob = start_p + recognition[lexicon[first[k]].character];
+                if (prob > -DBL_MAX)
+                {
+                    node.states.push_back(first[k]);
+                    node.column.push_back(prob);
+                }
+            }
+        }
+        nodes.push_back(node);
+    }
+
+    // extend a hypothesis with one more character, the child goes into the beam if it is good enough
+    void create_child( int parent, int seg_point )
+    {
+        // Score Heuristics: the segmentation is discarded if the new character is too large
+        // or if it overlaps too much with the previous one
+        float interdist = (float)oversegmentation[seg_point]*step_size
+                          - (float)oversegmentation[nodes[parent].seg_point]*step_size;
+        if ((float)interdist/win_size > 2.25) // TODO explain how did you set this thrs
+           return;
+        if ((float)interdist/win_size < 0.15) // TODO explain how did you set this thrs
+           return;
+
+        beamSearch_node node;
+        node.parent = parent;
+        node.seg_point = seg_point;
+        node.length = nodes[parent].length + 1;
+        node.expanded = false;
+        node.in_beam = true;
+
+        // one step of Viterbi from the column of the parent
+        const vector<double>& recognition = recognition_probabilities[seg_point];
+        const vector<double>& column = nodes[parent].column;
+        double max_prob = -DBL_MAX;
+        if (lexicon.empty())
+        {
+            node.column.resize(vocabulary.size());
+            for (int i=0; i<(int)vocabulary.size(); i++)
+            {
+                const double *transition = transition_to.ptr<double>(i);
+                double prob_i = -DBL_MAX;
+                for (int j=0; j<(int)vocabulary.size(); j++)
+                {
+                    double prob = column[j] + transition[j] + recognition[i];
+                    if ( prob > prob_i)
+                        prob_i = prob;
+                }
+                node.column[i] = prob_i;
+                if ( prob_i > max_prob)
+                    max_prob = prob_i;
+            }
+        }
+        else
+        {
+            // only the continuations of a lexicon word are possible
+            const vector<int>& states = nodes[parent].states;
+            for (size_t k=0; k<states.size(); k++)
+            {
+                const lexicon_node& from = lexicon[states[k]];
+                for (size_t c=0; c<from.children.size(); c++)
+                {
+                    int character = lexicon[from.children[c]].character;
+                    double prob = column[k] + transition_p.at<double>(from.character, character) + recognition[character];
+                    if (prob > -DBL_MAX)
+                    {
+                        node.states.push_back(from.children[c]);
+                        node.column.push_back(prob);
+                        if ( prob > max_prob)
+                            max_prob = prob;
+                    }
+                }
+            }
+            if (node.states.empty())
+                return;
+        }
+        node.score = max_prob / (node.length-1);
+
+        // bounded beam: the child replaces the worst hypothesis when the beam is full
+        beam_heap_compare compare(&nodes);
         if ((int)beam.size() >= beam_size)
-            min_score = beam[beam_size-1].score; //last element has the lowest score
+        {
+            if (node.score <= nodes[beam.front()].score)
+                return;
+            pop_heap(beam.begin(), beam.end(), compare);
+            beamSearch_node& worst = nodes[beam.back()];
+            worst.in_beam = false;
+            // the column of the hypothesis being expanded is still needed for its next children
+            if (!worst.expanded)
+            {
+                vector<double>().swap(worst.column);
+                vector<int>().swap(worst.states);
+            }
+            beam.pop_back();
+        }
+
+        nodes.push_back(node);
+        beam.push_back((int)nodes.size()-1);
+        push_heap(beam.begin(), beam.end(), compare);
+    }
+
+    // score of the best lexicon word for a segmentation, state is its trie node (-1 if none)
+    double score_segmentation_lexicon( vector<int> &segmentation, int& state )
+    {
+        double start_p = log(1.0/vocabulary.size());
 
-        for (size_t i=0; i<childs.size(); i++)
+        vector<int> states(1, 0), new_states;
+        vector<double> column(1, 0.), new_column;
+        for (int t=0; t<(int)segmentation.size(); t++)
         {
-            double score = score_segmentation(childs[i], out_sequence);
-            if (score > min_score)
+            const vector<double>& recognition = recognition_probabilities[segmentation[t]];
+            new_states.clear();
+            new_column.clear();
+            for (size_t k=0; k<states.size(); k++)
             {
-                beamSearch_node node;
-                node.score = score;
-                node.segmentation = childs[i];
-                node.expanded = false;
-                beam.push_back(node);
-                sort(beam.begin(),beam.end(),beam_sort_function);
-                if ((int)beam.size() > beam_size)
+                const lexicon_node& from = lexicon[states[k]];
+                for (size_t c=0; c<from.children.size(); c++)
                 {
-                    beam.erase(beam.begin()+beam_size,beam.end());
-                    min_score = beam[beam.size()-1].score;
+                    int character = lexicon[from.children[c]].character;
+                    double prob = column[k] + ((t == 0) ? start_p : transition_p.at<double>(from.character, character))
+                                  + recognition[character];
+                    new_states.push_back(from.children[c]);
+                    new_column.push_back(prob);
                 }
             }
+            states.swap(new_states);
+            column.swap(new_column);
         }
+
+        state = -1;
+        double max_prob = -DBL_MAX;
+        for (size_t k=0; k<states.size(); k++)
+        {
+            if (lexicon[states[k]].word_end && ((state < 0) || (column[k] > max_prob)))
+            {
+                max_prob = column[k];
+                state = states[k];
+            }
+        }
+        return (max_prob / (segmentation.size()-1));
     }
 
 
@@ -455,9 +692,10 @@ Ptr<OCRBeamSearchDecoder> OCRBeamSearchDecoder::create( Ptr<OCRBeamSearchDecoder
                                                         InputArray transition_p,
                                                         InputArray emission_p,
                                                         decoder_mode _mode,
-                                                        int _beam_size)
+                                                        int _beam_size,
+                                                        const vector<string>& _lexicon)
 {
-    return makePtr<OCRBeamSearchDecoderImpl>(_classifier, _vocabulary, transition_p, emission_p, _mode, _beam_size);
+    return makePtr<OCRBeamSearchDecoderImpl>(_classifier, _vocabulary, transition_p, emission_p, _mode, _beam_size, _lexicon);
 }
 
 
@@ -476,8 +714,8 @@ public:
     void setStepSize(int _step_size) {step_size = _step_size;}
 
 protected:
-    void normalizeAndZCA(Mat& patches);
-    double eval_feature(Mat& feature, double* prob_estimates);
+    void scale_features(Mat& features);
+    double eval_feature(const Mat& feature, double* prob_estimates);
 
 private:
     int window_size; // window size
@@ -494,6 +732,7 @@ private:
     int num_quads;   // extract 25 quads (12x12) from each image
     int num_tiles;   // extract 25 patches (8x8) from each quad
     double alpha;    // used in non-linear activation function z = max(0, |D*a| - alpha)
+    OCRCNNFeatures cnn_features; // patches convolution and pooling
 };
 
 OCRBeamSearchClassifierCNN::OCRBeamSearchClassifierCNN (const string& filename)
@@ -524,6 +763,9 @@ OCRBeamSearchClassifierCNN::OCRBeamSearchClassifierCNN (const string& filename)
     num_quads   = 25;
     num_tiles   = 25;
     alpha       = 0.5; // used in non-linear activation function z = max(0, |D*a| - alpha)
+
+    cnn_features.init(kernels, M, P, alpha, quad_size, window_size);
+    CV_Assert( nr_feature == cnn_features.getNumFeatures() );
 }
 
 void OCRBeamSearchClassifierCNN::eval( InputArray _src, vector< vector<double> >& recognition_probabilities, vector<int>& oversegmentation)
@@ -547,165 +789,55 @@ void OCRBeamSearchClassifierCNN::eval( InputArray _src, vector< vector<double> >
 
     resize(src,src,Size(window_size*src.cols/src.rows,window_size));
 
-    int seg_points = 0;
+    if (src.cols < window_size)
+        return;
 
-    Mat quad;
-    Mat tmp;
-    Mat img;
+    // all the sliding windows are evaluated in one batch, their patches are shared
+    Mat features;
+    cnn_features.compute(src, step_size, features);
+    scale_features(features);
 
-    // begin sliding window loop foreach detection window
-    for (int x_c=0; x_c<=src.cols-window_size; x_c=x_c+step_size)
+    vector<double> p(nr_class);
+    for (int seg_points=0; seg_points<features.rows; seg_points++)
     {
-
-        img = src(Rect(Point(x_c,0),Size(window_size,window_size)));
-
-        int patch_count = 0;
-        vector< vector<double> > data_pool(9);
-
-
-        int quad_id = 1;
-        for (int q_x=0; q_x<=window_size-quad_size; q_x=q_x+(quad_size/2-1))
-        {
-            for (int q_y=0; q_y<=window_size-quad_size; q_y=q_y+(quad_size/2-1))
-            {
-                Rect quad_rect = Rect(q_x,q_y,quad_size,quad_size);
-                quad = img(quad_rect);
-
-                //start sliding window (8x8) in each tile and store the patch as row in data_pool
-                for (int w_x=0; w_x<=quad_size-patch_size; w_x++)
-                {
-                    for (int w_y=0; w_y<=quad_size-patch_size; w_y++)
-                    {
-                        quad(Rect(w_x,w_y,patch_size,patch_size)).copyTo(tmp);
-                        tmp = tmp.reshape(0,1);
-                        tmp.convertTo(tmp, CV_64F);
-                        normalizeAndZCA(tmp);
-                        vector<double> patch;
-                        tmp.copyTo(patch);
-                        if ((quad_id == 1)||(quad_id == 2)||(quad_id == 6)||(quad_id == 7))
-                            data_pool[0].insert(data_pool[0].end(),patch.begin(),patch.end());
-                        if ((quad_id == 2)||(quad_id == 7)||(quad_id == 3)||(quad_id == 8)||(quad_id == 4)||(quad_id == 9))
-                            data_pool[1].insert(data_pool[1].end(),patch.begin(),patch.end());
-                        if ((quad_id == 4)||(quad_id == 9)||(quad_id == 5)||(quad_id == 10))
-                            data_pool[2].insert(data_pool[2].end(),patch.begin(),patch.end());
-                        if ((quad_id == 6)||(quad_id == 11)||(quad_id == 16)||(quad_id == 7)||(quad_id == 12)||(quad_id == 17))
-                            data_pool[3].insert(data_pool[3].end(),patch.begin(),patch.end());
-                        if ((quad_id == 7)||(quad_id == 12)||(quad_id == 17)||(quad_id == 8)||(quad_id == 13)||(quad_id == 18)||(quad_id == 9)||(quad_id == 14)||(quad_id == 19))
-                            data_pool[4].insert(data_pool[4].end(),patch.begin(),patch.end());
-                        if ((quad_id == 9)||(quad_id == 14)||(quad_id == 19)||(quad_id == 10)||(quad_id == 15)||(quad_id == 20))
-                            data_pool[5].insert(data_pool[5].end(),patch.begin(),patch.end());
-                        if ((quad_id == 16)||(quad_id == 21)||(quad_id == 17)||(quad_id == 22))
-                            data_pool[6].insert(data_pool[6].end(),patch.begin(),patch.end());
-                        if ((quad_id == 17)||(quad_id == 22)||(quad_id == 18)||(quad_id == 23)||(quad_id == 19)||(quad_id == 24))
-                            data_pool[7].insert(data_pool[7].end(),patch.begin(),patch.end());
-                        if ((quad_id == 19)||(quad_id == 24)||(quad_id == 20)||(quad_id == 25))
-                            data_pool[8].insert(data_pool[8].end(),patch.begin(),patch.end());
-                        patch_count++;
-                    }
-                }
-
-                quad_id++;
-            }
-        }
-
-        //do dot product of each normalized and whitened patch
-        //each pool is averaged and this yields a representation of 9xD
-        Mat feature = Mat::zeros(9,kernels.rows,CV_64FC1);
-        for (int i=0; i<9; i++)
-        {
-            Mat pool = Mat(data_pool[i]);
-            pool = pool.reshape(0,(int)data_pool[i].size()/kernels.cols);
-            for (int p=0; p<pool.rows; p++)
-            {
-                for (int f=0; f<kernels.rows; f++)
-                {
-                    feature.row(i).at<double>(0,f) = feature.row(i).at<double>(0,f) + max(0.0,std::abs(pool.row(p).dot(kernels.row(f)))-alpha);
-                }
-            }
-        }
-        feature = feature.reshape(0,1);
-
-
-        // data must be normalized within the range obtained during training
-        double lower = -1.0;
-        double upper =  1.0;
-        for (int k=0; k<feature.cols; k++)
-        {
-            feature.at<double>(0,k) = lower + (upper-lower) *
-                    (feature.at<double>(0,k)-feature_min.at<double>(0,k))/
-                    (feature_max.at<double>(0,k)-feature_min.at<double>(0,k));
-        }
-
-        double *p = new double[nr_class];
-        double predict_label = eval_feature(feature,p);
+        double predict_label = eval_feature(features.row(seg_points),&p[0]);
 
         if ( (predict_label < 0) || (predict_label > nr_class) )
             CV_Error(Error::StsOutOfRange, "OCRBeamSearchClassifierCNN::eval Error: unexpected prediction in eval_feature()");
 
-
-        vector<double> recognition_p(p, p+nr_class);
-        recognition_probabilities.push_back(recognition_p);
+        recognition_probabilities.push_back(p);
         oversegmentation.push_back(seg_points);
-        seg_points++;
     }
 
 }
 
-// normalize for contrast and apply ZCA whitening to a set of image patches
-void OCRBeamSearchClassifierCNN::normalizeAndZCA(Mat& patches)
+// data must be normalized within the range obtained during training
+void OCRBeamSearchClassifierCNN::scale_features(Mat& features)
 {
-
-    //Normalize for contrast
-    for (int i=0; i<patches.rows; i++)
+    double lower = -1.0;
+    double upper =  1.0;
+    const double *f_min = feature_min.ptr<double>();
+    const double *f_max = feature_max.ptr<double>();
+    for (int r=0; r<features.rows; r++)
     {
-        Scalar row_mean, row_std;
-        meanStdDev(patches.row(i),row_mean,row_std);
-        row_std[0] = sqrt(pow(row_std[0],2)*patches.cols/(patches.cols-1)+10);
-        patches.row(i) = (patches.row(i) - row_mean[0]) / row_std[0];
+        double *feature = features.ptr<double>(r);
+        for (int k=0; k<features.cols; k++)
+            feature[k] = lower + (upper-lower) * (feature[k]-f_min[k]) / (f_max[k]-f_min[k]);
     }
-
-
-    //ZCA whitening
-    if ((M.dims == 0) || (P.dims == 0))
-    {
-        Mat CC;
-        calcCovarMatrix(patches,CC,M,COVAR_NORMAL|COVAR_ROWS|COVAR_SCALE);
-        CC = CC * patches.rows / (patches.rows-1);
-
-
-        Mat e_val,e_vec;
-        eigen(CC.t(),e_val,e_vec);
-        e_vec = e_vec.t();
-        sqrt(1./(e_val + 0.1), e_val);
-
-
-        Mat V = Mat::zeros(e_vec.rows, e_vec.cols, CV_64FC1);
-        Mat D = Mat::eye(e_vec.rows, e_vec.cols, CV_64FC1);
-
-        for (int i=0; i<e_vec.cols; i++)
-        {
-            e_vec.col(e_vec.cols-i-1).copyTo(V.col(i));
-            D.col(i) = D.col(i) * e_val.at<double>(0,e_val.rows-i-1);
-        }
-
-        P = V * D * V.t();
-    }
-
-    for (int i=0; i<patches.rows; i++)
-        patches.row(i) = patches.row(i) - M;
-
-    patches = patches * P;
-
 }
 
-double OCRBeamSearchClassifierCNN::eval_feature(Mat& feature, double* prob_estimates)
+double OCRBeamSearchClassifierCNN::eval_feature(const Mat& feature, double* prob_estimates)
 {
     for(int i=0;i<nr_class;i++)
         prob_estimates[i] = 0;
 
+    const double *f = feature.ptr<double>();
     for(int idx=0; idx<nr_feature; idx++)
+    {
+        const float *w = weights.ptr<float>(idx);
         for(int i=0;i<nr_class;i++)
-            prob_estimates[i] += weights.at<float>(idx,i)*feature.at<double>(0,idx); //TODO use vectorized dot product
+            prob_estimates[i] += w[i]*f[idx];
+    }
 
     int dec_max_idx = 0;
     for(int i=1;i<nr_class;i++)
@@ -0,0 +1,189 @@
+/*M///////////////////////////////////////////////////////////////////////////////////////
+//
+//  IMPORTANT: READ BEFORE DOWNLOADING, COPYING, INSTALLING OR USING.
+//
+//  By downloading, copying, installing or using the software you agree to this license.
+//  If you do not agree to this license, do not download, install,
+//  copy or use the software.
+//
+//
+//                           License Agreement
+//                For Open Source Computer Vision Library
+//
+// Copyright (C) 2000-2008, Intel Corporation, all rights reserved.
+// Copyright (C) 2009, Willow Garage Inc., all rights reserved.
+// Third party copyrights are property of their respective owners.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+//   * Redistribution's of source code must retain the above copyright notice,
+//     this list of conditions and the following disclaimer.
+//
+//   * Redistribution's in binary form must reproduce the above copyright notice,
+//     this list of conditions and the following disclaimer in the documentation
+//     and/or other materials provided with the distribution.
+//
+//   * The name of the copyright holders may not be used to endorse or promote products
+//     derived from this software without specific prior written permission.
+//
+// This software is provided by the copyright holders and contributors "as is" and
+// any express or implied warranties, including, but not limited to, the implied
+// warranties of merchantability and fitness for a particular purpose are disclaimed.
+// In no event shall the Intel Corporation or contributors be liable for any direct,
+// indirect, incidental, special, exemplary, or consequential damages
+// (including, but not limited to, procurement of substitute goods or services;
+// loss of use, data, or profits; or business interruption) however caused
+// and on any theory of liability, whether in contract, strict liability,
+// or tort (including negligence or otherwise) arising in any way out of
+// the use of this software, even if advised of the possibility of such damage.
+//
+//M*/
+
+#include "precomp.hpp"
+#include "ocr_cnn_features.hpp"
+
+namespace cv
+{
+namespace text
+{
+
+using namespace std;
+
+void OCRCNNFeatures::init(const Mat& kernels, const Mat& M, const Mat& P, double _alpha, int _quad_size, int _window_size)
+{
+    CV_Assert( (kernels.cols > 0) && (kernels.rows > 0) );
+    CV_Assert( (M.total() == (size_t)kernels.cols) && (P.rows == kernels.cols) && (P.cols == kernels.cols) );
+
+    patch_size  = (int)sqrt((double)kernels.cols);
+    quad_size   = _quad_size;
+    window_size = _window_size;
+    alpha       = (float)_alpha;
+
+    CV_Assert( patch_size*patch_size == kernels.cols );
+    // the 9 pools are defined over a 5x5 grid of quads
+    CV_Assert( (quad_size > patch_size) && ((window_size-quad_size)/(quad_size/2-1) == 4) );
+
+    // ((a - M) * P) . k = a * (P * k') - M * (P * k')
+    Mat kernels64, M64, P64, W64;
+    kernels.convertTo(kernels64, CV_64F);
+    M.reshape(1,1).convertTo(M64, CV_64F);
+    P.convertTo(P64, CV_64F);
+
+    W64 = P64 * kernels64.t();
+    Mat bias64 = -M64 * W64;
+
+    W64.convertTo(W, CV_32F);
+    bias64.convertTo(bias, CV_32F);
+}
+
+void OCRCNNFeatures::compute(const Mat& img, int step, Mat& features) const
+{
+    CV_Assert( !W.empty() );
+    CV_Assert( (img.type() == CV_8UC1) && (img.rows == window_size) && (img.cols >= window_size) && (step > 0) );
+
+    int area        = patch_size*patch_size;
+    int num_kernels = W.cols;
+    int patch_rows  = img.rows - patch_size + 1;
+    int patch_cols  = img.cols - patch_size + 1;
+
+    // every patch, normalized for contrast, as a row
+    Mat patches(patch_rows*patch_cols, area, CV_32F);
+    for (int y=0; y<patch_rows; y++)
+    {
+        for (int x=0; x<patch_cols; x++)
+        {
+            float *patch = patches.ptr<float>(y*patch_cols+x);
+            int sum = 0, sqsum = 0;
+            for (int i=0; i<patch_size; i++)
+            {
+                const uchar *src = img.ptr<uchar>(y+i) + x;
+                for (int j=0; j<patch_size; j++)
+                {
+                    int v = src[j];
+                    patch[i*patch_size+j] = (float)v;
+                    sum   += v;
+                    sqsum += v*v;
+                }
+            }
+
+            // unbiased variance, regularized
+            double mean  = (double)sum/area;
+            double scale = 1./sqrt(((double)sqsum - sum*mean)/(area-1) + 10);
+            for (int k=0; k<area; k++)
+                patch[k] = (float)((patch[k] - mean)*scale);
+        }
+    }
+
+    // whitening and convolution with all the kernels at once
+    Mat responses;
+    gemm(patches, W, 1, noArray(), 0, responses);
+
+    // non-linear activation z = max(0, |D*a| - alpha)
+    const float *b = bias.ptr<float>();
+    for (int r=0; r<responses.rows; r++)
+    {
+        float *z = responses.ptr<float>(r);
+        for (int f=0; f<num_kernels; f++)
+            z[f] = std::max(std::abs(z[f] + b[f]) - alpha, 0.f);
+    }
+
+    // sum pooling of every sliding window
+    const int num_quads  = 5;
+    const int quad_step  = quad_size/2-1;
+    const int quad_tiles = quad_size - patch_size + 1;
+    // quads of every one of the 3 pools along an axis
+    const int pool_begin[3] = {0, 1, 3};
+    const int pool_end[3]   = {2, 4, 5};
+
+    int num_windows = (img.cols - window_size)/step + 1;
+    features.create(num_windows, 9*num_kernels, CV_64F);
+
+    vector<double> quads(num_quads*num_quads*num_kernels);
+    for (int w=0; w<num_windows; w++)
+    {
+        int x_c = w*step;
+
+        std::fill(quads.begin(), quads.end(), 0.);
+        for (int q_x=0; q_x<num_quads; q_x++)
+        {
+            for (int q_y=0; q_y<num_quads; q_y++)
+            {
+                double *quad = &quads[(q_x*num_quads+q_y)*num_kernels];
+                for (int t_y=0; t_y<quad_tiles; t_y++)
+                {
+                    for (int t_x=0; t_x<quad_tiles; t_x++)
+                    {
+                        const float *z = responses.ptr<float>((q_y*quad_step+t_y)*patch_cols + x_c+q_x*quad_step+t_x);
+                        for (int f=0; f<num_kernels; f++)
+                            quad[f] += z[f];
+                    }
+                }
+            }
+        }
+
+        double *feature = features.ptr<double>(w);
+        for (int p_x=0; p_x<3; p_x++)
+        {
+            for (int p_y=0; p_y<3; p_y++)
+            {
+                double *pool = feature + (p_x*3+p_y)*num_kernels;
+                for (int f=0; f<num_kernels; f++)
+                    pool[f] = 0.;
+
+                for (int q_x=pool_begin[p_x]; q_x<pool_end[p_x]; q_x++)
+                {
+                    for (int q_y=pool_begin[p_y]; q_y<pool_end[p_y]; q_y++)
+                    {
+                        const double *quad = &quads[(q_x*num_quads+q_y)*num_kernels];
+                        for (int f=0; f<num_kernels; f++)
+                            pool[f] += quad[f];
+                    }
+                }
+            }
+        }
+    }
+}
+
+}
+}
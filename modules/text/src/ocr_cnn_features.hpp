@@ -0,0 +1,91 @@
+/*M///////////////////////////////////////////////////////////////////////////////////////
+//
+//  IMPORTANT: READ BEFORE DOWNLOADING, COPYING, INSTALLING OR USING.
+//
+//  By downloading, copying, installing or using the software you agree to this license.
+//  If you do not agree to this license, do not download, install,
+//  copy or use the software.
+//
+//
+//                           License Agreement
+//                For Open Source Computer Vision Library
+//
+// Copyright (C) 2000-2008, Intel Corporation, all rights reserved.
+// Copyright (C) 2009, Willow Garage Inc., all rights reserved.
+// Third party copyrights are property of their respective owners.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+//   * Redistribution's of source code must retain the above copyright notice,
+//     this list of conditions and the following disclaimer.
+//
+//   * Redistribution's in binary form must reproduce the above copyright notice,
+//     this list of conditions and the following disclaimer in the documentation
+//     and/or other materials provided with the distribution.
+//
+//   * The name of the copyright holders may not be used to endorse or promote products
+//     derived from this software without specific prior written permission.
+//
+// This software is provided by the copyright holders and contributors "as is" and
+// any express or implied warranties, including, but not limited to, the implied
+// warranties of merchantability and fitness for a particular purpose are disclaimed.
+// In no event shall the Intel Corporation or contributors be liable for any direct,
+// indirect, incidental, special, exemplary, or consequential damages
+// (including, but not limited to, procurement of substitute goods or services;
+// loss of use, data, or profits; or business interruption) however caused
+// and on any theory of liability, whether in contract, strict liability,
+// or tort (including negligence or otherwise) arising in any way out of
+// the use of this software, even if advised of the possibility of such damage.
+//
+//M*/
+
+#ifndef __OPENCV_TEXT_OCR_CNN_FEATURES_HPP__
+#define __OPENCV_TEXT_OCR_CNN_FEATURES_HPP__
+
+#include "precomp.hpp"
+
+namespace cv
+{
+namespace text
+{
+
+/*
+    Convolutional features of the CNN character classifiers used by OCRHMMDecoder and
+    OCRBeamSearchDecoder.
+
+    Every patch_size x patch_size patch of the image is normalized for contrast and stored as a
+    row of a single matrix (im2col). ZCA whitening and the kernels bank are folded into one
+    matrix, so all patches are convolved with one float GEMM. A patch belongs to several quads
+    and pools, and to several overlapping sliding windows, but its activation is computed only
+    once. The activations are summed in every quad, and every one of the 9 pools of a window sums
+    its 4, 6 or 9 quads.
+*/
+class OCRCNNFeatures
+{
+public:
+    OCRCNNFeatures() : patch_size(0), quad_size(0), window_size(0), alpha(0.f) {}
+
+    // kernels bank (one kernel per row), ZCA whitening mean and matrix, activation threshold
+    // alpha of z = max(0, |D*a| - alpha) and size of the quads of a window_size x window_size window
+    void init(const Mat& kernels, const Mat& M, const Mat& P, double alpha, int quad_size, int window_size);
+
+    // features of the windows of a grey image of window_size rows, starting every step columns,
+    // one CV_64F row of 9*kernels.rows features per window
+    void compute(const Mat& img, int step, Mat& features) const;
+
+    int getNumFeatures() const { return 9*W.cols; }
+
+private:
+    int patch_size;
+    int quad_size;
+    int window_size;
+    float alpha;
+    Mat W;    // whitening followed by the kernels bank, one column per kernel
+    Mat bias; // whitening mean projected by W
+};
+
+}
+}
+
+#endif
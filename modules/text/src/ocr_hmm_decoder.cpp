@@ -41,12 +41,19 @@
 //M*/
 
 #include "precomp.hpp"
+#include "opencv2/core/utility.hpp"
 #include "opencv2/imgproc.hpp"
 #include "opencv2/ml.hpp"
+#include "opencv2/flann.hpp"
+#include "ocr_cnn_features.hpp"
+#include "ocr_hmm_knn_model.hpp"
 
 #include <iostream>
 #include <fstream>
 #include <queue>
+#include <map>
+#include <sys/types.h>
+#include <sys/stat.h>
 
 namespace cv
 {
@@ -97,6 +104,15 @@ void OCRHMMDecoder::ClassifierCallback::eval( InputArray image, vector<int>& out
     out_confidence.clear();
 }
 
+void OCRHMMDecoder::ClassifierCallback::evalBatch( const vector<Mat>& images, vector< vector<int> >& out_class,
+                                                   vector< vector<double> >& out_confidence)
+{
+    out_class.resize(images.size());
+    out_confidence.resize(images.size());
+    for (size_t i=0; i<images.size(); i++)
+        eval(images[i], out_class[i], out_confidence[i]);
+}
+
 
 bool sort_rect_horiz (Rect a,Rect b);
 bool sort_rect_horiz (Rect a,Rect b) { return (a.x<b.x); }
@@ -266,20 +282,17 @@ public:
 
             sort(contours_rect.begin(), contours_rect.end(), sort_rect_horiz);
 
-            // Do character recognition foreach contour
+            // Do character recognition of all the contours at once
+            vector<Mat> chars_mask(contours.size());
             for (int i=0; i<(int)contours.size(); i++)
+                words_mask[w](contours_rect.at(i)).copyTo(chars_mask[i]);
+
+            classifier->evalBatch(chars_mask,observations,confidences);
+            for (int i=0; i<(int)observations.size(); i++)
             {
-                Mat tmp_mask;
-                words_mask[w](contours_rect.at(i)).copyTo(tmp_mask);
-
-                vector<int> out_class;
-                vector<double> out_conf;
-                classifier->eval(tmp_mask,out_class,out_conf);
-                if (!out_class.empty())
-                    obs.push_back(out_class[0]);
-                observations.push_back(out_class);
-                confidences.push_back(out_conf);
-                //cout << " out class = " << vocabulary[out_class[0]] << endl;
+                if (!observations[i].empty())
+                    obs.push_back(observations[i][0]);
+                //cout << " out class = " << vocabulary[observations[i][0]] << endl;
             }
 
 
@@ -514,11 +527,10 @@ public:
 
             sort(contours_rect.begin(), contours_rect.end(), sort_rect_horiz);
 
-            // Do character recognition foreach contour
+            // Do character recognition of all the contours at once
+            vector<Mat> chars_image(contours.size());
             for (int i=0; i<(int)contours.size(); i++)
             {
-                vector<int> out_class;
-                vector<double> out_conf;
                 //take the center of the char rect and translate it to the real origin
                 Point char_center = Point(contours_rect.at(i).x+contours_rect.at(i).width/2,
                                           contours_rect.at(i).y+contours_rect.at(i).height/2);
@@ -528,15 +540,15 @@ public:
                 win_size += (int)(win_size*0.6); // add some pixels in the border TODO: is this a parameter for the user space?
                 Rect char_rect = Rect(char_center.x-win_size/2,char_center.y-win_size/2,win_size,win_size);
                 char_rect &= Rect(0,0,image.cols,image.rows);
-                Mat tmp_image;
-                image(char_rect).copyTo(tmp_image);
-
-                classifier->eval(tmp_image,out_class,out_conf);
-                if (!out_class.empty())
-                    obs.push_back(out_class[0]);
-                //cout << " out class = " << vocabulary[out_class[0]] << "(" << out_conf[0] << ")" << endl;
-                observations.push_back(out_class);
-                confidences.push_back(out_conf);
+                image(char_rect).copyTo(chars_image[i]);
+            }
+
+            classifier->evalBatch(chars_image,observations,confidences);
+            for (int i=0; i<(int)observations.size(); i++)
+            {
+                if (!observations[i].empty())
+                    obs.push_back(observations[i][0]);
+                //cout << " out class = " << vocabulary[observations[i][0]] << "(" << confidences[i][0] << ")" << endl;
             }
 
 
@@ -635,6 +647,76 @@ Ptr<OCRHMMDecoder> OCRHMMDecoder::create( Ptr<OCRHMMDecoder::ClassifierCallback>
 }
 
 
+// size and modification time of a file, false if it can not be accessed
+static bool getFileIdentity(const string& filename, long long& size, long long& mtime)
+{
+    struct stat st;
+    if (stat(filename.c_str(), &st) != 0)
+        return false;
+    size = (long long)st.st_size;
+    mtime = (long long)st.st_mtime;
+    return true;
+}
+
+void OCRHMMKNNModel::knnSearch(const Mat& queries, int k, Mat& neighbours, Mat& dists) const
+{
+    // unlimited checks make the KD-tree search exact
+    index->knnSearch(queries, neighbours, dists, k, flann::SearchParams(cvflann::FLANN_CHECKS_UNLIMITED));
+}
+
+Ptr<OCRHMMKNNModel> loadOCRHMMKNNModel(const string& filename)
+{
+    // the models are parsed from the XML file once per process, they are small enough to keep
+    // a few of them and the least recently used one is evicted
+    static const size_t max_cached_models = 4;
+    static Mutex cache_mutex;
+    static map<string, Ptr<OCRHMMKNNModel> > cache;
+    static unsigned long long use_counter = 0;
+
+    long long file_size = 0, file_mtime = 0;
+    if (!getFileIdentity(filename, file_size, file_mtime) || !ifstream(filename.c_str()))
+        CV_Error(Error::StsBadArg, "Default classifier data file not found!");
+
+    AutoLock lock(cache_mutex);
+    map<string, Ptr<OCRHMMKNNModel> >::iterator it = cache.find(filename);
+    if (it != cache.end())
+    {
+        if (it->second->file_size == file_size && it->second->file_mtime == file_mtime)
+        {
+            it->second->last_use = ++use_counter;
+            return it->second;
+        }
+        cache.erase(it);
+    }
+
+    Mat hus, labels;
+    cv::FileStorage storage(filename.c_str(), cv::FileStorage::READ);
+    storage["hus"] >> hus;
+    storage["labels"] >> labels;
+    storage.release();
+    CV_Assert( !hus.empty() && ((int)labels.total() == hus.rows) );
+
+    Ptr<OCRHMMKNNModel> model = makePtr<OCRHMMKNNModel>();
+    hus.convertTo(model->samples, CV_32F);
+    labels.reshape(1, 1).convertTo(model->labels, CV_32S);
+    model->index = makePtr<flann::Index>(model->samples, flann::KDTreeIndexParams(1), cvflann::FLANN_DIST_L2);
+    model->file_size = file_size;
+    model->file_mtime = file_mtime;
+    model->last_use = ++use_counter;
+
+    // classifiers already holding an evicted model keep it alive through their own Ptr
+    if (cache.size() >= max_cached_models)
+    {
+        map<string, Ptr<OCRHMMKNNModel> >::iterator lru = cache.begin();
+        for (it = cache.begin(); it != cache.end(); ++it)
+            if (it->second->last_use < lru->second->last_use)
+                lru = it;
+        cache.erase(lru);
+    }
+    cache[filename] = model;
+    return model;
+}
+
 class CV_EXPORTS OCRHMMClassifierKNN : public OCRHMMDecoder::ClassifierCallback
 {
 public:
@@ -644,38 +726,68 @@ public:
     ~OCRHMMClassifierKNN() {}
 
     void eval( InputArray mask, vector<int>& out_class, vector<double>& out_confidence );
+    void evalBatch( const vector<Mat>& masks, vector< vector<int> >& out_class, vector< vector<double> >& out_confidence );
 private:
-    Ptr<KNearest> knn;
+    // feature vector of a character mask, false if the mask is empty
+    bool compute_features( const Mat& mask, float* sample );
+    // class of a character from its nearest training samples
+    void vote( const int* neighbours, const float* dists, int k, vector<int>& out_class, vector<double>& out_confidence );
+
+    Ptr<OCRHMMKNNModel> model;
 };
 
 OCRHMMClassifierKNN::OCRHMMClassifierKNN (const string& filename)
 {
-    knn = KNearest::create();
-    if (ifstream(filename.c_str()))
-    {
-        Mat hus, labels;
-        cv::FileStorage storage(filename.c_str(), cv::FileStorage::READ);
-        storage["hus"] >> hus;
-        storage["labels"] >> labels;
-        storage.release();
-        knn->train(hus, ROW_SAMPLE, labels);
-    }
-    else
-        CV_Error(Error::StsBadArg, "Default classifier data file not found!");
+    model = loadOCRHMMKNNModel(filename);
+    CV_Assert( model->samples.cols == 200 );
 }
 
 void OCRHMMClassifierKNN::eval( InputArray _mask, vector<int>& out_class, vector<double>& out_confidence )
 {
-    CV_Assert( _mask.getMat().type() == CV_8UC1 );
+    vector<Mat> masks(1, _mask.getMat());
+    vector< vector<int> > classes;
+    vector< vector<double> > confidences;
+    evalBatch(masks, classes, confidences);
+    out_class.swap(classes[0]);
+    out_confidence.swap(confidences[0]);
+}
 
-    out_class.clear();
-    out_confidence.clear();
+void OCRHMMClassifierKNN::evalBatch( const vector<Mat>& masks, vector< vector<int> >& out_class,
+                                     vector< vector<double> >& out_confidence )
+{
+    out_class.assign(masks.size(), vector<int>());
+    out_confidence.assign(masks.size(), vector<double>());
+
+    int num_features = 200;
+    int num_neighbours = 11;
+
+    // features of all the characters, the ones without a contour are not classified
+    Mat samples((int)masks.size(), num_features, CV_32FC1);
+    vector<int> sample_idx;
+    for (int i=0; i<(int)masks.size(); i++)
+    {
+        CV_Assert( masks[i].type() == CV_8UC1 );
+        if (compute_features(masks[i], samples.ptr<float>((int)sample_idx.size())))
+            sample_idx.push_back(i);
+    }
+    if (sample_idx.empty())
+        return;
+
+    // a single query for all the characters
+    int k = min(num_neighbours, model->samples.rows);
+    Mat neighbours, dists;
+    model->knnSearch(samples.rowRange(0, (int)sample_idx.size()), k, neighbours, dists);
+
+    for (int i=0; i<(int)sample_idx.size(); i++)
+        vote(neighbours.ptr<int>(i), dists.ptr<float>(i), k, out_class[sample_idx[i]], out_confidence[sample_idx[i]]);
+}
 
+bool OCRHMMClassifierKNN::compute_features( const Mat& _mask, float* sample )
+{
     int image_height = 35;
     int image_width = 35;
-    int num_features = 200;
 
-    Mat img = _mask.getMat();
+    Mat img = _mask;
     Mat tmp;
     img.copyTo(tmp);
 
@@ -685,7 +797,7 @@ void OCRHMMClassifierKNN::eval( InputArray _mask, vector<int>& out_class, vector
     findContours( tmp, contours, hierarchy, RETR_EXTERNAL, CHAIN_APPROX_SIMPLE, Point(0, 0) );
 
     if (contours.empty())
-        return;
+        return false;
 
     int idx = 0;
     if (contours.size() > 1)
@@ -782,7 +894,6 @@ void OCRHMMClassifierKNN::eval( InputArray _mask, vector<int>& out_class, vector
     }
 
     //Generate features for each bitmap
-    Mat sample = Mat(1,num_features,CV_32FC1);
     Mat patch;
     for (int i=0; i<(int)maps.size(); i++)
     {
@@ -793,16 +904,46 @@ void OCRHMMClassifierKNN::eval( InputArray _mask, vector<int>& out_class, vector
                 maps[i](Rect(x,y,7,7)).copyTo(patch);
                 Scalar mean,std;
                 meanStdDev(patch,mean,std);
-                sample.at<float>(0,i*25+((int)x/7)+((int)y/7)*5) = (float)(mean[0]/255);
+                sample[i*25+((int)x/7)+((int)y/7)*5] = (float)(mean[0]/255);
                 //cout << " avg " << mean[0] << " in patch " << x << "," << y << " channel " << i << " idx = " << i*25+((int)x/7)+((int)y/7)*5<< endl;
             }
         }
     }
 
-    Mat responses,dists,predictions;
-    knn->findNearest( sample, 11, predictions, responses, dists);
+    return true;
+}
+
+void OCRHMMClassifierKNN::vote( const int* neighbours, const float* dists, int k,
+                                vector<int>& out_class, vector<double>& out_confidence )
+{
+    // labels of the neighbours and most frequent one (the lowest label on ties)
+    vector<int> responses(k, -1);
+    for (int j=0; j<k; j++)
+        if (neighbours[j] >= 0)
+            responses[j] = model->labels[neighbours[j]];
+
+    vector<int> sorted_responses(responses);
+    sort(sorted_responses.begin(), sorted_responses.end());
+    int prediction = -1, best_count = 0;
+    for (int j=0, start=0; j<=k; j++)
+    {
+        if ((j == k) || (sorted_responses[j] != sorted_responses[start]))
+        {
+            if ((sorted_responses[start] >= 0) && (j-start > best_count))
+            {
+                best_count = j-start;
+                prediction = sorted_responses[start];
+            }
+            start = j;
+        }
+    }
+    if (prediction < 0)
+        return;
 
-    Scalar dist_sum = sum(dists);
+    double dist_sum = 0;
+    for (int j=0; j<k; j++)
+        if (responses[j] >= 0)
+            dist_sum += dists[j];
     Mat class_predictions = Mat::zeros(1,62,CV_64FC1);
 
     vector<vector<int> > equivalency_mat(62);
@@ -838,22 +979,22 @@ void OCRHMMClassifierKNN::eval( InputArray _mask, vector<int>& out_class, vector
     equivalency_mat[51].push_back(25); // Z -> z
 
 
-    for (int j=0; j<responses.cols; j++)
+    for (int j=0; j<k; j++)
     {
-        if (responses.at<float>(0,j)<0)
+        if (responses[j]<0)
             continue;
-        class_predictions.at<double>(0,(int)responses.at<float>(0,j)) += dists.at<float>(0,j);
-        for (int e=0; e<(int)equivalency_mat[(int)responses.at<float>(0,j)].size(); e++)
+        class_predictions.at<double>(0,responses[j]) += dists[j];
+        for (int e=0; e<(int)equivalency_mat[responses[j]].size(); e++)
         {
-            class_predictions.at<double>(0,equivalency_mat[(int)responses.at<float>(0,j)][e]) += dists.at<float>(0,j);
-            dist_sum[0] +=  dists.at<float>(0,j);
+            class_predictions.at<double>(0,equivalency_mat[responses[j]][e]) += dists[j];
+            dist_sum +=  dists[j];
         }
     }
 
-    class_predictions = class_predictions/dist_sum[0];
+    class_predictions = class_predictions/dist_sum;
 
-    out_class.push_back((int)predictions.at<float>(0,0));
-    out_confidence.push_back(class_predictions.at<double>(0,(int)predictions.at<float>(0,0)));
+    out_class.push_back(prediction);
+    out_confidence.push_back(class_predictions.at<double>(0,prediction));
 
     for (int i=0; i<class_predictions.cols; i++)
     {
@@ -863,7 +1004,6 @@ void OCRHMMClassifierKNN::eval( InputArray _mask, vector<int>& out_class, vector
             out_confidence.push_back(class_predictions.at<double>(0,i));
         }
     }
-
 }
 
 
@@ -886,8 +1026,8 @@ public:
     void eval( InputArray image, vector<int>& out_class, vector<double>& out_confidence );
 
 protected:
-    void normalizeAndZCA(Mat& patches);
-    double eval_feature(Mat& feature, double* prob_estimates);
+    void scale_features(Mat& features);
+    double eval_feature(const Mat& feature, double* prob_estimates);
 
 private:
     int nr_class;		 // number of classes
@@ -903,6 +1043,7 @@ private:
     int num_quads;   // extract 25 quads (12x12) from each image
     int num_tiles;   // extract 25 patches (8x8) from each quad
     double alpha;    // used in non-linear activation function z = max(0, |D*a| - alpha)
+    OCRCNNFeatures cnn_features; // patches convolution and pooling
 };
 
 OCRHMMClassifierCNN::OCRHMMClassifierCNN (const string& filename)
@@ -941,6 +1082,9 @@ OCRHMMClassifierCNN::OCRHMMClassifierCNN (const string& filename)
     num_tiles   = 25;
     quad_size   = 12;
     alpha       = 0.5;
+
+    cnn_features.init(kernels, M, P, alpha, quad_size, window_size);
+    CV_Assert( nr_feature == cnn_features.getNumFeatures() );
 }
 
 void OCRHMMClassifierCNN::eval( InputArray _src, vector<int>& out_class, vector<double>& out_confidence )
@@ -961,88 +1105,14 @@ void OCRHMMClassifierCNN::eval( InputArray _src, vector<int>& out_class, vector<
     // shall we resize the input image or make a copy ?
     resize(img,img,Size(window_size,window_size));
 
-    Mat quad;
-    Mat tmp;
-
-    int patch_count = 0;
-    vector< vector<double> > data_pool(9);
-
-
-    int quad_id = 1;
-    for (int q_x=0; q_x<=window_size-quad_size; q_x=q_x+(int)(quad_size/2-1))
-    {
-        for (int q_y=0; q_y<=window_size-quad_size; q_y=q_y+(int)(quad_size/2-1))
-        {
-            Rect quad_rect = Rect(q_x,q_y,quad_size,quad_size);
-            quad = img(quad_rect);
-
-            //start sliding window (8x8) in each tile and store the patch as row in data_pool
-            for (int w_x=0; w_x<=quad_size-patch_size; w_x++)
-            {
-                for (int w_y=0; w_y<=quad_size-patch_size; w_y++)
-                {
-                    quad(Rect(w_x,w_y,patch_size,patch_size)).copyTo(tmp);
-                    tmp = tmp.reshape(0,1);
-                    tmp.convertTo(tmp, CV_64F);
-                    normalizeAndZCA(tmp);
-                    vector<double> patch;
-                    tmp.copyTo(patch);
-                    if ((quad_id == 1)||(quad_id == 2)||(quad_id == 6)||(quad_id == 7))
-                        data_pool[0].insert(data_pool[0].end(),patch.begin(),patch.end());
-                    if ((quad_id == 2)||(quad_id == 7)||(quad_id == 3)||(quad_id == 8)||(quad_id == 4)||(quad_id == 9))
-                        data_pool[1].insert(data_pool[1].end(),patch.begin(),patch.end());
-                    if ((quad_id == 4)||(quad_id == 9)||(quad_id == 5)||(quad_id == 10))
-                        data_pool[2].insert(data_pool[2].end(),patch.begin(),patch.end());
-                    if ((quad_id == 6)||(quad_id == 11)||(quad_id == 16)||(quad_id == 7)||(quad_id == 12)||(quad_id == 17))
-                        data_pool[3].insert(data_pool[3].end(),patch.begin(),patch.end());
-                    if ((quad_id == 7)||(quad_id == 12)||(quad_id == 17)||(quad_id == 8)||(quad_id == 13)||(quad_id == 18)||(quad_id == 9)||(quad_id == 14)||(quad_id == 19))
-                        data_pool[4].insert(data_pool[4].end(),patch.begin(),patch.end());
-                    if ((quad_id == 9)||(quad_id == 14)||(quad_id == 19)||(quad_id == 10)||(quad_id == 15)||(quad_id == 20))
-                        data_pool[5].insert(data_pool[5].end(),patch.begin(),patch.end());
-                    if ((quad_id == 16)||(quad_id == 21)||(quad_id == 17)||(quad_id == 22))
-                        data_pool[6].insert(data_pool[6].end(),patch.begin(),patch.end());
-                    if ((quad_id == 17)||(quad_id == 22)||(quad_id == 18)||(quad_id == 23)||(quad_id == 19)||(quad_id == 24))
-                        data_pool[7].insert(data_pool[7].end(),patch.begin(),patch.end());
-                    if ((quad_id == 19)||(quad_id == 24)||(quad_id == 20)||(quad_id == 25))
-                        data_pool[8].insert(data_pool[8].end(),patch.begin(),patch.end());
-                    patch_count++;
-                }
-            }
-
-            quad_id++;
-        }
-    }
-
-    //do dot product of each normalized and whitened patch
-    //each pool is averaged and this yields a representation of 9xD
-    Mat feature = Mat::zeros(9,kernels.rows,CV_64FC1);
-    for (int i=0; i<9; i++)
-    {
-        Mat pool = Mat(data_pool[i]);
-        pool = pool.reshape(0,(int)data_pool[i].size()/kernels.cols);
-        for (int p=0; p<pool.rows; p++)
-        {
-            for (int f=0; f<kernels.rows; f++)
-            {
-                feature.row(i).at<double>(0,f) = feature.row(i).at<double>(0,f) + max(0.0,std::abs(pool.row(p).dot(kernels.row(f)))-alpha);
-            }
-        }
-    }
-    feature = feature.reshape(0,1);
+    // convolve all the normalized and whitened patches with the kernels
+    // each pool is averaged and this yields a representation of 9xD
+    Mat feature;
+    cnn_features.compute(img, window_size, feature);
+    scale_features(feature);
 
-
-    // data must be normalized within the range obtained during training
-    double lower = -1.0;
-    double upper =  1.0;
-    for (int k=0; k<feature.cols; k++)
-    {
-        feature.at<double>(0,k) = lower + (upper-lower) *
-                (feature.at<double>(0,k)-feature_min.at<double>(0,k))/
-                (feature_max.at<double>(0,k)-feature_min.at<double>(0,k));
-    }
-
-    double *p = new double[nr_class];
-    double predict_label = eval_feature(feature,p);
+    vector<double> p(nr_class);
+    double predict_label = eval_feature(feature,&p[0]);
     //cout << " Prediction: " << vocabulary[predict_label] << " with probability " << p[0] << endl;
     if (predict_label < 0)
         CV_Error(Error::StsInternal, "OCRHMMClassifierCNN::eval Error: unexpected prediction in eval_feature()");
@@ -1062,61 +1132,33 @@ void OCRHMMClassifierCNN::eval( InputArray _src, vector<int>& out_class, vector<
 
 }
 
-// normalize for contrast and apply ZCA whitening to a set of image patches
-void OCRHMMClassifierCNN::normalizeAndZCA(Mat& patches)
+// data must be normalized within the range obtained during training
+void OCRHMMClassifierCNN::scale_features(Mat& features)
 {
-
-    //Normalize for contrast
-    for (int i=0; i<patches.rows; i++)
-    {
-        Scalar row_mean, row_std;
-        meanStdDev(patches.row(i),row_mean,row_std);
-        row_std[0] = sqrt(pow(row_std[0],2)*patches.cols/(patches.cols-1)+10);
-        patches.row(i) = (patches.row(i) - row_mean[0]) / row_std[0];
-    }
-
-
-    //ZCA whitening
-    if ((M.dims == 0) || (P.dims == 0))
+    double lower = -1.0;
+    double upper =  1.0;
+    const double *f_min = feature_min.ptr<double>();
+    const double *f_max = feature_max.ptr<double>();
+    for (int r=0; r<features.rows; r++)
     {
-        Mat CC;
-        calcCovarMatrix(patches,CC,M,COVAR_NORMAL|COVAR_ROWS|COVAR_SCALE);
-        CC = CC * patches.rows / (patches.rows-1);
-
-
-        Mat e_val,e_vec;
-        eigen(CC.t(),e_val,e_vec);
-        e_vec = e_vec.t();
-        sqrt(1./(e_val + 0.1), e_val);
-
-
-        Mat V = Mat::zeros(e_vec.rows, e_vec.cols, CV_64FC1);
-        Mat D = Mat::eye(e_vec.rows, e_vec.cols, CV_64FC1);
-
-        for (int i=0; i<e_vec.cols; i++)
-        {
-            e_vec.col(e_vec.cols-i-1).copyTo(V.col(i));
-            D.col(i) = D.col(i) * e_val.at<double>(0,e_val.rows-i-1);
-        }
-
-        P = V * D * V.t();
+        double *feature = features.ptr<double>(r);
+        for (int k=0; k<features.cols; k++)
+            feature[k] = lower + (upper-lower) * (feature[k]-f_min[k]) / (f_max[k]-f_min[k]);
     }
-
-    for (int i=0; i<patches.rows; i++)
-        patches.row(i) = patches.row(i) - M;
-
-    patches = patches * P;
-
 }
 
-double OCRHMMClassifierCNN::eval_feature(Mat& feature, double* prob_estimates)
+double OCRHMMClassifierCNN::eval_feature(const Mat& feature, double* prob_estimates)
 {
     for(int i=0;i<nr_class;i++)
         prob_estimates[i] = 0;
 
+    const double *f = feature.ptr<double>();
     for(int idx=0; idx<nr_feature; idx++)
+    {
+        const float *w = weights.ptr<float>(idx);
         for(int i=0;i<nr_class;i++)
-            prob_estimates[i] += weights.at<float>(idx,i)*feature.at<double>(0,idx); //TODO use vectorized dot product
+            prob_estimates[i] += w[i]*f[idx];
+    }
 
     int dec_max_idx = 0;
     for(int i=1;i<nr_class;i++)
@@ -0,0 +1,86 @@
+/*M///////////////////////////////////////////////////////////////////////////////////////
+//
+//  IMPORTANT: READ BEFORE DOWNLOADING, COPYING, INSTALLING OR USING.
+//
+//  By downloading, copying, installing or using the software you agree to this license.
+//  If you do not agree to this license, do not download, install,
+//  copy or use the software.
+//
+//
+//                           License Agreement
+//                For Open Source Computer Vision Library
+//
+// Copyright (C) 2000-2008, Intel Corporation, all rights reserved.
+// Copyright (C) 2009, Willow Garage Inc., all rights reserved.
+// Third party copyrights are property of their respective owners.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+//   * Redistribution's of source code must retain the above copyright notice,
+//     this list of conditions and the following disclaimer.
+//
+//   * Redistribution's in binary form must reproduce the above copyright notice,
+//     this list of conditions and the following disclaimer in the documentation
+//     and/or other materials provided with the distribution.
+//
+//   * The name of the copyright holders may not be used to endorse or promote products
+//     derived from this software without specific prior written permission.
+//
+// This software is provided by the copyright holders and contributors "as is" and
+// any express or implied warranties, including, but not limited to, the implied
+// warranties of merchantability and fitness for a particular purpose are disclaimed.
+// In no event shall the Intel Corporation or contributors be liable for any direct,
+// indirect, incidental, special, exemplary, or consequential damages
+// (including, but not limited to, procurement of substitute goods or services;
+// loss of use, data, or profits; or business interruption) however caused
+// and on any theory of liability, whether in contract, strict liability,
+// or tort (including negligence or otherwise) arising in any way out of
+// the use of this software, even if advised of the possibility of such damage.
+//
+//M*/
+
+#ifndef __OPENCV_TEXT_OCR_HMM_KNN_MODEL_HPP__
+#define __OPENCV_TEXT_OCR_HMM_KNN_MODEL_HPP__
+
+#include "opencv2/core.hpp"
+#include "opencv2/flann.hpp"
+
+#include <string>
+#include <vector>
+
+namespace cv
+{
+namespace text
+{
+
+/*
+    Training samples of a KNN character model file, shared by all the classifiers loading it.
+
+    The samples are stored as a contiguous float matrix indexed by a single KD-tree, which is
+    searched exactly: the tree prunes the subtrees farther than the current k-th neighbour, so
+    the neighbours are the ones of a linear scan without scanning all the samples.
+*/
+struct CV_EXPORTS OCRHMMKNNModel
+{
+    Mat samples;                // CV_32FC1, one row per training sample
+    std::vector<int> labels;
+    Ptr<flann::Index> index;
+
+    long long file_size;        // identity of the file the model was loaded from
+    long long file_mtime;
+    unsigned long long last_use;
+
+    // indices (CV_32S) and squared distances (CV_32F) of the k nearest training samples of every
+    // row of queries (CV_32FC1), sorted by distance
+    void knnSearch(const Mat& queries, int k, Mat& neighbours, Mat& dists) const;
+};
+
+// Model of a file, loaded once and kept in a small process-wide cache. A cached model is reused
+// while its file keeps the same size and modification time.
+CV_EXPORTS Ptr<OCRHMMKNNModel> loadOCRHMMKNNModel(const std::string& filename);
+
+}
+}
+
+#endif
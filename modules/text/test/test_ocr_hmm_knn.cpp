@@ -0,0 +1,96 @@
+#include "test_precomp.hpp"
+
+#include "../src/ocr_hmm_knn_model.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <utility>
+
+using namespace cv;
+using namespace cv::text;
+using namespace std;
+
+// A model file with clustered samples, as the features of a character are close to each other
+static void writeKNNModel(const string& filename, int num_samples, RNG& rng)
+{
+    const int num_features = 200, num_classes = 62;
+    Mat centers(num_classes, num_features, CV_32FC1);
+    rng.fill(centers, RNG::UNIFORM, 0.f, 1.f);
+
+    Mat hus(num_samples, num_features, CV_32FC1), labels(num_samples, 1, CV_32SC1);
+    for (int i = 0; i < num_samples; i++)
+    {
+        int label = rng.uniform(0, num_classes);
+        Mat noise(1, num_features, CV_32FC1);
+        rng.fill(noise, RNG::NORMAL, 0.f, 0.1f);
+        hus.row(i) = centers.row(label) + noise;
+        labels.at<int>(i) = label;
+    }
+
+    FileStorage fs(filename, FileStorage::WRITE);
+    fs << "hus" << hus;
+    fs << "labels" << labels;
+}
+
+TEST(TextOCRHMMKNN, exact_neighbours)
+{
+    string filename = tempfile(".xml");
+    RNG rng(0x4b4e4e);
+    writeKNNModel(filename, 3000, rng);
+
+    Ptr<OCRHMMKNNModel> model = loadOCRHMMKNNModel(filename);
+    ASSERT_EQ(3000, model->samples.rows);
+
+    // queries near the training samples and far from all of them
+    Mat queries(200, model->samples.cols, CV_32FC1);
+    for (int i = 0; i < queries.rows; i++)
+    {
+        Mat noise(1, queries.cols, CV_32FC1);
+        rng.fill(noise, RNG::NORMAL, 0.f, i % 2 ? 0.05f : 0.5f);
+        queries.row(i) = model->samples.row(rng.uniform(0, model->samples.rows)) + noise;
+    }
+
+    const int k = 11;
+    Mat neighbours, dists;
+    model->knnSearch(queries, k, neighbours, dists);
+    ASSERT_EQ(queries.rows, neighbours.rows);
+    ASSERT_EQ(k, neighbours.cols);
+
+    // brute force reference
+    Mat bfDists;
+    batchDistance(queries, model->samples, bfDists, CV_32F, noArray(), NORM_L2SQR);
+    for (int i = 0; i < queries.rows; i++)
+    {
+        vector< pair<float, int> > order(model->samples.rows);
+        for (int j = 0; j < model->samples.rows; j++)
+            order[j] = make_pair(bfDists.at<float>(i, j), j);
+        partial_sort(order.begin(), order.begin() + k, order.end());
+
+        for (int j = 0; j < k; j++)
+        {
+            EXPECT_EQ(model->labels[order[j].second], model->labels[neighbours.at<int>(i, j)]) << "query " << i;
+            EXPECT_NEAR(order[j].first, dists.at<float>(i, j), 1e-3f * (1.f + order[j].first)) << "query " << i;
+        }
+    }
+
+    remove(filename.c_str());
+}
+
+TEST(TextOCRHMMKNN, model_cache)
+{
+    string filename = tempfile(".xml");
+    RNG rng(0x4b4e4e);
+    writeKNNModel(filename, 100, rng);
+
+    Ptr<OCRHMMKNNModel> model = loadOCRHMMKNNModel(filename);
+    EXPECT_TRUE(model == loadOCRHMMKNNModel(filename));
+
+    // a model file rewritten in place is loaded again
+    writeKNNModel(filename, 150, rng);
+    Ptr<OCRHMMKNNModel> reloaded = loadOCRHMMKNNModel(filename);
+    EXPECT_FALSE(model == reloaded);
+    EXPECT_EQ(150, reloaded->samples.rows);
+    EXPECT_EQ(100, model->samples.rows);
+
+    remove(filename.c_str());
+}
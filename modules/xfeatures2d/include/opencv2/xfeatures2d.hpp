@@ -110,6 +110,15 @@ public:
                          int lineThresholdProjected=10,
                          int lineThresholdBinarized=8,
                          int suppressNonmaxSize=5);
+
+    /** @brief Keep only the maxPerCell strongest keypoints in every cell of a gridSize grid.
+    0 (default) disables the budget. It is applied after the detection on the whole image, so it does not
+    reduce the detection cost.
+    @sa SIFT::setGridBudget
+     */
+    CV_WRAP virtual void setGridBudget(Size gridSize, int maxPerCell) = 0;
+    CV_WRAP virtual Size getGridSize() const = 0;
+    CV_WRAP virtual int getMaxPerCell() const = 0;
 };
 
 /*
@@ -239,6 +248,35 @@ public:
      */
     virtual bool GetDescriptor( double y, double x, int orientation, float* descriptor, double* H ) const = 0;
 
+    /** @brief Use the scale space shared with other algorithms, the smoothed gradient layers are taken from
+    it, so repeated compute calls on the same image build them only once.
+    @sa ScaleSpace
+     */
+    CV_WRAP virtual void setScaleSpace(const Ptr<ScaleSpace>& scaleSpace) = 0;
+    CV_WRAP virtual Ptr<ScaleSpace> getScaleSpace() const = 0;
+
+    /** @brief Limit the memory taken by the smoothed gradient layers.
+
+    With a positive limit the keypoint and the dense compute process the image in full width row bands whose
+    layers fit into the given number of megabytes: only the bands around the keypoints (or the roi rows) are
+    computed, so sparse keypoints on large images do not need the layers of the whole image. The layers are not
+    kept after compute then, and GetDescriptor and GetUnnormalizedDescriptor raise an error. Banding is not
+    applied when a homography is set, interpolation is disabled or a shared scale space is used. 0 (default)
+    means no limit.
+
+    A band holds at least one described row plus the margin rows its layers need above and below (about 53
+    rows with the default parameters), that is (2*margin+1) * image width * q_hist * (q_radius+1) floats,
+    about 13.4 MB for a 1024 pixel wide image with the defaults. Compute raises an error when the limit is
+    below that minimum. Bands only a few rows high recompute their margins for every band, so limits well
+    above the minimum are faster.
+
+    @note The limit covers only the working layers. The dense compute still returns a descriptor for every
+    pixel of the roi, so its output matrix (roi area x descriptor size floats) is allocated in full and usually
+    dominates the peak memory of dense mode. The descriptors are computed and normalized band by band into it.
+     */
+    CV_WRAP virtual void setMemoryLimit(int megabytes) = 0;
+    CV_WRAP virtual int getMemoryLimit() const = 0;
+
     /**
      * @param y position y on image
      * @param x position x on image
@@ -44,6 +44,7 @@
 #define __OPENCV_XFEATURES2D_FEATURES_2D_HPP__
 
 #include "opencv2/features2d.hpp"
+#include "opencv2/xfeatures2d/scale_space.hpp"
 
 namespace cv
 {
@@ -75,10 +76,39 @@ public:
 
     @param sigma The sigma of the Gaussian applied to the input image at the octave \#0. If your image
     is captured with a weak camera with soft lenses, you might want to reduce the number.
+
+    @param descriptorType The type of descriptors, CV_32F or CV_8U. Descriptor elements are quantized to
+    [0, 255] range in both cases, so CV_8U descriptors are the same values stored in 4 times less memory.
+
+    @param rootSIFT Apply RootSIFT normalization @cite Arandjelovic12 : the descriptor is L1 normalized
+    and square rooted, so L2 distance between descriptors corresponds to the Hellinger kernel. The resulting
+    elements lie in [0, 1] and are scaled by 255 to fit the [0, 255] range.
      */
     CV_WRAP static Ptr<SIFT> create( int nfeatures = 0, int nOctaveLayers = 3,
                                     double contrastThreshold = 0.04, double edgeThreshold = 10,
-                                    double sigma = 1.6);
+                                    double sigma = 1.6, int descriptorType = CV_32F,
+                                    bool rootSIFT = false);
+
+    /** @brief Use the scale space shared with other algorithms, the Gaussian and DoG pyramids are taken from
+    it and only the missing octaves are computed.
+    @sa ScaleSpace
+     */
+    CV_WRAP virtual void setScaleSpace(const Ptr<ScaleSpace>& scaleSpace) = 0;
+    CV_WRAP virtual Ptr<ScaleSpace> getScaleSpace() const = 0;
+
+    /** @brief Spread the detected keypoints over the image.
+
+    The image is divided into a gridSize.width x gridSize.height grid and only the maxPerCell strongest
+    keypoints (by response) of every cell are kept, before the descriptors are computed. The budget is
+    applied after the nfeatures limit and does not affect keypoints passed in with useProvidedKeypoints.
+    The keypoints are first detected on the whole image, so the budget does not reduce the detection cost,
+    only the number of keypoints that are kept and described.
+    @param gridSize number of grid cells along x and y, both positive when the budget is enabled
+    @param maxPerCell maximum number of keypoints retained per cell, 0 (default) disables the budget
+     */
+    CV_WRAP virtual void setGridBudget(Size gridSize, int maxPerCell) = 0;
+    CV_WRAP virtual Size getGridSize() const = 0;
+    CV_WRAP virtual int getMaxPerCell() const = 0;
 };
 
 typedef SIFT SiftFeatureDetector;
@@ -143,6 +173,22 @@ public:
 
     CV_WRAP virtual void setUpright(bool upright) = 0;
     CV_WRAP virtual bool getUpright() const = 0;
+
+    /** @brief Use the scale space shared with other algorithms, the grayscale image and its integral are
+    taken from it.
+    @sa ScaleSpace
+     */
+    CV_WRAP virtual void setScaleSpace(const Ptr<ScaleSpace>& scaleSpace) = 0;
+    CV_WRAP virtual Ptr<ScaleSpace> getScaleSpace() const = 0;
+
+    /** @brief Keep only the maxPerCell strongest keypoints in every cell of a gridSize grid, before the
+    descriptors are computed. 0 (default) disables the budget. It is applied after the detection on the
+    whole image, so it does not reduce the detection cost.
+    @sa SIFT::setGridBudget
+     */
+    CV_WRAP virtual void setGridBudget(Size gridSize, int maxPerCell) = 0;
+    CV_WRAP virtual Size getGridSize() const = 0;
+    CV_WRAP virtual int getMaxPerCell() const = 0;
 };
 
 typedef SURF SurfFeatureDetector;
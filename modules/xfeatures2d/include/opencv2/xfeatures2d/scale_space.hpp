@@ -0,0 +1,88 @@
+/*
+By downloading, copying, installing or using the software you agree to this
+license. If you do not agree to this license, do not download, install,
+copy or use the software.
+
+                          License Agreement
+               For Open Source Computer Vision Library
+                       (3-clause BSD License)
+
+Copyright (C) 2013, OpenCV Foundation, all rights reserved.
+Third party copyrights are property of their respective owners.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+  * Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+
+  * Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  * Neither the names of the copyright holders nor the names of the contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+
+This software is provided by the copyright holders and contributors "as is" and
+any express or implied warranties, including, but not limited to, the implied
+warranties of merchantability and fitness for a particular purpose are
+disclaimed. In no event shall copyright holders or contributors be liable for
+any direct, indirect, incidental, special, exemplary, or consequential damages
+(including, but not limited to, procurement of substitute goods or services;
+loss of use, data, or profits; or business interruption) however caused
+and on any theory of liability, whether in contract, strict liability,
+or tort (including negligence or otherwise) arising in any way out of
+the use of this software, even if advised of the possibility of such damage.
+*/
+
+
+#ifndef __OPENCV_XFEATURES2D_SCALE_SPACE_HPP__
+#define __OPENCV_XFEATURES2D_SCALE_SPACE_HPP__
+
+#include "opencv2/core.hpp"
+
+namespace cv
+{
+namespace xfeatures2d
+{
+
+//! @addtogroup xfeatures2d
+//! @{
+
+/** @brief Intermediate image representations shared between feature detectors and descriptor extractors.
+
+The object keeps the data built for one image by SIFT (grayscale image, Gaussian and DoG pyramids), SURF
+(integral image) and DAISY (smoothed gradient layers). Attach the same object to several algorithms with
+their setScaleSpace methods and call setImage for every new frame. The data is computed lazily on the
+first request, and every algorithm computes only the parts which are missing, e.g. the pyramid octaves not
+built by the previous call. The data is reused by all subsequent detect, compute and detectAndCompute calls
+with an image equal to the one passed to setImage. For any other image the algorithms compute everything
+themselves.
+
+@note The object is not thread-safe, algorithms sharing it must not run concurrently.
+ */
+class CV_EXPORTS_W ScaleSpace : public Algorithm
+{
+public:
+    /** @brief Set the image and release the data computed for the previous one.
+
+    @param image 8-bit image. It is copied, and the algorithms use cached data only when they are called
+    with an image of the same size, type and content: every call compares the pixels with the copy, so a
+    buffer refilled with the next frame (e.g. by VideoCapture::read) without setImage is detected and
+    processed from scratch.
+     */
+    CV_WRAP virtual void setImage(InputArray image) = 0;
+
+    /** @brief Release the image and all cached data. */
+    CV_WRAP virtual void clear() = 0;
+
+    CV_WRAP static Ptr<ScaleSpace> create();
+};
+
+//! @}
+
+}
+}
+
+#endif
@@ -31,3 +31,23 @@ PERF_TEST_P(daisy, extract, testing::Values(DAISY_IMAGES))
 
     SANITY_CHECK(descriptors, 1e-4);
 }
+
+PERF_TEST_P(daisy, extract_keypoints_memory_limit, testing::Values(DAISY_IMAGES))
+{
+    string filename = getDataPath(GetParam());
+    Mat frame = imread(filename, IMREAD_GRAYSCALE);
+    ASSERT_FALSE(frame.empty()) << "Unable to load source image " << filename;
+
+    declare.in(frame);
+
+    vector<KeyPoint> points;
+    ORB::create(200)->detect(frame, points);
+
+    Ptr<DAISY> descriptor = DAISY::create();
+    descriptor->setMemoryLimit(64);
+
+    Mat descriptors;
+    TEST_CYCLE() descriptor->compute(frame, points, descriptors);
+
+    SANITY_CHECK_NOTHING();
+}
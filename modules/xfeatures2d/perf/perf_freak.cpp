@@ -0,0 +1,37 @@
+#include "perf_precomp.hpp"
+
+using namespace std;
+using namespace cv;
+using namespace cv::xfeatures2d;
+using namespace perf;
+using std::tr1::make_tuple;
+using std::tr1::get;
+
+typedef perf::TestBaseWithParam<std::string> freak;
+
+#define FREAK_IMAGES \
+    "cv/detectors_descriptors_evaluation/images_datasets/leuven/img1.png",\
+    "stitching/a3.png"
+
+PERF_TEST_P(freak, extract, testing::Values(FREAK_IMAGES))
+{
+    string filename = getDataPath(GetParam());
+    Mat frame = imread(filename, IMREAD_GRAYSCALE);
+    ASSERT_FALSE(frame.empty()) << "Unable to load source image " << filename;
+
+    declare.in(frame);
+
+    Ptr<ORB> detector = ORB::create(5000);
+    vector<KeyPoint> points;
+    detector->detect(frame, points);
+
+    Ptr<FREAK> descriptor = FREAK::create();
+    Mat descriptors;
+    TEST_CYCLE()
+    {
+        vector<KeyPoint> kp = points;
+        descriptor->compute(frame, kp, descriptors);
+    }
+
+    SANITY_CHECK_NOTHING();
+}
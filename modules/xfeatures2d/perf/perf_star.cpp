@@ -0,0 +1,63 @@
+#include "perf_precomp.hpp"
+
+using namespace std;
+using namespace cv;
+using namespace cv::xfeatures2d;
+using namespace perf;
+using std::tr1::make_tuple;
+using std::tr1::get;
+
+typedef perf::TestBaseWithParam<std::string> star;
+
+#define STAR_IMAGES \
+    "cv/detectors_descriptors_evaluation/images_datasets/leuven/img1.png",\
+    "stitching/a3.png"
+
+PERF_TEST_P(star, detect, testing::Values(STAR_IMAGES))
+{
+    string filename = getDataPath(GetParam());
+    Mat frame = imread(filename, IMREAD_GRAYSCALE);
+    ASSERT_FALSE(frame.empty()) << "Unable to load source image " << filename;
+
+    declare.in(frame);
+
+    Ptr<StarDetector> detector = StarDetector::create();
+    vector<KeyPoint> points;
+
+    TEST_CYCLE() detector->detect(frame, points);
+
+    SANITY_CHECK_NOTHING();
+}
+
+// the FAST and ORB detectors of features2d on the same images, for comparison
+PERF_TEST_P(star, detect_fast_reference, testing::Values(STAR_IMAGES))
+{
+    string filename = getDataPath(GetParam());
+    Mat frame = imread(filename, IMREAD_GRAYSCALE);
+    ASSERT_FALSE(frame.empty()) << "Unable to load source image " << filename;
+
+    declare.in(frame);
+
+    Ptr<FastFeatureDetector> detector = FastFeatureDetector::create();
+    vector<KeyPoint> points;
+
+    TEST_CYCLE() detector->detect(frame, points);
+
+    SANITY_CHECK_NOTHING();
+}
+
+PERF_TEST_P(star, detect_orb_reference, testing::Values(STAR_IMAGES))
+{
+    string filename = getDataPath(GetParam());
+    Mat frame = imread(filename, IMREAD_GRAYSCALE);
+    ASSERT_FALSE(frame.empty()) << "Unable to load source image " << filename;
+
+    declare.in(frame);
+
+    Ptr<ORB> detector = ORB::create();
+    vector<KeyPoint> points;
+
+    TEST_CYCLE() detector->detect(frame, points);
+
+    SANITY_CHECK_NOTHING();
+}
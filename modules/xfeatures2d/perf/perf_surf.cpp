@@ -65,3 +65,27 @@ PERF_TEST_P(surf, full, testing::Values(SURF_IMAGES))
     SANITY_CHECK_KEYPOINTS(points, 1e-3);
     SANITY_CHECK(descriptors, 1e-4);
 }
+
+PERF_TEST_P(surf, detect_compute_scale_space, testing::Values(SURF_IMAGES))
+{
+    string filename = getDataPath(GetParam());
+    Mat frame = imread(filename, IMREAD_GRAYSCALE);
+    ASSERT_FALSE(frame.empty()) << "Unable to load source image " << filename;
+
+    declare.in(frame).time(90);
+    Ptr<ScaleSpace> scaleSpace = ScaleSpace::create();
+    Ptr<SURF> detector = SURF::create();
+    detector->setScaleSpace(scaleSpace);
+    vector<KeyPoint> points;
+    vector<float> descriptors;
+
+    TEST_CYCLE()
+    {
+        // the integral image is computed by detect and reused by compute
+        scaleSpace->setImage(frame);
+        detector->detect(frame, points);
+        detector->compute(frame, points, descriptors);
+    }
+
+    SANITY_CHECK_NOTHING();
+}
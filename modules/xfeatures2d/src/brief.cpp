@@ -73,7 +73,7 @@ public:
     virtual void compute(InputArray image, std::vector<KeyPoint>& keypoints, OutputArray descriptors);
 
 protected:
-    typedef void(*PixelTestFn)(InputArray, const std::vector<KeyPoint>&, OutputArray, bool use_orientation );
+    typedef void(*PixelTestFn)(const Mat& sum, const std::vector<KeyPoint>& keypoints, Mat& descriptors, bool use_orientation, const Range& range);
 
     int bytes_;
     bool use_orientation_;
@@ -105,13 +105,12 @@ inline int smoothedSum(const Mat& sum, const KeyPoint& pt, int y, int x, bool us
            + sum.at<int>(img_y - HALF_KERNEL, img_x - HALF_KERNEL);
 }
 
-static void pixelTests16(InputArray _sum, const std::vector<KeyPoint>& keypoints, OutputArray _descriptors, bool use_orientation )
+static void pixelTests16(const Mat& sum, const std::vector<KeyPoint>& keypoints, Mat& descriptors, bool use_orientation, const Range& range)
 {
     Matx21f R;
-    Mat sum = _sum.getMat(), descriptors = _descriptors.getMat();
-    for (size_t i = 0; i < keypoints.size(); ++i)
+    for (int i = range.start; i < range.end; ++i)
     {
-        uchar* desc = descriptors.ptr(static_cast<int>(i));
+        uchar* desc = descriptors.ptr(i);
         const KeyPoint& pt = keypoints[i];
         if ( use_orientation )
         {
@@ -125,13 +124,12 @@ static void pixelTests16(InputArray _sum, const std::vector<KeyPoint>& keypoints
     }
 }
 
-static void pixelTests32(InputArray _sum, const std::vector<KeyPoint>& keypoints, OutputArray _descriptors, bool use_orientation)
+static void pixelTests32(const Mat& sum, const std::vector<KeyPoint>& keypoints, Mat& descriptors, bool use_orientation, const Range& range)
 {
     Matx21f R;
-    Mat sum = _sum.getMat(), descriptors = _descriptors.getMat();
-    for (size_t i = 0; i < keypoints.size(); ++i)
+    for (int i = range.start; i < range.end; ++i)
     {
-        uchar* desc = descriptors.ptr(static_cast<int>(i));
+        uchar* desc = descriptors.ptr(i);
         const KeyPoint& pt = keypoints[i];
         if ( use_orientation )
         {
@@ -145,13 +143,12 @@ static void pixelTests32(InputArray _sum, const std::vector<KeyPoint>& keypoints
     }
 }
 
-static void pixelTests64(InputArray _sum, const std::vector<KeyPoint>& keypoints, OutputArray _descriptors, bool use_orientation)
+static void pixelTests64(const Mat& sum, const std::vector<KeyPoint>& keypoints, Mat& descriptors, bool use_orientation, const Range& range)
 {
     Matx21f R;
-    Mat sum = _sum.getMat(), descriptors = _descriptors.getMat();
-    for (size_t i = 0; i < keypoints.size(); ++i)
+    for (int i = range.start; i < range.end; ++i)
     {
-        uchar* desc = descriptors.ptr(static_cast<int>(i));
+        uchar* desc = descriptors.ptr(i);
         const KeyPoint& pt = keypoints[i];
         if ( use_orientation )
         {
@@ -165,6 +162,29 @@ static void pixelTests64(InputArray _sum, const std::vector<KeyPoint>& keypoints
     }
 }
 
+class BriefInvoker : public ParallelLoopBody
+{
+public:
+    typedef void(*PixelTestFn)(const Mat&, const std::vector<KeyPoint>&, Mat&, bool, const Range&);
+
+    BriefInvoker(const Mat& _sum, const std::vector<KeyPoint>& _keypoints, Mat& _descriptors, bool _use_orientation, PixelTestFn _test_fn)
+        : sum(_sum), keypoints(_keypoints), descriptors(_descriptors), use_orientation(_use_orientation), test_fn(_test_fn)
+    {
+    }
+
+    void operator()(const Range& range) const
+    {
+        test_fn(sum, keypoints, descriptors, use_orientation, range);
+    }
+
+private:
+    const Mat& sum;
+    const std::vector<KeyPoint>& keypoints;
+    Mat& descriptors;
+    bool use_orientation;
+    PixelTestFn test_fn;
+};
+
 BriefDescriptorExtractorImpl::BriefDescriptorExtractorImpl(int bytes, bool use_orientation) :
     bytes_(bytes), test_fn_(NULL)
 {
@@ -248,7 +268,10 @@ void BriefDescriptorExtractorImpl::compute(InputArray image,
 
     descriptors.create((int)keypoints.size(), bytes_, CV_8U);
     descriptors.setTo(Scalar::all(0));
-    test_fn_(sum, keypoints, descriptors, use_orientation_);
+
+    Mat descriptorsMat = descriptors.getMat();
+    parallel_for_(Range(0, (int)keypoints.size()),
+                  BriefInvoker(sum, keypoints, descriptorsMat, use_orientation_, test_fn_));
 }
 
 }
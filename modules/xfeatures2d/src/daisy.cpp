@@ -49,7 +49,9 @@
  */
 
 #include "precomp.hpp"
+#include "scale_space.hpp"
 
+#include <algorithm>
 #include <fstream>
 #include <stdlib.h>
 
@@ -169,6 +171,14 @@ public:
      */
     virtual bool GetUnnormalizedDescriptor( double y, double x, int orientation, float* descriptor, double* H ) const;
 
+    virtual void setScaleSpace( const Ptr<ScaleSpace>& scaleSpace ) { m_scale_space = scaleSpace; }
+
+    virtual Ptr<ScaleSpace> getScaleSpace() const { return m_scale_space; }
+
+    virtual void setMemoryLimit( int megabytes ) { CV_Assert( megabytes >= 0 ); m_memory_limit = megabytes; }
+
+    virtual int getMemoryLimit() const { return m_memory_limit; }
+
 protected:
 
     /*
@@ -255,6 +265,15 @@ protected:
     // holds the amount of shift that's required for histogram computation
     double m_orientation_shift_table[360];
 
+    // optional scale space shared with other algorithms
+    Ptr<ScaleSpace> m_scale_space;
+
+    // cache of the shared scale space valid for the current image, or NULL
+    ScaleSpaceImpl* m_cache;
+
+    // memory limit of the smoothed gradient layers in megabytes, 0 for no limit
+    int m_memory_limit;
+
 
 private:
 
@@ -262,8 +281,8 @@ private:
      * DAISY functions
      */
 
-    // initializes the class: computes gradient and structure-points
-    inline void initialize();
+    // initializes the class: computes gradient and structure-points of image
+    inline void initialize( const Mat& image );
 
     // initializes for get_descriptor(double, double, int) mode: pre-computes
     // convolutions of gradient layers in m_smoothed_gradient_layers
@@ -318,10 +337,25 @@ private:
     inline void compute_oriented_grid_points();
 
     // applies one of the normalizations (partial,full,sift) to the desciptors.
-    inline void normalize_descriptors( Mat* m_dense_descriptors );
+    inline void normalize_descriptors( Mat* m_dense_descriptors, const Range& range );
 
     inline void update_selected_cubes();
 
+    // true if the layers can be computed band by band without changing the descriptors
+    inline bool use_bands() const;
+
+    // rows above and below a band needed for exact layers inside of it
+    inline int band_margin() const;
+
+    // number of described rows per band fitting into the memory limit
+    inline int band_rows( int margin ) const;
+
+    // computes the smoothed gradient layers of the image rows [y0, y1)
+    inline void compute_band_layers( int y0, int y1 );
+
+    // the single descriptor accessors need the layers of the whole image
+    inline void check_layers() const;
+
 }; // END DAISY_Impl CLASS
 
 
@@ -927,6 +961,7 @@ static bool get_descriptor_h( const double y, const double x, const int orientat
 
 void DAISY_Impl::GetDescriptor( double y, double x, int orientation, float* descriptor ) const
 {
+    check_layers();
     get_descriptor( y, x, orientation, descriptor, &m_smoothed_gradient_layers,
                     &m_oriented_grid_points, m_orientation_shift_table, m_th_q_no,
                     m_hist_th_q_no, m_grid_point_number, m_descriptor_size, m_enable_interpolation,
@@ -935,6 +970,7 @@ void DAISY_Impl::GetDescriptor( double y, double x, int orientation, float* desc
 
 bool DAISY_Impl::GetDescriptor( double y, double x, int orientation, float* descriptor, double* H ) const
 {
+  check_layers();
   return
   get_descriptor_h( y, x, orientation, descriptor, H, &m_smoothed_gradient_layers,
                     m_cube_sigmas, &m_grid_points, m_orientation_shift_table, m_th_q_no,
@@ -944,6 +980,7 @@ bool DAISY_Impl::GetDescriptor( double y, double x, int orientation, float* desc
 
 void DAISY_Impl::GetUnnormalizedDescriptor( double y, double x, int orientation, float* descriptor ) const
 {
+    check_layers();
     get_unnormalized_descriptor( y, x, orientation, descriptor, &m_smoothed_gradient_layers,
                                  &m_oriented_grid_points, m_orientation_shift_table, m_th_q_no,
                                  m_enable_interpolation );
@@ -951,6 +988,7 @@ void DAISY_Impl::GetUnnormalizedDescriptor( double y, double x, int orientation,
 
 bool DAISY_Impl::GetUnnormalizedDescriptor( double y, double x, int orientation, float* descriptor, double* H ) const
 {
+  check_layers();
   return
   get_unnormalized_descriptor_h( y, x, orientation, descriptor, H, &m_smoothed_gradient_layers,
                                  m_cube_sigmas, &m_grid_points, m_orientation_shift_table, m_th_q_no,
@@ -986,14 +1024,15 @@ inline void DAISY_Impl::compute_grid_points()
 
 struct ComputeDescriptorsInvoker : ParallelLoopBody
 {
-    ComputeDescriptorsInvoker( Mat* _descriptors, Mat* _image, Rect* _roi,
+    ComputeDescriptorsInvoker( Mat* _descriptors, Rect* _roi, int _layers_y_off,
                                std::vector<Mat>* _layers, Mat* _orientation_map,
                                Mat* _oriented_grid_points, double* _orientation_shift_table,
                                int _th_q_no, bool _enable_interpolation )
     {
       x_off = _roi->x;
       x_end = _roi->x + _roi->width;
-      image = _image;
+      y_off = _roi->y;
+      layers_y_off = _layers_y_off;
       layers = _layers;
       th_q_no = _th_q_no;
       descriptors = _descriptors;
@@ -1010,13 +1049,13 @@ struct ComputeDescriptorsInvoker : ParallelLoopBody
       {
         for( int x = x_off; x < x_end; x++ )
         {
-          index = y*image->cols + x;
+          index = (y - y_off)*(x_end - x_off) + (x - x_off);
           orientation = 0;
           if( !orientation_map->empty() )
               orientation = (int) orientation_map->at<ushort>( y, x );
           if( !( orientation >= 0 && orientation < g_grid_orientation_resolution ) )
               orientation = 0;
-          get_unnormalized_descriptor( y, x, orientation, descriptors->ptr<float>( index ),
+          get_unnormalized_descriptor( y - layers_y_off, x, orientation, descriptors->ptr<float>( index ),
                                        layers, oriented_grid_points, orientation_shift_table,
                                        th_q_no, enable_interpolation );
         }
@@ -1024,13 +1063,14 @@ struct ComputeDescriptorsInvoker : ParallelLoopBody
     }
 
     int th_q_no;
-    int x_off, x_end;
+    int x_off, x_end, y_off;
+    int layers_y_off;
     std::vector<Mat>* layers;
     Mat *descriptors;
     Mat *orientation_map;
     bool enable_interpolation;
     double* orientation_shift_table;
-    Mat *image, *oriented_grid_points;
+    Mat *oriented_grid_points;
 };
 
 // Computes the descriptor by sampling convoluted orientation maps.
@@ -1042,16 +1082,110 @@ inline void DAISY_Impl::compute_descriptors( Mat* m_dense_descriptors )
     if( m_scale_invariant    ) compute_scales();
     if( m_rotation_invariant ) compute_orientations();
 
+    if( use_bands() )
+    {
+        // stream the roi band by band, only the layers of the current band are alive and the
+        // descriptors of the band are finished (normalized) while they are still in cache
+        int margin = band_margin();
+        int rows = band_rows( margin );
+        for( int y = y_off; y < y_end; y += rows )
+        {
+          int band_end = std::min( y + rows, y_end );
+          int layers_y_off = std::max( y - margin, 0 );
+          compute_band_layers( layers_y_off, std::min( band_end + margin, m_image.rows ) );
+
+          Range band( (y - y_off) * m_roi.width, (band_end - y_off) * m_roi.width );
+          m_dense_descriptors->rowRange( band ).setTo( Scalar(0) );
+          parallel_for_( Range(y, band_end),
+              ComputeDescriptorsInvoker( m_dense_descriptors, &m_roi, layers_y_off, &m_smoothed_gradient_layers,
+                                         &m_orientation_map, &m_oriented_grid_points, m_orientation_shift_table,
+                                         m_th_q_no, m_enable_interpolation )
+          );
+          normalize_descriptors( m_dense_descriptors, band );
+        }
+        m_smoothed_gradient_layers.clear();
+        return;
+    }
+
     m_dense_descriptors->setTo( Scalar(0) );
 
+    initialize_single_descriptor_mode();
+
     parallel_for_( Range(y_off, y_end),
-        ComputeDescriptorsInvoker( m_dense_descriptors, &m_image, &m_roi, &m_smoothed_gradient_layers,
+        ComputeDescriptorsInvoker( m_dense_descriptors, &m_roi, 0, &m_smoothed_gradient_layers,
                                    &m_orientation_map, &m_oriented_grid_points, m_orientation_shift_table,
                                    m_th_q_no, m_enable_interpolation )
     );
 
+    normalize_descriptors( m_dense_descriptors, Range(0, m_roi.width * m_roi.height) );
 }
 
+struct ComputeKeypointDescriptorsInvoker : ParallelLoopBody
+{
+    ComputeKeypointDescriptorsInvoker( Mat* _descriptors, const std::vector<KeyPoint>* _keypoints,
+                                       const int* _indices, int _layers_y_off, double* _H,
+                                       std::vector<Mat>* _layers, Mat* _cube_sigmas, Mat* _grid_points,
+                                       Mat* _oriented_grid_points, double* _orientation_shift_table,
+                                       int _th_q_no, int _hist_th_q_no, int _grid_point_number,
+                                       int _descriptor_size, bool _enable_interpolation, int _nrm_type,
+                                       bool _use_orientation )
+    {
+      descriptors = _descriptors;
+      keypoints = _keypoints;
+      indices = _indices;
+      layers_y_off = _layers_y_off;
+      H = _H;
+      layers = _layers;
+      cube_sigmas = _cube_sigmas;
+      grid_points = _grid_points;
+      oriented_grid_points = _oriented_grid_points;
+      orientation_shift_table = _orientation_shift_table;
+      th_q_no = _th_q_no;
+      hist_th_q_no = _hist_th_q_no;
+      grid_point_number = _grid_point_number;
+      descriptor_size = _descriptor_size;
+      enable_interpolation = _enable_interpolation;
+      nrm_type = _nrm_type;
+      use_orientation = _use_orientation;
+    }
+
+    void operator ()(const cv::Range& range) const
+    {
+      for (int i = range.start; i < range.end; ++i)
+      {
+        int k = indices ? indices[i] : i;
+        const KeyPoint& kp = keypoints->at(k);
+        int orientation = use_orientation ? (int) kp.angle : 0;
+
+        if( !H )
+          get_descriptor( kp.pt.y - layers_y_off, kp.pt.x, orientation,
+                          descriptors->ptr<float>( k ), layers,
+                          oriented_grid_points, orientation_shift_table, th_q_no,
+                          hist_th_q_no, grid_point_number, descriptor_size, enable_interpolation,
+                          nrm_type );
+        else
+          get_descriptor_h( kp.pt.y, kp.pt.x, orientation,
+                            descriptors->ptr<float>( k ), H, layers,
+                            *cube_sigmas, grid_points, orientation_shift_table, th_q_no,
+                            hist_th_q_no, grid_point_number, descriptor_size, enable_interpolation,
+                            nrm_type );
+      }
+    }
+
+    Mat *descriptors;
+    const std::vector<KeyPoint>* keypoints;
+    const int* indices;
+    int layers_y_off;
+    double* H;
+    std::vector<Mat>* layers;
+    Mat *cube_sigmas, *grid_points, *oriented_grid_points;
+    double* orientation_shift_table;
+    int th_q_no, hist_th_q_no, grid_point_number, descriptor_size;
+    bool enable_interpolation;
+    int nrm_type;
+    bool use_orientation;
+};
+
 struct NormalizeDescriptorsInvoker : ParallelLoopBody
 {
     NormalizeDescriptorsInvoker( Mat* _descriptors, int _nrm_type, int _grid_point_number,
@@ -1080,31 +1214,31 @@ struct NormalizeDescriptorsInvoker : ParallelLoopBody
     int descriptor_size;
 };
 
-inline void DAISY_Impl::normalize_descriptors( Mat* m_dense_descriptors )
+inline void DAISY_Impl::normalize_descriptors( Mat* m_dense_descriptors, const Range& range )
 {
     CV_Assert( !m_dense_descriptors->empty() );
-    int number_of_descriptors =  m_roi.width * m_roi.height;
 
-    parallel_for_( Range(0, number_of_descriptors),
+    parallel_for_( range,
         NormalizeDescriptorsInvoker( m_dense_descriptors, m_nrm_type, m_grid_point_number, m_hist_th_q_no, m_descriptor_size )
     );
 }
 
-inline void DAISY_Impl::initialize()
+inline void DAISY_Impl::initialize( const Mat& image )
 {
     // no image ?
-    CV_Assert(m_image.rows != 0);
-    CV_Assert(m_image.cols != 0);
+    CV_Assert(image.rows != 0);
+    CV_Assert(image.cols != 0);
 
     // (m_rad_q_no + 1) matrices
     // 3 dims matrix (idhist, img_y, img_x);
     m_smoothed_gradient_layers.resize( m_rad_q_no + 1 );
 
-    int dims[3] = { m_hist_th_q_no, m_image.rows, m_image.cols };
+    int dims[3] = { m_hist_th_q_no, image.rows, image.cols };
     for ( int c=0; c<=m_rad_q_no; c++)
       m_smoothed_gradient_layers[c] = Mat( 3, dims, CV_32F );
 
-    layered_gradient( m_image, &m_smoothed_gradient_layers[0] );
+    Mat data = image;
+    layered_gradient( data, &m_smoothed_gradient_layers[0] );
 
     // assuming a 0.5 image smoothness, we pull this to 1.6 as in sift
     smooth_layers( &m_smoothed_gradient_layers[0], (float)sqrt(g_sigma_init*g_sigma_init-0.25f) );
@@ -1172,7 +1306,7 @@ inline void DAISY_Impl::compute_histograms()
 {
     for( int r=0; r<m_rad_q_no; r++ )
     {
-      parallel_for_( Range(0, m_image.rows), ComputeHistogramsInvoker( &m_smoothed_gradient_layers, r ) );
+      parallel_for_( Range(0, m_smoothed_gradient_layers[r].size[1]), ComputeHistogramsInvoker( &m_smoothed_gradient_layers, r ) );
     }
 }
 
@@ -1189,11 +1323,13 @@ inline void DAISY_Impl::compute_smoothed_gradient_layers()
                     - m_cube_sigmas.at<double>(r-1) * m_cube_sigmas.at<double>(r-1) );
 
       int ks = filter_size( sigma, 5.0f );
+      int rows = m_smoothed_gradient_layers[r].size[1];
+      int cols = m_smoothed_gradient_layers[r].size[2];
 
       for( int th=0; th<m_hist_th_q_no; th++ )
       {
-        Mat cvI( m_image.rows, m_image.cols, CV_32F, m_smoothed_gradient_layers[r  ].ptr<float>(th,0,0) );
-        Mat cvO( m_image.rows, m_image.cols, CV_32F, m_smoothed_gradient_layers[r+1].ptr<float>(th,0,0) );
+        Mat cvI( rows, cols, CV_32F, m_smoothed_gradient_layers[r  ].ptr<float>(th,0,0) );
+        Mat cvO( rows, cols, CV_32F, m_smoothed_gradient_layers[r+1].ptr<float>(th,0,0) );
         GaussianBlur( cvI, cvO, Size(ks, ks), sigma, sigma, BORDER_REPLICATE );
       }
     }
@@ -1417,7 +1553,73 @@ inline void DAISY_Impl::compute_orientations()
 
 inline void DAISY_Impl::initialize_single_descriptor_mode( )
 {
-    initialize();
+    ScaleSpaceImpl::GradientLayers* cached = NULL;
+    if( m_cache )
+    {
+        cached = &m_cache->getGradientLayers( m_rad, m_rad_q_no, m_hist_th_q_no );
+        // layers are read only after initialization, so they are shared without copying
+        if( !cached->layers.empty() )
+        {
+            m_smoothed_gradient_layers = cached->layers;
+            return;
+        }
+    }
+
+    initialize( m_image );
+    compute_smoothed_gradient_layers();
+
+    if( cached )
+        cached->layers = m_smoothed_gradient_layers;
+}
+
+inline bool DAISY_Impl::use_bands() const
+{
+    // the non interpolated histograms are addressed across the whole layer, and
+    // warped grids may sample anywhere in the image
+    return m_memory_limit > 0 && m_enable_interpolation && m_h_matrix.empty() && !m_cache;
+}
+
+inline int DAISY_Impl::band_margin() const
+{
+    // support of the gradient (5x5 blur + sobel) and of the initial smoothing
+    int margin = 3 + filter_size( sqrt(g_sigma_init*g_sigma_init-0.25f), 5.0f ) / 2;
+
+    // support of the incremental smoothing of the cubes
+    for( int r=0; r<m_rad_q_no; r++ )
+    {
+      double sigma = r == 0 ? m_cube_sigmas.at<double>(0)
+                            : sqrt( m_cube_sigmas.at<double>(r  ) * m_cube_sigmas.at<double>(r  )
+                                  - m_cube_sigmas.at<double>(r-1) * m_cube_sigmas.at<double>(r-1) );
+      margin += filter_size( sigma, 5.0f ) / 2;
+    }
+
+    // grid radius, bilinear neighbours and histograms running into the next row
+    return margin + cvCeil( m_rad ) + 3;
+}
+
+inline int DAISY_Impl::band_rows( int margin ) const
+{
+    double row_bytes = (double)m_image.cols * m_hist_th_q_no * (m_rad_q_no + 1) * sizeof(float);
+    int rows = (int)( m_memory_limit * 1024.0 * 1024.0 / row_bytes ) - 2 * margin;
+    // a single described row still needs its margins, a smaller limit can't be honoured
+    if( rows < 1 )
+        CV_Error( Error::StsOutOfRange,
+                  format( "DAISY memory limit of %d MB is below the %d MB needed by a band of this image",
+                          m_memory_limit, cvCeil( (2 * margin + 1) * row_bytes / (1024.0 * 1024.0) ) ) );
+    return rows;
+}
+
+inline void DAISY_Impl::check_layers() const
+{
+    if( m_smoothed_gradient_layers.empty() )
+        CV_Error( Error::StsError, "DAISY layers are not available: call compute() first, "
+                                   "they are not kept when a memory limit is set" );
+}
+
+inline void DAISY_Impl::compute_band_layers( int y0, int y1 )
+{
+    // the band is processed as a standalone image, the margin absorbs its borders
+    initialize( m_image.rowRange( y0, y1 ).clone() );
     compute_smoothed_gradient_layers();
 }
 
@@ -1446,8 +1648,15 @@ inline void DAISY_Impl::set_image( InputArray _image )
     Mat image = _image.getMat();
     // image cannot be empty
     CV_Assert( ! image.empty() );
+    m_cache = ScaleSpaceImpl::get( m_scale_space, _image );
+    // reuse grayscale image of the shared scale space
+    if ( m_cache ) {
+
+      m_cache->getGray().convertTo( m_image, CV_32F );
+      m_image /= 255.0f;
+    }
     // clone image for conversion
-    if ( image.depth() != CV_32F ) {
+    else if ( image.depth() != CV_32F ) {
 
       m_image = image.clone();
       // convert to gray inplace
@@ -1487,8 +1696,6 @@ void DAISY_Impl::compute( InputArray _image, std::vector<KeyPoint>& keypoints, O
 
     set_parameters();
 
-    initialize_single_descriptor_mode();
-
     // allocate array
     _descriptors.create( (int) keypoints.size(), m_descriptor_size, CV_32F );
 
@@ -1496,29 +1703,60 @@ void DAISY_Impl::compute( InputArray _image, std::vector<KeyPoint>& keypoints, O
     Mat descriptors = _descriptors.getMat();
     descriptors.setTo( Scalar(0) );
 
-    // iterate over keypoints
-    // and fill computed descriptors
-    if ( H.empty() )
-      for (int k = 0; k < (int) keypoints.size(); k++)
-      {
-          get_descriptor( keypoints[k].pt.y, keypoints[k].pt.x,
-                          m_use_orientation ? (int) keypoints[k].angle : 0,
-                          &descriptors.at<float>( k, 0 ), &m_smoothed_gradient_layers,
-                          &m_oriented_grid_points, m_orientation_shift_table, m_th_q_no,
-                          m_hist_th_q_no, m_grid_point_number, m_descriptor_size, m_enable_interpolation,
-                          m_nrm_type );
-      }
-    else
+    if( use_bands() && !keypoints.empty() )
+    {
+      // sort the keypoints by rows and describe them band by band, a new band is started when the
+      // current one gets over the memory limit or the next keypoint is too far to share the margin
+      std::vector<std::pair<int, int> > rows( keypoints.size() );
       for (int k = 0; k < (int) keypoints.size(); k++)
+          rows[k] = std::make_pair( cvFloor( keypoints[k].pt.y ), k );
+      std::sort( rows.begin(), rows.end() );
+
+      std::vector<int> indices( keypoints.size() );
+      for (size_t k = 0; k < rows.size(); k++)
+          indices[k] = rows[k].second;
+
+      int margin = band_margin();
+      int max_rows = band_rows( margin );
+      size_t first = 0;
+      while( first < rows.size() )
       {
-        get_descriptor_h( keypoints[k].pt.y, keypoints[k].pt.x,
-                          m_use_orientation ? (int) keypoints[k].angle : 0,
-                          &descriptors.at<float>( k, 0 ), &H.at<double>( 0 ), &m_smoothed_gradient_layers,
-                          m_cube_sigmas, &m_grid_points, m_orientation_shift_table, m_th_q_no,
-                          m_hist_th_q_no, m_grid_point_number, m_descriptor_size, m_enable_interpolation,
-                          m_nrm_type );
+        size_t last = first + 1;
+        while( last < rows.size() && rows[last].first - rows[first].first < max_rows
+               && rows[last].first - rows[last-1].first <= 2 * margin )
+            last++;
+
+        int y0 = std::max( rows[first].first - margin, 0 );
+        int y1 = std::min( rows[last-1].first + margin + 1, m_image.rows );
+        compute_band_layers( y0, std::max( y1, y0 + 1 ) );
+
+        parallel_for_( Range( (int)first, (int)last ),
+            ComputeKeypointDescriptorsInvoker( &descriptors, &keypoints, &indices[0], y0, NULL,
+                                               &m_smoothed_gradient_layers, &m_cube_sigmas, &m_grid_points,
+                                               &m_oriented_grid_points, m_orientation_shift_table,
+                                               m_th_q_no, m_hist_th_q_no, m_grid_point_number,
+                                               m_descriptor_size, m_enable_interpolation, m_nrm_type,
+                                               m_use_orientation )
+        );
+        first = last;
       }
+      m_smoothed_gradient_layers.clear();
+      return;
+    }
+
+    initialize_single_descriptor_mode();
 
+    // iterate over keypoints
+    // and fill computed descriptors
+    parallel_for_( Range( 0, (int) keypoints.size() ),
+        ComputeKeypointDescriptorsInvoker( &descriptors, &keypoints, NULL, 0,
+                                           H.empty() ? NULL : &H.at<double>( 0 ),
+                                           &m_smoothed_gradient_layers, &m_cube_sigmas, &m_grid_points,
+                                           &m_oriented_grid_points, m_orientation_shift_table,
+                                           m_th_q_no, m_hist_th_q_no, m_grid_point_number,
+                                           m_descriptor_size, m_enable_interpolation, m_nrm_type,
+                                           m_use_orientation )
+    );
 }
 
 // full scope with roi
@@ -1536,15 +1774,13 @@ void DAISY_Impl::compute( InputArray _image, Rect roi, OutputArray _descriptors
     m_roi = roi;
 
     set_parameters();
-    initialize_single_descriptor_mode();
 
     _descriptors.create( m_roi.width*m_roi.height, m_descriptor_size, CV_32F );
 
     Mat descriptors = _descriptors.getMat();
 
-    // compute full desc
+    // compute full normalized desc
     compute_descriptors( &descriptors );
-    normalize_descriptors( &descriptors );
 }
 
 // full scope
@@ -1563,15 +1799,13 @@ void DAISY_Impl::compute( InputArray _image, OutputArray _descriptors )
     m_roi = Rect( 0, 0, m_image.cols, m_image.rows );
 
     set_parameters();
-    initialize_single_descriptor_mode();
 
     _descriptors.create( m_roi.width*m_roi.height, m_descriptor_size, CV_32F );
 
     Mat descriptors = _descriptors.getMat();
 
-    // compute full desc
+    // compute full normalized desc
     compute_descriptors( &descriptors );
-    normalize_descriptors( &descriptors );
 }
 
 // constructor
@@ -1583,6 +1817,8 @@ DAISY_Impl::DAISY_Impl( float _radius, int _q_radius, int _q_theta, int _q_hist,
 
     m_descriptor_size = 0;
     m_grid_point_number = 0;
+    m_cache = NULL;
+    m_memory_limit = 0;
 
     m_scale_invariant = false;
     m_rotation_invariant = false;
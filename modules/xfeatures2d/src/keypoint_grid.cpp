@@ -0,0 +1,145 @@
+/*
+By downloading, copying, installing or using the software you agree to this
+license. If you do not agree to this license, do not download, install,
+copy or use the software.
+
+                          License Agreement
+               For Open Source Computer Vision Library
+                       (3-clause BSD License)
+
+Copyright (C) 2013, OpenCV Foundation, all rights reserved.
+Third party copyrights are property of their respective owners.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+  * Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+
+  * Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  * Neither the names of the copyright holders nor the names of the contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+
+This software is provided by the copyright holders and contributors "as is" and
+any express or implied warranties, including, but not limited to, the implied
+warranties of merchantability and fitness for a particular purpose are
+disclaimed. In no event shall copyright holders or contributors be liable for
+any direct, indirect, incidental, special, exemplary, or consequential damages
+(including, but not limited to, procurement of substitute goods or services;
+loss of use, data, or profits; or business interruption) however caused
+and on any theory of liability, whether in contract, strict liability,
+or tort (including negligence or otherwise) arising in any way out of
+the use of this software, even if advised of the possibility of such damage.
+*/
+
+
+#include "precomp.hpp"
+#include "keypoint_grid.hpp"
+
+#include <algorithm>
+
+namespace cv
+{
+namespace xfeatures2d
+{
+
+// orders keypoint indices by decreasing response, ties by position in the input
+struct KeypointResponseGreater
+{
+    KeypointResponseGreater( const std::vector<KeyPoint>& _keypoints ) : keypoints(&_keypoints) {}
+
+    bool operator()( int a, int b ) const
+    {
+        float ra = (*keypoints)[a].response, rb = (*keypoints)[b].response;
+        return ra > rb || (ra == rb && a < b);
+    }
+
+    const std::vector<KeyPoint>* keypoints;
+};
+
+class GridCellRetentionInvoker : public ParallelLoopBody
+{
+public:
+    GridCellRetentionInvoker( const std::vector<KeyPoint>& _keypoints, std::vector<int>& _indices,
+                              const std::vector<int>& _cellStart, std::vector<uchar>& _keep, int _maxPerCell )
+        : keypoints(_keypoints), indices(_indices), cellStart(_cellStart), keep(_keep), maxPerCell(_maxPerCell)
+    {
+    }
+
+    void operator()( const Range& range ) const
+    {
+        for( int cell = range.start; cell < range.end; cell++ )
+        {
+            int* first = &indices[0] + cellStart[cell];
+            int* last = &indices[0] + cellStart[cell + 1];
+            int* nth = last;
+
+            if( last - first > maxPerCell )
+            {
+                nth = first + maxPerCell;
+                std::nth_element( first, nth, last, KeypointResponseGreater(keypoints) );
+            }
+
+            for( int* i = first; i < nth; i++ )
+                keep[*i] = 1;
+        }
+    }
+
+private:
+    const std::vector<KeyPoint>& keypoints;
+    std::vector<int>& indices;
+    const std::vector<int>& cellStart;
+    std::vector<uchar>& keep;
+    int maxPerCell;
+};
+
+void checkGridBudget( Size gridSize, int maxPerCell )
+{
+    CV_Assert( gridSize.width >= 0 && gridSize.height >= 0 && maxPerCell >= 0 );
+    CV_Assert( maxPerCell == 0 || gridSize.area() > 0 );
+}
+
+void retainBestPerGridCell( std::vector<KeyPoint>& keypoints, Size imageSize, Size gridSize, int maxPerCell )
+{
+    if( maxPerCell <= 0 || keypoints.empty() )
+        return;
+
+    CV_Assert( gridSize.width > 0 && gridSize.height > 0 && imageSize.width > 0 && imageSize.height > 0 );
+
+    int nkeypoints = (int)keypoints.size();
+    int ncells = gridSize.area();
+    float cellScaleX = (float)gridSize.width / imageSize.width;
+    float cellScaleY = (float)gridSize.height / imageSize.height;
+
+    // bucket the keypoint indices by cell with a counting sort
+    std::vector<int> cells( nkeypoints ), cellStart( ncells + 1, 0 );
+    for( int i = 0; i < nkeypoints; i++ )
+    {
+        int cx = std::min( std::max( cvFloor( keypoints[i].pt.x * cellScaleX ), 0 ), gridSize.width - 1 );
+        int cy = std::min( std::max( cvFloor( keypoints[i].pt.y * cellScaleY ), 0 ), gridSize.height - 1 );
+        cells[i] = cy * gridSize.width + cx;
+        cellStart[cells[i] + 1]++;
+    }
+    for( int cell = 0; cell < ncells; cell++ )
+        cellStart[cell + 1] += cellStart[cell];
+
+    std::vector<int> indices( nkeypoints ), cellPos( cellStart.begin(), cellStart.end() - 1 );
+    for( int i = 0; i < nkeypoints; i++ )
+        indices[cellPos[cells[i]]++] = i;
+
+    std::vector<uchar> keep( nkeypoints, 0 );
+    parallel_for_( Range(0, ncells), GridCellRetentionInvoker( keypoints, indices, cellStart, keep, maxPerCell ) );
+
+    int nkept = 0;
+    for( int i = 0; i < nkeypoints; i++ )
+        if( keep[i] )
+            keypoints[nkept++] = keypoints[i];
+    keypoints.resize( nkept );
+}
+
+}
+}
@@ -44,6 +44,7 @@
 //M*/
 
 #include "precomp.hpp"
+#include "opencv2/hal/intrin.hpp"
 #include <algorithm>
 #include <vector>
 
@@ -90,315 +91,173 @@ namespace cv
         {
             return makePtr<LATCHDescriptorExtractorImpl>(bytes, rotationInvariance, half_ssd_size);
         }
-        void CalcuateSums(int count, const std::vector<int> &points, bool rotationInvariance, const Mat &grayImage, const KeyPoint &pt, int &suma, int &sumc, float cos_theta, float sin_theta, int half_ssd_size);
-
-
-        static void pixelTests1(const Mat& grayImage, const std::vector<KeyPoint>& keypoints, OutputArray _descriptors, const std::vector<int> &points, bool rotationInvariance, int half_ssd_size)
+        // Converts the sampling triplets to offsets of the patch top-left corners relative to the keypoint,
+        // rotated by the keypoint orientation if cos_theta/sin_theta are given
+        static void computeTripletOffsets(const std::vector<int> &points, int nTests, bool rotate, float cos_theta, float sin_theta,
+                                          int half_ssd_size, int step, int* offsets)
         {
-            Mat descriptors = _descriptors.getMat();
-            for (int i = 0; i < (int)keypoints.size(); ++i)
+            for (int t = 0; t < nTests; t++)
             {
-                uchar* desc = descriptors.ptr(i);
-                const KeyPoint& pt = keypoints[i];
-                int count = 0;
-
-                //handling keypoint orientation
-                float angle = pt.angle;
-                angle *= (float)(CV_PI / 180.f);
-                float cos_theta = cos(angle);
-                float sin_theta = sin(angle);
-                for (int ix = 0; ix < 1; ix++){
-                    desc[ix] = 0;
-                    for (int j = 7; j >= 0; j--){
-
-                        int suma = 0;
-                        int sumc = 0;
+                for (int k = 0; k < 3; k++)
+                {
+                    int x = points[t * 6 + k * 2];
+                    int y = points[t * 6 + k * 2 + 1];
 
-                        CalcuateSums(count, points, rotationInvariance, grayImage, pt, suma, sumc, cos_theta, sin_theta, half_ssd_size);
-                        desc[ix] += (uchar)((suma < sumc) << j);
+                    if (rotate)
+                    {
+                        int x2 = (int)(((float)x)*cos_theta - ((float)y)*sin_theta);
+                        int y2 = (int)(((float)x)*sin_theta + ((float)y)*cos_theta);
 
-                        count += 6;
+                        x = std::max(-24, std::min(24, x2));
+                        y = std::max(-24, std::min(24, y2));
                     }
+
+                    offsets[t * 3 + k] = (y - half_ssd_size) * step + x - half_ssd_size;
                 }
             }
         }
 
-
-        static void pixelTests2(const Mat& grayImage, const std::vector<KeyPoint>& keypoints, OutputArray _descriptors, const std::vector<int> &points, bool rotationInvariance, int half_ssd_size)
+#if CV_SIMD128
+        static inline v_int32x4 ssd8(const uchar* a, const uchar* b, const v_int16x8& mask)
         {
-            Mat descriptors = _descriptors.getMat();
-            for (int i = 0; i < (int)keypoints.size(); ++i)
-            {
-                uchar* desc = descriptors.ptr(i);
-                const KeyPoint& pt = keypoints[i];
-                int count = 0;
-
-                //handling keypoint orientation
-                float angle = pt.angle;
-                angle *= (float)(CV_PI / 180.f);
-                float cos_theta = cos(angle);
-                float sin_theta = sin(angle);
-                for (int ix = 0; ix < 2; ix++){
-                    desc[ix] = 0;
-                    for (int j = 7; j >= 0; j--){
-
-                        int suma = 0;
-                        int sumc = 0;
-
-                        CalcuateSums(count, points, rotationInvariance, grayImage, pt, suma, sumc, cos_theta, sin_theta, half_ssd_size);
-                        desc[ix] += (uchar)((suma < sumc) << j);
-
-                        count += 6;
-                    }
-                }
-            }
+            v_int16x8 d = (v_reinterpret_as_s16(v_load_expand(a)) - v_reinterpret_as_s16(v_load_expand(b))) & mask;
+            return v_dotprod(d, d);
         }
+#endif
 
-
-        static void pixelTests4(const Mat& grayImage, const std::vector<KeyPoint>& keypoints, OutputArray _descriptors, const std::vector<int> &points, bool rotationInvariance, int half_ssd_size)
+        // Sums of squared differences of the patches a-b and c-b of size x size pixels,
+        // simdSafe means that 7 bytes after the end of every patch row may be read
+        static inline void CalcuateSums(const uchar* a, const uchar* b, const uchar* c, int step, int size,
+                                        bool simdSafe, int &suma, int &sumc)
         {
-            Mat descriptors = _descriptors.getMat();
-            for (int i = 0; i < (int)keypoints.size(); ++i)
-            {
-                uchar* desc = descriptors.ptr(i);
-                const KeyPoint& pt = keypoints[i];
-                int count = 0;
-
-                //handling keypoint orientation
-                float angle = pt.angle;
-                angle *= (float)(CV_PI / 180.f);
-                float cos_theta = cos(angle);
-                float sin_theta = sin(angle);
-                for (int ix = 0; ix < 4; ix++){
-                    desc[ix] = 0;
-                    for (int j = 7; j >= 0; j--){
-
-                        int suma = 0;
-                        int sumc = 0;
-
-                        CalcuateSums(count, points, rotationInvariance, grayImage, pt, suma, sumc, cos_theta, sin_theta, half_ssd_size);
-                        desc[ix] += (uchar)((suma < sumc) << j);
+            suma = 0;
+            sumc = 0;
 
-                        count += 6;
+#if CV_SIMD128
+            if (simdSafe)
+            {
+                int tail = size & 7;
+                short CV_DECL_ALIGNED(16) maskBuf[8];
+                for (int k = 0; k < 8; k++)
+                    maskBuf[k] = (short)(k < tail ? -1 : 0);
+                const v_int16x8 tailMask = v_load_aligned(maskBuf), fullMask = v_setall_s16(-1);
+
+                v_int32x4 vsuma = v_setzero_s32(), vsumc = v_setzero_s32();
+                for (int iy = 0; iy < size; iy++, a += step, b += step, c += step)
+                {
+                    int ix = 0;
+                    for (; ix <= size - 8; ix += 8)
+                    {
+                        vsuma += ssd8(a + ix, b + ix, fullMask);
+                        vsumc += ssd8(c + ix, b + ix, fullMask);
+                    }
+                    if (tail)
+                    {
+                        vsuma += ssd8(a + ix, b + ix, tailMask);
+                        vsumc += ssd8(c + ix, b + ix, tailMask);
                     }
                 }
-            }
-        }
-
 
+                suma = v_reduce_sum(vsuma);
+                sumc = v_reduce_sum(vsumc);
+                return;
+            }
+#else
+            (void)simdSafe;
+#endif
 
-        static void pixelTests8(const Mat& grayImage, const std::vector<KeyPoint>& keypoints, OutputArray _descriptors, const std::vector<int> &points, bool rotationInvariance, int half_ssd_size)
-        {
-            Mat descriptors = _descriptors.getMat();
-            for (int i = 0; i < (int)keypoints.size(); ++i)
+            for (int iy = 0; iy < size; iy++, a += step, b += step, c += step)
             {
-                uchar* desc = descriptors.ptr(i);
-                const KeyPoint& pt = keypoints[i];
-                int count = 0;
-
-                //handling keypoint orientation
-                float angle = pt.angle;
-                angle *= (float)(CV_PI / 180.f);
-                float cos_theta = cos(angle);
-                float sin_theta = sin(angle);
-                for (int ix = 0; ix < 8; ix++){
-                    desc[ix] = 0;
-                    for (int j = 7; j >= 0; j--){
-
-                        int suma = 0;
-                        int sumc = 0;
-
-                        CalcuateSums(count, points, rotationInvariance, grayImage, pt, suma, sumc, cos_theta, sin_theta, half_ssd_size);
-                        desc[ix] += (uchar)((suma < sumc) << j);
+                for (int ix = 0; ix < size; ix++)
+                {
+                    int difa = a[ix] - b[ix];
+                    suma += difa * difa;
 
-                        count += 6;
-                    }
+                    int difc = c[ix] - b[ix];
+                    sumc += difc * difc;
                 }
             }
         }
 
-
-        static void pixelTests16(const Mat& grayImage, const std::vector<KeyPoint>& keypoints, OutputArray _descriptors, const std::vector<int> &points, bool rotationInvariance, int half_ssd_size)
+        class LATCHInvoker : public ParallelLoopBody
         {
-            Mat descriptors = _descriptors.getMat();
-            for (int i = 0; i < (int)keypoints.size(); ++i)
+        public:
+            LATCHInvoker(const Mat& _grayImage, const std::vector<KeyPoint>& _keypoints, Mat& _descriptors,
+                         const std::vector<int> &_points, bool _rotationInvariance, int _half_ssd_size, int _bytes,
+                         const std::vector<int> &_uprightOffsets)
+                : grayImage(_grayImage), keypoints(_keypoints), descriptors(_descriptors), points(_points),
+                  rotationInvariance(_rotationInvariance), half_ssd_size(_half_ssd_size), bytes(_bytes),
+                  uprightOffsets(_uprightOffsets)
             {
-                uchar* desc = descriptors.ptr(i);
-                const KeyPoint& pt = keypoints[i];
-                int count = 0;
-
-                //handling keypoint orientation
-                float angle = pt.angle;
-                angle *= (float)(CV_PI / 180.f);
-                float cos_theta = cos(angle);
-                float sin_theta = sin(angle);
-                for (int ix = 0; ix < 16; ix++){
-                    desc[ix] = 0;
-                    for (int j = 7; j >= 0; j--){
-
-                        int suma = 0;
-                        int sumc = 0;
-
-                        CalcuateSums(count, points, rotationInvariance, grayImage, pt, suma, sumc, cos_theta, sin_theta, half_ssd_size);
-                        desc[ix] += (uchar)((suma < sumc) << j);
-
-                        count += 6;
-                    }
-                }
             }
-        }
-
 
-        static void pixelTests32(const Mat& grayImage, const std::vector<KeyPoint>& keypoints, OutputArray _descriptors, const std::vector<int> &points, bool rotationInvariance, int half_ssd_size)
-        {
-            Mat descriptors = _descriptors.getMat();
-            for (int i = 0; i < (int)keypoints.size(); ++i)
+            void operator()(const Range& range) const
             {
-                uchar* desc = descriptors.ptr(i);
-                const KeyPoint& pt = keypoints[i];
-                int count = 0;
-
-                float angle = pt.angle;
-                angle *= (float)(CV_PI / 180.f);
-                float cos_theta = cos(angle);
-                float sin_theta = sin(angle);
-                for (int ix = 0; ix < 32; ix++){
-                    desc[ix] = 0;
-                    for (int j = 7; j >= 0; j--){
+                const int nTests = bytes * 8;
+                const int step = (int)grayImage.step;
+                const int size = 2 * half_ssd_size + 1;
+                std::vector<int> rotatedOffsets(nTests * 3);
 
-                        int suma = 0;
-                        int sumc = 0;
-
-                        CalcuateSums(count, points, rotationInvariance, grayImage, pt, suma, sumc, cos_theta, sin_theta, half_ssd_size);
-                        desc[ix] += (uchar)((suma < sumc) << j);
-
-                        count += 6;
+                for (int i = range.start; i < range.end; ++i)
+                {
+                    uchar* desc = descriptors.ptr(i);
+                    const KeyPoint& pt = keypoints[i];
+                    const int* offsets = &uprightOffsets[0];
+
+                    //handling keypoint orientation
+                    if (rotationInvariance)
+                    {
+                        float angle = pt.angle;
+                        angle *= (float)(CV_PI / 180.f);
+                        float cos_theta = cos(angle);
+                        float sin_theta = sin(angle);
+
+                        computeTripletOffsets(points, nTests, true, cos_theta, sin_theta, half_ssd_size, step, &rotatedOffsets[0]);
+                        offsets = &rotatedOffsets[0];
                     }
-                }
-            }
-        }
 
+                    int x = (int)(pt.pt.x + 0.5);
+                    int y = (int)(pt.pt.y + 0.5);
+                    const uchar* center = grayImage.ptr<uchar>(y) + x;
+                    bool simdSafe = x + 24 + half_ssd_size + 8 < grayImage.cols;
 
-        static void pixelTests64(const Mat& grayImage, const std::vector<KeyPoint>& keypoints, OutputArray _descriptors, const std::vector<int> &points, bool rotationInvariance, int half_ssd_size)
-        {
-            Mat descriptors = _descriptors.getMat();
-            for (int i = 0; i < (int)keypoints.size(); ++i)
-            {
-                uchar* desc = descriptors.ptr(i);
-                const KeyPoint& pt = keypoints[i];
-                int count = 0;
+                    for (int ix = 0; ix < bytes; ix++){
+                        desc[ix] = 0;
+                        for (int j = 7; j >= 0; j--){
+                            const int* ofs = offsets + (ix * 8 + 7 - j) * 3;
 
-                //handling keypoint orientation
-                float angle = pt.angle;
-                angle *= (float)(CV_PI / 180.f);
-                float cos_theta = cos(angle);
-                float sin_theta = sin(angle);
-                for (int ix = 0; ix < 64; ix++){
-                    desc[ix] = 0;
-                    for (int j = 7; j >= 0; j--){
+                            int suma = 0;
+                            int sumc = 0;
 
-                        int suma = 0;
-                        int sumc = 0;
-
-                        CalcuateSums(count, points, rotationInvariance, grayImage, pt, suma, sumc, cos_theta, sin_theta, half_ssd_size);
-                        desc[ix] += (uchar)((suma < sumc) << j);
-
-                        count += 6;
+                            CalcuateSums(center + ofs[0], center + ofs[1], center + ofs[2], step, size, simdSafe, suma, sumc);
+                            desc[ix] += (uchar)((suma < sumc) << j);
+                        }
                     }
                 }
             }
-        }
 
-        void CalcuateSums(int count, const std::vector<int> &points, bool rotationInvariance, const Mat &grayImage, const KeyPoint &pt, int &suma, int &sumc, float cos_theta, float sin_theta, int half_ssd_size)
+        private:
+            const Mat& grayImage;
+            const std::vector<KeyPoint>& keypoints;
+            Mat& descriptors;
+            const std::vector<int>& points;
+            bool rotationInvariance;
+            int half_ssd_size;
+            int bytes;
+            const std::vector<int>& uprightOffsets;
+        };
 
+        template <int bytes>
+        static void pixelTests(const Mat& grayImage, const std::vector<KeyPoint>& keypoints, OutputArray _descriptors, const std::vector<int> &points, bool rotationInvariance, int half_ssd_size)
         {
-            int ax = points[count];
-            int ay = points[count + 1];
-
-            int	bx = points[count + 2];
-            int	by = points[count + 3];
-
-            int cx = points[count + 4];
-            int cy = points[count + 5];
-
-            int ax2 = ax;
-            int ay2 = ay;
-            int bx2 = bx;
-            int by2 = by;
-            int cx2 = cx;
-            int cy2 = cy;
-
-            if (rotationInvariance){
-
-
-                ax2 =(int)(((float)ax)*cos_theta - ((float)ay)*sin_theta);
-                ay2 = (int)(((float)ax)*sin_theta + ((float)ay)*cos_theta);
-                bx2 = (int)(((float)bx)*cos_theta - ((float)by)*sin_theta);
-                by2 = (int)(((float)bx)*sin_theta + ((float)by)*cos_theta);
-                cx2 = (int)(((float)cx)*cos_theta - ((float)cy)*sin_theta);
-                cy2 = (int)(((float)cx)*sin_theta + ((float)cy)*cos_theta);
-
-
-                if (ax2 > 24)
-                    ax2 = 24;
-                if (ax2<-24)
-                    ax2 = -24;
-
-                if (ay2>24)
-                    ay2 = 24;
-                if (ay2<-24)
-                    ay2 = -24;
-
-                if (bx2>24)
-                    bx2 = 24;
-                if (bx2<-24)
-                    bx2 = -24;
-
-                if (by2>24)
-                    by2 = 24;
-                if (by2<-24)
-                    by2 = -24;
-
-                if (cx2>24)
-                    cx2 = 24;
-                if (cx2<-24)
-                    cx2 = -24;
-
-                if (cy2>24)
-                    cy2 = 24;
-                if (cy2 < -24)
-                    cy2 = -24;
-
-            }
-
-
-            ax2 += (int)(pt.pt.x + 0.5);
-            ay2 += (int)(pt.pt.y + 0.5);
-
-            bx2 += (int)(pt.pt.x + 0.5);
-            by2 += (int)(pt.pt.y + 0.5);
-
-            cx2 += (int)(pt.pt.x + 0.5);
-            cy2 += (int)(pt.pt.y + 0.5);
-
-
-            int K = half_ssd_size;
-            for (int iy = -K; iy <= K; iy++)
-            {
-                const uchar * Mi_a = grayImage.ptr<uchar>(ay2 + iy);
-                const uchar * Mi_b = grayImage.ptr<uchar>(by2 + iy);
-                const uchar * Mi_c = grayImage.ptr<uchar>(cy2 + iy);
-
-                for (int ix = -K; ix <= K; ix++)
-                {
-                    double difa = Mi_a[ax2 + ix] - Mi_b[bx2 + ix];
-                    suma += (int)((difa)*(difa));
+            Mat descriptors = _descriptors.getMat();
 
-                    double difc = Mi_c[cx2 + ix] - Mi_b[bx2 + ix];
-                    sumc += (int)((difc)*(difc));
-                }
-            }
+            // offsets without rotation are the same for all keypoints
+            std::vector<int> uprightOffsets(bytes * 8 * 3);
+            computeTripletOffsets(points, bytes * 8, false, 1.f, 0.f, half_ssd_size, (int)grayImage.step, &uprightOffsets[0]);
 
+            parallel_for_(Range(0, (int)keypoints.size()),
+                          LATCHInvoker(grayImage, keypoints, descriptors, points, rotationInvariance, half_ssd_size, bytes, uprightOffsets));
         }
 
 
@@ -409,25 +268,25 @@ namespace cv
             switch (bytes)
             {
             case 1:
-                test_fn_ = pixelTests1;
+                test_fn_ = pixelTests<1>;
                 break;
             case 2:
-                test_fn_ = pixelTests2;
+                test_fn_ = pixelTests<2>;
                 break;
             case 4:
-                test_fn_ = pixelTests4;
+                test_fn_ = pixelTests<4>;
                 break;
             case 8:
-                test_fn_ = pixelTests8;
+                test_fn_ = pixelTests<8>;
                 break;
             case 16:
-                test_fn_ = pixelTests16;
+                test_fn_ = pixelTests<16>;
                 break;
             case 32:
-                test_fn_ = pixelTests32;
+                test_fn_ = pixelTests<32>;
                 break;
             case 64:
-                test_fn_ = pixelTests64;
+                test_fn_ = pixelTests<64>;
                 break;
             default:
                 CV_Error(Error::StsBadArg, "descriptorSize must be 1,2, 4, 8, 16, 32, or 64");
@@ -457,25 +316,25 @@ namespace cv
             switch (dSize)
             {
             case 1:
-                test_fn_ = pixelTests1;
+                test_fn_ = pixelTests<1>;
                 break;
             case 2:
-                test_fn_ = pixelTests2;
+                test_fn_ = pixelTests<2>;
                 break;
             case 4:
-                test_fn_ = pixelTests4;
+                test_fn_ = pixelTests<4>;
                 break;
             case 8:
-                test_fn_ = pixelTests8;
+                test_fn_ = pixelTests<8>;
                 break;
             case 16:
-                test_fn_ = pixelTests16;
+                test_fn_ = pixelTests<16>;
                 break;
             case 32:
-                test_fn_ = pixelTests32;
+                test_fn_ = pixelTests<32>;
                 break;
             case 64:
-                test_fn_ = pixelTests64;
+                test_fn_ = pixelTests<64>;
                 break;
             default:
                 CV_Error(Error::StsBadArg, "descriptorSize must be 1,2, 4, 8, 16, 32, or 64");
@@ -50,6 +50,9 @@ the use of this software, even if advised of the possibility of such damage.
 
 namespace cv {
     namespace xfeatures2d {
+        // the image is blurred patch by patch while the patches cover less than 1/LUCID_SPARSE_FACTOR of it
+        static const size_t LUCID_SPARSE_FACTOR = 4;
+
         /*!
          LUCID implementation
          */
@@ -97,44 +100,103 @@ namespace cv {
             return NORM_HAMMING;
         }
 
-        // gliese581h suggested filling a cv::Mat with descriptors to enable BFmatcher compatibility
-        // speed-ups and enhancements by gliese581h
-        void LUCIDImpl::compute(InputArray _src, std::vector<KeyPoint> &keypoints, OutputArray _desc) {
-            if (_src.getMat().empty())
-                return;
+        // writes the values of a row in ascending order, counting sort is cheaper than a comparison sort for 8-bit data
+        static void sortRow(const uchar* src, uchar* dst, int n) {
+            int hist[256] = {0};
+            int vmin = 255, vmax = 0;
+
+            for (int k = 0; k < n; ++k) {
+                int v = src[k];
+                hist[v]++;
+                vmin = std::min(vmin, v);
+                vmax = std::max(vmax, v);
+            }
 
-            Mat_<Vec3b> src;
+            for (int v = vmin; v <= vmax; ++v)
+                for (int k = hist[v]; k > 0; --k)
+                    *dst++ = (uchar)v;
+        }
+
+        class LUCIDInvoker : public ParallelLoopBody {
+            public:
+                LUCIDInvoker(const Mat& _src, const Mat& _blurred, const std::vector<KeyPoint>& _keypoints, Mat& _desc,
+                             int _l_kernel, int _b_kernel)
+                    : src(_src), blurred(_blurred), keypoints(_keypoints), desc(_desc), l_kernel(_l_kernel), b_kernel(_b_kernel) {
+                }
+
+                void operator()(const Range& range) const {
+                    const int size = l_kernel*2+1, width = src.cols, height = src.rows;
+                    std::vector<uchar> buf(desc.cols);
+                    Mat_<Vec3b> patch, pixel;
+
+                    for (int i = range.start; i < range.end; ++i) {
+                        const int x0 = static_cast<int>(keypoints[i].pt.x)-l_kernel, y0 = static_cast<int>(keypoints[i].pt.y)-l_kernel;
+                        // the patch does not wrap around the image borders
+                        const bool inside = x0 >= 0 && y0 >= 0 && x0+size <= width && y0+size <= height;
+
+                        if (blurred.empty() && inside)
+                            blur(src(Rect(x0, y0, size, size)), patch, Size(b_kernel, b_kernel));
+
+                        uchar* row = &buf[0];
+                        for (int y = y0; y < y0+size; ++y) {
+                            const int yy = y < 0 ? height+y : y >= height ? y-height : y;
+
+                            for (int x = x0; x < x0+size; ++x) {
+                                const int xx = x < 0 ? width+x : x >= width ? x-width : x;
+                                const Vec3b* pix;
+
+                                if (!blurred.empty())
+                                    pix = &blurred.at<Vec3b>(yy, xx);
+                                else if (inside)
+                                    pix = &patch(y-y0, x-x0);
+                                else {
+                                    blur(src(Rect(xx, yy, 1, 1)), pixel, Size(b_kernel, b_kernel));
+                                    pix = &pixel(0, 0);
+                                }
+
+                                *row++ = (*pix)[0];
+                                *row++ = (*pix)[1];
+                                *row++ = (*pix)[2];
+                            }
+                        }
 
-            blur(_src.getMat(), src, cv::Size(b_kernel, b_kernel));
+                        sortRow(&buf[0], desc.ptr(i), desc.cols);
+                    }
+                }
 
-            int x, y, j, d, p, m = (l_kernel*2+1)*(l_kernel*2+1)*3, width = src.cols, height = src.rows, r, c;
+            private:
+                const Mat& src;
+                const Mat& blurred;
+                const std::vector<KeyPoint>& keypoints;
+                Mat& desc;
+                int l_kernel, b_kernel;
+        };
 
-            Mat_<uchar> desc(static_cast<int>(keypoints.size()), m);
+        // gliese581h suggested filling a cv::Mat with descriptors to enable BFmatcher compatibility
+        // speed-ups and enhancements by gliese581h
+        void LUCIDImpl::compute(InputArray _src, std::vector<KeyPoint> &keypoints, OutputArray _desc) {
+            Mat src = _src.getMat();
+            if (src.empty())
+                return;
 
-            for (std::size_t i = 0; i < keypoints.size(); ++i) {
-                x = static_cast<int>(keypoints[i].pt.x)-l_kernel, y = static_cast<int>(keypoints[i].pt.y)-l_kernel, d = x+2*l_kernel, p = y+2*l_kernel, j = x, r = static_cast<int>(i), c = 0;
+            CV_Assert(src.type() == CV_8UC3);
 
-                while (x <= d) {
-                    Vec3b &pix = src((y < 0 ? height+y : y >= height ? y-height : y), (x < 0 ? width+x : x >= width ? x-width : x));
+            if (!_desc.needed())
+                return;
 
-                    desc(r, c++) = pix[0];
-                    desc(r, c++) = pix[1];
-                    desc(r, c++) = pix[2];
+            const int m = (l_kernel*2+1)*(l_kernel*2+1)*3;
+            _desc.create(static_cast<int>(keypoints.size()), m, CV_8U);
+            Mat desc = _desc.getMat();
 
-                    ++x;
-                    if (x > d) {
-                        if (y < p) {
-                            ++y;
-                            x = j;
-                        }
-                        else
-                            break;
-                    }
-                }
-            }
+            // filtering a ROI takes the neighbouring pixels from the whole image, so blurring only the
+            // patches gives the same result as blurring everything; do so when the patches cover little of the image
+            const int blurredSide = l_kernel*2+b_kernel;
+            Mat blurred;
+            if (keypoints.size()*blurredSide*blurredSide*LUCID_SPARSE_FACTOR >= src.total())
+                blur(src, blurred, Size(b_kernel, b_kernel));
 
-            if (_desc.needed())
-                sort(desc, _desc, SORT_EVERY_ROW | SORT_ASCENDING);
+            parallel_for_(Range(0, static_cast<int>(keypoints.size())),
+                          LUCIDInvoker(src, blurred, keypoints, desc, l_kernel, b_kernel));
         }
     }
 } // END NAMESPACE CV
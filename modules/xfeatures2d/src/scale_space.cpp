@@ -0,0 +1,159 @@
+/*
+By downloading, copying, installing or using the software you agree to this
+license. If you do not agree to this license, do not download, install,
+copy or use the software.
+
+                          License Agreement
+               For Open Source Computer Vision Library
+                       (3-clause BSD License)
+
+Copyright (C) 2013, OpenCV Foundation, all rights reserved.
+Third party copyrights are property of their respective owners.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+  * Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+
+  * Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  * Neither the names of the copyright holders nor the names of the contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+
+This software is provided by the copyright holders and contributors "as is" and
+any express or implied warranties, including, but not limited to, the implied
+warranties of merchantability and fitness for a particular purpose are
+disclaimed. In no event shall copyright holders or contributors be liable for
+any direct, indirect, incidental, special, exemplary, or consequential damages
+(including, but not limited to, procurement of substitute goods or services;
+loss of use, data, or profits; or business interruption) however caused
+and on any theory of liability, whether in contract, strict liability,
+or tort (including negligence or otherwise) arising in any way out of
+the use of this software, even if advised of the possibility of such damage.
+*/
+
+
+#include "precomp.hpp"
+#include "scale_space.hpp"
+
+namespace cv
+{
+namespace xfeatures2d
+{
+
+Ptr<ScaleSpace> ScaleSpace::create()
+{
+    return makePtr<ScaleSpaceImpl>();
+}
+
+void ScaleSpaceImpl::setImage(InputArray _image)
+{
+    clear();
+
+    // a private copy, the caller may refill its buffer with the next frame
+    image = _image.getMat().clone();
+    CV_Assert( !image.empty() && image.depth() == CV_8U );
+    CV_Assert( image.channels() == 1 || image.channels() == 3 || image.channels() == 4 );
+}
+
+void ScaleSpaceImpl::clear()
+{
+    image.release();
+    gray.release();
+    sum.release();
+
+    pyramids.clear();
+    gradientLayers.clear();
+}
+
+bool ScaleSpaceImpl::isImage(InputArray _image) const
+{
+    if( image.empty() || !_image.isMat() )
+        return false;
+
+    Mat img = _image.getMat();
+    if( img.size() != image.size() || img.type() != image.type() )
+        return false;
+
+    // the content is compared rather than the data pointer, so a buffer refilled with
+    // another frame after setImage is never taken for the cached image
+    size_t rowSize = img.cols*img.elemSize();
+    for( int i = 0; i < img.rows; i++ )
+    {
+        if( memcmp(img.ptr(i), image.ptr(i), rowSize) != 0 )
+            return false;
+    }
+    return true;
+}
+
+const Mat& ScaleSpaceImpl::getGray()
+{
+    CV_Assert( !image.empty() );
+
+    if( gray.empty() )
+    {
+        if( image.channels() == 3 || image.channels() == 4 )
+            cvtColor(image, gray, COLOR_BGR2GRAY);
+        else
+            gray = image;
+    }
+
+    return gray;
+}
+
+const Mat& ScaleSpaceImpl::getIntegral()
+{
+    if( sum.empty() )
+        integral(getGray(), sum, CV_32S);
+
+    return sum;
+}
+
+ScaleSpaceImpl::GaussianPyramid& ScaleSpaceImpl::getGaussianPyramid(double sigma, int nOctaveLayers, bool doubleImageSize)
+{
+    for( size_t i = 0; i < pyramids.size(); i++ )
+    {
+        GaussianPyramid& p = pyramids[i];
+        if( p.sigma == sigma && p.nOctaveLayers == nOctaveLayers && p.doubleImageSize == doubleImageSize )
+            return p;
+    }
+
+    GaussianPyramid p;
+    p.sigma = sigma;
+    p.nOctaveLayers = nOctaveLayers;
+    p.doubleImageSize = doubleImageSize;
+    pyramids.push_back(p);
+
+    return pyramids.back();
+}
+
+ScaleSpaceImpl::GradientLayers& ScaleSpaceImpl::getGradientLayers(float radius, int radiusQuant, int histQuant)
+{
+    for( size_t i = 0; i < gradientLayers.size(); i++ )
+    {
+        GradientLayers& l = gradientLayers[i];
+        if( l.radius == radius && l.radiusQuant == radiusQuant && l.histQuant == histQuant )
+            return l;
+    }
+
+    GradientLayers l;
+    l.radius = radius;
+    l.radiusQuant = radiusQuant;
+    l.histQuant = histQuant;
+    gradientLayers.push_back(l);
+
+    return gradientLayers.back();
+}
+
+ScaleSpaceImpl* ScaleSpaceImpl::get(const Ptr<ScaleSpace>& scaleSpace, InputArray image)
+{
+    ScaleSpaceImpl* impl = dynamic_cast<ScaleSpaceImpl*>(scaleSpace.get());
+    return impl != NULL && impl->isImage(image) ? impl : NULL;
+}
+
+}
+}
@@ -0,0 +1,107 @@
+/*
+By downloading, copying, installing or using the software you agree to this
+license. If you do not agree to this license, do not download, install,
+copy or use the software.
+
+                          License Agreement
+               For Open Source Computer Vision Library
+                       (3-clause BSD License)
+
+Copyright (C) 2013, OpenCV Foundation, all rights reserved.
+Third party copyrights are property of their respective owners.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+  * Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+
+  * Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  * Neither the names of the copyright holders nor the names of the contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+
+This software is provided by the copyright holders and contributors "as is" and
+any express or implied warranties, including, but not limited to, the implied
+warranties of merchantability and fitness for a particular purpose are
+disclaimed. In no event shall copyright holders or contributors be liable for
+any direct, indirect, incidental, special, exemplary, or consequential damages
+(including, but not limited to, procurement of substitute goods or services;
+loss of use, data, or profits; or business interruption) however caused
+and on any theory of liability, whether in contract, strict liability,
+or tort (including negligence or otherwise) arising in any way out of
+the use of this software, even if advised of the possibility of such damage.
+*/
+
+
+#ifndef __OPENCV_XFEATURES2D_SCALE_SPACE_IMPL_HPP__
+#define __OPENCV_XFEATURES2D_SCALE_SPACE_IMPL_HPP__
+
+namespace cv
+{
+namespace xfeatures2d
+{
+
+class ScaleSpaceImpl : public ScaleSpace
+{
+public:
+    //! SIFT Gaussian and DoG pyramids built for one set of parameters
+    struct GaussianPyramid
+    {
+        double sigma;
+        int nOctaveLayers;
+        bool doubleImageSize;
+
+        Mat base;
+        std::vector<Mat> gpyr;
+        std::vector<Mat> dogpyr;
+    };
+
+    //! DAISY smoothed gradient layers built for one set of parameters
+    struct GradientLayers
+    {
+        float radius;
+        int radiusQuant;
+        int histQuant;
+
+        std::vector<Mat> layers;
+    };
+
+    void setImage(InputArray image);
+
+    void clear();
+
+    //! returns true if the cached data belongs to this image
+    bool isImage(InputArray image) const;
+
+    //! 8-bit grayscale version of the image
+    const Mat& getGray();
+
+    //! CV_32S integral of the grayscale image
+    const Mat& getIntegral();
+
+    //! returns the pyramid entry, it is empty on the first request and filled by the caller
+    GaussianPyramid& getGaussianPyramid(double sigma, int nOctaveLayers, bool doubleImageSize);
+
+    //! returns the layers entry, it is empty on the first request and filled by the caller
+    GradientLayers& getGradientLayers(float radius, int radiusQuant, int histQuant);
+
+    //! returns the cache attached to the algorithm if it can be used for the image
+    static ScaleSpaceImpl* get(const Ptr<ScaleSpace>& scaleSpace, InputArray image);
+
+private:
+    Mat image;
+    Mat gray;
+    Mat sum;
+
+    std::vector<GaussianPyramid> pyramids;
+    std::vector<GradientLayers> gradientLayers;
+};
+
+}
+}
+
+#endif
@@ -103,6 +103,9 @@
 \**********************************************************************************************/
 
 #include "precomp.hpp"
+#include "scale_space.hpp"
+#include "keypoint_grid.hpp"
+#include "opencv2/hal/intrin.hpp"
 #include <iostream>
 #include <stdarg.h>
 
@@ -121,9 +124,9 @@ class SIFT_Impl : public SIFT
 public:
     explicit SIFT_Impl( int nfeatures = 0, int nOctaveLayers = 3,
                           double contrastThreshold = 0.04, double edgeThreshold = 10,
-                          double sigma = 1.6);
+                          double sigma = 1.6, int descType = CV_32F, bool rootSIFT = false);
 
-    //! returns the descriptor size in floats (128)
+    //! returns the descriptor size in elements (128)
     int descriptorSize() const;
 
     //! returns the descriptor type
@@ -139,6 +142,18 @@ public:
                     OutputArray descriptors,
                     bool useProvidedKeypoints = false);
 
+    void setScaleSpace(const Ptr<ScaleSpace>& _scaleSpace) { scaleSpace = _scaleSpace; }
+    Ptr<ScaleSpace> getScaleSpace() const { return scaleSpace; }
+
+    void setGridBudget(Size _gridSize, int _maxPerCell)
+    {
+        checkGridBudget( _gridSize, _maxPerCell );
+        gridSize = _gridSize; maxPerCell = _maxPerCell;
+    }
+    Size getGridSize() const { return gridSize; }
+    int getMaxPerCell() const { return maxPerCell; }
+
+    //! builds the octaves missing in pyr, the octaves already present are kept
     void buildGaussianPyramid( const Mat& base, std::vector<Mat>& pyr, int nOctaves ) const;
     void buildDoGPyramid( const std::vector<Mat>& pyr, std::vector<Mat>& dogpyr ) const;
     void findScaleSpaceExtrema( const std::vector<Mat>& gauss_pyr, const std::vector<Mat>& dog_pyr,
@@ -150,12 +165,21 @@ protected:
     CV_PROP_RW double contrastThreshold;
     CV_PROP_RW double edgeThreshold;
     CV_PROP_RW double sigma;
+    CV_PROP_RW int descType;
+    CV_PROP_RW bool rootSIFT;
+
+    Ptr<ScaleSpace> scaleSpace;
+    Size gridSize;
+    int maxPerCell;
 };
 
 Ptr<SIFT> SIFT::create( int _nfeatures, int _nOctaveLayers,
-                     double _contrastThreshold, double _edgeThreshold, double _sigma )
+                     double _contrastThreshold, double _edgeThreshold, double _sigma,
+                     int _descType, bool _rootSIFT )
 {
-    return makePtr<SIFT_Impl>(_nfeatures, _nOctaveLayers, _contrastThreshold, _edgeThreshold, _sigma);
+    CV_Assert( _descType == CV_32F || _descType == CV_8U );
+    return makePtr<SIFT_Impl>(_nfeatures, _nOctaveLayers, _contrastThreshold, _edgeThreshold, _sigma,
+                              _descType, _rootSIFT);
 }
 
 /******************************* Defs and macros *****************************/
@@ -196,6 +220,16 @@ static const float SIFT_DESCR_MAG_THR = 0.2f;
 // factor used to convert floating-point descriptor to unsigned char
 static const float SIFT_INT_DESCR_FCTR = 512.f;
 
+// factor used to convert RootSIFT descriptor to unsigned char: its elements are square roots
+// of L1 normalized values, so they lie in [0, 1] and are mapped to the whole [0, 255] range
+static const float SIFT_ROOT_DESCR_FCTR = 255.f;
+
+// number of image rows processed by one task of the parallel Gaussian blur
+static const int SIFT_BLUR_STRIPE_ROWS = 128;
+
+// number of image rows processed by one task of the parallel extrema search
+static const int SIFT_EXTREMA_TILE_ROWS = 64;
+
 #if 0
 // intermediate type used for DoG pyramids
 typedef short sift_wt;
@@ -221,7 +255,7 @@ static Mat createInitialImage( const Mat& img, bool doubleImageSize, float sigma
     if( img.channels() == 3 || img.channels() == 4 )
         cvtColor(img, gray, COLOR_BGR2GRAY);
     else
-        img.copyTo(gray);
+        gray = img;
     gray.convertTo(gray_fpt, DataType<sift_wt>::type, SIFT_FIXPT_SCALE, 0);
 
     float sig_diff;
@@ -243,8 +277,56 @@ static Mat createInitialImage( const Mat& img, bool doubleImageSize, float sigma
 }
 
 
+// Blurs the image by horizontal stripes. Every stripe is filtered together with the
+// margin covering the kernel radius, so the result is the same as for the whole image.
+class GaussianBlurInvoker : public ParallelLoopBody
+{
+public:
+    GaussianBlurInvoker( const Mat& _src, Mat& _dst, double _sigma )
+        : src(_src), dst(_dst), sigma(_sigma)
+    {
+        margin = cvCeil(sigma*4) + 1;
+    }
+
+    void operator()( const Range& range ) const
+    {
+        int y0 = std::max(range.start - margin, 0);
+        int y1 = std::min(range.end + margin, src.rows);
+
+        Mat stripe;
+        GaussianBlur(src.rowRange(y0, y1), stripe, Size(), sigma, sigma);
+        stripe.rowRange(range.start - y0, range.end - y0).copyTo(dst.rowRange(range.start, range.end));
+    }
+
+private:
+    const Mat& src;
+    Mat& dst;
+    double sigma;
+    int margin;
+};
+
+static void parallelGaussianBlur( const Mat& src, Mat& dst, double sigma )
+{
+    CV_Assert( src.data != dst.data );
+
+    if( src.rows < 2*SIFT_BLUR_STRIPE_ROWS )
+    {
+        GaussianBlur(src, dst, Size(), sigma, sigma);
+        return;
+    }
+
+    dst.create(src.size(), src.type());
+    parallel_for_(Range(0, src.rows), GaussianBlurInvoker(src, dst, sigma),
+                  (double)src.rows / SIFT_BLUR_STRIPE_ROWS);
+}
+
+
 void SIFT_Impl::buildGaussianPyramid( const Mat& base, std::vector<Mat>& pyr, int nOctaves ) const
 {
+    int firstNewOctave = (int)pyr.size()/(nOctaveLayers + 3);
+    if( firstNewOctave >= nOctaves )
+        return;
+
     std::vector<double> sig(nOctaveLayers + 3);
     pyr.resize(nOctaves*(nOctaveLayers + 3));
 
@@ -259,7 +341,7 @@ void SIFT_Impl::buildGaussianPyramid( const Mat& base, std::vector<Mat>& pyr, in
         sig[i] = std::sqrt(sig_total*sig_total - sig_prev*sig_prev);
     }
 
-    for( int o = 0; o < nOctaves; o++ )
+    for( int o = firstNewOctave; o < nOctaves; o++ )
     {
         for( int i = 0; i < nOctaveLayers + 3; i++ )
         {
@@ -275,41 +357,66 @@ void SIFT_Impl::buildGaussianPyramid( const Mat& base, std::vector<Mat>& pyr, in
             }
             else
             {
+                // layers of the octave depend on each other, so every layer is blurred by row stripes
                 const Mat& src = pyr[o*(nOctaveLayers + 3) + i-1];
-                GaussianBlur(src, dst, Size(), sig[i], sig[i]);
+                parallelGaussianBlur(src, dst, sig[i]);
             }
         }
     }
 }
 
 
-void SIFT_Impl::buildDoGPyramid( const std::vector<Mat>& gpyr, std::vector<Mat>& dogpyr ) const
+class BuildDoGPyramidInvoker : public ParallelLoopBody
 {
-    int nOctaves = (int)gpyr.size()/(nOctaveLayers + 3);
-    dogpyr.resize( nOctaves*(nOctaveLayers + 2) );
+public:
+    BuildDoGPyramidInvoker( int _nOctaveLayers, const std::vector<Mat>& _gpyr, std::vector<Mat>& _dogpyr )
+        : nOctaveLayers(_nOctaveLayers), gpyr(_gpyr), dogpyr(_dogpyr)
+    {}
 
-    for( int o = 0; o < nOctaves; o++ )
+    void operator()( const Range& range ) const
     {
-        for( int i = 0; i < nOctaveLayers + 2; i++ )
+        for( int a = range.start; a < range.end; a++ )
         {
+            const int o = a / (nOctaveLayers + 2);
+            const int i = a % (nOctaveLayers + 2);
+
             const Mat& src1 = gpyr[o*(nOctaveLayers + 3) + i];
             const Mat& src2 = gpyr[o*(nOctaveLayers + 3) + i + 1];
             Mat& dst = dogpyr[o*(nOctaveLayers + 2) + i];
             subtract(src2, src1, dst, noArray(), DataType<sift_wt>::type);
         }
     }
+
+private:
+    int nOctaveLayers;
+    const std::vector<Mat>& gpyr;
+    std::vector<Mat>& dogpyr;
+};
+
+void SIFT_Impl::buildDoGPyramid( const std::vector<Mat>& gpyr, std::vector<Mat>& dogpyr ) const
+{
+    int nOctaves = (int)gpyr.size()/(nOctaveLayers + 3);
+    int firstNewOctave = (int)dogpyr.size()/(nOctaveLayers + 2);
+    if( firstNewOctave >= nOctaves )
+        return;
+
+    dogpyr.resize( nOctaves*(nOctaveLayers + 2) );
+
+    parallel_for_(Range(firstNewOctave * (nOctaveLayers + 2), nOctaves * (nOctaveLayers + 2)),
+                  BuildDoGPyramidInvoker(nOctaveLayers, gpyr, dogpyr));
 }
 
 
-// Computes a gradient orientation histogram at a specified pixel
+// Computes a gradient orientation histogram at a specified pixel,
+// buf is the scratch memory reused between the calls of the same thread
 static float calcOrientationHist( const Mat& img, Point pt, int radius,
-                                  float sigma, float* hist, int n )
+                                  float sigma, float* hist, int n, std::vector<float>& buf )
 {
     int i, j, k, len = (radius*2+1)*(radius*2+1);
 
     float expf_scale = -1.f/(2.f * sigma * sigma);
-    AutoBuffer<float> buf(len*4 + n+4);
-    float *X = buf, *Y = X + len, *Mag = X, *Ori = Y + len, *W = Ori + len;
+    buf.resize(len*4 + n+4);
+    float *X = &buf[0], *Y = X + len, *Mag = X, *Ori = Y + len, *W = Ori + len;
     float* temphist = W + len + 2;
 
     for( i = 0; i < n; i++ )
@@ -478,31 +585,50 @@ static bool adjustLocalExtrema( const std::vector<Mat>& dog_pyr, KeyPoint& kpt,
 }
 
 
-//
-// Detects features at extrema in DoG scale space.  Bad features are discarded
-// based on contrast and ratio of principal curvatures.
-void SIFT_Impl::findScaleSpaceExtrema( const std::vector<Mat>& gauss_pyr, const std::vector<Mat>& dog_pyr,
-                                  std::vector<KeyPoint>& keypoints ) const
+// Part of the DoG layer searched for extrema by one task
+struct ScaleSpaceTile
 {
-    int nOctaves = (int)gauss_pyr.size()/(nOctaveLayers + 3);
-    int threshold = cvFloor(0.5 * contrastThreshold / nOctaveLayers * 255 * SIFT_FIXPT_SCALE);
-    const int n = SIFT_ORI_HIST_BINS;
-    float hist[n];
-    KeyPoint kpt;
+    int octave;
+    int layer;
+    int rowStart;
+    int rowEnd;
+};
 
-    keypoints.clear();
+class FindScaleSpaceExtremaInvoker : public ParallelLoopBody
+{
+public:
+    FindScaleSpaceExtremaInvoker( const std::vector<ScaleSpaceTile>& _tiles,
+                                  const std::vector<Mat>& _gauss_pyr, const std::vector<Mat>& _dog_pyr,
+                                  int _nOctaveLayers, int _threshold, double _contrastThreshold,
+                                  double _edgeThreshold, double _sigma,
+                                  std::vector<std::vector<KeyPoint> >& _tileKeypoints )
+        : tiles(_tiles), gauss_pyr(_gauss_pyr), dog_pyr(_dog_pyr),
+          nOctaveLayers(_nOctaveLayers), threshold(_threshold), contrastThreshold(_contrastThreshold),
+          edgeThreshold(_edgeThreshold), sigma(_sigma), tileKeypoints(_tileKeypoints)
+    {}
+
+    void operator()( const Range& range ) const
+    {
+        const int n = SIFT_ORI_HIST_BINS;
+        float hist[n];
+        std::vector<float> buf;
+        KeyPoint kpt;
 
-    for( int o = 0; o < nOctaves; o++ )
-        for( int i = 1; i <= nOctaveLayers; i++ )
+        for( int t = range.start; t < range.end; t++ )
         {
+            const ScaleSpaceTile& tile = tiles[t];
+            std::vector<KeyPoint>& keypoints = tileKeypoints[t];
+            keypoints.clear();
+
+            const int o = tile.octave, i = tile.layer;
             int idx = o*(nOctaveLayers+2)+i;
             const Mat& img = dog_pyr[idx];
             const Mat& prev = dog_pyr[idx-1];
             const Mat& next = dog_pyr[idx+1];
             int step = (int)img.step1();
-            int rows = img.rows, cols = img.cols;
+            int cols = img.cols;
 
-            for( int r = SIFT_IMG_BORDER; r < rows-SIFT_IMG_BORDER; r++)
+            for( int r = tile.rowStart; r < tile.rowEnd; r++)
             {
                 const sift_wt* currptr = img.ptr<sift_wt>(r);
                 const sift_wt* prevptr = prev.ptr<sift_wt>(r);
@@ -543,7 +669,7 @@ void SIFT_Impl::findScaleSpaceExtrema( const std::vector<Mat>& gauss_pyr, const
                                                          Point(c1, r1),
                                                          cvRound(SIFT_ORI_RADIUS * scl_octv),
                                                          SIFT_ORI_SIG_FCTR * scl_octv,
-                                                         hist, n);
+                                                         hist, n, buf);
                         float mag_thr = (float)(omax * SIFT_ORI_PEAK_RATIO);
                         for( int j = 0; j < n; j++ )
                         {
@@ -564,11 +690,66 @@ void SIFT_Impl::findScaleSpaceExtrema( const std::vector<Mat>& gauss_pyr, const
                 }
             }
         }
+    }
+
+private:
+    const std::vector<ScaleSpaceTile>& tiles;
+    const std::vector<Mat>& gauss_pyr;
+    const std::vector<Mat>& dog_pyr;
+    int nOctaveLayers;
+    int threshold;
+    double contrastThreshold;
+    double edgeThreshold;
+    double sigma;
+    std::vector<std::vector<KeyPoint> >& tileKeypoints;
+};
+
+//
+// Detects features at extrema in DoG scale space.  Bad features are discarded
+// based on contrast and ratio of principal curvatures.
+// Octave layers are split into row tiles which are processed in parallel,
+// keypoints of the tiles are gathered in the same order as the serial scan produces.
+void SIFT_Impl::findScaleSpaceExtrema( const std::vector<Mat>& gauss_pyr, const std::vector<Mat>& dog_pyr,
+                                  std::vector<KeyPoint>& keypoints ) const
+{
+    int nOctaves = (int)gauss_pyr.size()/(nOctaveLayers + 3);
+    int threshold = cvFloor(0.5 * contrastThreshold / nOctaveLayers * 255 * SIFT_FIXPT_SCALE);
+
+    keypoints.clear();
+
+    std::vector<ScaleSpaceTile> tiles;
+    for( int o = 0; o < nOctaves; o++ )
+        for( int i = 1; i <= nOctaveLayers; i++ )
+        {
+            int rows = dog_pyr[o*(nOctaveLayers+2)+i].rows;
+            for( int r = SIFT_IMG_BORDER; r < rows-SIFT_IMG_BORDER; r += SIFT_EXTREMA_TILE_ROWS )
+            {
+                ScaleSpaceTile tile;
+                tile.octave = o;
+                tile.layer = i;
+                tile.rowStart = r;
+                tile.rowEnd = std::min(r + SIFT_EXTREMA_TILE_ROWS, rows-SIFT_IMG_BORDER);
+                tiles.push_back(tile);
+            }
+        }
+
+    std::vector<std::vector<KeyPoint> > tileKeypoints(tiles.size());
+    parallel_for_(Range(0, (int)tiles.size()),
+                  FindScaleSpaceExtremaInvoker(tiles, gauss_pyr, dog_pyr, nOctaveLayers, threshold,
+                                               contrastThreshold, edgeThreshold, sigma, tileKeypoints));
+
+    size_t total = 0;
+    for( size_t t = 0; t < tileKeypoints.size(); t++ )
+        total += tileKeypoints[t].size();
+
+    keypoints.reserve(total);
+    for( size_t t = 0; t < tileKeypoints.size(); t++ )
+        keypoints.insert(keypoints.end(), tileKeypoints[t].begin(), tileKeypoints[t].end());
 }
 
 
 static void calcSIFTDescriptor( const Mat& img, Point2f ptf, float ori, float scl,
-                               int d, int n, float* dst )
+                               int d, int n, float* dst, bool rootSIFT, std::vector<float>& buf )
 {
     Point pt(cvRound(ptf.x), cvRound(ptf.y));
     float cos_t = cosf(ori*(float)(CV_PI/180));
@@ -585,8 +766,8 @@ static void calcSIFTDescriptor( const Mat& img, Point2f ptf, float ori, float sc
     int i, j, k, len = (radius*2+1)*(radius*2+1), histlen = (d+2)*(d+2)*(n+2);
     int rows = img.rows, cols = img.cols;
 
-    AutoBuffer<float> buf(len*6 + histlen);
-    float *X = buf, *Y = X + len, *Mag = Y, *Ori = Mag + len, *W = Ori + len;
+    buf.resize(len*6 + histlen);
+    float *X = &buf[0], *Y = X + len, *Mag = Y, *Ori = Mag + len, *W = Ori + len;
     float *RBin = W + len, *CBin = RBin + len, *hist = CBin + len;
 
     for( i = 0; i < d+2; i++ )
@@ -624,7 +805,68 @@ static void calcSIFTDescriptor( const Mat& img, Point2f ptf, float ori, float sc
     hal::magnitude(X, Y, Mag, len);
     hal::exp(W, W, len);
 
-    for( k = 0; k < len; k++ )
+    k = 0;
+#if CV_SIMD128
+    {
+        // bins and interpolation weights are computed for 4 samples at once, histogram is updated
+        // in the same order as by the scalar code, so the result doesn't depend on the branch
+        int CV_DECL_ALIGNED(16) r0_buf[4], c0_buf[4], o0_buf[4];
+        float CV_DECL_ALIGNED(16) rco_buf[8*4];
+
+        const v_float32x4 v_ori = v_setall_f32(ori), v_bins_per_rad = v_setall_f32(bins_per_rad);
+        const v_int32x4 v_n = v_setall_s32(n), v_zero = v_setzero_s32();
+
+        for( ; k <= len - 4; k += 4 )
+        {
+            v_float32x4 v_rbin = v_load(RBin + k), v_cbin = v_load(CBin + k);
+            v_float32x4 v_obin = (v_load(Ori + k) - v_ori)*v_bins_per_rad;
+            v_float32x4 v_mag = v_load(Mag + k)*v_load(W + k);
+
+            v_int32x4 v_r0 = v_floor(v_rbin), v_c0 = v_floor(v_cbin), v_o0 = v_floor(v_obin);
+            v_rbin = v_rbin - v_cvt_f32(v_r0);
+            v_cbin = v_cbin - v_cvt_f32(v_c0);
+            v_obin = v_obin - v_cvt_f32(v_o0);
+
+            v_o0 = v_o0 + (v_n & (v_o0 < v_zero));
+            v_o0 = v_o0 - (v_n & (v_o0 >= v_n));
+
+            v_float32x4 v_r1 = v_mag*v_rbin, v_r0f = v_mag - v_r1;
+            v_float32x4 v_rc11 = v_r1*v_cbin, v_rc10 = v_r1 - v_rc11;
+            v_float32x4 v_rc01 = v_r0f*v_cbin, v_rc00 = v_r0f - v_rc01;
+            v_float32x4 v_rco111 = v_rc11*v_obin, v_rco110 = v_rc11 - v_rco111;
+            v_float32x4 v_rco101 = v_rc10*v_obin, v_rco100 = v_rc10 - v_rco101;
+            v_float32x4 v_rco011 = v_rc01*v_obin, v_rco010 = v_rc01 - v_rco011;
+            v_float32x4 v_rco001 = v_rc00*v_obin, v_rco000 = v_rc00 - v_rco001;
+
+            v_store_aligned(r0_buf, v_r0);
+            v_store_aligned(c0_buf, v_c0);
+            v_store_aligned(o0_buf, v_o0);
+            v_store_aligned(rco_buf, v_rco000);
+            v_store_aligned(rco_buf + 4, v_rco001);
+            v_store_aligned(rco_buf + 8, v_rco010);
+            v_store_aligned(rco_buf + 12, v_rco011);
+            v_store_aligned(rco_buf + 16, v_rco100);
+            v_store_aligned(rco_buf + 20, v_rco101);
+            v_store_aligned(rco_buf + 24, v_rco110);
+            v_store_aligned(rco_buf + 28, v_rco111);
+
+            for( int l = 0; l < 4; l++ )
+            {
+                int idx = ((r0_buf[l]+1)*(d+2) + c0_buf[l]+1)*(n+2) + o0_buf[l];
+                hist[idx] += rco_buf[l];
+                hist[idx+1] += rco_buf[4 + l];
+                hist[idx+(n+2)] += rco_buf[8 + l];
+                hist[idx+(n+3)] += rco_buf[12 + l];
+                hist[idx+(d+2)*(n+2)] += rco_buf[16 + l];
+                hist[idx+(d+2)*(n+2)+1] += rco_buf[20 + l];
+                hist[idx+(d+3)*(n+2)] += rco_buf[24 + l];
+                hist[idx+(d+3)*(n+2)+1] += rco_buf[28 + l];
+            }
+        }
+    }
+#endif
+
+    for( ; k < len; k++ )
     {
         float rbin = RBin[k], cbin = CBin[k];
         float obin = (Ori[k] - ori)*bins_per_rad;
@@ -687,57 +929,96 @@ static void calcSIFTDescriptor( const Mat& img, Point2f ptf, float ori, float sc
         dst[i] = val;
         nrm2 += val*val;
     }
-    nrm2 = SIFT_INT_DESCR_FCTR/std::max(std::sqrt(nrm2), FLT_EPSILON);
 
-#if 1
-    for( k = 0; k < len; k++ )
+    if( !rootSIFT )
     {
-        dst[k] = saturate_cast<uchar>(dst[k]*nrm2);
-    }
-#else
-    float nrm1 = 0;
-    for( k = 0; k < len; k++ )
-    {
-        dst[k] *= nrm2;
-        nrm1 += dst[k];
+        nrm2 = SIFT_INT_DESCR_FCTR/std::max(std::sqrt(nrm2), FLT_EPSILON);
+        for( k = 0; k < len; k++ )
+        {
+            dst[k] = saturate_cast<uchar>(dst[k]*nrm2);
+        }
     }
-    nrm1 = 1.f/std::max(nrm1, FLT_EPSILON);
-    for( k = 0; k < len; k++ )
+    else
     {
-        dst[k] = std::sqrt(dst[k] * nrm1);//saturate_cast<uchar>(std::sqrt(dst[k] * nrm1)*SIFT_INT_DESCR_FCTR);
+        // RootSIFT: L1 normalization followed by the element-wise square root
+        float nrm1 = 0;
+        for( k = 0; k < len; k++ )
+            nrm1 += dst[k];
+        nrm1 = 1.f/std::max(nrm1, FLT_EPSILON);
+        for( k = 0; k < len; k++ )
+        {
+            dst[k] = saturate_cast<uchar>(std::sqrt(dst[k] * nrm1)*SIFT_ROOT_DESCR_FCTR);
+        }
     }
-#endif
 }
 
-static void calcDescriptors(const std::vector<Mat>& gpyr, const std::vector<KeyPoint>& keypoints,
-                            Mat& descriptors, int nOctaveLayers, int firstOctave )
+class CalcDescriptorsInvoker : public ParallelLoopBody
 {
-    int d = SIFT_DESCR_WIDTH, n = SIFT_DESCR_HIST_BINS;
+public:
+    CalcDescriptorsInvoker( const std::vector<Mat>& _gpyr, const std::vector<KeyPoint>& _keypoints,
+                            Mat& _descriptors, int _nOctaveLayers, int _firstOctave, bool _rootSIFT )
+        : gpyr(_gpyr), keypoints(_keypoints), descriptors(_descriptors),
+          nOctaveLayers(_nOctaveLayers), firstOctave(_firstOctave), rootSIFT(_rootSIFT)
+    {}
 
-    for( size_t i = 0; i < keypoints.size(); i++ )
+    void operator()( const Range& range ) const
     {
-        KeyPoint kpt = keypoints[i];
-        int octave, layer;
-        float scale;
-        unpackOctave(kpt, octave, layer, scale);
-        CV_Assert(octave >= firstOctave && layer <= nOctaveLayers+2);
-        float size=kpt.size*scale;
-        Point2f ptf(kpt.pt.x*scale, kpt.pt.y*scale);
-        const Mat& img = gpyr[(octave - firstOctave)*(nOctaveLayers + 3) + layer];
-
-        float angle = 360.f - kpt.angle;
-        if(std::abs(angle - 360.f) < FLT_EPSILON)
-            angle = 0.f;
-        calcSIFTDescriptor(img, ptf, angle, size*0.5f, d, n, descriptors.ptr<float>((int)i));
+        int d = SIFT_DESCR_WIDTH, n = SIFT_DESCR_HIST_BINS;
+        std::vector<float> buf;
+        float descr[SIFT_DESCR_WIDTH*SIFT_DESCR_WIDTH*SIFT_DESCR_HIST_BINS];
+        bool toBytes = descriptors.depth() == CV_8U;
+
+        for( int i = range.start; i < range.end; i++ )
+        {
+            KeyPoint kpt = keypoints[i];
+            int octave, layer;
+            float scale;
+            unpackOctave(kpt, octave, layer, scale);
+            CV_Assert(octave >= firstOctave && layer <= nOctaveLayers+2);
+            float size=kpt.size*scale;
+            Point2f ptf(kpt.pt.x*scale, kpt.pt.y*scale);
+            const Mat& img = gpyr[(octave - firstOctave)*(nOctaveLayers + 3) + layer];
+
+            float angle = 360.f - kpt.angle;
+            if(std::abs(angle - 360.f) < FLT_EPSILON)
+                angle = 0.f;
+            if( toBytes )
+            {
+                // the values are already rounded to [0, 255], so conversion is exact
+                calcSIFTDescriptor(img, ptf, angle, size*0.5f, d, n, descr, rootSIFT, buf);
+                uchar* dst = descriptors.ptr<uchar>(i);
+                for( int k = 0; k < d*d*n; k++ )
+                    dst[k] = (uchar)descr[k];
+            }
+            else
+                calcSIFTDescriptor(img, ptf, angle, size*0.5f, d, n, descriptors.ptr<float>(i), rootSIFT, buf);
+        }
     }
+
+private:
+    const std::vector<Mat>& gpyr;
+    const std::vector<KeyPoint>& keypoints;
+    Mat& descriptors;
+    int nOctaveLayers;
+    int firstOctave;
+    bool rootSIFT;
+};
+
+static void calcDescriptors(const std::vector<Mat>& gpyr, const std::vector<KeyPoint>& keypoints,
+                            Mat& descriptors, int nOctaveLayers, int firstOctave, bool rootSIFT )
+{
+    parallel_for_(Range(0, (int)keypoints.size()),
+                  CalcDescriptorsInvoker(gpyr, keypoints, descriptors, nOctaveLayers, firstOctave, rootSIFT));
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////
 
 SIFT_Impl::SIFT_Impl( int _nfeatures, int _nOctaveLayers,
-           double _contrastThreshold, double _edgeThreshold, double _sigma )
+           double _contrastThreshold, double _edgeThreshold, double _sigma,
+           int _descType, bool _rootSIFT )
     : nfeatures(_nfeatures), nOctaveLayers(_nOctaveLayers),
-    contrastThreshold(_contrastThreshold), edgeThreshold(_edgeThreshold), sigma(_sigma)
+    contrastThreshold(_contrastThreshold), edgeThreshold(_edgeThreshold), sigma(_sigma),
+    descType(_descType), rootSIFT(_rootSIFT), maxPerCell(0)
 {
 }
 
@@ -748,7 +1029,7 @@ int SIFT_Impl::descriptorSize() const
 
 int SIFT_Impl::descriptorType() const
 {
-    return CV_32F;
+    return descType;
 }
 
 int SIFT_Impl::defaultNorm() const
@@ -790,14 +1071,37 @@ void SIFT_Impl::detectAndCompute(InputArray _image, InputArray _mask,
         actualNOctaves = maxOctave - firstOctave + 1;
     }
 
-    Mat base = createInitialImage(image, firstOctave < 0, (float)sigma);
+    ScaleSpaceImpl* cache = ScaleSpaceImpl::get(scaleSpace, _image);
+    ScaleSpaceImpl::GaussianPyramid* cachedPyr = 0;
+    Mat base;
+    if( cache )
+    {
+        cachedPyr = &cache->getGaussianPyramid(sigma, nOctaveLayers, firstOctave < 0);
+        if( cachedPyr->base.empty() )
+            cachedPyr->base = createInitialImage(cache->getGray(), firstOctave < 0, (float)sigma);
+        base = cachedPyr->base;
+    }
+    else
+        base = createInitialImage(image, firstOctave < 0, (float)sigma);
+
     std::vector<Mat> gpyr, dogpyr;
     int nOctaves = actualNOctaves > 0 ? actualNOctaves : cvRound(std::log( (double)std::min( base.cols, base.rows ) ) / std::log(2.) - 2) - firstOctave;
 
     //double t, tf = getTickFrequency();
     //t = (double)getTickCount();
-    buildGaussianPyramid(base, gpyr, nOctaves);
-    buildDoGPyramid(gpyr, dogpyr);
+    if( cachedPyr )
+    {
+        // only the octaves missing in the shared scale space are built
+        buildGaussianPyramid(base, cachedPyr->gpyr, nOctaves);
+        buildDoGPyramid(cachedPyr->gpyr, cachedPyr->dogpyr);
+        gpyr.assign(cachedPyr->gpyr.begin(), cachedPyr->gpyr.begin() + nOctaves*(nOctaveLayers + 3));
+        dogpyr.assign(cachedPyr->dogpyr.begin(), cachedPyr->dogpyr.begin() + nOctaves*(nOctaveLayers + 2));
+    }
+    else
+    {
+        buildGaussianPyramid(base, gpyr, nOctaves);
+        buildDoGPyramid(gpyr, dogpyr);
+    }
 
     //t = (double)getTickCount() - t;
     //printf("pyramid construction time: %g\n", t*1000./tf);
@@ -825,6 +1129,7 @@ void SIFT_Impl::detectAndCompute(InputArray _image, InputArray _mask,
 
         if( !mask.empty() )
             KeyPointsFilter::runByPixelsMask( keypoints, mask );
+        retainBestPerGridCell( keypoints, image.size(), gridSize, maxPerCell );
     }
     else
     {
@@ -836,10 +1141,10 @@ void SIFT_Impl::detectAndCompute(InputArray _image, InputArray _mask,
     {
         //t = (double)getTickCount();
         int dsize = descriptorSize();
-        _descriptors.create((int)keypoints.size(), dsize, CV_32F);
+        _descriptors.create((int)keypoints.size(), dsize, descType);
         Mat descriptors = _descriptors.getMat();
 
-        calcDescriptors(gpyr, keypoints, descriptors, nOctaveLayers, firstOctave);
+        calcDescriptors(gpyr, keypoints, descriptors, nOctaveLayers, firstOctave, rootSIFT);
         //t = (double)getTickCount() - t;
         //printf("descriptor extraction time: %g\n", t*1000./tf);
     }
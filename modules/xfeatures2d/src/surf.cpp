@@ -109,6 +109,9 @@ Modifications by Ian Mahon
 */
 #include "precomp.hpp"
 #include "surf.hpp"
+#include "scale_space.hpp"
+#include "keypoint_grid.hpp"
+#include "opencv2/hal/intrin.hpp"
 
 namespace cv
 {
@@ -145,6 +148,25 @@ inline float calcHaarPattern( const int* origin, const SurfHF* f, int n )
     return (float)d;
 }
 
+#if CV_SIMD128_64F
+/* calcHaarPattern for 4 adjacent samples. The weighted box sums are rounded to
+   float and accumulated in double just like the scalar version, so the results
+   are the same */
+inline v_float32x4 calcHaarPattern4( const int* origin, const SurfHF* f, int n )
+{
+    v_float64x2 d0 = v_setzero_f64(), d1 = v_setzero_f64();
+    for( int k = 0; k < n; k++ )
+    {
+        v_int32x4 box = v_load(origin + f[k].p0) + v_load(origin + f[k].p3) -
+                        v_load(origin + f[k].p1) - v_load(origin + f[k].p2);
+        v_float32x4 t = v_cvt_f32(box) * v_setall_f32(f[k].w);
+        d0 += v_cvt_f64(t);
+        d1 += v_cvt_f64(v_combine_high(t, t));
+    }
+    return v_combine_low(v_cvt_f32(d0), v_cvt_f32(d1));
+}
+#endif
+
 static void
 resizeHaarPattern( const int src[][5], SurfHF* dst, int n, int oldSize, int newSize, int widthStep )
 {
@@ -196,7 +218,23 @@ static void calcLayerDetAndTrace( const Mat& sum, int size, int sampleStep,
         const int* sum_ptr = sum.ptr<int>(i*sampleStep);
         float* det_ptr = &det.at<float>(i+margin, margin);
         float* trace_ptr = &trace.at<float>(i+margin, margin);
-        for( int j = 0; j < samples_j; j++ )
+        int j = 0;
+#if CV_SIMD128_64F
+        // the samples of the first octave are adjacent in the integral image
+        if( sampleStep == 1 )
+        {
+            v_float32x4 c = v_setall_f32(0.81f);
+            for( ; j <= samples_j - 4; j += 4, sum_ptr += 4 )
+            {
+                v_float32x4 dx  = calcHaarPattern4( sum_ptr, Dx , 3 );
+                v_float32x4 dy  = calcHaarPattern4( sum_ptr, Dy , 3 );
+                v_float32x4 dxy = calcHaarPattern4( sum_ptr, Dxy, 4 );
+                v_store(det_ptr + j, dx*dy - c*dxy*dxy);
+                v_store(trace_ptr + j, dx + dy);
+            }
+        }
+#endif
+        for( ; j < samples_j; j++ )
         {
             float dx  = calcHaarPattern( sum_ptr, Dx , 3 );
             float dy  = calcHaarPattern( sum_ptr, Dy , 3 );
@@ -574,7 +612,9 @@ struct SURFInvoker : ParallelLoopBody
         // array lengths.  Maybe because it is a constant known at compile time
         const int nOriSampleBound =(2*ORI_RADIUS+1)*(2*ORI_RADIUS+1);
 
+        // orientation workspace, shared by all keypoints of the range
         float X[nOriSampleBound], Y[nOriSampleBound], angle[nOriSampleBound];
+        int iangle[nOriSampleBound];
         uchar PATCH[PATCH_SZ+1][PATCH_SZ+1];
         float DX[PATCH_SZ][PATCH_SZ], DY[PATCH_SZ][PATCH_SZ];
         Mat _patch(PATCH_SZ+1, PATCH_SZ+1, CV_8U, PATCH);
@@ -644,7 +684,9 @@ struct SURFInvoker : ParallelLoopBody
                     continue;
                 }
 
-                phase( Mat(1, nangle, CV_32F, X), Mat(1, nangle, CV_32F, Y), Mat(1, nangle, CV_32F, angle), true );
+                hal::fastAtan2( Y, X, angle, nangle, true );
+                for( j = 0; j < nangle; j++ )
+                    iangle[j] = cvRound(angle[j]);
 
                 float bestx = 0, besty = 0, descriptor_mod = 0;
                 for( i = 0; i < 360; i += SURF_ORI_SEARCH_INC )
@@ -652,7 +694,7 @@ struct SURFInvoker : ParallelLoopBody
                     float sumx = 0, sumy = 0, temp_mod;
                     for( j = 0; j < nangle; j++ )
                     {
-                        int d = std::abs(cvRound(angle[j]) - i);
+                        int d = std::abs(iangle[j] - i);
                         if( d < ORI_WIN/2 || d > 360-ORI_WIN/2 )
                         {
                             sumx += X[j];
@@ -874,12 +916,19 @@ SURF_Impl::SURF_Impl(double _threshold, int _nOctaves, int _nOctaveLayers, bool
     upright = _upright;
     nOctaves = _nOctaves;
     nOctaveLayers = _nOctaveLayers;
+    maxPerCell = 0;
 }
 
 int SURF_Impl::descriptorSize() const { return extended ? 128 : 64; }
 int SURF_Impl::descriptorType() const { return CV_32F; }
 int SURF_Impl::defaultNorm() const { return NORM_L2; }
 
+void SURF_Impl::setGridBudget(Size gridSize_, int maxPerCell_)
+{
+    checkGridBudget( gridSize_, maxPerCell_ );
+    gridSize = gridSize_; maxPerCell = maxPerCell_;
+}
+
 
 void SURF_Impl::detectAndCompute(InputArray _img, InputArray _mask,
                       CV_OUT std::vector<KeyPoint>& keypoints,
@@ -892,7 +941,8 @@ void SURF_Impl::detectAndCompute(InputArray _img, InputArray _mask,
     CV_Assert(!_img.empty() && CV_MAT_DEPTH(imgtype) == CV_8U && (imgcn == 1 || imgcn == 3 || imgcn == 4));
     CV_Assert(_descriptors.needed() || !useProvidedKeypoints);
 
-    if( ocl::useOpenCL() )
+    // the OpenCL path computes the descriptors together with the keypoints, so it can't apply the grid budget
+    if( ocl::useOpenCL() && maxPerCell <= 0 )
     {
         SURF_OCL ocl_surf;
         UMat gpu_kpt;
@@ -920,8 +970,11 @@ void SURF_Impl::detectAndCompute(InputArray _img, InputArray _mask,
     }
 
     Mat img = _img.getMat(), mask = _mask.getMat(), mask1, sum, msum;
+    ScaleSpaceImpl* cache = ScaleSpaceImpl::get(scaleSpace, _img);
 
-    if( imgcn > 1 )
+    if( cache )
+        img = cache->getGray();
+    else if( imgcn > 1 )
         cvtColor(img, img, COLOR_BGR2GRAY);
 
     CV_Assert(mask.empty() || (mask.type() == CV_8U && mask.size() == img.size()));
@@ -929,7 +982,10 @@ void SURF_Impl::detectAndCompute(InputArray _img, InputArray _mask,
     CV_Assert(nOctaves > 0);
     CV_Assert(nOctaveLayers > 0);
 
-    integral(img, sum, CV_32S);
+    if( cache )
+        sum = cache->getIntegral();
+    else
+        integral(img, sum, CV_32S);
 
     // Compute keypoints only if we are not asked for evaluating the descriptors are some given locations:
     if( !useProvidedKeypoints )
@@ -940,6 +996,7 @@ void SURF_Impl::detectAndCompute(InputArray _img, InputArray _mask,
             integral(mask1, msum, CV_32S);
         }
         fastHessianDetector( sum, msum, keypoints, nOctaves, nOctaveLayers, (float)hessianThreshold );
+        retainBestPerGridCell( keypoints, img.size(), gridSize, maxPerCell );
     }
 
     int i, j, N = (int)keypoints.size();
@@ -57,11 +57,21 @@ public:
     void setUpright(bool upright_) { upright = upright_; }
     bool getUpright() const { return upright; }
 
+    void setScaleSpace(const Ptr<ScaleSpace>& scaleSpace_) { scaleSpace = scaleSpace_; }
+    Ptr<ScaleSpace> getScaleSpace() const { return scaleSpace; }
+
+    void setGridBudget(Size gridSize_, int maxPerCell_);
+    Size getGridSize() const { return gridSize; }
+    int getMaxPerCell() const { return maxPerCell; }
+
     double hessianThreshold;
     int nOctaves;
     int nOctaveLayers;
     bool extended;
     bool upright;
+    Ptr<ScaleSpace> scaleSpace;
+    Size gridSize;
+    int maxPerCell;
 };
 
 class SURF_OCL
@@ -1282,3 +1282,402 @@ TEST( XFeatures2d_DescriptorExtractor, batch )
         EXPECT_GT(descriptors[i].rows, 100);
     }
 }
+
+TEST( XFeatures2d_SIFT, parallel_same_as_serial )
+{
+    string imgname = string(cvtest::TS::ptr()->get_data_path() + "detectors_descriptors_evaluation/images_datasets/graf/img1.png");
+    Mat img = imread(imgname, 0);
+    ASSERT_FALSE(img.empty());
+
+    Ptr<SIFT> sift = SIFT::create();
+    int nThreads = getNumThreads();
+
+    vector<KeyPoint> keypoints, keypointsSerial;
+    Mat descriptors, descriptorsSerial;
+
+    setNumThreads(1);
+    sift->detectAndCompute(img, noArray(), keypointsSerial, descriptorsSerial);
+    setNumThreads(nThreads);
+    sift->detectAndCompute(img, noArray(), keypoints, descriptors);
+
+    ASSERT_EQ(keypointsSerial.size(), keypoints.size());
+    for( size_t i = 0; i < keypoints.size(); i++ )
+    {
+        EXPECT_EQ(keypointsSerial[i].pt, keypoints[i].pt);
+        EXPECT_EQ(keypointsSerial[i].angle, keypoints[i].angle);
+        EXPECT_EQ(keypointsSerial[i].octave, keypoints[i].octave);
+    }
+    EXPECT_EQ(0, cvtest::norm(descriptorsSerial, descriptors, NORM_INF));
+}
+
+TEST( XFeatures2d_SIFT, descriptor_types )
+{
+    string imgname = string(cvtest::TS::ptr()->get_data_path() + "detectors_descriptors_evaluation/images_datasets/graf/img1.png");
+    Mat img = imread(imgname, 0);
+    ASSERT_FALSE(img.empty());
+
+    vector<KeyPoint> keypoints;
+    Mat descriptors32f, descriptors8u, descriptorsRoot;
+
+    Ptr<SIFT> sift = SIFT::create();
+    sift->detectAndCompute(img, noArray(), keypoints, descriptors32f);
+    ASSERT_FALSE(keypoints.empty());
+
+    Ptr<SIFT> sift8u = SIFT::create(0, 3, 0.04, 10, 1.6, CV_8U);
+    EXPECT_EQ(CV_8U, sift8u->descriptorType());
+    sift8u->compute(img, keypoints, descriptors8u);
+    ASSERT_EQ(CV_8U, descriptors8u.type());
+
+    Mat descriptors8uAsFloat;
+    descriptors8u.convertTo(descriptors8uAsFloat, CV_32F);
+    EXPECT_EQ(0, cvtest::norm(descriptors32f, descriptors8uAsFloat, NORM_INF));
+
+    Ptr<SIFT> siftRoot = SIFT::create(0, 3, 0.04, 10, 1.6, CV_8U, true);
+    siftRoot->compute(img, keypoints, descriptorsRoot);
+    ASSERT_EQ(descriptors8u.size(), descriptorsRoot.size());
+
+    // square root of L1 normalized vector has unit L2 norm, it is scaled by 255 without clipping
+    for( int i = 0; i < descriptorsRoot.rows; i++ )
+    {
+        double nrm = cvtest::norm(descriptorsRoot.row(i), NORM_L2);
+        EXPECT_NEAR(255.0, nrm, 255.0 * 0.05);
+    }
+}
+
+TEST( XFeatures2d_ScaleSpace, same_as_without_cache )
+{
+    string imgname = string(cvtest::TS::ptr()->get_data_path() + "detectors_descriptors_evaluation/images_datasets/graf/img1.png");
+    Mat img = imread(imgname);
+    ASSERT_FALSE(img.empty());
+
+    Ptr<ScaleSpace> scaleSpace = ScaleSpace::create();
+    scaleSpace->setImage(img);
+
+    Ptr<SIFT> sift = SIFT::create(), siftShared = SIFT::create();
+    Ptr<SURF> surf = SURF::create(), surfShared = SURF::create();
+    Ptr<DAISY> daisy = DAISY::create(), daisyShared = DAISY::create();
+    siftShared->setScaleSpace(scaleSpace);
+    surfShared->setScaleSpace(scaleSpace);
+    daisyShared->setScaleSpace(scaleSpace);
+
+    vector<KeyPoint> kpRef, kp;
+    Mat descRef, desc;
+
+    // detection and description in separate calls reuse the cached pyramid
+    sift->detectAndCompute(img, noArray(), kpRef, descRef);
+    siftShared->detect(img, kp);
+    siftShared->compute(img, kp, desc);
+    ASSERT_EQ(kpRef.size(), kp.size());
+    EXPECT_EQ(0, cvtest::norm(descRef, desc, NORM_INF));
+
+    surf->detectAndCompute(img, noArray(), kpRef, descRef);
+    surfShared->detectAndCompute(img, noArray(), kp, desc);
+    ASSERT_EQ(kpRef.size(), kp.size());
+    EXPECT_EQ(0, cvtest::norm(descRef, desc, NORM_INF));
+
+    // the second call takes the gradient layers from the cache
+    daisy->compute(img, kpRef, descRef);
+    for( int i = 0; i < 2; i++ )
+    {
+        daisyShared->compute(img, kpRef, desc);
+        EXPECT_EQ(0, cvtest::norm(descRef, desc, NORM_INF));
+    }
+
+    // the cache is not used for other images
+    Mat img2 = img.clone();
+    siftShared->detectAndCompute(img2, noArray(), kp, desc);
+    sift->detectAndCompute(img2, noArray(), kpRef, descRef);
+    ASSERT_EQ(kpRef.size(), kp.size());
+    EXPECT_EQ(0, cvtest::norm(descRef, desc, NORM_INF));
+}
+
+TEST( XFeatures2d_ScaleSpace, refilled_buffer )
+{
+    string imgname = string(cvtest::TS::ptr()->get_data_path() + "detectors_descriptors_evaluation/images_datasets/graf/img1.png");
+    Mat img = imread(imgname);
+    ASSERT_FALSE(img.empty());
+
+    Mat frame = img.clone();
+    Ptr<ScaleSpace> scaleSpace = ScaleSpace::create();
+    scaleSpace->setImage(frame);
+
+    Ptr<SIFT> sift = SIFT::create(), siftShared = SIFT::create();
+    siftShared->setScaleSpace(scaleSpace);
+
+    vector<KeyPoint> kpRef, kp;
+    Mat descRef, desc;
+    siftShared->detectAndCompute(frame, noArray(), kp, desc);
+
+    // the next frame is read into the same buffer without setImage, the cached pyramid must not be used
+    flip(img, frame, 1);
+    siftShared->detectAndCompute(frame, noArray(), kp, desc);
+    sift->detectAndCompute(frame, noArray(), kpRef, descRef);
+    ASSERT_EQ(kpRef.size(), kp.size());
+    EXPECT_EQ(0, cvtest::norm(descRef, desc, NORM_INF));
+}
+
+TEST( XFeatures2d_LATCH, parallel_same_as_serial )
+{
+    string imgname = string(cvtest::TS::ptr()->get_data_path() + "detectors_descriptors_evaluation/images_datasets/graf/img1.png");
+    Mat img = imread(imgname, 0);
+    ASSERT_FALSE(img.empty());
+
+    vector<KeyPoint> keypoints;
+    ORB::create(1000)->detect(img, keypoints);
+    ASSERT_FALSE(keypoints.empty());
+
+    vector<KeyPoint> uprightKeypoints = keypoints;
+    for( size_t i = 0; i < uprightKeypoints.size(); i++ )
+        uprightKeypoints[i].angle = 0.f;
+
+    int nThreads = getNumThreads();
+    const int bytes[] = { 1, 2, 4, 8, 16, 32, 64 };
+    for( int i = 0; i < (int)(sizeof(bytes)/sizeof(bytes[0])); i++ )
+    {
+        Ptr<LATCH> latch = LATCH::create(bytes[i], true, 3);
+        vector<KeyPoint> kp = keypoints, kpSerial = keypoints;
+        Mat descriptors, descriptorsSerial;
+
+        setNumThreads(1);
+        latch->compute(img, kpSerial, descriptorsSerial);
+        setNumThreads(nThreads);
+        latch->compute(img, kp, descriptors);
+
+        ASSERT_EQ(kpSerial.size(), kp.size());
+        EXPECT_EQ(0, cvtest::norm(descriptorsSerial, descriptors, NORM_INF));
+
+        // rotated sampling offsets of upright keypoints are the precomputed ones
+        Mat descriptorsRotated, descriptorsUpright;
+        kp = uprightKeypoints;
+        latch->compute(img, kp, descriptorsRotated);
+        kp = uprightKeypoints;
+        LATCH::create(bytes[i], false, 3)->compute(img, kp, descriptorsUpright);
+        EXPECT_EQ(0, cvtest::norm(descriptorsRotated, descriptorsUpright, NORM_INF));
+    }
+}
+
+TEST( XFeatures2d_LUCID, sparse_same_as_dense )
+{
+    string imgname = string(cvtest::TS::ptr()->get_data_path() + "shared/lena.png");
+    Mat img = imread(imgname);
+    ASSERT_FALSE(img.empty());
+
+    // a dense grid makes the whole image blurred at once, a few keypoints only their patches
+    vector<KeyPoint> dense;
+    for( int y = 0; y < img.rows; y += 4 )
+        for( int x = 0; x < img.cols; x += 4 )
+            dense.push_back(KeyPoint((float)x, (float)y, 7.f));
+
+    vector<KeyPoint> sparse;
+    vector<int> idx;
+    for( size_t i = 0; i < dense.size(); i += dense.size() / 16 )
+    {
+        sparse.push_back(dense[i]);
+        idx.push_back((int)i);
+    }
+    // patches wrapping around the image borders
+    sparse.push_back(dense[0]);
+    idx.push_back(0);
+    sparse.push_back(dense.back());
+    idx.push_back((int)dense.size() - 1);
+
+    Ptr<LUCID> lucid = LUCID::create(2, 2);
+    Mat descDense, descSparse;
+    lucid->compute(img, dense, descDense);
+    lucid->compute(img, sparse, descSparse);
+
+    ASSERT_EQ((int)sparse.size(), descSparse.rows);
+    for( int i = 0; i < descSparse.rows; i++ )
+        EXPECT_EQ(0, cvtest::norm(descSparse.row(i), descDense.row(idx[i]), NORM_INF));
+}
+
+TEST( XFeatures2d_FREAK, parallel_same_as_serial )
+{
+    string imgname = string(cvtest::TS::ptr()->get_data_path() + "detectors_descriptors_evaluation/images_datasets/graf/img1.png");
+    Mat img = imread(imgname, 0);
+    ASSERT_FALSE(img.empty());
+
+    vector<KeyPoint> keypoints;
+    ORB::create(5000)->detect(img, keypoints);
+    ASSERT_FALSE(keypoints.empty());
+
+    Ptr<FREAK> freak = FREAK::create();
+    int nThreads = getNumThreads();
+
+    vector<KeyPoint> kp = keypoints, kpSerial = keypoints;
+    Mat descriptors, descriptorsSerial;
+
+    setNumThreads(1);
+    freak->compute(img, kpSerial, descriptorsSerial);
+    setNumThreads(nThreads);
+    freak->compute(img, kp, descriptors);
+
+    ASSERT_EQ(kpSerial.size(), kp.size());
+    for( size_t i = 0; i < kp.size(); i++ )
+    {
+        EXPECT_EQ(kpSerial[i].pt, kp[i].pt);
+        EXPECT_EQ(kpSerial[i].angle, kp[i].angle);
+    }
+    EXPECT_EQ(0, cvtest::norm(descriptorsSerial, descriptors, NORM_INF));
+}
+
+TEST( XFeatures2d_DAISY, memory_limit_same_as_whole_image )
+{
+    string imgname = string(cvtest::TS::ptr()->get_data_path() + "shared/lena.png");
+    Mat img = imread(imgname, 0);
+    ASSERT_FALSE(img.empty());
+    resize(img, img, Size(256, 256));
+
+    vector<KeyPoint> keypoints;
+    ORB::create(500)->detect(img, keypoints);
+    ASSERT_FALSE(keypoints.empty());
+
+    Ptr<DAISY> daisy = DAISY::create(), daisyBanded = DAISY::create();
+    // a few rows per band, so the image is processed in several bands
+    daisyBanded->setMemoryLimit(4);
+
+    Mat descRef, desc;
+    daisy->compute(img, keypoints, descRef);
+    daisyBanded->compute(img, keypoints, desc);
+    ASSERT_EQ(descRef.size(), desc.size());
+    EXPECT_LE(cvtest::norm(descRef, desc, NORM_INF), 1e-5);
+
+    Rect roi(0, 64, img.cols, 96);
+    daisy->compute(img, roi, descRef);
+    daisyBanded->compute(img, roi, desc);
+    ASSERT_EQ(descRef.size(), desc.size());
+    EXPECT_LE(cvtest::norm(descRef, desc, NORM_INF), 1e-5);
+}
+
+TEST( XFeatures2d_DAISY, memory_limit_errors )
+{
+    string imgname = string(cvtest::TS::ptr()->get_data_path() + "shared/lena.png");
+    Mat img = imread(imgname, 0);
+    ASSERT_FALSE(img.empty());
+    resize(img, img, Size(256, 256));
+
+    vector<KeyPoint> keypoints;
+    ORB::create(500)->detect(img, keypoints);
+    ASSERT_FALSE(keypoints.empty());
+
+    Ptr<DAISY> daisy = DAISY::create();
+    vector<float> descriptor(200);
+
+    // a band of a 256 pixel wide image needs more than 1 MB
+    daisy->setMemoryLimit(1);
+    Mat desc;
+    EXPECT_THROW(daisy->compute(img, keypoints, desc), cv::Exception);
+
+    // the layers are not kept after a banded compute
+    daisy->setMemoryLimit(4);
+    daisy->compute(img, keypoints, desc);
+    EXPECT_THROW(daisy->GetDescriptor(128, 128, 0, &descriptor[0]), cv::Exception);
+    EXPECT_THROW(daisy->GetUnnormalizedDescriptor(128, 128, 0, &descriptor[0]), cv::Exception);
+
+    daisy->setMemoryLimit(0);
+    daisy->compute(img, keypoints, desc);
+    EXPECT_NO_THROW(daisy->GetDescriptor(128, 128, 0, &descriptor[0]));
+}
+
+TEST( XFeatures2d_StarDetector, parallel_same_as_serial )
+{
+    string imgname = string(cvtest::TS::ptr()->get_data_path() + "detectors_descriptors_evaluation/images_datasets/graf/img1.png");
+    Mat img = imread(imgname, 0);
+    ASSERT_FALSE(img.empty());
+
+    Ptr<StarDetector> star = StarDetector::create();
+    int nThreads = getNumThreads();
+
+    vector<KeyPoint> keypoints, keypointsSerial;
+    setNumThreads(1);
+    star->detect(img, keypointsSerial);
+    setNumThreads(nThreads);
+    star->detect(img, keypoints);
+
+    ASSERT_FALSE(keypoints.empty());
+    ASSERT_EQ(keypointsSerial.size(), keypoints.size());
+    for( size_t i = 0; i < keypoints.size(); i++ )
+    {
+        EXPECT_EQ(keypointsSerial[i].pt, keypoints[i].pt);
+        EXPECT_EQ(keypointsSerial[i].size, keypoints[i].size);
+        EXPECT_EQ(keypointsSerial[i].response, keypoints[i].response);
+    }
+}
+
+static void checkGridBudget( const Ptr<Feature2D>& detector, const Mat& img,
+                             const vector<KeyPoint>& keypointsAll, Size gridSize, int maxPerCell )
+{
+    vector<KeyPoint> keypoints;
+    Mat descriptors;
+    detector->detectAndCompute(img, noArray(), keypoints, descriptors);
+
+    ASSERT_FALSE(keypoints.empty());
+    ASSERT_LT(keypoints.size(), keypointsAll.size());
+    ASSERT_EQ((int)keypoints.size(), descriptors.rows);
+
+    vector<int> counts(gridSize.area(), 0);
+    for( size_t i = 0; i < keypoints.size(); i++ )
+    {
+        int cx = std::min(cvFloor(keypoints[i].pt.x * ((float)gridSize.width / img.cols)), gridSize.width - 1);
+        int cy = std::min(cvFloor(keypoints[i].pt.y * ((float)gridSize.height / img.rows)), gridSize.height - 1);
+        EXPECT_LE(++counts[cy * gridSize.width + cx], maxPerCell);
+
+        bool found = false;
+        for( size_t j = 0; j < keypointsAll.size() && !found; j++ )
+            found = keypointsAll[j].pt == keypoints[i].pt && keypointsAll[j].response == keypoints[i].response;
+        EXPECT_TRUE(found);
+    }
+}
+
+TEST( XFeatures2d_GridBudget, retains_best_per_cell )
+{
+    string imgname = string(cvtest::TS::ptr()->get_data_path() + "detectors_descriptors_evaluation/images_datasets/graf/img1.png");
+    Mat img = imread(imgname, 0);
+    ASSERT_FALSE(img.empty());
+
+    Size gridSize(8, 6);
+    int maxPerCell = 4;
+    vector<KeyPoint> keypointsAll;
+
+    Ptr<SIFT> sift = SIFT::create();
+    sift->detect(img, keypointsAll);
+    sift->setGridBudget(gridSize, maxPerCell);
+    checkGridBudget(sift, img, keypointsAll, gridSize, maxPerCell);
+
+    Ptr<SURF> surf = SURF::create();
+    surf->detect(img, keypointsAll);
+    surf->setGridBudget(gridSize, maxPerCell);
+    checkGridBudget(surf, img, keypointsAll, gridSize, maxPerCell);
+
+    Ptr<StarDetector> star = StarDetector::create();
+    star->detect(img, keypointsAll);
+    star->setGridBudget(gridSize, maxPerCell);
+
+    vector<KeyPoint> keypoints;
+    star->detect(img, keypoints);
+    ASSERT_FALSE(keypoints.empty());
+    ASSERT_LT(keypoints.size(), keypointsAll.size());
+    vector<int> counts(gridSize.area(), 0);
+    for( size_t i = 0; i < keypoints.size(); i++ )
+    {
+        int cx = std::min(cvFloor(keypoints[i].pt.x * ((float)gridSize.width / img.cols)), gridSize.width - 1);
+        int cy = std::min(cvFloor(keypoints[i].pt.y * ((float)gridSize.height / img.rows)), gridSize.height - 1);
+        EXPECT_LE(++counts[cy * gridSize.width + cx], maxPerCell);
+    }
+}
+
+TEST( XFeatures2d_GridBudget, rejects_invalid_arguments )
+{
+    Ptr<SIFT> sift = SIFT::create();
+    Ptr<SURF> surf = SURF::create();
+    Ptr<StarDetector> star = StarDetector::create();
+
+    EXPECT_ANY_THROW(sift->setGridBudget(Size(), 4));
+    EXPECT_ANY_THROW(sift->setGridBudget(Size(-1, 4), 4));
+    EXPECT_ANY_THROW(sift->setGridBudget(Size(8, 6), -1));
+    EXPECT_ANY_THROW(surf->setGridBudget(Size(8, 0), 4));
+    EXPECT_ANY_THROW(star->setGridBudget(Size(8, 6), -1));
+
+    // an empty grid is fine when the budget is disabled
+    EXPECT_NO_THROW(sift->setGridBudget(Size(), 0));
+}
@@ -120,6 +120,20 @@ public:
     /** @brief Get the ROI used in the last filter call
      */
     CV_WRAP virtual Rect getROI() = 0;
+
+    /** video-related parameters */
+
+    /** @brief TemporalWeight defines how much the filtered disparity map of the previous filter call is trusted
+    when filtering the current frame of a stereo video. The previous result enters the data term of the smoother:
+    before smoothing, it is added to the confidence-weighted disparity with the weight TemporalWeight times its
+    smoothed confidence, and that weight is added to the confidence. Without confidence every pixel has unit
+    confidence and the same mechanism applies. This suppresses temporal flickering. The default value of 0.0 disables it, so that each call is independent. The previous result is used only if
+    it has the same size and ROI as the current one. Setting the parameter drops the stored result, so it can be
+    used to reset the filter on scene cuts.
+     */
+    CV_WRAP virtual double getTemporalWeight() = 0;
+    /** @see getTemporalWeight */
+    CV_WRAP virtual void setTemporalWeight(double _temporal_weight) = 0;
 };
 
 /** @brief Convenience factory method that creates an instance of DisparityWLSFilter and sets up all the relevant
@@ -58,6 +58,12 @@ enum EdgeAwareFiltersList
     AM_FILTER
 };
 
+enum JointBilateralFilterMode
+{
+    JBF_EXACT,
+    JBF_GRID
+};
+
 
 /** @brief Interface for realizations of Domain Transform filter.
 
@@ -141,6 +147,14 @@ public:
     to src.depth().
      */
     CV_WRAP virtual void filter(InputArray src, OutputArray dst, int dDepth = -1) = 0;
+
+    /** @brief Replace the guided image keeping radius, eps and scale. Internal buffers are reused if the
+    new guide has the same size and number of channels, so it's cheaper than creating new instance
+    for each frame of a video.
+
+    @param guide new guided image (or array of images) with up to 3 channels.
+     */
+    CV_WRAP virtual void setGuide(InputArray guide) = 0;
 };
 
 /** @brief Factory method, create instance of GuidedFilter and produce initialization routines.
@@ -153,9 +167,13 @@ channels then only first 3 channels will be used.
 @param eps regularization term of Guided Filter. \f${eps}^2\f$ is similar to the sigma in the color
 space into bilateralFilter.
 
+@param scale subsampling ratio of Fast Guided Filter @cite Kaiming15 . If scale > 1 then the linear
+coefficients are computed on images downsampled scale times (with radius/scale window) and then
+upsampled to apply to the full resolution guide. scale = 1 corresponds to the original filter.
+
 For more details about Guided Filter parameters, see the original article @cite Kaiming10 .
  */
-CV_EXPORTS_W Ptr<GuidedFilter> createGuidedFilter(InputArray guide, int radius, double eps);
+CV_EXPORTS_W Ptr<GuidedFilter> createGuidedFilter(InputArray guide, int radius, double eps, int scale = 1);
 
 /** @brief Simple one-line Guided Filter call.
 
@@ -176,8 +194,10 @@ space into bilateralFilter.
 
 @param dDepth optional depth of the output image.
 
+@param scale optional subsampling ratio of Fast Guided Filter, see createGuidedFilter.
+
 @sa bilateralFilter, dtFilter, amFilter */
-CV_EXPORTS_W void guidedFilter(InputArray guide, InputArray src, OutputArray dst, int radius, double eps, int dDepth = -1);
+CV_EXPORTS_W void guidedFilter(InputArray guide, InputArray src, OutputArray dst, int radius, double eps, int dDepth = -1, int scale = 1);
 
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
@@ -213,6 +233,30 @@ public:
      */
     CV_WRAP virtual void filter(InputArray src, OutputArray dst, InputArray joint = noArray()) = 0;
 
+    /** @brief Build the manifold tree for the joint image and store it inside the filter.
+
+    The manifolds and the normalization weights depend only on the joint image and filter parameters, so
+    after this call any number of source images can be filtered against the same joint with
+    filterWithManifolds, each call performs only splatting, blurring and slicing of the source channels.
+
+    @param joint joint (also called as guided) image or array of images with any numbers of channels.
+     */
+    CV_WRAP virtual void buildManifolds(InputArray joint) = 0;
+
+    /** @brief Filter the image using manifolds stored by the last buildManifolds call.
+
+    When UseRNG is false, the result is the same as filter(src, dst, joint) call with the joint passed to
+    buildManifolds. With UseRNG enabled the manifold tree is built from random eigenvector estimates, so the
+    result differs from filter() by the random choice of the manifolds (it is still the same for all the
+    sources filtered with the stored manifolds). Filter parameters must not be changed after buildManifolds call.
+
+    @param src filtering image with any numbers of channels, its size must be the same as joint size.
+
+    @param dst output image.
+     */
+    CV_WRAP virtual void filterWithManifolds(InputArray src, OutputArray dst) = 0;
+
+    /** @brief Release the internal buffers and the stored manifolds. */
     CV_WRAP virtual void collectGarbage() = 0;
 
     CV_WRAP static Ptr<AdaptiveManifoldFilter> create();
@@ -309,12 +353,20 @@ proportional to sigmaSpace .
 
 @param borderType
 
+@param mode one of JBF_EXACT and JBF_GRID. JBF_EXACT evaluates the whole (2r+1)x(2r+1) window for each
+pixel, so its cost grows quadratically with the radius. JBF_GRID uses bilateral grid approximation
+@cite Paris2006 , its cost doesn't depend on the radius, d and borderType are ignored in this mode.
+
 @note bilateralFilter and jointBilateralFilter use L1 norm to compute difference between colors.
+JBF_GRID mode uses Gaussian weights computed separately for each channel of joint image instead, so
+results for 3-channel joint images differ more from the exact filter. If the grid doesn't fit into
+the memory budget (sigmaColor is too small in comparison with the joint image range) exact filter is
+used.
 
 @sa bilateralFilter, amFilter
 */
 CV_EXPORTS_W
-void jointBilateralFilter(InputArray joint, InputArray src, OutputArray dst, int d, double sigmaColor, double sigmaSpace, int borderType = BORDER_DEFAULT);
+void jointBilateralFilter(InputArray joint, InputArray src, OutputArray dst, int d, double sigmaColor, double sigmaSpace, int borderType = BORDER_DEFAULT, int mode = JBF_EXACT);
 
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
@@ -349,6 +401,12 @@ it should be 0.25. Setting it to 1.0 may lead to streaking artifacts.
 
 @param num_iter number of iterations used for filtering, 3 is usually enough.
 
+@param num_levels number of resolution levels used for filtering. With num_levels > 1 all iterations but
+the last one are performed on the twice downscaled image (recursively, with the same rule applied to the next
+level), and only the last iteration is performed at full resolution. This makes filtering of large images
+several times faster at the cost of slightly softer edges of the result. The default value of 1 corresponds
+to the original filter.
+
 For more details about Fast Global Smoother parameters, see the original paper @cite Min2014. However, please note that
 there are several differences. Lambda attenuation described in the paper is implemented a bit differently so do not
 expect the results to be identical to those from the paper; sigma_color values from the paper should be multiplied by 255.0 to
@@ -356,7 +414,7 @@ achieve the same effect. Also, in case of image filtering where source and guide
 propose to dynamically update the guide image after each iteration. To maximize the performance this feature
 was not implemented here.
 */
-CV_EXPORTS_W Ptr<FastGlobalSmootherFilter> createFastGlobalSmootherFilter(InputArray guide, double lambda, double sigma_color, double lambda_attenuation=0.25, int num_iter=3);
+CV_EXPORTS_W Ptr<FastGlobalSmootherFilter> createFastGlobalSmootherFilter(InputArray guide, double lambda, double sigma_color, double lambda_attenuation=0.25, int num_iter=3, int num_levels=1);
 
 /** @brief Simple one-line Fast Global Smoother filter call. If you have multiple images to filter with the same
 guide then use FastGlobalSmootherFilter interface to avoid extra computations.
@@ -375,8 +433,10 @@ guide then use FastGlobalSmootherFilter interface to avoid extra computations.
 it should be 0.25. Setting it to 1.0 may lead to streaking artifacts.
 
 @param num_iter number of iterations used for filtering, 3 is usually enough.
+
+@param num_levels number of resolution levels used for filtering, see createFastGlobalSmootherFilter.
 */
-CV_EXPORTS_W void fastGlobalSmootherFilter(InputArray guide, InputArray src, OutputArray dst, double lambda, double sigma_color, double lambda_attenuation=0.25, int num_iter=3);
+CV_EXPORTS_W void fastGlobalSmootherFilter(InputArray guide, InputArray src, OutputArray dst, double lambda, double sigma_color, double lambda_attenuation=0.25, int num_iter=3, int num_levels=1);
 
 //! @}
 }
@@ -90,4 +90,42 @@ PERF_TEST_P( AdaptiveManifoldPerfTest, perf,
     SANITY_CHECK(dst);
 }
 
-}
\ No newline at end of file
+typedef tuple<Size, int> AMStoredManifoldsPerfTestParam;
+typedef TestBaseWithParam<AMStoredManifoldsPerfTestParam> AdaptiveManifoldStoredManifoldsPerfTest;
+
+PERF_TEST_P( AdaptiveManifoldStoredManifoldsPerfTest, perf,
+    Combine(
+    Values(sz1080p, sz720p),        //size
+    Values(1, 3)                    //source channels num
+    )
+)
+{
+    Size sz     = get<0>(GetParam());
+    int srcCnNum = get<1>(GetParam());
+    const int framesNum = 4;
+
+    Mat joint(sz, CV_8UC3);
+    std::vector<Mat> srcs(framesNum);
+    std::vector<Mat> dsts(framesNum);
+    randu(joint, 0, 255);
+    for (int i = 0; i < framesNum; i++)
+    {
+        srcs[i].create(sz, CV_MAKE_TYPE(CV_8U, srcCnNum));
+        randu(srcs[i], 0, 255);
+    }
+
+    cv::setNumThreads(cv::getNumberOfCPUs());
+
+    Ptr<AdaptiveManifoldFilter> amf = createAMFilter(16.0, 0.5, false);
+
+    TEST_CYCLE_N(3)
+    {
+        amf->buildManifolds(joint);
+        for (int i = 0; i < framesNum; i++)
+            amf->filterWithManifolds(srcs[i], dsts[i]);
+    }
+
+    SANITY_CHECK_NOTHING();
+}
+
+}
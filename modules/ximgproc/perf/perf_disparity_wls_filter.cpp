@@ -92,6 +92,36 @@ PERF_TEST_P( DisparityWLSFilterPerfTest, perf, Combine(GuideTypes::all(), SrcTyp
     SANITY_CHECK(dst);
 }
 
+typedef TestBaseWithParam<tuple<GuideTypes, SrcTypes, Size> > DisparityWLSFilterVideoPerfTest;
+
+PERF_TEST_P( DisparityWLSFilterVideoPerfTest, perf, Combine(GuideTypes::all(), SrcTypes::all(), Values(sz720p)) )
+{
+    RNG rng(0);
+
+    int guideType = get<0>(GetParam());
+    int srcType   = get<1>(GetParam());
+    Size sz       = get<2>(GetParam());
+
+    Mat guide(sz, guideType);
+    Mat disp_left(sz, srcType);
+    Mat disp_right(sz, srcType);
+    Mat dst(sz, srcType);
+    Rect ROI;
+
+    MakeArtificialExample(rng,guide,disp_left,disp_right,ROI);
+
+    cv::setNumThreads(cv::getNumberOfCPUs());
+    Ptr<DisparityWLSFilter> wls_filter = createDisparityWLSFilterGeneric(true);
+    wls_filter->setTemporalWeight(0.5);
+    wls_filter->filter(disp_left,guide,dst,disp_right,ROI);
+    TEST_CYCLE_N(10)
+    {
+        wls_filter->filter(disp_left,guide,dst,disp_right,ROI);
+    }
+
+    SANITY_CHECK_NOTHING();
+}
+
 void MakeArtificialExample(RNG rng, Mat& dst_left_view, Mat& dst_left_disparity_map, Mat& dst_right_disparity_map, Rect& dst_ROI)
 {
     int w = dst_left_view.cols;
@@ -78,4 +78,28 @@ PERF_TEST_P( FGSFilterPerfTest, perf, Combine(GuideTypes::all(), SrcTypes::all()
     SANITY_CHECK(dst);
 }
 
-}
\ No newline at end of file
+typedef tuple<GuideTypes, int> FGSMultiLevelParams;
+typedef TestBaseWithParam<FGSMultiLevelParams> FGSFilterMultiLevelPerfTest;
+
+PERF_TEST_P( FGSFilterMultiLevelPerfTest, perf, Combine(GuideTypes::all(), Values(1, 2, 3)) )
+{
+    int guideType  = get<0>(GetParam());
+    int num_levels = get<1>(GetParam());
+    Size sz(5472, 3648); // 20 MP
+
+    Mat guide(sz, guideType);
+    Mat src(sz, CV_16SC1);
+    Mat dst(sz, CV_16SC1);
+
+    declare.in(guide, src, WARMUP_RNG).out(dst).tbb_threads(cv::getNumberOfCPUs());
+
+    cv::setNumThreads(cv::getNumberOfCPUs());
+    TEST_CYCLE_N(3)
+    {
+        fastGlobalSmootherFilter(guide,src,dst,1000.0,10.0,0.25,3,num_levels);
+    }
+
+    SANITY_CHECK_NOTHING();
+}
+
+}
@@ -78,4 +78,31 @@ PERF_TEST_P( GuidedFilterPerfTest, perf, Combine(GuideTypes::all(), SrcTypes::al
     SANITY_CHECK(dst);
 }
 
-}
\ No newline at end of file
+typedef tuple<GuideTypes, int> FastGFParams;
+typedef TestBaseWithParam<FastGFParams> FastGuidedFilterPerfTest;
+
+PERF_TEST_P( FastGuidedFilterPerfTest, perf, Combine(Values(CV_8UC1, CV_8UC3, CV_32FC3), Values(1, 2, 4)) )
+{
+    FastGFParams params = GetParam();
+    int guideType   = get<0>(params);
+    int scale       = get<1>(params);
+    Size sz(3840, 2160);
+
+    Mat guide(sz, guideType);
+    Mat src(sz, CV_8UC3);
+    Mat dst(sz, CV_8UC3);
+
+    declare.in(guide, src, WARMUP_RNG).out(dst).tbb_threads(cv::getNumberOfCPUs());
+
+    cv::setNumThreads(cv::getNumberOfCPUs());
+    Ptr<GuidedFilter> gf = createGuidedFilter(guide, 16, 100.0, scale);
+    TEST_CYCLE_N(3)
+    {
+        gf->setGuide(guide);
+        gf->filter(src, dst);
+    }
+
+    SANITY_CHECK_NOTHING();
+}
+
+}
@@ -82,4 +82,40 @@ PERF_TEST_P(JointBilateralFilterTest, perf,
     
     SANITY_CHECK(dst);
 }
-}
\ No newline at end of file
+
+typedef tuple<double, Size, MatType, int, int> JBFGridTestParam;
+typedef TestBaseWithParam<JBFGridTestParam> JointBilateralFilterGridTest;
+
+PERF_TEST_P(JointBilateralFilterGridTest, perf,
+    Combine(
+    Values(4.0, 10.0, 20.0),
+    SZ_TYPICAL,
+    Values(CV_8U, CV_32F),
+    Values(1, 3),
+    Values(1, 3))
+)
+{
+    JBFGridTestParam params = GetParam();
+    double sigmaS   = get<0>(params);
+    Size sz         = get<1>(params);
+    int depth       = get<2>(params);
+    int jCn         = get<3>(params);
+    int srcCn       = get<4>(params);
+
+    Mat joint(sz, CV_MAKE_TYPE(depth, jCn));
+    Mat src(sz, CV_MAKE_TYPE(depth, srcCn));
+    Mat dst(sz, src.type());
+
+    cv::setNumThreads(cv::getNumberOfCPUs());
+    declare.in(joint, src, WARMUP_RNG).out(dst).tbb_threads(cv::getNumberOfCPUs());
+
+    double sigmaC = 32.0;
+
+    TEST_CYCLE_N(1)
+    {
+        jointBilateralFilter(joint, src, dst, 0, sigmaC, sigmaS, BORDER_DEFAULT, JBF_GRID);
+    }
+
+    SANITY_CHECK_NOTHING();
+}
+}
@@ -111,6 +111,10 @@ public:
 
     void filter(InputArray src, OutputArray dst, InputArray joint);
 
+    void buildManifolds(InputArray joint);
+
+    void filterWithManifolds(InputArray src, OutputArray dst);
+
     void collectGarbage();
 
     CV_IMPL_PROPERTY(double, SigmaS, sigma_s_)
@@ -149,7 +153,22 @@ private:
     vector<Mat> Psi_splat_small;
 
     Mat1f minDistToManifoldSquared;
-    
+
+    Mat splatBuf, sliceBuf;
+
+    /*joint-dependent data of the tree node, stored by buildManifolds*/
+    struct Manifold
+    {
+        Mat w_k;
+        Ptr<DTFilter> dtf;
+    };
+
+    bool storeManifolds;
+    vector<Manifold> manifolds;
+    Mat manifoldsNormalizer;
+    Mat1f manifoldsMinDistSquared;
+    Size manifoldsSize;
+
     int curTreeHeight;
     float sigma_r_over_sqrt_2;
 
@@ -209,13 +228,21 @@ private: /*inline functions*/
 
 private:
 
-    void initBuffers(InputArray src_, InputArray joint_);
+    void initBuffers();
 
     void initSrcAndJoint(InputArray src_, InputArray joint_);
 
+    void initJoint(InputArray joint_);
+
+    void initSrc(InputArray src_);
+
+    void buildTree();
+
     void buildManifoldsAndPerformFiltering(vector<Mat>& eta, Mat1b& cluster, int treeLevel);
 
-    void gatherResult(InputArray src_, OutputArray dst_);
+    void splatBlurSlice(const Mat& wk, const Ptr<DTFilter>& dtf, bool withNormalizer);
+
+    void gatherResult(InputArray src_, OutputArray dst_, const Mat& normalizer, Mat1f& minDistSquared);
 
     void compute_w_k(vector<Mat>& etak, Mat& dst, float sigma, int curTreeLevel);
 
@@ -226,7 +253,7 @@ private:
 
     static void h_filter(const Mat1f& src, Mat& dst, float sigma);
 
-    static void RFFilterPass(vector<Mat>& joint, vector<Mat>& Psi_splat, Mat& Psi_splat_0, vector<Mat>& Psi_splat_dst, Mat& Psi_splat_0_dst, float ss, float sr);
+    static Ptr<DTFilter> createRFFilter(vector<Mat>& joint, float ss, float sr);
 
     static void computeDTHor(vector<Mat>& srcCn, Mat& dst, float ss, float sr);
 
@@ -274,12 +301,11 @@ AdaptiveManifoldFilterN::AdaptiveManifoldFilterN()
     num_pca_iterations_ = 1;
     adjust_outliers_ = false;
     useRNG = true;
+    storeManifolds = false;
 }
 
-void AdaptiveManifoldFilterN::initBuffers(InputArray src_, InputArray joint_)
+void AdaptiveManifoldFilterN::initBuffers()
 {
-    initSrcAndJoint(src_, joint_);
-
     jointCn.resize(jointCnNum);
     Psi_splat_small.resize(jointCnNum);
     for (int i = 0; i < jointCnNum; i++)
@@ -293,10 +319,12 @@ void AdaptiveManifoldFilterN::initBuffers(InputArray src_, InputArray joint_)
     for (int i = 0; i < srcCnNum; i++)
     {
         //srcCn[i].create(srcSize, CV_32FC1);
-        sum_w_ki_Psi_blur_[i] = Mat::zeros(srcSize, CV_32FC1);
+        sum_w_ki_Psi_blur_[i].create(srcSize, CV_32FC1);
+        sum_w_ki_Psi_blur_[i].setTo(0.0f);
     }
 
-    sum_w_ki_Psi_blur_0_ = Mat::zeros(srcSize, CV_32FC1);
+    sum_w_ki_Psi_blur_0_.create(srcSize, CV_32FC1);
+    sum_w_ki_Psi_blur_0_.setTo(0.0f);
     w_k.create(srcSize, CV_32FC1);
     Psi_splat_0_small.create(smallSize, CV_32FC1);
     
@@ -304,7 +332,7 @@ void AdaptiveManifoldFilterN::initBuffers(InputArray src_, InputArray joint_)
         minDistToManifoldSquared.create(srcSize);
 }
 
-void AdaptiveManifoldFilterN::initSrcAndJoint(InputArray src_, InputArray joint_)
+void AdaptiveManifoldFilterN::initSrc(InputArray src_)
 {
     srcSize = src_.size();
     smallSize = getSmallSize();
@@ -316,6 +344,11 @@ void AdaptiveManifoldFilterN::initSrcAndJoint(InputArray src_, InputArray joint_
         for (int i = 0; i < srcCnNum; i++)
             srcCn[i].convertTo(srcCn[i], CV_32F);
     }
+}
+
+void AdaptiveManifoldFilterN::initSrcAndJoint(InputArray src_, InputArray joint_)
+{
+    initSrc(src_);
 
     if (joint_.empty() || joint_.getObj() == src_.getObj())
     {
@@ -334,19 +367,24 @@ void AdaptiveManifoldFilterN::initSrcAndJoint(InputArray src_, InputArray joint_
     }
     else
     {
-        splitChannels(joint_, jointCn);
-        
-        jointCnNum = (int)jointCn.size();
-        int jointDepth = jointCn[0].depth();
-        Size jointSize = jointCn[0].size();
+        initJoint(joint_);
+        CV_Assert( jointCn[0].size() == srcSize );
+    }
+}
 
-        CV_Assert( jointSize == srcSize && (jointDepth == CV_8U || jointDepth == CV_16U || jointDepth == CV_32F) );
+void AdaptiveManifoldFilterN::initJoint(InputArray joint_)
+{
+    splitChannels(joint_, jointCn);
 
-        if (jointDepth != CV_32F)
-        {
-            for (int i = 0; i < jointCnNum; i++)
-                jointCn[i].convertTo(jointCn[i], CV_32F, getNormalizer(jointDepth));
-        }
+    jointCnNum = (int)jointCn.size();
+    int jointDepth = jointCn[0].depth();
+
+    CV_Assert( jointDepth == CV_8U || jointDepth == CV_16U || jointDepth == CV_32F );
+
+    if (jointDepth != CV_32F)
+    {
+        for (int i = 0; i < jointCnNum; i++)
+            jointCn[i].convertTo(jointCn[i], CV_32F, getNormalizer(jointDepth));
     }
 }
 
@@ -355,8 +393,72 @@ void AdaptiveManifoldFilterN::filter(InputArray src, OutputArray dst, InputArray
     CV_Assert(sigma_s_ >= 1 && (sigma_r_ > 0 && sigma_r_ <= 1));
     num_pca_iterations_ = std::max(1, num_pca_iterations_);
 
-    initBuffers(src, joint);
+    initSrcAndJoint(src, joint);
+    initBuffers();
+
+    buildTree();
+
+    gatherResult(src, dst, sum_w_ki_Psi_blur_0_, minDistToManifoldSquared);
+}
+
+void AdaptiveManifoldFilterN::buildManifolds(InputArray joint)
+{
+    CV_Assert(!joint.empty());
+    CV_Assert(sigma_s_ >= 1 && (sigma_r_ > 0 && sigma_r_ <= 1));
+    num_pca_iterations_ = std::max(1, num_pca_iterations_);
+
+    manifolds.clear();
+
+    //the tree is built with the empty source, so only the normalization weights are accumulated
+    initJoint(joint);
+    srcSize = jointCn[0].size();
+    smallSize = getSmallSize();
+    srcCnNum = 0;
+    srcCn.clear();
+    initBuffers();
+
+    storeManifolds = true;
+    buildTree();
+    storeManifolds = false;
+
+    manifoldsSize = srcSize;
+    manifoldsNormalizer = sum_w_ki_Psi_blur_0_;
+    sum_w_ki_Psi_blur_0_.release();
+    manifoldsMinDistSquared = minDistToManifoldSquared;
+    minDistToManifoldSquared.release();
+
+    jointCn.clear();
+    etaFull.clear();
+    w_k.release();
+}
+
+void AdaptiveManifoldFilterN::filterWithManifolds(InputArray src, OutputArray dst)
+{
+    CV_Assert(!manifolds.empty());
+    CV_Assert(src.size() == manifoldsSize);
+    CV_Assert(!adjust_outliers_ || !manifoldsMinDistSquared.empty());
+
+    initSrc(src);
 
+    sum_w_ki_Psi_blur_.resize(srcCnNum);
+    for (int i = 0; i < srcCnNum; i++)
+    {
+        sum_w_ki_Psi_blur_[i].create(srcSize, CV_32FC1);
+        sum_w_ki_Psi_blur_[i].setTo(0.0f);
+    }
+
+    for (size_t k = 0; k < manifolds.size(); k++)
+        splatBlurSlice(manifolds[k].w_k, manifolds[k].dtf, false);
+
+    Mat1f minDistSquared;
+    if (adjust_outliers_)
+        manifoldsMinDistSquared.copyTo(minDistSquared);
+
+    gatherResult(src, dst, manifoldsNormalizer, minDistSquared);
+}
+
+void AdaptiveManifoldFilterN::buildTree()
+{
     curTreeHeight = tree_height_ <= 0 ? computeManifoldTreeHeight(sigma_s_, sigma_r_) : tree_height_;
 
     sigma_r_over_sqrt_2 = (float) (sigma_r_ / sqrt(2.0));
@@ -371,11 +473,9 @@ void AdaptiveManifoldFilterN::filter(InputArray src, OutputArray dst, InputArray
         h_filter(jointCn[i], eta0[i], (float)sigma_s_);
 
     buildManifoldsAndPerformFiltering(eta0, cluster0, 1);
-
-    gatherResult(src, dst);
 }
 
-void AdaptiveManifoldFilterN::gatherResult(InputArray src_, OutputArray dst_)
+void AdaptiveManifoldFilterN::gatherResult(InputArray src_, OutputArray dst_, const Mat& normalizer, Mat1f& minDistSquared)
 {
     int dDepth = src_.depth();
     vector<Mat> dstCn(srcCnNum);
@@ -383,23 +483,23 @@ void AdaptiveManifoldFilterN::gatherResult(InputArray src_, OutputArray dst_)
     if (!adjust_outliers_)
     {
         for (int i = 0; i < srcCnNum; i++)
-            divide(sum_w_ki_Psi_blur_[i], sum_w_ki_Psi_blur_0_, dstCn[i], 1.0, dDepth);
+            divide(sum_w_ki_Psi_blur_[i], normalizer, dstCn[i], 1.0, dDepth);
 
         merge(dstCn, dst_);
     }
     else
     {
-        Mat1f& alpha = minDistToManifoldSquared;
+        Mat1f& alpha = minDistSquared;
         double sigmaMember = -0.5 / (sigma_r_*sigma_r_);
-        multiply(minDistToManifoldSquared, sigmaMember, minDistToManifoldSquared);
-        cv::exp(minDistToManifoldSquared, alpha);
+        multiply(minDistSquared, sigmaMember, minDistSquared);
+        cv::exp(minDistSquared, alpha);
 
         for (int i = 0; i < srcCnNum; i++)
         {
             Mat& f = srcCn[i];
             Mat& g = dstCn[i];
 
-            divide(sum_w_ki_Psi_blur_[i], sum_w_ki_Psi_blur_0_, g);
+            divide(sum_w_ki_Psi_blur_[i], normalizer, g);
 
             subtract(g, f, g);
             multiply(alpha, g, g);
@@ -432,35 +532,18 @@ void AdaptiveManifoldFilterN::buildManifoldsAndPerformFiltering(vector<Mat>& eta
         compute_w_k(etaFull, w_k, sigma_r_over_sqrt_2, treeLevel);
     }
     
-    //blurring
-    Psi_splat_small.resize(srcCnNum);
-    for (int si = 0; si < srcCnNum; si++)
-    {
-        Mat tmp;
-        multiply(srcCn[si], w_k, tmp);
-        downsample(tmp, Psi_splat_small[si]);
-    }
-    downsample(w_k, Psi_splat_0_small);
-
-    vector<Mat>& Psi_splat_small_blur = Psi_splat_small;
-    Mat& Psi_splat_0_small_blur = Psi_splat_0_small;
-
     float rf_ss = (float)(sigma_s_ / getResizeRatio());
     float rf_sr = (float)(sigma_r_over_sqrt_2);
-    RFFilterPass(eta, Psi_splat_small, Psi_splat_0_small, Psi_splat_small_blur, Psi_splat_0_small_blur, rf_ss, rf_sr);
+    Ptr<DTFilter> dtf = createRFFilter(eta, rf_ss, rf_sr);
 
-    //slicing
+    splatBlurSlice(w_k, dtf, true);
+
+    if (storeManifolds)
     {
-        Mat tmp;
-        for (int i = 0; i < srcCnNum; i++)
-        {
-            upsample(Psi_splat_small_blur[i], tmp);
-            multiply(tmp, w_k, tmp);
-            add(sum_w_ki_Psi_blur_[i], tmp, sum_w_ki_Psi_blur_[i]);
-        }
-        upsample(Psi_splat_0_small_blur, tmp);
-        multiply(tmp, w_k, tmp);
-        add(sum_w_ki_Psi_blur_0_, tmp, sum_w_ki_Psi_blur_0_);
+        Manifold m;
+        w_k.copyTo(m.w_k);
+        m.dtf = dtf;
+        manifolds.push_back(m);
     }
 
     //build new manifolds
@@ -486,6 +569,39 @@ void AdaptiveManifoldFilterN::buildManifoldsAndPerformFiltering(vector<Mat>& eta
     }
 }
 
+void AdaptiveManifoldFilterN::splatBlurSlice(const Mat& wk, const Ptr<DTFilter>& dtf, bool withNormalizer)
+{
+    //splatting
+    Psi_splat_small.resize(srcCnNum);
+    for (int si = 0; si < srcCnNum; si++)
+    {
+        multiply(srcCn[si], wk, splatBuf);
+        downsample(splatBuf, Psi_splat_small[si]);
+    }
+    if (withNormalizer)
+        downsample(wk, Psi_splat_0_small);
+
+    //blurring
+    for (int si = 0; si < srcCnNum; si++)
+        dtf->filter(Psi_splat_small[si], Psi_splat_small[si]);
+    if (withNormalizer)
+        dtf->filter(Psi_splat_0_small, Psi_splat_0_small);
+
+    //slicing
+    for (int si = 0; si < srcCnNum; si++)
+    {
+        upsample(Psi_splat_small[si], sliceBuf);
+        multiply(sliceBuf, wk, sliceBuf);
+        add(sum_w_ki_Psi_blur_[si], sliceBuf, sum_w_ki_Psi_blur_[si]);
+    }
+    if (withNormalizer)
+    {
+        upsample(Psi_splat_0_small, sliceBuf);
+        multiply(sliceBuf, wk, sliceBuf);
+        add(sum_w_ki_Psi_blur_0_, sliceBuf, sum_w_ki_Psi_blur_0_);
+    }
+}
+
 void AdaptiveManifoldFilterN::collectGarbage()
 {
     srcCn.clear();
@@ -498,6 +614,12 @@ void AdaptiveManifoldFilterN::collectGarbage()
     w_k.release();
     Psi_splat_0_small.release();
     minDistToManifoldSquared.release();
+    splatBuf.release();
+    sliceBuf.release();
+
+    manifolds.clear();
+    manifoldsNormalizer.release();
+    manifoldsMinDistSquared.release();
 }
 
 void AdaptiveManifoldFilterN::h_filter(const Mat1f& src, Mat& dst, float sigma)
@@ -657,25 +779,13 @@ void AdaptiveManifoldFilterN::computeDTVer(vector<Mat>& srcCn, Mat& dst, float s
     cv::exp(dst, dst);
 }
 
-void AdaptiveManifoldFilterN::RFFilterPass(vector<Mat>& joint, vector<Mat>& Psi_splat, Mat& Psi_splat_0, vector<Mat>& Psi_splat_dst, Mat& Psi_splat_0_dst, float ss, float sr)
+Ptr<DTFilter> AdaptiveManifoldFilterN::createRFFilter(vector<Mat>& joint, float ss, float sr)
 {
-    int h = joint[0].rows;
-    int w = joint[0].cols;
-    int cnNum = (int)Psi_splat.size();
-
     Mat adth, adtv;
     computeDTHor(joint, adth, ss, sr);
     computeDTVer(joint, adtv, ss, sr);
 
-    Psi_splat_0_dst.create(h, w, CV_32FC1);
-    Psi_splat_dst.resize(cnNum);
-    for (int cn = 0; cn < cnNum; cn++)
-        Psi_splat_dst[cn].create(h, w, CV_32FC1);
-
-    Ptr<DTFilter> dtf = createDTFilterRF(adth, adtv, ss, sr, 1);
-    for (int cn = 0; cn < cnNum; cn++)
-        dtf->filter(Psi_splat[cn], Psi_splat_dst[cn]);
-    dtf->filter(Psi_splat_0, Psi_splat_0_dst);
+    return createDTFilterRF(adth, adtv, ss, sr, 1);
 }
 
 void AdaptiveManifoldFilterN::computeClusters(Mat1b& cluster, Mat1b& cluster_minus, Mat1b& cluster_plus)
@@ -35,6 +35,7 @@
  */
 
 #include "precomp.hpp"
+#include "edgeaware_filters_common.hpp"
 #include "opencv2/ximgproc/disparity_filter.hpp"
 #include "opencv2/highgui.hpp"
 #include <math.h>
@@ -62,9 +63,23 @@ protected:
     float resize_factor;
     int num_stripes;
 
+    /*buffers reused between filter calls*/
+    Mat ldisp_box,rdisp_box,ldisp_squared,rdisp_squared;
+    Mat depth_discontinuity_map_left,depth_discontinuity_map_right;
+    Mat disp_mul_conf,conf_filtered,unit_conf;
+    Ptr<FastGlobalSmootherFilter> smoother; /*reset to the guide of every call, its buffers are kept*/
+
+    /*state for the temporal mode*/
+    double temporal_weight;
+    Mat prev_filtered_disp,prev_conf_filtered;
+    Rect prev_ROI;
+
     void init(double _lambda, double _sigma_color, bool _use_confidence, int l_offs, int r_offs, int t_offs, int b_offs, int _min_disp);
     void computeDepthDiscontinuityMaps(Mat& left_disp, Mat& right_disp, Mat& left_dst, Mat& right_dst);
     void computeConfidenceMap(InputArray left_disp, InputArray right_disp);
+    void filterWithConfidence(Mat& disp, Mat& conf, Mat& dst, Rect ROI);
+    bool addTemporalPrior(Mat& numerator, Mat& denominator, Rect ROI);
+    void storeTemporalState(Mat& filtered, Mat& conf, Rect ROI, bool with_prior);
 
 protected:
     struct ComputeDiscontinuityAwareLRC_ParBody : public ParallelLoopBody
@@ -137,6 +152,15 @@ public:
 
     Mat getConfidenceMap() {return confidence_map;}
     Rect getROI() {return valid_disp_ROI;}
+
+    double getTemporalWeight() {return temporal_weight;}
+    void setTemporalWeight(double _temporal_weight)
+    {
+        CV_Assert(_temporal_weight >= 0.0);
+        temporal_weight = _temporal_weight;
+        prev_filtered_disp.release();
+        prev_conf_filtered.release();
+    }
 };
 
 void DisparityWLSFilterImpl::init(double _lambda, double _sigma_color, bool _use_confidence,  int l_offs, int r_offs, int t_offs, int b_offs, int _min_disp)
@@ -156,13 +180,15 @@ void DisparityWLSFilterImpl::init(double _lambda, double _sigma_color, bool _use
     depth_discontinuity_roll_off_factor = 0.001f;
     resize_factor = 1.0;
     num_stripes = getNumThreads();
+    temporal_weight = 0.0;
 }
 
 void DisparityWLSFilterImpl::computeDepthDiscontinuityMaps(Mat& left_disp, Mat& right_disp, Mat& left_dst, Mat& right_dst)
 {
     Mat left_disp_ROI (left_disp, valid_disp_ROI);
     Mat right_disp_ROI(right_disp,right_view_valid_disp_ROI);
-    Mat ldisp,rdisp,ldisp_squared,rdisp_squared;
+    Mat& ldisp = ldisp_box;
+    Mat& rdisp = rdisp_box;
 
     {
         vector<Mat*> _src; _src.push_back(&left_disp_ROI);_src.push_back(&right_disp_ROI);
@@ -184,8 +210,10 @@ void DisparityWLSFilterImpl::computeDepthDiscontinuityMaps(Mat& left_disp, Mat&
         parallel_for_(Range(0,4),ParallelMatOp_ParBody(*this,_ops,_src,_dst));
     }
 
-    left_dst  = Mat::zeros(left_disp.rows,left_disp.cols,CV_32F);
-    right_dst = Mat::zeros(right_disp.rows,right_disp.cols,CV_32F);
+    left_dst.create(left_disp.rows,left_disp.cols,CV_32F);
+    right_dst.create(right_disp.rows,right_disp.cols,CV_32F);
+    left_dst  = Scalar(0.0f);
+    right_dst = Scalar(0.0f);
     Mat left_dst_ROI (left_dst,valid_disp_ROI);
     Mat right_dst_ROI(right_dst,right_view_valid_disp_ROI);
 
@@ -198,7 +226,6 @@ void DisparityWLSFilterImpl::computeConfidenceMap(InputArray left_disp, InputArr
 {
     Mat ldisp = left_disp.getMat();
     Mat rdisp = right_disp.getMat();
-    Mat depth_discontinuity_map_left,depth_discontinuity_map_right;
     right_view_valid_disp_ROI = Rect(ldisp.cols-(valid_disp_ROI.x+valid_disp_ROI.width),valid_disp_ROI.y,
                                      valid_disp_ROI.width,valid_disp_ROI.height);
     computeDepthDiscontinuityMaps(ldisp,rdisp,depth_discontinuity_map_left,depth_discontinuity_map_right);
@@ -206,9 +233,53 @@ void DisparityWLSFilterImpl::computeConfidenceMap(InputArray left_disp, InputArr
     confidence_map = depth_discontinuity_map_left;
 
     parallel_for_(Range(0,num_stripes),ComputeDiscontinuityAwareLRC_ParBody(*this,ldisp,rdisp, depth_discontinuity_map_left,depth_discontinuity_map_right,confidence_map,valid_disp_ROI,right_view_valid_disp_ROI,num_stripes));
+    /* a new matrix, so the map returned by getConfidenceMap() doesn't share memory with
+       the discontinuity buffers that the next filter() call overwrites */
     confidence_map = 255.0f*confidence_map;
 }
 
+/* the previous result enters the data term: its disparity weighted by its confidence is added to the numerator
+   and that weight to the confidence before both are smoothed */
+bool DisparityWLSFilterImpl::addTemporalPrior(Mat& numerator, Mat& denominator, Rect ROI)
+{
+    if(temporal_weight<=0.0 || prev_filtered_disp.empty() || prev_ROI!=ROI || prev_filtered_disp.size()!=numerator.size())
+        return false;
+
+    Mat prev_disp_float;
+    prev_filtered_disp.convertTo(prev_disp_float,CV_32F);
+    Mat prev_weight = (float)temporal_weight*prev_conf_filtered;
+    numerator  += prev_weight.mul(prev_disp_float);
+    denominator = denominator + prev_weight; //new buffer, the caller's confidence stays intact
+    return true;
+}
+
+void DisparityWLSFilterImpl::storeTemporalState(Mat& filtered, Mat& conf, Rect ROI, bool with_prior)
+{
+    if(temporal_weight<=0.0)
+        return;
+
+    filtered.copyTo(prev_filtered_disp);
+    /* the smoothed weight includes the prior, scaling it back keeps the stored confidence a blend of
+       the current and previous confidences instead of letting it grow from frame to frame */
+    conf.convertTo(prev_conf_filtered,CV_32F,with_prior ? 1.0/(1.0+temporal_weight) : 1.0);
+    prev_ROI = ROI;
+}
+
+/* dst = S(conf*disp + prior)/S(conf + prior weight), S being the smoother of the current guide */
+void DisparityWLSFilterImpl::filterWithConfidence(Mat& disp, Mat& conf, Mat& dst, Rect ROI)
+{
+    disp.convertTo(disp_mul_conf,CV_32F);
+    multiply(conf,disp_mul_conf,disp_mul_conf);
+    Mat weight = conf;
+    bool with_prior = addTemporalPrior(disp_mul_conf,weight,ROI);
+    smoother->filter(disp_mul_conf,disp_mul_conf);
+    smoother->filter(weight,conf_filtered);
+    conf_filtered += EPS;
+    divide(disp_mul_conf,conf_filtered,disp_mul_conf);
+    disp_mul_conf.convertTo(dst,CV_16S);
+    storeTemporalState(dst,conf_filtered,ROI,with_prior);
+}
+
 Ptr<DisparityWLSFilterImpl> DisparityWLSFilterImpl::create(bool _use_confidence, int l_offs=0, int r_offs=0, int t_offs=0, int b_offs=0, int min_disp=0)
 {
     DisparityWLSFilterImpl *wls = new DisparityWLSFilterImpl();
@@ -253,47 +324,58 @@ void DisparityWLSFilterImpl::filter(InputArray disparity_map_left, InputArray le
         Mat& dst_full_size = filtered_disparity_map.getMatRef();
         dst_full_size = Scalar(16*(min_disp-1));
         dst = Mat(dst_full_size,ROI);
-        Mat filtered_disp;
-        fastGlobalSmootherFilter(src,disp,filtered_disp,lambda,sigma_color);
-        filtered_disp.copyTo(dst);
+        resetFastGlobalSmootherFilter(smoother,src,lambda,sigma_color);
+        if(temporal_weight>0.0)
+        {
+            /* without confidence every pixel has unit confidence, the previous result enters the data term
+               the same way as in the confidence mode */
+            unit_conf.create(disp.size(),CV_32F);
+            unit_conf.setTo(Scalar(1.0f));
+            filterWithConfidence(disp,unit_conf,dst,ROI);
+        }
+        else
+        {
+            Mat filtered_disp;
+            smoother->filter(disp,filtered_disp);
+            filtered_disp.copyTo(dst);
+        }
     }
     else
     {
         CV_Assert( !disparity_map_right.empty() && (disparity_map_right.depth() == CV_16S) && (disparity_map_right.channels() == 1) );
         CV_Assert( (disparity_map_left.cols() == disparity_map_right.cols()) );
         CV_Assert( (disparity_map_left.rows() == disparity_map_right.rows()) );
-        computeConfidenceMap(disparity_map_left,disparity_map_right);
         Mat disp_full_size = disparity_map_left.getMat();
+        Mat right_disp_full_size = disparity_map_right.getMat();
         Mat src_full_size = left_view.getMat();
-        if(disp_full_size.size!=src_full_size.size)
+        bool need_resize = disp_full_size.size!=src_full_size.size;
+        float x_ratio = src_full_size.cols/(float)disp_full_size.cols;
+        float y_ratio = src_full_size.rows/(float)disp_full_size.rows;
+        if(need_resize)
+            ROI = Rect((int)(valid_disp_ROI.x*x_ratio),    (int)(valid_disp_ROI.y*y_ratio),
+                       (int)(valid_disp_ROI.width*x_ratio),(int)(valid_disp_ROI.height*y_ratio));
+        else
+            ROI = valid_disp_ROI;
+        src = Mat(src_full_size,ROI);
+
+        /* both steps are parallelized internally, so they run one after another */
+        computeConfidenceMap(disp_full_size,right_disp_full_size);
+        resetFastGlobalSmootherFilter(smoother,src,lambda,sigma_color);
+
+        if(need_resize)
         {
-            float x_ratio = src_full_size.cols/(float)disp_full_size.cols;
-            float y_ratio = src_full_size.rows/(float)disp_full_size.rows;
             resize(disp_full_size,disp_full_size,src_full_size.size());
             disp_full_size = disp_full_size*x_ratio;
             resize(confidence_map,confidence_map,src_full_size.size());
-            ROI = Rect((int)(valid_disp_ROI.x*x_ratio),    (int)(valid_disp_ROI.y*y_ratio),
-                       (int)(valid_disp_ROI.width*x_ratio),(int)(valid_disp_ROI.height*y_ratio));
         }
-        else
-            ROI = valid_disp_ROI;
         disp = Mat(disp_full_size,ROI);
-        src  = Mat(src_full_size ,ROI);
         filtered_disparity_map.create(disp_full_size.size(), disp_full_size.type());
         Mat& dst_full_size = filtered_disparity_map.getMatRef();
         dst_full_size = Scalar(16*(min_disp-1));
         dst = Mat(dst_full_size,ROI);
         Mat conf(confidence_map,ROI);
 
-        Mat disp_mul_conf;
-        disp.convertTo(disp_mul_conf,CV_32F);
-        disp_mul_conf = conf.mul(disp_mul_conf);
-        Mat conf_filtered;
-        Ptr<FastGlobalSmootherFilter> wls = createFastGlobalSmootherFilter(src,lambda,sigma_color);
-        wls->filter(disp_mul_conf,disp_mul_conf);
-        wls->filter(conf,conf_filtered);
-        disp_mul_conf = disp_mul_conf.mul(1/(conf_filtered+EPS));
-        disp_mul_conf.convertTo(dst,CV_16S);
+        filterWithConfidence(disp,conf,dst,ROI);
     }
 }
 
@@ -45,6 +45,11 @@ namespace ximgproc
 
 Ptr<DTFilter> createDTFilterRF(InputArray adistHor, InputArray adistVert, double sigmaSpatial, double sigmaColor, int numIters);
 
+/* Sets up fgs for a new guide. A smoother made by createFastGlobalSmootherFilter is reinitialized in place, so its
+   weight and work buffers are reused when the guide keeps its size, otherwise a new one is created. */
+void resetFastGlobalSmootherFilter(Ptr<FastGlobalSmootherFilter>& fgs, InputArray guide, double lambda, double sigma_color,
+                                   double lambda_attenuation=0.25, int num_iter=3, int num_levels=1);
+
 int getTotalNumberOfChannels(InputArrayOfArrays src);
 
 void checkSameSizeAndDepth(InputArrayOfArrays src, Size &sz, int &depth);
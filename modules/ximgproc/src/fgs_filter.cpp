@@ -35,6 +35,7 @@
  */
 
 #include "precomp.hpp"
+#include "edgeaware_filters_common.hpp"
 #include "opencv2/hal/intrin.hpp"
 #include <vector>
 
@@ -61,8 +62,10 @@ inline WorkType get_weight_3channel(WorkType* LUT, unsigned char* p1,unsigned ch
 class FastGlobalSmootherFilterImpl : public FastGlobalSmootherFilter
 {
 public:
-    static Ptr<FastGlobalSmootherFilterImpl> create(InputArray guide, double lambda, double sigma_color, int num_iter,double lambda_attenuation);
+    static Ptr<FastGlobalSmootherFilterImpl> create(InputArray guide, double lambda, double sigma_color, int num_iter,double lambda_attenuation, int num_levels);
     void filter(InputArray src, OutputArray dst);
+    /* also used to switch to a new guide, the weight and work buffers are reused when its size doesn't change */
+    void init(InputArray guide,double _lambda,double _sigmaColor,int _num_iter,double _lambda_attenuation,int _num_levels);
 
 protected:
     int w,h;
@@ -73,7 +76,7 @@ protected:
     Mat weights_LUT;
     Mat Chor, Cvert;
     Mat interD;
-    void init(InputArray guide,double _lambda,double _sigmaColor,int _num_iter,double _lambda_attenuation);
+    Ptr<FastGlobalSmootherFilterImpl> coarse; /* performs all iterations but the last one on the downscaled image */
     void horizontalPass(Mat& cur);
     void verticalPass(Mat& cur);
 protected:
@@ -138,20 +141,24 @@ protected:
 };
 
 
-void FastGlobalSmootherFilterImpl::init(InputArray guide,double _lambda,double _sigmaColor,int _num_iter,double _lambda_attenuation)
+void FastGlobalSmootherFilterImpl::init(InputArray guide,double _lambda,double _sigmaColor,int _num_iter,double _lambda_attenuation,int _num_levels)
 {
-    CV_Assert( !guide.empty() && _lambda >= 0 && _sigmaColor >= 0 && _num_iter >=1 );
+    CV_Assert( !guide.empty() && _lambda >= 0 && _sigmaColor >= 0 && _num_iter >=1 && _num_levels >= 1 );
     CV_Assert( guide.depth() == CV_8U && (guide.channels() == 1 || guide.channels() == 3) );
+    bool same_LUT = !weights_LUT.empty() && sigmaColor == (float)_sigmaColor;
     sigmaColor = (float)_sigmaColor;
     lambda = (float)_lambda;
     lambda_attenuation = (float)_lambda_attenuation;
     num_iter = _num_iter;
     num_stripes = getNumThreads();
-    int num_levels = 3*256*256;
-    weights_LUT.create(1,num_levels,WorkVec::type);
+    if(!same_LUT)
+    {
+        int num_levels = 3*256*256;
+        weights_LUT.create(1,num_levels,WorkVec::type);
 
-    WorkType* LUT = (WorkType*)weights_LUT.ptr(0);
-    parallel_for_(Range(0,num_stripes),ComputeLUT_ParBody(*this,LUT,num_stripes,num_levels));
+        WorkType* LUT = (WorkType*)weights_LUT.ptr(0);
+        parallel_for_(Range(0,num_stripes),ComputeLUT_ParBody(*this,LUT,num_stripes,num_levels));
+    }
 
     w = guide.cols();
     h = guide.rows();
@@ -170,12 +177,26 @@ void FastGlobalSmootherFilterImpl::init(InputArray guide,double _lambda,double _
         parallel_for_(Range(0,num_stripes),ComputeHorizontalWeights_ParBody<get_weight_3channel,3>(*this,guideMat,num_stripes,h));
         parallel_for_(Range(0,num_stripes),ComputeVerticalWeights_ParBody  <get_weight_3channel,3>(*this,guideMat,num_stripes,w));
     }
+
+    const int min_coarse_size = 16;
+    if(_num_levels>1 && _num_iter>1 && std::min(w,h)>=2*min_coarse_size)
+    {
+        /* twice smaller grid: lambda is divided by 4 to preserve the spatial extent of smoothing */
+        Mat coarse_guide;
+        resize(guideMat,coarse_guide,Size((w+1)/2,(h+1)/2),0,0,INTER_AREA);
+        if(coarse.empty())
+            coarse = create(coarse_guide,_lambda/4.0,_sigmaColor,_num_iter-1,_lambda_attenuation,_num_levels-1);
+        else
+            coarse->init(coarse_guide,_lambda/4.0,_sigmaColor,_num_iter-1,_lambda_attenuation,_num_levels-1);
+    }
+    else
+        coarse.release();
 }
 
-Ptr<FastGlobalSmootherFilterImpl> FastGlobalSmootherFilterImpl::create(InputArray guide, double lambda, double sigma_color, int num_iter, double lambda_attenuation)
+Ptr<FastGlobalSmootherFilterImpl> FastGlobalSmootherFilterImpl::create(InputArray guide, double lambda, double sigma_color, int num_iter, double lambda_attenuation, int num_levels)
 {
     FastGlobalSmootherFilterImpl *fgs = new FastGlobalSmootherFilterImpl();
-    fgs->init(guide,lambda,sigma_color,num_iter,lambda_attenuation);
+    fgs->init(guide,lambda,sigma_color,num_iter,lambda_attenuation,num_levels);
     return Ptr<FastGlobalSmootherFilterImpl>(fgs);
 }
 
@@ -204,7 +225,18 @@ void FastGlobalSmootherFilterImpl::filter(InputArray src, OutputArray dst)
         if(src.depth()!=WorkVec::type)
             cur_res.convertTo(cur_res,WorkVec::type);
 
-        for(int n=0;n<num_iter;n++)
+        int n=0;
+        if(!coarse.empty())
+        {
+            Mat coarse_res;
+            resize(cur_res,coarse_res,Size(coarse->w,coarse->h),0,0,INTER_AREA);
+            coarse->filter(coarse_res,coarse_res);
+            resize(coarse_res,cur_res,Size(w,h),0,0,INTER_LINEAR);
+            for(;n<num_iter-1;n++)
+                lambda*=lambda_attenuation;
+        }
+
+        for(;n<num_iter;n++)
         {
             horizontalPass(cur_res);
             verticalPass(cur_res);
@@ -678,15 +710,24 @@ void FastGlobalSmootherFilterImpl::ComputeLUT_ParBody::operator()(const Range& r
 ////////////////////////////////////////////////////////////////////////////////////////////////
 
 CV_EXPORTS_W
-Ptr<FastGlobalSmootherFilter> createFastGlobalSmootherFilter(InputArray guide, double lambda, double sigma_color, double lambda_attenuation, int num_iter)
+void resetFastGlobalSmootherFilter(Ptr<FastGlobalSmootherFilter>& fgs, InputArray guide, double lambda, double sigma_color, double lambda_attenuation, int num_iter, int num_levels)
+{
+    FastGlobalSmootherFilterImpl* impl = fgs.empty() ? NULL : dynamic_cast<FastGlobalSmootherFilterImpl*>(fgs.get());
+    if(impl)
+        impl->init(guide,lambda,sigma_color,num_iter,lambda_attenuation,num_levels);
+    else
+        fgs = createFastGlobalSmootherFilter(guide,lambda,sigma_color,lambda_attenuation,num_iter,num_levels);
+}
+
+Ptr<FastGlobalSmootherFilter> createFastGlobalSmootherFilter(InputArray guide, double lambda, double sigma_color, double lambda_attenuation, int num_iter, int num_levels)
 {
-    return Ptr<FastGlobalSmootherFilter>(FastGlobalSmootherFilterImpl::create(guide, lambda, sigma_color, num_iter, lambda_attenuation));
+    return Ptr<FastGlobalSmootherFilter>(FastGlobalSmootherFilterImpl::create(guide, lambda, sigma_color, num_iter, lambda_attenuation, num_levels));
 }
 
 CV_EXPORTS_W
-void fastGlobalSmootherFilter(InputArray guide, InputArray src, OutputArray dst, double lambda, double sigma_color, double lambda_attenuation, int num_iter)
+void fastGlobalSmootherFilter(InputArray guide, InputArray src, OutputArray dst, double lambda, double sigma_color, double lambda_attenuation, int num_iter, int num_levels)
 {
-    Ptr<FastGlobalSmootherFilter> fgs = createFastGlobalSmootherFilter(guide, lambda, sigma_color, lambda_attenuation, num_iter);
+    Ptr<FastGlobalSmootherFilter> fgs = createFastGlobalSmootherFilter(guide, lambda, sigma_color, lambda_attenuation, num_iter, num_levels);
     fgs->filter(src, dst);
 }
 
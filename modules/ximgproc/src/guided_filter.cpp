@@ -128,28 +128,39 @@ class GuidedFilterImpl : public GuidedFilter
 {
 public:
     
-    static Ptr<GuidedFilterImpl> create(InputArray guide, int radius, double eps);
+    static Ptr<GuidedFilterImpl> create(InputArray guide, int radius, double eps, int scale);
 
     void filter(InputArray src, OutputArray dst, int dDepth = -1);
 
+    void setGuide(InputArray guide);
+
 protected:
 
-    int radius;
+    int radius, fullRadius;
     double eps;
+    int scale;
     int h, w;
+    int fullH, fullW;
 
     vector<Mat> guideCn;
     vector<Mat> guideCnMean;
 
+    SymArray2D<Mat> covars;
     SymArray2D<Mat> covarsInv;
 
     int gCnNum;
 
+    /*workspace reused by setGuide() and filter() calls*/
+    vector<Mat> guideCnRaw, guideCnFull;
+    vector<Mat> srcCnRaw, srcCnFull, srcCn;
+    vector<vector<Mat> > covSrcGuide, alpha, alphaFull;
+    vector<Mat> betaFull, dstCn;
+
 protected:
 
     GuidedFilterImpl() {}
     
-    void init(InputArray guide, int radius, double eps);
+    void init(InputArray guide, int radius, double eps, int scale);
 
     void computeCovGuide(SymArray2D<Mat>& covars);
 
@@ -167,6 +178,16 @@ protected:
         src.convertTo(dst, CV_32F);
     }
 
+    inline void downsample(Mat& src, Mat& dst)
+    {
+        resize(src, dst, Size(w, h), 0, 0, INTER_AREA);
+    }
+
+    inline void upsample(Mat& src, Mat& dst)
+    {
+        resize(src, dst, Size(fullW, fullH), 0, 0, INTER_LINEAR);
+    }
+
 private: /*Routines to parallelize boxFilter and convertTo*/
     
     typedef void (GuidedFilterImpl::*TransformFunc)(Mat& src, Mat& dst);
@@ -203,6 +224,20 @@ private: /*Routines to parallelize boxFilter and convertTo*/
         parallel_for_(pb.getRange(), pb);
     }
 
+    template<typename V>
+    void parDownsample(V &src, V &dst)
+    {
+        GFTransform_ParBody pb(*this, src, dst, &GuidedFilterImpl::downsample);
+        parallel_for_(pb.getRange(), pb);
+    }
+
+    template<typename V>
+    void parUpsample(V &src, V &dst)
+    {
+        GFTransform_ParBody pb(*this, src, dst, &GuidedFilterImpl::upsample);
+        parallel_for_(pb.getRange(), pb);
+    }
+
 private: /*Parallel body classes*/
 
     inline void runParBody(const ParallelLoopBody& pb)
@@ -295,11 +330,12 @@ private: /*Parallel body classes*/
     struct ApplyTransform_ParBody : public ParallelLoopBody
     {
         GuidedFilterImpl &gf;
+        vector<Mat> &guide;
         vector<vector<Mat> > &alpha;
         vector<Mat> &beta;
 
-        ApplyTransform_ParBody(GuidedFilterImpl& gf_, vector<vector<Mat> >& alpha_, vector<Mat>& beta_)
-            : gf(gf_),  alpha(alpha_), beta(beta_) {}
+        ApplyTransform_ParBody(GuidedFilterImpl& gf_, vector<Mat>& guide_, vector<vector<Mat> >& alpha_, vector<Mat>& beta_)
+            : gf(gf_), guide(guide_), alpha(alpha_), beta(beta_) {}
 
         void operator () (const Range& range) const;
     };
@@ -570,12 +606,13 @@ void GuidedFilterImpl::ComputeBeta_ParBody::operator()(const Range& range) const
 void GuidedFilterImpl::ApplyTransform_ParBody::operator()(const Range& range) const
 {
     int srcCnNum = (int)alpha.size();
+    int width = guide[0].cols;
 
     for (int i = range.start; i < range.end; i++)
     {
         float *_g[4];
         for (int gi = 0; gi < gf.gCnNum; gi++)
-            _g[gi] = gf.guideCn[gi].ptr<float>(i);
+            _g[gi] = guide[gi].ptr<float>(i);
 
         float *betaDst, *g, *a;
         for (int si = 0; si < srcCnNum; si++)
@@ -586,7 +623,7 @@ void GuidedFilterImpl::ApplyTransform_ParBody::operator()(const Range& range) co
                 a = alpha[si][gi].ptr<float>(i);
                 g = _g[gi];
 
-                add_mul(betaDst, a, g, gf.w);
+                add_mul(betaDst, a, g, width);
             }
         }
     }
@@ -659,53 +696,85 @@ void GuidedFilterImpl::getWalkPattern(int eid, int &cn1, int &cn2)
     cn2 = wdata[6 * 2 * (gCnNum-1) + 6 + eid];
 }
 
-Ptr<GuidedFilterImpl> GuidedFilterImpl::create(InputArray guide, int radius, double eps)
+Ptr<GuidedFilterImpl> GuidedFilterImpl::create(InputArray guide, int radius, double eps, int scale)
 {
     GuidedFilterImpl *gf = new GuidedFilterImpl();
-    gf->init(guide, radius, eps);
+    gf->init(guide, radius, eps, scale);
     return Ptr<GuidedFilterImpl>(gf);
 }
 
-void GuidedFilterImpl::init(InputArray guide, int radius_, double eps_)
+void GuidedFilterImpl::init(InputArray guide, int radius_, double eps_, int scale_)
 {
-    CV_Assert( !guide.empty() && radius_ >= 0 && eps_ >= 0 );
-    CV_Assert( (guide.depth() == CV_32F || guide.depth() == CV_8U || guide.depth() == CV_16U) && (guide.channels() <= 3) );
+    CV_Assert( radius_ >= 0 && eps_ >= 0 && scale_ >= 1 );
 
-    radius = radius_;
+    fullRadius = radius_;
     eps = eps_;
+    scale = scale_;
+
+    setGuide(guide);
+}
+
+void GuidedFilterImpl::setGuide(InputArray guide)
+{
+    CV_Assert( !guide.empty() );
+    CV_Assert( (guide.depth() == CV_32F || guide.depth() == CV_8U || guide.depth() == CV_16U) && (guide.channels() <= 3) );
+
+    if (guide.depth() == CV_32F)
+    {
+        splitFirstNChannels(guide, guideCnFull, 3);
+    }
+    else
+    {
+        splitFirstNChannels(guide, guideCnRaw, 3);
+        guideCnFull.resize(guideCnRaw.size());
+        parConvertToWorkType(guideCnRaw, guideCnFull);
+    }
 
-    splitFirstNChannels(guide, guideCn, 3);
-    gCnNum = (int)guideCn.size();
-    h = guideCn[0].rows;
-    w = guideCn[0].cols;
+    gCnNum = (int)guideCnFull.size();
+    fullH = guideCnFull[0].rows;
+    fullW = guideCnFull[0].cols;
+
+    if (scale > 1)
+    {
+        h = std::max(1, cvRound((double)fullH / scale));
+        w = std::max(1, cvRound((double)fullW / scale));
+        radius = (fullRadius > 0) ? std::max(1, cvRound((double)fullRadius / scale)) : 0;
+
+        guideCn.resize(gCnNum);
+        parDownsample(guideCnFull, guideCn);
+    }
+    else
+    {
+        h = fullH;
+        w = fullW;
+        radius = fullRadius;
+        guideCn = guideCnFull;
+    }
 
     guideCnMean.resize(gCnNum);
-    parConvertToWorkType(guideCn, guideCn);
     parMeanFilter(guideCn, guideCnMean);
-    
-    SymArray2D<Mat> covars;
+
     computeCovGuide(covars);
     runParBody(ComputeCovGuideInv_ParBody(*this, covars));
-    covars.release();
 }
 
-void GuidedFilterImpl::computeCovGuide(SymArray2D<Mat>& covars)
+void GuidedFilterImpl::computeCovGuide(SymArray2D<Mat>& covars_)
 {
-    covars.create(gCnNum);
-    for (int i = 0; i < covars.total(); i++)
-        covars(i).create(h, w, CV_32FC1);
+    covars_.create(gCnNum);
+    for (int i = 0; i < covars_.total(); i++)
+        covars_(i).create(h, w, CV_32FC1);
 
-    runParBody(MulChannelsGuide_ParBody(*this, covars));
+    runParBody(MulChannelsGuide_ParBody(*this, covars_));
 
-    parMeanFilter(covars.vec, covars.vec);
+    parMeanFilter(covars_.vec, covars_.vec);
 
-    runParBody(ComputeCovGuideFromChannelsMul_ParBody(*this, covars));
+    runParBody(ComputeCovGuideFromChannelsMul_ParBody(*this, covars_));
 }
 
 void GuidedFilterImpl::filter(InputArray src, OutputArray dst, int dDepth /*= -1*/)
 {
     CV_Assert( !src.empty() && (src.depth() == CV_32F || src.depth() == CV_8U) );
-    if (src.rows() != h || src.cols() != w)
+    if (src.rows() != fullH || src.cols() != fullW)
     {
         CV_Error(Error::StsBadSize, "Size of filtering image must be equal to size of guide image");
         return;
@@ -714,19 +783,31 @@ void GuidedFilterImpl::filter(InputArray src, OutputArray dst, int dDepth /*= -1
     if (dDepth == -1) dDepth = src.depth();
     int srcCnNum = src.channels();
 
-    vector<Mat> srcCn(srcCnNum);
-    vector<Mat>& srcCnMean = srcCn;
-    split(src, srcCn);
+    if (src.depth() == CV_32F)
+    {
+        split(src, srcCnFull);
+    }
+    else
+    {
+        split(src, srcCnRaw);
+        srcCnFull.resize(srcCnNum);
+        parConvertToWorkType(srcCnRaw, srcCnFull);
+    }
 
-    if (src.depth() != CV_32F)
+    if (scale > 1)
     {
-        parConvertToWorkType(srcCn, srcCn);
+        srcCn.resize(srcCnNum);
+        parDownsample(srcCnFull, srcCn);
     }
+    else
+    {
+        srcCn = srcCnFull;
+    }
+    vector<Mat>& srcCnMean = srcCn;
 
-    vector<vector<Mat> > covSrcGuide(srcCnNum);
     computeCovGuideAndSrc(srcCn, srcCnMean, covSrcGuide);
 
-    vector<vector<Mat> > alpha(srcCnNum);
+    alpha.resize(srcCnNum);
     for (int si = 0; si < srcCnNum; si++)
     {
         alpha[si].resize(gCnNum);
@@ -734,7 +815,6 @@ void GuidedFilterImpl::filter(InputArray src, OutputArray dst, int dDepth /*= -1
             alpha[si][gi].create(h, w, CV_32FC1);
     }
     runParBody(ComputeAlpha_ParBody(*this, alpha, covSrcGuide));
-    covSrcGuide.clear();
 
     vector<Mat>& beta = srcCnMean;
     runParBody(ComputeBeta_ParBody(*this, alpha, srcCnMean, beta));
@@ -742,13 +822,34 @@ void GuidedFilterImpl::filter(InputArray src, OutputArray dst, int dDepth /*= -1
     parMeanFilter(beta, beta);
     parMeanFilter(alpha, alpha);
 
-    runParBody(ApplyTransform_ParBody(*this, alpha, beta));
+    vector<Mat>& betaDst = (scale > 1) ? betaFull : beta;
+    if (scale > 1)
+    {
+        alphaFull.resize(srcCnNum);
+        for (int si = 0; si < srcCnNum; si++)
+            alphaFull[si].resize(gCnNum);
+        betaFull.resize(srcCnNum);
+
+        parUpsample(alpha, alphaFull);
+        parUpsample(beta, betaFull);
+        parallel_for_(Range(0, fullH), ApplyTransform_ParBody(*this, guideCnFull, alphaFull, betaFull));
+    }
+    else
+    {
+        runParBody(ApplyTransform_ParBody(*this, guideCn, alpha, beta));
+    }
+
     if (dDepth != CV_32F)
     {
+        dstCn.resize(srcCnNum);
         for (int i = 0; i < srcCnNum; i++)
-            beta[i].convertTo(beta[i], dDepth);
+            betaDst[i].convertTo(dstCn[i], dDepth);
+        merge(dstCn, dst);
+    }
+    else
+    {
+        merge(betaDst, dst);
     }
-    merge(beta, dst);
 }
 
 void GuidedFilterImpl::computeCovGuideAndSrc(vector<Mat>& srcCn, vector<Mat>& srcCnMean, vector<vector<Mat> >& cov)
@@ -775,15 +876,15 @@ void GuidedFilterImpl::computeCovGuideAndSrc(vector<Mat>& srcCn, vector<Mat>& sr
 //////////////////////////////////////////////////////////////////////////
 
 CV_EXPORTS_W
-Ptr<GuidedFilter> createGuidedFilter(InputArray guide, int radius, double eps)
+Ptr<GuidedFilter> createGuidedFilter(InputArray guide, int radius, double eps, int scale)
 {
-    return Ptr<GuidedFilter>(GuidedFilterImpl::create(guide, radius, eps));
+    return Ptr<GuidedFilter>(GuidedFilterImpl::create(guide, radius, eps, scale));
 }
 
 CV_EXPORTS_W
-void guidedFilter(InputArray guide, InputArray src, OutputArray dst, int radius, double eps, int dDepth)
+void guidedFilter(InputArray guide, InputArray src, OutputArray dst, int radius, double eps, int dDepth, int scale)
 {
-    Ptr<GuidedFilter> gf = createGuidedFilter(guide, radius, eps);
+    Ptr<GuidedFilter> gf = createGuidedFilter(guide, radius, eps, scale);
     gf->filter(src, dst, dDepth);
 }
 
@@ -59,6 +59,8 @@ void jointBilateralFilter_32f(Mat& joint, Mat& src, Mat& dst, int radius, double
 
 void jointBilateralFilter_8u(Mat& joint, Mat& src, Mat& dst, int radius, double sigmaColor, double sigmaSpace, int borderType);
 
+bool jointBilateralGrid(Mat& joint, Mat& src, Mat& dst, double sigmaColor, double sigmaSpace);
+
 template<typename JointVec, typename SrcVec>
 class JointBilateralFilter_32f : public ParallelLoopBody
 {
@@ -336,20 +338,270 @@ void jointBilateralFilter_8u(Mat& joint, Mat& src, Mat& dst, int radius, double
     }
 }
 
-void jointBilateralFilter(InputArray joint_, InputArray src_, OutputArray dst_, int d, double sigmaColor, double sigmaSpace, int borderType)
+/* Bilateral grid approximation of the joint bilateral filter.
+ * Pixels are splatted into a grid with sampling rates sigmaSpace in space and sigmaColor in each joint
+ * channel, the grid is blurred by a 5-tap binomial kernel along every axis and the result is sliced
+ * back with multilinear interpolation. Cost is linear in the number of pixels and grid cells and does
+ * not depend on the radius. */
+
+static const int kGridPad = 2;
+static const size_t kGridMaxMemory = (size_t)1 << 29;
+
+class BilateralGridBlur_ParBody : public ParallelLoopBody
+{
+    float *grid;
+    int cellCn, axisSize, axisStride, numLines;
+
+public:
+
+    BilateralGridBlur_ParBody(float *grid_, int cellCn_, int axisSize_, int axisStride_, int numLines_)
+        : grid(grid_), cellCn(cellCn_), axisSize(axisSize_), axisStride(axisStride_), numLines(numLines_) {}
+
+    Range getRange() const { return Range(0, numLines); }
+
+    void operator () (const Range& range) const
+    {
+        vector<float> linev((axisSize + 2*kGridPad)*cellCn, 0.0f);
+        float *line = &linev[kGridPad*cellCn];
+
+        for (int l = range.start; l < range.end; l++)
+        {
+            size_t base = (size_t)(l / axisStride) * axisStride * axisSize + (l % axisStride);
+            float *cell = grid + base*cellCn;
+            size_t step = (size_t)axisStride*cellCn;
+
+            for (int i = 0; i < axisSize; i++)
+                for (int c = 0; c < cellCn; c++)
+                    line[i*cellCn + c] = cell[i*step + c];
+
+            for (int i = 0; i < axisSize; i++)
+            {
+                const float *p = line + i*cellCn;
+                for (int c = 0; c < cellCn; c++)
+                {
+                    cell[i*step + c] = (1.0f/16)*(p[c - 2*cellCn] + p[c + 2*cellCn])
+                                     + (4.0f/16)*(p[c - cellCn] + p[c + cellCn])
+                                     + (6.0f/16)*p[c];
+                }
+            }
+        }
+    }
+};
+
+template<int jCn, int srcCn>
+class BilateralGridSlice_ParBody : public ParallelLoopBody
+{
+    const Mat &joint, &src;
+    Mat &dst;
+    const float *grid;
+    const int *dims;
+    const size_t *strides;
+    const float *jointMin;
+    float invSigmaSpace, invSigmaColor;
+
+public:
+
+    BilateralGridSlice_ParBody(const Mat& joint_, const Mat& src_, Mat& dst_, const float *grid_, const int *dims_,
+        const size_t *strides_, const float *jointMin_, float invSigmaSpace_, float invSigmaColor_)
+        : joint(joint_), src(src_), dst(dst_), grid(grid_), dims(dims_), strides(strides_), jointMin(jointMin_),
+        invSigmaSpace(invSigmaSpace_), invSigmaColor(invSigmaColor_) {}
+
+    void operator () (const Range& range) const
+    {
+        const int D = 2 + jCn;
+        const int cellCn = srcCn + 1;
+        const int numCorners = 1 << D;
+
+        for (int i = range.start; i < range.end; i++)
+        {
+            const float *jointRow = joint.ptr<float>(i);
+            float *dstRow = dst.ptr<float>(i);
+
+            for (int j = 0; j < src.cols; j++)
+            {
+                float coord[D];
+                coord[0] = j*invSigmaSpace + kGridPad;
+                coord[1] = i*invSigmaSpace + kGridPad;
+                for (int cn = 0; cn < jCn; cn++)
+                    coord[2 + cn] = (jointRow[j*jCn + cn] - jointMin[cn])*invSigmaColor + kGridPad;
+
+                size_t baseOfs = 0;
+                float frac[D];
+                for (int d = 0; d < D; d++)
+                {
+                    int ic = std::min(cvFloor(coord[d]), dims[d] - 2);
+                    frac[d] = coord[d] - ic;
+                    baseOfs += ic*strides[d];
+                }
+
+                float sum[cellCn];
+                for (int c = 0; c < cellCn; c++)
+                    sum[c] = 0.0f;
+
+                for (int corner = 0; corner < numCorners; corner++)
+                {
+                    float w = 1.0f;
+                    size_t ofs = baseOfs;
+                    for (int d = 0; d < D; d++)
+                    {
+                        if (corner & (1 << d))
+                        {
+                            w *= frac[d];
+                            ofs += strides[d];
+                        }
+                        else
+                        {
+                            w *= 1.0f - frac[d];
+                        }
+                    }
+
+                    const float *cell = grid + ofs*cellCn;
+                    for (int c = 0; c < cellCn; c++)
+                        sum[c] += w*cell[c];
+                }
+
+                float norm = (sum[srcCn] > FLT_EPSILON) ? 1.0f / sum[srcCn] : 0.0f;
+                for (int cn = 0; cn < srcCn; cn++)
+                    dstRow[j*srcCn + cn] = sum[cn] * norm;
+            }
+        }
+    }
+};
+
+template<int jCn, int srcCn>
+static bool jointBilateralGrid_(Mat& joint, Mat& src, Mat& dst, double sigmaColor, double sigmaSpace)
+{
+    const int D = 2 + jCn;
+    const int cellCn = srcCn + 1;
+
+    float jointMin[jCn], jointMax[jCn];
+    for (int cn = 0; cn < jCn; cn++)
+    {
+        jointMin[cn] = FLT_MAX;
+        jointMax[cn] = -FLT_MAX;
+    }
+    for (int i = 0; i < joint.rows; i++)
+    {
+        const float *jointRow = joint.ptr<float>(i);
+        for (int j = 0; j < joint.cols; j++)
+        {
+            for (int cn = 0; cn < jCn; cn++)
+            {
+                float v = jointRow[j*jCn + cn];
+                //non-finite joint values can't be placed on the grid, leave them to the exact filter
+                if (cvIsNaN(v) || cvIsInf(v))
+                    return false;
+                jointMin[cn] = std::min(jointMin[cn], v);
+                jointMax[cn] = std::max(jointMax[cn], v);
+            }
+        }
+    }
+
+    float invSigmaSpace = (float)(1.0 / sigmaSpace);
+    float invSigmaColor = (float)(1.0 / sigmaColor);
+
+    //grid extents are checked against the memory cap in double, before they are converted to int
+    double extents[D];
+    extents[0] = std::floor((src.cols - 1)*(double)invSigmaSpace) + 1 + 2*kGridPad;
+    extents[1] = std::floor((src.rows - 1)*(double)invSigmaSpace) + 1 + 2*kGridPad;
+    for (int cn = 0; cn < jCn; cn++)
+        extents[2 + cn] = std::floor(((double)jointMax[cn] - jointMin[cn])*invSigmaColor) + 1 + 2*kGridPad;
+
+    double numCellsApprox = 1.0;
+    for (int d = 0; d < D; d++)
+        numCellsApprox *= extents[d];
+    if (!(numCellsApprox*cellCn*sizeof(float) <= (double)kGridMaxMemory))
+        return false;
+
+    int dims[D];
+    size_t strides[D];
+    for (int d = 0; d < D; d++)
+        dims[d] = (int)extents[d];
+
+    size_t numCells = 1;
+    for (int d = 0; d < D; d++)
+    {
+        strides[d] = numCells;
+        numCells *= dims[d];
+    }
+
+    vector<float> gridv(numCells*cellCn, 0.0f);
+    float *grid = &gridv[0];
+
+    for (int i = 0; i < src.rows; i++)
+    {
+        const float *jointRow = joint.ptr<float>(i);
+        const float *srcRow = src.ptr<float>(i);
+        size_t rowOfs = (cvRound(i*invSigmaSpace) + kGridPad)*strides[1];
+
+        for (int j = 0; j < src.cols; j++)
+        {
+            size_t ofs = rowOfs + (cvRound(j*invSigmaSpace) + kGridPad)*strides[0];
+            for (int cn = 0; cn < jCn; cn++)
+                ofs += (cvRound((jointRow[j*jCn + cn] - jointMin[cn])*invSigmaColor) + kGridPad)*strides[2 + cn];
+
+            float *cell = grid + ofs*cellCn;
+            for (int cn = 0; cn < srcCn; cn++)
+                cell[cn] += srcRow[j*srcCn + cn];
+            cell[srcCn] += 1.0f;
+        }
+    }
+
+    for (int d = 0; d < D; d++)
+    {
+        BilateralGridBlur_ParBody blur(grid, cellCn, dims[d], (int)strides[d], (int)(numCells / dims[d]));
+        parallel_for_(blur.getRange(), blur);
+    }
+
+    parallel_for_(Range(0, src.rows), BilateralGridSlice_ParBody<jCn, srcCn>(joint, src, dst, grid, dims, strides,
+        jointMin, invSigmaSpace, invSigmaColor));
+
+    return true;
+}
+
+bool jointBilateralGrid(Mat& joint, Mat& src, Mat& dst, double sigmaColor, double sigmaSpace)
+{
+    Mat jointf, srcf, dstf(src.size(), CV_MAKE_TYPE(CV_32F, src.channels()));
+    joint.convertTo(jointf, CV_32F);
+    src.convertTo(srcf, CV_32F);
+
+    bool res = false;
+    if (joint.channels() == 1)
+    {
+        if (src.channels() == 1)
+            res = jointBilateralGrid_<1, 1>(jointf, srcf, dstf, sigmaColor, sigmaSpace);
+        if (src.channels() == 3)
+            res = jointBilateralGrid_<1, 3>(jointf, srcf, dstf, sigmaColor, sigmaSpace);
+    }
+
+    if (joint.channels() == 3)
+    {
+        if (src.channels() == 1)
+            res = jointBilateralGrid_<3, 1>(jointf, srcf, dstf, sigmaColor, sigmaSpace);
+        if (src.channels() == 3)
+            res = jointBilateralGrid_<3, 3>(jointf, srcf, dstf, sigmaColor, sigmaSpace);
+    }
+
+    if (res)
+        dstf.convertTo(dst, dst.type());
+    return res;
+}
+
+void jointBilateralFilter(InputArray joint_, InputArray src_, OutputArray dst_, int d, double sigmaColor, double sigmaSpace, int borderType, int mode)
 {
     CV_Assert(!src_.empty());
+    CV_Assert(mode == JBF_EXACT || mode == JBF_GRID);
 
-    if (joint_.empty())
+    if (joint_.empty() && mode == JBF_EXACT)
     {
         bilateralFilter(src_, dst_, d, sigmaColor, sigmaSpace, borderType);
         return;
     }
 
     Mat src = src_.getMat();
-    Mat joint = joint_.getMat();
+    Mat joint = joint_.empty() ? src : joint_.getMat();
 
-    if (src.data == joint.data)
+    if (src.data == joint.data && mode == JBF_EXACT)
     {
         bilateralFilter(src_, dst_, d, sigmaColor, sigmaSpace, borderType);
         return;
@@ -383,6 +635,10 @@ void jointBilateralFilter(InputArray joint_, InputArray src_, OutputArray dst_,
 
     if ( (srcCnNum == 1 || srcCnNum == 3) && (jointCnNum == 1 || jointCnNum == 3) )
     {
+        //fall back to the exact filter if the grid doesn't fit into the memory budget (too small sigmaColor)
+        if (mode == JBF_GRID && jointBilateralGrid(joint, src, dst, sigmaColor, sigmaSpace))
+            return;
+
         if (joint.depth() == CV_8U)
         {
             jointBilateralFilter_8u(joint, src, dst, radius, sigmaColor, sigmaSpace, borderType);
@@ -163,6 +163,41 @@ TEST(AdaptiveManifoldTest, AuthorsReferenceAccuracy)
     }
 }
 
+TEST(AdaptiveManifoldTest, StoredManifolds)
+{
+    Mat guide = imread(getOpenCVExtraDir() + "cv/edgefilter/kodim23.png");
+    Mat src1 = imread(getOpenCVExtraDir() + "cv/shared/lena.png");
+    Mat src2 = imread(getOpenCVExtraDir() + "cv/npr/test4.png", IMREAD_GRAYSCALE);
+    ASSERT_TRUE(!guide.empty() && !src1.empty() && !src2.empty());
+    resize(src1, src1, guide.size());
+    resize(src2, src2, guide.size());
+
+    cv::setNumThreads(cv::getNumberOfCPUs());
+
+    for (int i = 0; i < 2; i++)
+    {
+        bool adjust_outliers = (i == 1);
+        Ptr<AdaptiveManifoldFilter> amf = createAMFilter(20.0, 0.25, adjust_outliers);
+        amf->setUseRNG(false);
+        amf->buildManifolds(guide);
+
+        Mat res1, res2, resRef1, resRef2;
+        amf->filterWithManifolds(src1, res1);
+        amf->filterWithManifolds(src2, res2);
+
+        amf->filter(src1, resRef1, guide);
+        amf->filter(src2, resRef2, guide);
+
+        //stored manifolds must survive filter() calls
+        Mat res1Again;
+        amf->filterWithManifolds(src1, res1Again);
+
+        checkSimilarity(res1, resRef1, 1, 1.0 / 1024);
+        checkSimilarity(res2, resRef2, 1, 1.0 / 1024);
+        EXPECT_EQ(0, cvtest::norm(res1, res1Again, NORM_INF));
+    }
+}
+
 typedef tuple<string, string> AMRefTestParams;
 typedef TestWithParam<AMRefTestParams> AdaptiveManifoldRefImplTest;
 
@@ -183,6 +183,10 @@ namespace
 
         void filter(InputArray src, OutputArray dst, InputArray joint);
 
+        void buildManifolds(InputArray) { CV_Error(Error::StsNotImplemented, "Reference implementation doesn't store manifolds"); }
+
+        void filterWithManifolds(InputArray, OutputArray) { CV_Error(Error::StsNotImplemented, "Reference implementation doesn't store manifolds"); }
+
         void collectGarbage();
 
         CV_IMPL_PROPERTY(double, SigmaS, sigma_s_)
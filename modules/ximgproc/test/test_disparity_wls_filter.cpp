@@ -96,6 +96,121 @@ TEST(DisparityWLSFilterTest, ReferenceAccuracy)
     EXPECT_LE(BadPercent,ref_BadPercent+eps*ref_BadPercent);
 }
 
+TEST(DisparityWLSFilterTest, TemporalMode)
+{
+    string dir = getDataDir() + "cv/disparityfilter";
+
+    Mat left = imread(dir + "/left_view.png",IMREAD_COLOR);
+    ASSERT_FALSE(left.empty());
+    Mat left_disp  = imread(dir + "/disparity_left_raw.png",IMREAD_GRAYSCALE);
+    ASSERT_FALSE(left_disp.empty());
+    left_disp.convertTo(left_disp,CV_16S,16);
+    Mat right_disp = imread(dir + "/disparity_right_raw.png",IMREAD_GRAYSCALE);
+    ASSERT_FALSE(right_disp.empty());
+    right_disp.convertTo(right_disp,CV_16S,-16);
+
+    FileStorage ROI_storage( dir + "/ROI.xml", FileStorage::READ );
+    Rect ROI((int)ROI_storage["x"],(int)ROI_storage["y"],(int)ROI_storage["width"],(int)ROI_storage["height"]);
+
+    cv::setNumThreads(cv::getNumberOfCPUs());
+    Ptr<DisparityWLSFilter> wls_filter = createDisparityWLSFilterGeneric(true);
+    wls_filter->setLambda(8000.0);
+    wls_filter->setSigmaColor(0.5);
+
+    Mat res, res_first, res_second, res_after_reset;
+    wls_filter->filter(left_disp,left,res,right_disp,ROI);
+
+    wls_filter->setTemporalWeight(0.5);
+    wls_filter->filter(left_disp,left,res_first,right_disp,ROI);
+    wls_filter->filter(left_disp,left,res_second,right_disp,ROI);
+    wls_filter->setTemporalWeight(0.5);
+    wls_filter->filter(left_disp,left,res_after_reset,right_disp,ROI);
+
+    //first frame has no history, a static scene has to stay (almost) the same:
+    EXPECT_EQ(0.0, cv::norm(res, res_first, NORM_INF));
+    EXPECT_LE(cv::norm(res_first, res_second, NORM_INF), 1.0);
+    EXPECT_EQ(0.0, cv::norm(res_first, res_after_reset, NORM_INF));
+}
+
+TEST(DisparityWLSFilterTest, TemporalModeWithoutConfidence)
+{
+    string dir = getDataDir() + "cv/disparityfilter";
+
+    Mat left = imread(dir + "/left_view.png",IMREAD_COLOR);
+    ASSERT_FALSE(left.empty());
+    Mat left_disp  = imread(dir + "/disparity_left_raw.png",IMREAD_GRAYSCALE);
+    ASSERT_FALSE(left_disp.empty());
+    left_disp.convertTo(left_disp,CV_16S,16);
+
+    Ptr<DisparityWLSFilter> wls_filter = createDisparityWLSFilterGeneric(false);
+    Mat res, res_first, res_second;
+    wls_filter->filter(left_disp,left,res);
+
+    wls_filter->setTemporalWeight(0.5);
+    wls_filter->filter(left_disp,left,res_first);
+    wls_filter->filter(left_disp,left,res_second);
+
+    //the prior enters the data term as in the confidence mode, a static scene has to stay (almost) the same:
+    EXPECT_LE(cv::norm(res, res_first, NORM_INF), 1.0);
+    EXPECT_LE(cv::norm(res_first, res_second, NORM_INF), 1.0);
+}
+
+TEST(DisparityWLSFilterTest, SmootherReuse)
+{
+    string dir = getDataDir() + "cv/disparityfilter";
+
+    Mat left = imread(dir + "/left_view.png",IMREAD_COLOR);
+    ASSERT_FALSE(left.empty());
+    Mat left_disp  = imread(dir + "/disparity_left_raw.png",IMREAD_GRAYSCALE);
+    ASSERT_FALSE(left_disp.empty());
+    left_disp.convertTo(left_disp,CV_16S,16);
+    Mat right_disp = imread(dir + "/disparity_right_raw.png",IMREAD_GRAYSCALE);
+    ASSERT_FALSE(right_disp.empty());
+    right_disp.convertTo(right_disp,CV_16S,-16);
+
+    //a second frame with another guide of the same size
+    Mat other_left;
+    GaussianBlur(left,other_left,Size(5,5),2.0);
+
+    for(int use_conf = 0; use_conf <= 1; use_conf++)
+    {
+        Ptr<DisparityWLSFilter> reused = createDisparityWLSFilterGeneric(use_conf != 0);
+        Ptr<DisparityWLSFilter> fresh  = createDisparityWLSFilterGeneric(use_conf != 0);
+        Mat res, res_reused, res_fresh;
+        reused->filter(left_disp,left,res,right_disp);
+        reused->filter(left_disp,other_left,res_reused,right_disp);
+        fresh->filter(left_disp,other_left,res_fresh,right_disp);
+
+        //the smoother kept between the calls is fully set up for the new guide:
+        EXPECT_EQ(0.0, cv::norm(res_reused, res_fresh, NORM_INF)) << "use_conf = " << use_conf;
+    }
+}
+
+TEST(DisparityWLSFilterTest, ConfidenceMapOwnership)
+{
+    string dir = getDataDir() + "cv/disparityfilter";
+
+    Mat left = imread(dir + "/left_view.png",IMREAD_COLOR);
+    ASSERT_FALSE(left.empty());
+    Mat left_disp  = imread(dir + "/disparity_left_raw.png",IMREAD_GRAYSCALE);
+    ASSERT_FALSE(left_disp.empty());
+    left_disp.convertTo(left_disp,CV_16S,16);
+    Mat right_disp = imread(dir + "/disparity_right_raw.png",IMREAD_GRAYSCALE);
+    ASSERT_FALSE(right_disp.empty());
+    right_disp.convertTo(right_disp,CV_16S,-16);
+
+    Ptr<DisparityWLSFilter> wls_filter = createDisparityWLSFilterGeneric(true);
+    Mat res;
+    wls_filter->filter(left_disp,left,res,right_disp);
+    Mat conf = wls_filter->getConfidenceMap();
+    Mat conf_copy = conf.clone();
+
+    //the map of the previous call must not be overwritten by the next one:
+    Mat other_left_disp = left_disp/2, other_right_disp = right_disp/2;
+    wls_filter->filter(other_left_disp,left,res,other_right_disp);
+    EXPECT_EQ(0.0, cv::norm(conf, conf_copy, NORM_INF));
+}
+
 TEST_P(DisparityWLSFilterTest, MultiThreadReproducibility)
 {
     if (cv::getNumberOfCPUs() == 1)
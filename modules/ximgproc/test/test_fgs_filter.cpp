@@ -106,6 +106,26 @@ TEST(FastGlobalSmootherTest, ReferenceAccuracy)
     EXPECT_LE(cvtest::norm(res, ref, NORM_INF), 1);
 }
 
+TEST(FastGlobalSmootherTest, MultiLevelAccuracy)
+{
+    string dir = getDataDir() + "cv/edgefilter";
+
+    Mat src = imread(dir + "/kodim23.png");
+    ASSERT_FALSE(src.empty());
+
+    cv::setNumThreads(cv::getNumberOfCPUs());
+    Mat res, resMultiLevel;
+    fastGlobalSmootherFilter(src,src,res,1000.0,10.0);
+    fastGlobalSmootherFilter(src,src,resMultiLevel,1000.0,10.0,0.25,3,3);
+
+    double normL1 = cvtest::norm(res, resMultiLevel, NORM_L1)/src.total()/src.channels();
+    EXPECT_LE(normL1, 2.0);
+
+    Mat surface(src.size(), CV_16SC1, Scalar(1000));
+    fastGlobalSmootherFilter(src,surface,resMultiLevel,1000.0,10.0,0.25,3,3);
+    EXPECT_LE(cvtest::norm(surface, resMultiLevel, NORM_L1)/src.total(), 1.0/64);
+}
+
 TEST_P(FastGlobalSmootherTest, MultiThreadReproducibility)
 {
     if (cv::getNumberOfCPUs() == 1)
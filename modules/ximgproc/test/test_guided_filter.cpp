@@ -131,6 +131,8 @@ public:
 
     void filter(InputArray src, OutputArray dst, int dDepth = -1);
 
+    void setGuide(InputArray) { CV_Error(Error::StsNotImplemented, "Reference implementation doesn't support guide replacement"); }
+
     ~GuidedFilterRefImpl();
 };
 
@@ -395,4 +397,59 @@ INSTANTIATE_TEST_CASE_P(TypicalSet, GuidedFilterTest,
     Values("cv/shared/lena.png", "cv/shared/baboon.png", "cv/npr/test2.png")
 ));
 
-}
\ No newline at end of file
+TEST(GuidedFilterTest, setGuide)
+{
+    Mat guide1 = imread(getOpenCVExtraDir() + "cv/shared/lena.png");
+    Mat guide2 = imread(getOpenCVExtraDir() + "cv/shared/baboon.png");
+    ASSERT_TRUE(!guide1.empty() && !guide2.empty());
+    resize(guide2, guide2, guide1.size());
+    Mat src = guide1.clone();
+
+    int radius = 8;
+    double eps = 100.0;
+
+    Mat res, resRef;
+    Ptr<GuidedFilter> gf = createGuidedFilter(guide1, radius, eps);
+    gf->filter(src, res);
+    gf->setGuide(guide2);
+    gf->filter(src, res);
+
+    guidedFilter(guide2, src, resRef, radius, eps);
+    EXPECT_EQ(0.0, cv::norm(res, resRef, NORM_INF));
+}
+
+typedef tuple<int, int, string> FastGFParams;
+typedef TestWithParam<FastGFParams> FastGuidedFilterTest;
+
+TEST_P(FastGuidedFilterTest, accuracy)
+{
+    FastGFParams params = GetParam();
+
+    int guideCnNum = get<0>(params);
+    int scale = get<1>(params);
+    string srcFileName = get<2>(params);
+
+    Mat src = imread(getOpenCVExtraDir() + srcFileName);
+    ASSERT_TRUE(!src.empty());
+    Mat guide = convertTypeAndSize(src, CV_MAKE_TYPE(src.depth(), guideCnNum), src.size());
+
+    int radius = 16;
+    double eps = SQR(0.1*255.0);
+
+    cv::setNumThreads(cv::getNumberOfCPUs());
+    Mat res, resRef;
+    guidedFilter(guide, src, res, radius, eps, -1, scale);
+    guidedFilter(guide, src, resRef, radius, eps, -1, 1);
+
+    double normL1 = cv::norm(res, resRef, NORM_L1) / (src.total()*src.channels());
+    EXPECT_LE(normL1, 3.0);
+}
+
+INSTANTIATE_TEST_CASE_P(TypicalSet, FastGuidedFilterTest,
+    Combine(
+    Values(1, 3),
+    Values(2, 4),
+    Values("cv/shared/lena.png", "cv/shared/baboon.png")
+));
+
+}
@@ -289,4 +289,52 @@ INSTANTIATE_TEST_CASE_P(Set1, JointBilateralFilterTest_BilateralRef,
     )
 );
 
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+typedef tuple<double, string, int, int, int> JBFGridTestParam;
+typedef TestWithParam<JBFGridTestParam> JointBilateralFilterTest_GridApprox;
+
+TEST_P(JointBilateralFilterTest_GridApprox, Accuracy)
+{
+    JBFGridTestParam param = GetParam();
+    double sigmaS       = get<0>(param);
+    string srcPath      = get<1>(param);
+    int depth           = get<2>(param);
+    int jCn             = get<3>(param);
+    int srcCn           = get<4>(param);
+
+    Mat img = imread(getOpenCVExtraDir() + srcPath);
+    ASSERT_TRUE(!img.empty());
+
+    Mat joint = convertTypeAndSize(img, CV_MAKE_TYPE(depth, jCn), img.size());
+    Mat src = convertTypeAndSize(img, CV_MAKE_TYPE(depth, srcCn), img.size());
+    double sigmaC = 32.0;
+
+    Mat resNaive;
+    jointBilateralFilterNaive(joint, src, resNaive, 0, sigmaC, sigmaS);
+
+    cv::setNumThreads(cv::getNumberOfCPUs());
+    Mat res;
+    jointBilateralFilter(joint, src, res, 0, sigmaC, sigmaS, BORDER_DEFAULT, JBF_GRID);
+    cv::setNumThreads(1);
+
+    double meanAbsErr = cvtest::norm(res, resNaive, NORM_L1) / (src.total()*src.channels());
+    double rmsErr = cvtest::norm(res, resNaive, NORM_L2) / std::sqrt((double)(src.total()*src.channels()));
+    RecordProperty("mean_abs_error", cv::format("%.3f", meanAbsErr).c_str());
+    RecordProperty("rms_error", cv::format("%.3f", rmsErr).c_str());
+
+    EXPECT_LE(meanAbsErr, (jCn == 1) ? 4.0 : 8.0);
+    EXPECT_LE(rmsErr, (jCn == 1) ? 8.0 : 14.0);
+}
+
+INSTANTIATE_TEST_CASE_P(Set3, JointBilateralFilterTest_GridApprox,
+    Combine(
+    Values(4.0, 8.0),
+    Values("/cv/shared/lena.png", "/cv/shared/fruits.png"),
+    Values(CV_8U, CV_32F),
+    Values(1, 3),
+    Values(1, 3))
+);
+
 }
\ No newline at end of file